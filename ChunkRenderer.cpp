@@ -0,0 +1,459 @@
+#include "ChunkRenderer.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLFunctions_4_4_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector4D>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <map>
+
+namespace {
+
+const char *const PATH_NAMES[] = {"legacy", "core", "indirect"};
+
+const char *const VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec4 colour;\n"
+    "uniform mat4 transform;\n"
+    "out vec4 shade;\n"
+    "void main() {\n"
+    "    gl_Position = transform * vec4(position, 1.0);\n"
+    "    shade = colour;\n"
+    "}\n";
+
+const char *const FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec4 shade;\n"
+    "out vec4 fragment;\n"
+    "void main() {\n"
+    "    fragment = shade;\n"
+    "}\n";
+
+// Ring parts in flight: the one being written and up to two frames the
+// GPU may still be reading.
+const int RING_SEGMENTS = 3;
+const size_t RING_SEGMENT_BYTES = 8u << 20;
+const size_t RING_ALIGNMENT = 16;
+const GLuint64 FENCE_TIMEOUT_NS = 1000000000ull;
+
+const size_t INITIAL_VERTICES = 1u << 20;
+const size_t INITIAL_INDICES = 1u << 21;
+
+// Layout glMultiDrawElementsIndirect reads.
+struct DrawCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+} // namespace
+
+// One shared GL buffer holding the vertices or indices of every chunk,
+// handed out in ranges of elements (first fit) and doubled when full.
+struct ChunkRenderer::Arena {
+    size_t stride;
+    size_t capacity;
+    GLuint buffer;
+    std::map<size_t, size_t> free;  // first element -> count
+
+    explicit Arena(size_t stride) : stride(stride), capacity(0), buffer(0) {}
+
+    bool allocate(size_t count, size_t &first) {
+        for (auto it = free.begin(); it != free.end(); ++it) {
+            if (it->second < count) {
+                continue;
+            }
+            first = it->first;
+            size_t left = it->second - count;
+            free.erase(it);
+            if (left) {
+                free[first + count] = left;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void release(size_t first, size_t count) {
+        auto next = free.lower_bound(first);
+        if (next != free.end() && first + count == next->first) {
+            count += next->second;
+            next = free.erase(next);
+        }
+        if (next != free.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == first) {
+                previous->second += count;
+                return;
+            }
+        }
+        free[first] = count;
+    }
+
+    // Moves everything into a buffer with room for at least count more.
+    void grow(QOpenGLFunctions_3_3_Core *gl, size_t count) {
+        size_t grown = std::max(capacity * 2, capacity + count);
+        GLuint replacement = 0;
+        gl->glGenBuffers(1, &replacement);
+        gl->glBindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+        gl->glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(grown * stride), nullptr, GL_STATIC_DRAW);
+        if (buffer) {
+            gl->glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(capacity * stride));
+            gl->glDeleteBuffers(1, &buffer);
+        }
+        buffer = replacement;
+        release(capacity, grown - capacity);
+        capacity = grown;
+    }
+
+    void destroy(QOpenGLFunctions_3_3_Core *gl) {
+        if (buffer) {
+            gl->glDeleteBuffers(1, &buffer);
+        }
+        buffer = 0;
+        capacity = 0;
+        free.clear();
+    }
+};
+
+ChunkRenderer::ChunkRenderer()
+    : mPath(PATH_LEGACY), mInitialized(false), mCore(nullptr), mIndirect(nullptr), mVertexArray(0),
+      mLayoutDirty(true), mRing(0), mRingData(nullptr), mSegment(0), mSegmentUsed(0) {
+    std::fill(mFences, mFences + RING_SEGMENTS, nullptr);
+}
+
+ChunkRenderer::~ChunkRenderer() {
+    // Without a current context the GL objects go with the context.
+}
+
+const char *ChunkRenderer::pathName(Path path) {
+    return PATH_NAMES[path];
+}
+
+bool ChunkRenderer::parsePath(const char *name, Path &path) {
+    for (int p = PATH_LEGACY; p <= PATH_INDIRECT; ++p) {
+        if (std::strcmp(name, PATH_NAMES[p]) == 0) {
+            path = Path(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+ChunkRenderer::Path ChunkRenderer::getPath() const {
+    return mPath;
+}
+
+bool ChunkRenderer::supports(Path path) const {
+    switch (path) {
+    case PATH_LEGACY:
+        return QOpenGLContext::currentContext()->format().profile() != QSurfaceFormat::CoreProfile;
+    case PATH_CORE:
+        return mCore != nullptr;
+    case PATH_INDIRECT:
+        return mCore != nullptr && mIndirect != nullptr;
+    }
+    return false;
+}
+
+void ChunkRenderer::initialize(Path preferred) {
+    release();
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    mCore = context->versionFunctions<QOpenGLFunctions_3_3_Core>();
+    if (mCore && !mCore->initializeOpenGLFunctions()) {
+        mCore = nullptr;
+    }
+    mIndirect = context->versionFunctions<QOpenGLFunctions_4_4_Core>();
+    if (mIndirect && !mIndirect->initializeOpenGLFunctions()) {
+        mIndirect = nullptr;
+    }
+
+    // The preferred path or the best one below it, else the first above.
+    mPath = preferred;
+    while (mPath > PATH_LEGACY && !supports(mPath)) {
+        mPath = Path(mPath - 1);
+    }
+    for (int p = preferred + 1; !supports(mPath) && p <= PATH_INDIRECT; ++p) {
+        mPath = Path(p);
+    }
+    mInitialized = true;
+    if (mPath == PATH_LEGACY) {
+        return;
+    }
+
+    mProgram.reset(new QOpenGLShaderProgram());
+    mProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, VERTEX_SHADER);
+    mProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, FRAGMENT_SHADER);
+    mProgram->link();
+    mCore->glGenVertexArrays(1, &mVertexArray);
+    mVertices.reset(new Arena(sizeof(vox::MeshVertex)));
+    mIndices.reset(new Arena(sizeof(uint32_t)));
+    mVertices->grow(mCore, INITIAL_VERTICES);
+    mIndices->grow(mCore, INITIAL_INDICES);
+    mLayoutDirty = true;
+
+    if (mPath == PATH_INDIRECT) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr bytes = GLsizeiptr(RING_SEGMENTS * RING_SEGMENT_BYTES);
+        mIndirect->glGenBuffers(1, &mRing);
+        mIndirect->glBindBuffer(GL_COPY_READ_BUFFER, mRing);
+        mIndirect->glBufferStorage(GL_COPY_READ_BUFFER, bytes, nullptr, flags);
+        mRingData = static_cast<uint8_t *>(mIndirect->glMapBufferRange(GL_COPY_READ_BUFFER, 0, bytes, flags));
+        mSegment = 0;
+        mSegmentUsed = 0;
+    }
+}
+
+void ChunkRenderer::release() {
+    mChunks.clear();
+    mVisible.clear();
+    if (!mInitialized) {
+        return;
+    }
+    mInitialized = false;
+    if (mCore) {
+        for (GLsync &fence : mFences) {
+            if (fence) {
+                mCore->glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        if (mRing) {
+            mCore->glBindBuffer(GL_COPY_READ_BUFFER, mRing);
+            mCore->glUnmapBuffer(GL_COPY_READ_BUFFER);
+            mCore->glDeleteBuffers(1, &mRing);
+        }
+        if (mVertexArray) {
+            mCore->glDeleteVertexArrays(1, &mVertexArray);
+        }
+        if (mVertices) {
+            mVertices->destroy(mCore);
+            mIndices->destroy(mCore);
+        }
+    }
+    mRing = 0;
+    mRingData = nullptr;
+    mVertexArray = 0;
+    mVertices.reset();
+    mIndices.reset();
+    mProgram.reset();
+}
+
+void ChunkRenderer::beginFrame() {
+    if (mPath != PATH_INDIRECT) {
+        return;
+    }
+    mSegment = (mSegment + 1) % RING_SEGMENTS;
+    mSegmentUsed = 0;
+    GLsync &fence = mFences[mSegment];
+    if (fence) {
+        while (mCore->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS) == GL_TIMEOUT_EXPIRED) {
+        }
+        mCore->glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+bool ChunkRenderer::stage(const void *data, size_t bytes, size_t &offset) {
+    if (!mRingData || mSegmentUsed + bytes > RING_SEGMENT_BYTES) {
+        return false;
+    }
+    offset = size_t(mSegment) * RING_SEGMENT_BYTES + mSegmentUsed;
+    std::memcpy(mRingData + offset, data, bytes);
+    mSegmentUsed += (bytes + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+    return true;
+}
+
+void ChunkRenderer::write(Arena &arena, size_t first, size_t count, const void *data) {
+    const size_t bytes = count * arena.stride;
+    size_t offset;
+    if (mPath == PATH_INDIRECT && stage(data, bytes, offset)) {
+        // A copy on the GPU: the draw that reads it is ordered after it.
+        mCore->glBindBuffer(GL_COPY_READ_BUFFER, mRing);
+        mCore->glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+        mCore->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(offset),
+                                   GLintptr(first * arena.stride), GLsizeiptr(bytes));
+        return;
+    }
+    // Larger than what is left of the ring this frame.
+    mCore->glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+    mCore->glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(first * arena.stride), GLsizeiptr(bytes), data);
+}
+
+void ChunkRenderer::upload(const vox::Vec3i &chunk, const vox::ChunkMesh &mesh) {
+    remove(chunk);
+    if (mesh.empty()) {
+        return;
+    }
+    Entry entry;
+    entry.vertexCount = mesh.vertices.size();
+    entry.indexCount = mesh.indices.size();
+    entry.firstVertex = 0;
+    entry.firstIndex = 0;
+    const vox::MeshVertex &first = mesh.vertices[0];
+    entry.min[0] = entry.max[0] = first.x;
+    entry.min[1] = entry.max[1] = first.y;
+    entry.min[2] = entry.max[2] = first.z;
+    for (const vox::MeshVertex &v : mesh.vertices) {
+        entry.min[0] = std::min(entry.min[0], v.x);
+        entry.min[1] = std::min(entry.min[1], v.y);
+        entry.min[2] = std::min(entry.min[2], v.z);
+        entry.max[0] = std::max(entry.max[0], v.x);
+        entry.max[1] = std::max(entry.max[1], v.y);
+        entry.max[2] = std::max(entry.max[2], v.z);
+    }
+
+    if (mPath == PATH_LEGACY) {
+        entry.vertices = mesh.vertices;
+        entry.indices = mesh.indices;
+    } else {
+        if (!mVertices->allocate(entry.vertexCount, entry.firstVertex)) {
+            mVertices->grow(mCore, entry.vertexCount);
+            mVertices->allocate(entry.vertexCount, entry.firstVertex);
+            mLayoutDirty = true;
+        }
+        if (!mIndices->allocate(entry.indexCount, entry.firstIndex)) {
+            mIndices->grow(mCore, entry.indexCount);
+            mIndices->allocate(entry.indexCount, entry.firstIndex);
+            mLayoutDirty = true;
+        }
+        write(*mVertices, entry.firstVertex, entry.vertexCount, mesh.vertices.data());
+        write(*mIndices, entry.firstIndex, entry.indexCount, mesh.indices.data());
+    }
+    mChunks[chunk] = std::move(entry);
+}
+
+void ChunkRenderer::remove(const vox::Vec3i &chunk) {
+    auto it = mChunks.find(chunk);
+    if (it == mChunks.end()) {
+        return;
+    }
+    if (mPath != PATH_LEGACY) {
+        mVertices->release(it->second.firstVertex, it->second.vertexCount);
+        mIndices->release(it->second.firstIndex, it->second.indexCount);
+    }
+    mChunks.erase(it);
+}
+
+// The vertex array records the buffers it reads, so it is set up again
+// whenever an arena moved to a bigger buffer.
+void ChunkRenderer::bindLayout() {
+    mCore->glBindVertexArray(mVertexArray);
+    if (!mLayoutDirty) {
+        return;
+    }
+    const GLsizei stride = sizeof(vox::MeshVertex);
+    mCore->glBindBuffer(GL_ARRAY_BUFFER, mVertices->buffer);
+    mCore->glEnableVertexAttribArray(0);
+    mCore->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                                 reinterpret_cast<const void *>(offsetof(vox::MeshVertex, x)));
+    mCore->glEnableVertexAttribArray(1);
+    mCore->glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                                 reinterpret_cast<const void *>(offsetof(vox::MeshVertex, r)));
+    mCore->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndices->buffer);
+    mLayoutDirty = false;
+}
+
+// Planes of the view frustum straight from the combined matrix (Gribb and
+// Hartmann); a box is out when its corner furthest along a plane's normal
+// is behind it.
+void ChunkRenderer::cull(const QMatrix4x4 &transform) {
+    const QVector4D x = transform.row(0), y = transform.row(1), z = transform.row(2), w = transform.row(3);
+    const QVector4D planes[6] = {w + x, w - x, w + y, w - y, w + z, w - z};
+    mVisible.clear();
+    for (const auto &item : mChunks) {
+        const Entry &entry = item.second;
+        bool inside = true;
+        for (const QVector4D &plane : planes) {
+            float px = plane.x() > 0.0f ? entry.max[0] : entry.min[0];
+            float py = plane.y() > 0.0f ? entry.max[1] : entry.min[1];
+            float pz = plane.z() > 0.0f ? entry.max[2] : entry.min[2];
+            if (plane.x() * px + plane.y() * py + plane.z() * pz + plane.w() < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) {
+            mVisible.push_back(&entry);
+        }
+    }
+}
+
+void ChunkRenderer::draw(const QMatrix4x4 &projection, const QMatrix4x4 &view, const QMatrix4x4 &model) {
+    const QMatrix4x4 transform = projection * view * model;
+    cull(transform);
+
+    if (mPath == PATH_LEGACY) {
+        const QMatrix4x4 modelView = view * model;
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projection.constData());
+        glMatrixMode(GL_MODELVIEW);
+        glLoadMatrixf(modelView.constData());
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        for (const Entry *entry : mVisible) {
+            glVertexPointer(3, GL_FLOAT, sizeof(vox::MeshVertex), &entry->vertices[0].x);
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(vox::MeshVertex), &entry->vertices[0].r);
+            glDrawElements(GL_TRIANGLES, GLsizei(entry->indexCount), GL_UNSIGNED_INT, entry->indices.data());
+        }
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        return;
+    }
+
+    mProgram->bind();
+    mProgram->setUniformValue("transform", transform);
+    bindLayout();
+
+    bool drawn = false;
+    if (mPath == PATH_INDIRECT && !mVisible.empty()) {
+        std::vector<DrawCommand> commands;
+        commands.reserve(mVisible.size());
+        for (const Entry *entry : mVisible) {
+            commands.push_back(DrawCommand{GLuint(entry->indexCount), 1, GLuint(entry->firstIndex),
+                                           GLint(entry->firstVertex), 0});
+        }
+        size_t offset;
+        if (stage(commands.data(), commands.size() * sizeof(DrawCommand), offset)) {
+            mIndirect->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mRing);
+            mIndirect->glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                                   reinterpret_cast<const void *>(offset),
+                                                   GLsizei(commands.size()), 0);
+            mIndirect->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            drawn = true;
+        }
+    }
+    if (!drawn) {
+        for (const Entry *entry : mVisible) {
+            mCore->glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(entry->indexCount), GL_UNSIGNED_INT,
+                                            reinterpret_cast<const void *>(entry->firstIndex * sizeof(uint32_t)),
+                                            GLint(entry->firstVertex));
+        }
+    }
+    mCore->glBindVertexArray(0);
+    mProgram->release();
+
+    if (mPath == PATH_INDIRECT) {
+        // The ring part this frame wrote is free again once this passes.
+        if (mFences[mSegment]) {
+            mCore->glDeleteSync(mFences[mSegment]);
+        }
+        mFences[mSegment] = mCore->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+size_t ChunkRenderer::getChunkCount() const {
+    return mChunks.size();
+}
+
+size_t ChunkRenderer::getDrawnChunkCount() const {
+    return mVisible.size();
+}
@@ -0,0 +1,105 @@
+#ifndef CHUNKRENDERER_H
+#define CHUNKRENDERER_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkMesher.h"
+
+class QOpenGLFunctions_3_3_Core;
+class QOpenGLFunctions_4_4_Core;
+class QOpenGLShaderProgram;
+
+// Draws the chunk meshes of the OpenGL editor. Three paths, the best one
+// the context supports is used:
+//   PATH_INDIRECT  GL 4.4: meshes are streamed through a persistently
+//                  mapped ring buffer into two shared buffers and every
+//                  visible chunk goes out in one multi-draw-indirect call.
+//   PATH_CORE      GL 3.3: the same shared buffers filled with
+//                  glBufferSubData, one draw per visible chunk.
+//   PATH_LEGACY    fixed function client arrays, for old compatibility
+//                  contexts; a core profile context has no such path.
+// All of them draw with the vertex colours (light is baked in) and skip
+// chunks outside the view frustum.
+//
+// Every call needs the widget's context current.
+class ChunkRenderer {
+public:
+    enum Path {
+        PATH_LEGACY,
+        PATH_CORE,
+        PATH_INDIRECT
+    };
+
+    ChunkRenderer();
+    ~ChunkRenderer();
+
+    // Uses preferred if the context has it, else the nearest path it has.
+    void initialize(Path preferred);
+    // Frees the GL objects and every uploaded mesh.
+    void release();
+
+    Path getPath() const;
+    static const char *pathName(Path path);
+    static bool parsePath(const char *name, Path &path);
+
+    // Start of a frame, before uploads: waits until the GPU is done with
+    // the part of the ring this frame writes to.
+    void beginFrame();
+
+    // Replaces the mesh of a chunk; an empty mesh removes it.
+    void upload(const vox::Vec3i &chunk, const vox::ChunkMesh &mesh);
+    void remove(const vox::Vec3i &chunk);
+
+    // model takes the mesh coordinates (world voxels) into the scene.
+    void draw(const QMatrix4x4 &projection, const QMatrix4x4 &view, const QMatrix4x4 &model);
+
+    size_t getChunkCount() const;
+    size_t getDrawnChunkCount() const;
+
+private:
+    struct Arena;
+
+    struct Entry {
+        float min[3];
+        float max[3];
+        size_t firstVertex;
+        size_t vertexCount;
+        size_t firstIndex;
+        size_t indexCount;
+        // PATH_LEGACY keeps the mesh itself, the others keep it on the GPU.
+        std::vector<vox::MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    bool supports(Path path) const;
+    void write(Arena &arena, size_t first, size_t count, const void *data);
+    // Copies data into this frame's part of the ring, false if it is full.
+    bool stage(const void *data, size_t bytes, size_t &offset);
+    void bindLayout();
+    void cull(const QMatrix4x4 &transform);
+
+    Path mPath;
+    bool mInitialized;
+    QOpenGLFunctions_3_3_Core *mCore;
+    QOpenGLFunctions_4_4_Core *mIndirect;
+    std::unique_ptr<QOpenGLShaderProgram> mProgram;
+    GLuint mVertexArray;
+    bool mLayoutDirty;
+    std::unique_ptr<Arena> mVertices;
+    std::unique_ptr<Arena> mIndices;
+
+    GLuint mRing;
+    uint8_t *mRingData;
+    GLsync mFences[3];
+    int mSegment;
+    size_t mSegmentUsed;
+
+    std::unordered_map<vox::Vec3i, Entry, vox::Vec3iHash> mChunks;
+    std::vector<const Entry *> mVisible;
+};
+
+#endif // CHUNKRENDERER_H
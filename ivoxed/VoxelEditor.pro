@@ -1,14 +1,19 @@
 QT += core gui widgets
 
-CONFIG += c++11
+CONFIG += c++17
 
 TARGET = VoxelEditor
 TEMPLATE = app
 
 SOURCES += main.cpp \
-                     VoxelNode.cpp
+                     VoxelNode.cpp \
+                     VoxelInstancer.cpp
 
-HEADERS +=            VoxelNode.h
+HEADERS +=            VoxelNode.h \
+                      VoxelInstancer.h
+
+# Shared voxel storage
+include(../voxcore/voxcore.pri)
 
 # Include paths for Irrlicht
 INCLUDEPATH += /path/to/irrlicht/include
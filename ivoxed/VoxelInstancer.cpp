@@ -0,0 +1,255 @@
+#include "VoxelInstancer.h"
+
+#include "VoxelNode.h"
+
+namespace {
+
+const u32 CUBE_VERTICES = 24;
+const u32 CUBE_INDICES = 36;
+
+struct CubeVertex {
+    f32 x, y, z;
+    f32 nx, ny, nz;
+    f32 u, v;
+};
+
+// Unit cube centred on the origin like addCubeSceneNode(1.0f), four
+// vertices per face so each face has its own normal and texture corners.
+const CubeVertex CUBE[CUBE_VERTICES] = {
+    {-0.5f, -0.5f, -0.5f, 0, 0, -1, 0, 1}, {-0.5f, 0.5f, -0.5f, 0, 0, -1, 0, 0},
+    {0.5f, 0.5f, -0.5f, 0, 0, -1, 1, 0},   {0.5f, -0.5f, -0.5f, 0, 0, -1, 1, 1},
+    {0.5f, -0.5f, 0.5f, 0, 0, 1, 0, 1},    {0.5f, 0.5f, 0.5f, 0, 0, 1, 0, 0},
+    {-0.5f, 0.5f, 0.5f, 0, 0, 1, 1, 0},    {-0.5f, -0.5f, 0.5f, 0, 0, 1, 1, 1},
+    {-0.5f, -0.5f, 0.5f, -1, 0, 0, 0, 1},  {-0.5f, 0.5f, 0.5f, -1, 0, 0, 0, 0},
+    {-0.5f, 0.5f, -0.5f, -1, 0, 0, 1, 0},  {-0.5f, -0.5f, -0.5f, -1, 0, 0, 1, 1},
+    {0.5f, -0.5f, -0.5f, 1, 0, 0, 0, 1},   {0.5f, 0.5f, -0.5f, 1, 0, 0, 0, 0},
+    {0.5f, 0.5f, 0.5f, 1, 0, 0, 1, 0},     {0.5f, -0.5f, 0.5f, 1, 0, 0, 1, 1},
+    {-0.5f, 0.5f, -0.5f, 0, 1, 0, 0, 1},   {-0.5f, 0.5f, 0.5f, 0, 1, 0, 0, 0},
+    {0.5f, 0.5f, 0.5f, 0, 1, 0, 1, 0},     {0.5f, 0.5f, -0.5f, 0, 1, 0, 1, 1},
+    {-0.5f, -0.5f, 0.5f, 0, -1, 0, 0, 1},  {-0.5f, -0.5f, -0.5f, 0, -1, 0, 0, 0},
+    {0.5f, -0.5f, -0.5f, 0, -1, 0, 1, 0},  {0.5f, -0.5f, 0.5f, 0, -1, 0, 1, 1},
+};
+
+// Two clockwise triangles per face, Irrlicht's front face winding.
+const u32 FACE_INDICES[6] = {0, 1, 2, 0, 2, 3};
+
+video::ITexture *textureOf(VoxelNode *voxel) {
+    return voxel->getNode()->getMaterial(0).getTexture(0);
+}
+
+// Where the ray enters the box, as a fraction of its length, or false.
+bool rayBox(const core::line3df &ray, const core::aabbox3d<f32> &box, f32 &t) {
+    const core::vector3df dir = ray.end - ray.start;
+    f32 enter = 0.0f, leave = 1.0f;
+    const f32 start[3] = {ray.start.X, ray.start.Y, ray.start.Z};
+    const f32 d[3] = {dir.X, dir.Y, dir.Z};
+    const f32 lo[3] = {box.MinEdge.X, box.MinEdge.Y, box.MinEdge.Z};
+    const f32 hi[3] = {box.MaxEdge.X, box.MaxEdge.Y, box.MaxEdge.Z};
+    for (int axis = 0; axis < 3; ++axis) {
+        if (core::iszero(d[axis])) {
+            if (start[axis] < lo[axis] || start[axis] > hi[axis]) {
+                return false;
+            }
+            continue;
+        }
+        f32 t0 = (lo[axis] - start[axis]) / d[axis];
+        f32 t1 = (hi[axis] - start[axis]) / d[axis];
+        if (t0 > t1) {
+            core::swap(t0, t1);
+        }
+        enter = core::max_(enter, t0);
+        leave = core::min_(leave, t1);
+        if (enter > leave) {
+            return false;
+        }
+    }
+    t = enter;
+    return true;
+}
+
+} // namespace
+
+VoxelInstancer::VoxelInstancer(scene::ISceneNode *parent, scene::ISceneManager *manager, s32 id)
+    : scene::ISceneNode(parent, manager, id) {
+    setAutomaticCulling(scene::EAC_BOX);
+}
+
+VoxelInstancer::~VoxelInstancer() {
+    for (Batch &batch : mBatches) {
+        batch.buffer->drop();
+    }
+}
+
+void VoxelInstancer::add(VoxelNode *voxel, video::SColor colour) {
+    if (mSlots.count(voxel)) {
+        return;
+    }
+    video::ITexture *texture = textureOf(voxel);
+    u32 b = 0;
+    while (b < mBatches.size() && mBatches[b].material.getTexture(0) != texture) {
+        ++b;
+    }
+    if (b == mBatches.size()) {
+        Batch batch;
+        batch.material.Lighting = false;
+        batch.material.setTexture(0, texture);
+        batch.buffer = new scene::CDynamicMeshBuffer(video::EVT_STANDARD, video::EIT_32BIT);
+        // Vertices change every frame, indices only with the instance count.
+        batch.buffer->setHardwareMappingHint(scene::EHM_STREAM, scene::EBT_VERTEX);
+        batch.buffer->setHardwareMappingHint(scene::EHM_STATIC, scene::EBT_INDEX);
+        mBatches.push_back(batch);
+    }
+    Batch &batch = mBatches[b];
+    mSlots[voxel] = Slot{b, u32(batch.voxels.size())};
+    batch.voxels.push_back(voxel);
+    batch.colours.push_back(colour);
+}
+
+void VoxelInstancer::remove(VoxelNode *voxel) {
+    auto it = mSlots.find(voxel);
+    if (it == mSlots.end()) {
+        return;
+    }
+    Batch &batch = mBatches[it->second.batch];
+    const u32 index = it->second.index;
+    // Swap with the last instance so the arrays stay packed.
+    VoxelNode *last = batch.voxels.back();
+    batch.voxels[index] = last;
+    batch.colours[index] = batch.colours.back();
+    mSlots[last].index = index;
+    batch.voxels.pop_back();
+    batch.colours.pop_back();
+    mSlots.erase(voxel);
+}
+
+bool VoxelInstancer::contains(VoxelNode *voxel) const {
+    return mSlots.count(voxel) != 0;
+}
+
+void VoxelInstancer::setColour(VoxelNode *voxel, video::SColor colour) {
+    auto it = mSlots.find(voxel);
+    if (it != mSlots.end()) {
+        mBatches[it->second.batch].colours[it->second.index] = colour;
+    }
+}
+
+u32 VoxelInstancer::getInstanceCount() const {
+    return u32(mSlots.size());
+}
+
+u32 VoxelInstancer::getBatchCount() const {
+    return u32(mBatches.size());
+}
+
+VoxelNode *VoxelInstancer::pick(const core::line3df &ray, core::vector3df &hit) const {
+    VoxelNode *best = nullptr;
+    f32 nearest = 2.0f;
+    for (const Batch &batch : mBatches) {
+        for (VoxelNode *voxel : batch.voxels) {
+            const scene::ISceneNode *node = voxel->getNode();
+            const core::vector3df half = node->getScale() * 0.5f;
+            const core::vector3df &centre = node->getPosition();
+            f32 t;
+            if (rayBox(ray, core::aabbox3d<f32>(centre - half, centre + half), t) && t < nearest) {
+                nearest = t;
+                best = voxel;
+            }
+        }
+    }
+    if (best) {
+        hit = ray.start + (ray.end - ray.start) * nearest;
+    }
+    return best;
+}
+
+void VoxelInstancer::update() {
+    mBox.reset(core::vector3df(0.0f, 0.0f, 0.0f));
+    bool first = true;
+    for (Batch &batch : mBatches) {
+        const u32 count = u32(batch.voxels.size());
+        scene::IVertexBuffer &vertices = batch.buffer->getVertexBuffer();
+        scene::IIndexBuffer &indices = batch.buffer->getIndexBuffer();
+        if (indices.size() != count * CUBE_INDICES) {
+            indices.set_used(count * CUBE_INDICES);
+            u32 *out = static_cast<u32 *>(indices.getData());
+            for (u32 i = 0; i < count; ++i) {
+                for (u32 face = 0; face < 6; ++face) {
+                    for (u32 k = 0; k < 6; ++k) {
+                        *out++ = i * CUBE_VERTICES + face * 4 + FACE_INDICES[k];
+                    }
+                }
+            }
+            batch.buffer->setDirty(scene::EBT_INDEX);
+        }
+        vertices.set_used(count * CUBE_VERTICES);
+        if (!count) {
+            continue;
+        }
+
+        // The bulk update: one pass over the instances writing every vertex.
+        video::S3DVertex *out = static_cast<video::S3DVertex *>(vertices.getData());
+        core::aabbox3d<f32> box;
+        for (u32 i = 0; i < count; ++i) {
+            const scene::ISceneNode *node = batch.voxels[i]->getNode();
+            const core::vector3df &position = node->getPosition();
+            const core::vector3df &scale = node->getScale();
+            const video::SColor colour = batch.colours[i];
+            for (u32 v = 0; v < CUBE_VERTICES; ++v) {
+                const CubeVertex &c = CUBE[v];
+                out->Pos.set(position.X + c.x * scale.X, position.Y + c.y * scale.Y, position.Z + c.z * scale.Z);
+                out->Normal.set(c.nx, c.ny, c.nz);
+                out->Color = colour;
+                out->TCoords.set(c.u, c.v);
+                ++out;
+            }
+            const core::vector3df half = scale * 0.5f;
+            if (i == 0) {
+                box.reset(position - half);
+            } else {
+                box.addInternalPoint(position - half);
+            }
+            box.addInternalPoint(position + half);
+        }
+        batch.buffer->setBoundingBox(box);
+        batch.buffer->setDirty(scene::EBT_VERTEX);
+        if (first) {
+            mBox = box;
+            first = false;
+        } else {
+            mBox.addInternalBox(box);
+        }
+    }
+}
+
+void VoxelInstancer::OnRegisterSceneNode() {
+    if (IsVisible && !mSlots.empty()) {
+        update();
+        SceneManager->registerNodeForRendering(this);
+    }
+    scene::ISceneNode::OnRegisterSceneNode();
+}
+
+void VoxelInstancer::render() {
+    video::IVideoDriver *driver = SceneManager->getVideoDriver();
+    // Vertices are in world space already.
+    driver->setTransform(video::ETS_WORLD, core::IdentityMatrix);
+    for (Batch &batch : mBatches) {
+        if (batch.voxels.empty()) {
+            continue;
+        }
+        driver->setMaterial(batch.material);
+        driver->drawMeshBuffer(batch.buffer);
+    }
+}
+
+const core::aabbox3d<f32> &VoxelInstancer::getBoundingBox() const {
+    return mBox;
+}
+
+u32 VoxelInstancer::getMaterialCount() const {
+    return u32(mBatches.size());
+}
+
+video::SMaterial &VoxelInstancer::getMaterial(u32 i) {
+    return mBatches[i].material;
+}
@@ -0,0 +1,62 @@
+#ifndef VOXELINSTANCER_H
+#define VOXELINSTANCER_H
+
+#include <irrlicht/irrlicht.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace irr;
+
+class VoxelNode;
+
+// Draws many voxels as one batch per texture instead of one scene node
+// each, for voxels that are scaled or moving. Irrlicht has no hardware
+// instancing, so each frame the position, scale and colour of every
+// instance are read in bulk and expanded into a unit cube per instance in
+// a single streamed vertex buffer, drawn with one call per texture.
+//
+// The voxels keep their own (hidden) cube nodes, which still hold their
+// transform: the editor moves and scales those as before.
+class VoxelInstancer : public scene::ISceneNode {
+public:
+    VoxelInstancer(scene::ISceneNode *parent, scene::ISceneManager *manager, s32 id = -1);
+    ~VoxelInstancer();
+
+    void add(VoxelNode *voxel, video::SColor colour = video::SColor(255, 255, 255, 255));
+    void remove(VoxelNode *voxel);
+    bool contains(VoxelNode *voxel) const;
+    void setColour(VoxelNode *voxel, video::SColor colour);
+    u32 getInstanceCount() const;
+    u32 getBatchCount() const;
+
+    // Nearest instance the ray hits, or null. hit is where it enters.
+    VoxelNode *pick(const core::line3df &ray, core::vector3df &hit) const;
+
+    void OnRegisterSceneNode() override;
+    void render() override;
+    const core::aabbox3d<f32> &getBoundingBox() const override;
+    u32 getMaterialCount() const override;
+    video::SMaterial &getMaterial(u32 i) override;
+
+private:
+    struct Batch {
+        video::SMaterial material;
+        std::vector<VoxelNode *> voxels;
+        std::vector<video::SColor> colours;
+        scene::CDynamicMeshBuffer *buffer;
+    };
+
+    struct Slot {
+        u32 batch;
+        u32 index;
+    };
+
+    // Refreshes the vertices of every batch from the current transforms.
+    void update();
+
+    std::vector<Batch> mBatches;
+    std::unordered_map<VoxelNode *, Slot> mSlots;
+    core::aabbox3d<f32> mBox;
+};
+
+#endif // VOXELINSTANCER_H
@@ -3,15 +3,24 @@
 #include <QWidget>
 #include <QVBoxLayout>
 #include <QPushButton>
+#include <QCheckBox>
 #include <QFileDialog>
 #include <QTimer>
 #include <QMouseEvent>
 #include <iostream>
+#include <memory>
 #include <unordered_map>
 #include "VoxelNode.h"
+#include "VoxelInstancer.h"
+#include "VoxelMap.h"
+#include "CellularPhysics.h"
+#include "DiffusionField.h"
 
 using namespace irr;
 
+// Frames after its last move before a voxel is drawn by its own node again.
+const int SETTLE_FRAMES = 30;
+
 class VoxelEditor : public QWidget, public IEventReceiver {
     Q_OBJECT
 
@@ -37,19 +46,39 @@ private:
     void placeVoxel(const core::vector3df &position);
     void removeVoxel(scene::ISceneNode *node);
     void scaleVoxel(VoxelNode* voxelNode, float scale);
+    void applyMoves();
+    void updateDynamic(VoxelNode *voxelNode);
+    scene::ISceneNode *pick(const core::position2di &cursor, core::vector3df &intersection);
 
     IrrlichtDevice *mDevice;
     video::IVideoDriver *mDriver;
     scene::ISceneManager *mSceneMgr;
     scene::ICameraSceneNode *mCamera;
     bool mRunning;
-    std::string mCurrentTexture;
+    vox::VoxelMap mMap;
+    vox::MaterialId mCurrentMaterial;
     scene::ISceneCollisionManager* cm;
 
     QTimer *mTimer;
     u32 mLastClickTime;
     core::vector3df mLastClickPos;
     std::unordered_map<scene::ISceneNode *, VoxelNode *> mVoxelMap;
+    // Voxel in each cell, to follow the moves of the physics.
+    std::unordered_map<vox::Vec3i, VoxelNode *, vox::Vec3iHash> mCellMap;
+
+    std::unique_ptr<vox::CellularPhysics> mPhysics;
+    std::vector<vox::CellMove> mMoves;
+    QCheckBox *mSimulateBox;
+    QCheckBox *mGranularBox;
+
+    // Scent spreading from emitter voxels, shown for the cell under the cursor.
+    std::unique_ptr<vox::DiffusionField> mScent;
+    QCheckBox *mEmitterBox;
+
+    // Scaled or moving voxels, drawn in bulk instead of as their own nodes.
+    VoxelInstancer *mInstancer;
+    // Frames a voxel the physics moved stays with the instancer.
+    std::unordered_map<VoxelNode *, int> mAnimated;
 
     bool mLeftMousePressed;
     bool mRightMousePressed;
@@ -62,9 +91,10 @@ VoxelEditor::VoxelEditor()
       mCamera(nullptr),
       mRunning(true),
       mLastClickTime(0),
+      mInstancer(nullptr),
       mLeftMousePressed(false),
       mRightMousePressed(false) {
-    mCurrentTexture = "default.png";
+    mCurrentMaterial = mMap.getMaterials().getOrAddTexture("default.png");
 
     QVBoxLayout *layout = new QVBoxLayout(this);
     QPushButton *textureButton = new QPushButton("Select Texture", this);
@@ -72,6 +102,18 @@ VoxelEditor::VoxelEditor()
 
     connect(textureButton, &QPushButton::clicked, this, &VoxelEditor::onSelectTexture);
 
+    mSimulateBox = new QCheckBox("Simulate", this);
+    layout->addWidget(mSimulateBox);
+    mGranularBox = new QCheckBox("Granular", this);
+    layout->addWidget(mGranularBox);
+    mEmitterBox = new QCheckBox("Emitter", this);
+    layout->addWidget(mEmitterBox);
+
+    vox::PhysicsSettings physics;
+    physics.floor = -32;
+    mPhysics.reset(new vox::CellularPhysics(mMap, physics));
+    mScent.reset(new vox::DiffusionField(mMap));
+
     mTimer = new QTimer(this);
     connect(mTimer, &QTimer::timeout, this, &VoxelEditor::onUpdate);
     mTimer->start(16);  // roughly 60 FPS
@@ -83,6 +125,7 @@ VoxelEditor::VoxelEditor()
 
     mDriver = mDevice->getVideoDriver();
     mSceneMgr = mDevice->getSceneManager();
+    cm = mSceneMgr->getSceneCollisionManager();
     mCamera = mSceneMgr->addCameraSceneNode();
     mCamera->setPosition(core::vector3df(0, 30, -40));
     mCamera->setTarget(core::vector3df(0, 0, 0));
@@ -106,7 +149,10 @@ void VoxelEditor::run() {
 }
 
 void VoxelEditor::createScene() {
-    // Initialize the scene (currently empty as we dynamically place voxels)
+    // Voxels are placed dynamically; only the instancer for the moving ones
+    // exists up front.
+    mInstancer = new VoxelInstancer(mSceneMgr->getRootSceneNode(), mSceneMgr);
+    mInstancer->drop();
 }
 
 bool VoxelEditor::OnEvent(const SEvent &event) {
@@ -126,11 +172,8 @@ bool VoxelEditor::OnEvent(const SEvent &event) {
             break;
         case EMIE_MOUSE_MOVED:
             if (mLeftMousePressed || mRightMousePressed) {
-                core::position2di cursorPos = mDevice->getCursorControl()->getPosition();
-                core::line3df ray = cm->getRayFromScreenCoordinates(cursorPos, mCamera);
                 core::vector3df intersection;
-                core::triangle3df hitTriangle;
-                scene::ISceneNode *selectedNode = cm->getSceneNodeAndCollisionPointFromRay(ray, intersection, hitTriangle);
+                scene::ISceneNode *selectedNode = pick(mDevice->getCursorControl()->getPosition(), intersection);
 
                 if (selectedNode) {
                     if (mRightMousePressed) {
@@ -151,16 +194,34 @@ bool VoxelEditor::OnEvent(const SEvent &event) {
 }
 
 void VoxelEditor::placeVoxel(const core::vector3df &position) {
+    vox::Vec3i cell(core::round32(position.X), core::round32(position.Y), core::round32(position.Z));
+    if (mCellMap.count(cell)) {
+        return;
+    }
     scene::IMeshSceneNode *voxel = mSceneMgr->addCubeSceneNode(1.0f, 0, -1, position);
     voxel->setMaterialFlag(video::EMF_LIGHTING, false);
-    voxel->setMaterialTexture(0, mDriver->getTexture(mCurrentTexture.c_str()));
-    VoxelNode* voxelNode = new VoxelNode(voxel, 0, 1.0f);
+    voxel->setMaterialTexture(0, mDriver->getTexture(mMap.getMaterials().get(mCurrentMaterial).texture.c_str()));
+    VoxelNode* voxelNode = new VoxelNode(voxel, mCurrentMaterial, 1.0f);
+    voxelNode->setAffectorValue(mEmitterBox->isChecked() ? 1.0f : 0.0f);
     mVoxelMap[voxel] = voxelNode;
+    mCellMap[cell] = voxelNode;
+    mMap.setMaterial(cell.x, cell.y, cell.z, mCurrentMaterial);
+    mMap.setAttribute(vox::ATTR_WEIGHT, cell.x, cell.y, cell.z,
+                      vox::packWeight(voxelNode->getWeight(), mGranularBox->isChecked()));
+    mMap.setAttribute(vox::ATTR_AFFECTOR, cell.x, cell.y, cell.z, vox::packAffector(voxelNode->getAffectorValue()));
 }
 
 void VoxelEditor::removeVoxel(scene::ISceneNode *node) {
     auto it = mVoxelMap.find(node);
     if (it != mVoxelMap.end()) {
+        const core::vector3df &position = node->getPosition();
+        vox::Vec3i cell(core::round32(position.X), core::round32(position.Y), core::round32(position.Z));
+        mMap.setMaterial(cell.x, cell.y, cell.z, vox::AIR);
+        mMap.setAttribute(vox::ATTR_WEIGHT, cell.x, cell.y, cell.z, 0);
+        mMap.setAttribute(vox::ATTR_AFFECTOR, cell.x, cell.y, cell.z, 0);
+        mCellMap.erase(cell);
+        mInstancer->remove(it->second);
+        mAnimated.erase(it->second);
         node->remove();
         delete it->second; // Ensure to delete the VoxelNode pointer
         mVoxelMap.erase(it);
@@ -171,17 +232,88 @@ void VoxelEditor::scaleVoxel(VoxelNode* voxelNode, float scale) {
     if (voxelNode) {
         voxelNode->getNode()->setScale(core::vector3df(scale, scale, scale));
         voxelNode->setLastSize(scale);
+        updateDynamic(voxelNode);
+    }
+}
+
+// Voxels at their normal size and at rest are drawn by their own cube
+// node; the others go to the instancer while they stay that way.
+void VoxelEditor::updateDynamic(VoxelNode *voxelNode) {
+    bool dynamic = voxelNode->getLastSize() != 1.0f || mAnimated.count(voxelNode);
+    if (dynamic == mInstancer->contains(voxelNode)) {
+        return;
+    }
+    if (dynamic) {
+        mInstancer->add(voxelNode);
+    } else {
+        mInstancer->remove(voxelNode);
+    }
+    voxelNode->getNode()->setVisible(!dynamic);
+}
+
+// Hidden cube nodes are not hit by the collision manager, so instanced
+// voxels are tested separately and the nearer hit wins.
+scene::ISceneNode *VoxelEditor::pick(const core::position2di &cursor, core::vector3df &intersection) {
+    core::line3df ray = cm->getRayFromScreenCoordinates(cursor, mCamera);
+    core::triangle3df hitTriangle;
+    scene::ISceneNode *selectedNode = cm->getSceneNodeAndCollisionPointFromRay(ray, intersection, hitTriangle);
+    core::vector3df instanceHit;
+    VoxelNode *instanced = mInstancer->pick(ray, instanceHit);
+    if (instanced
+        && (!selectedNode || ray.start.getDistanceFromSQ(instanceHit) < ray.start.getDistanceFromSQ(intersection))) {
+        intersection = instanceHit;
+        return instanced->getNode();
     }
+    return selectedNode;
 }
 
 void VoxelEditor::onSelectTexture() {
     QString filePath = QFileDialog::getOpenFileName(this, tr("Select Texture"), "", tr("Images (*.png *.jpg *.bmp)"));
     if (!filePath.isEmpty()) {
-        mCurrentTexture = filePath.toStdString();
+        mCurrentMaterial = mMap.getMaterials().getOrAddTexture(filePath.toStdString());
     }
 }
 
+// Moves the scene nodes after the cells the physics moved, in order, so a
+// cell moving twice in a step ends up in the right place.
+void VoxelEditor::applyMoves() {
+    mPhysics->takeMoves(mMoves);
+    for (const vox::CellMove &move : mMoves) {
+        auto it = mCellMap.find(move.from);
+        if (it == mCellMap.end()) {
+            continue;
+        }
+        VoxelNode *voxelNode = it->second;
+        mCellMap.erase(it);
+        mCellMap[move.to] = voxelNode;
+        mAnimated[voxelNode] = SETTLE_FRAMES;
+        updateDynamic(voxelNode);
+        voxelNode->getNode()->setPosition(core::vector3df(f32(move.to.x), f32(move.to.y), f32(move.to.z)));
+        // The physics carries weights only; emitters take their scent along.
+        if (voxelNode->getAffectorValue() != 0.0f) {
+            mMap.setAttribute(vox::ATTR_AFFECTOR, move.from.x, move.from.y, move.from.z, 0);
+            mMap.setAttribute(vox::ATTR_AFFECTOR, move.to.x, move.to.y, move.to.z,
+                              vox::packAffector(voxelNode->getAffectorValue()));
+        }
+    }
+    mMoves.clear();
+}
+
 void VoxelEditor::onUpdate() {
+    if (mSimulateBox->isChecked()) {
+        mPhysics->step();
+        applyMoves();
+    }
+    mScent->step();
+    for (auto it = mAnimated.begin(); it != mAnimated.end();) {
+        VoxelNode *voxelNode = it->first;
+        if (--it->second > 0) {
+            ++it;
+            continue;
+        }
+        it = mAnimated.erase(it);
+        updateDynamic(voxelNode);
+    }
     if (mDevice) {
         mDevice->run();
         mDriver->beginScene(true, true, video::SColor(255, 100, 101, 140));
@@ -207,13 +339,11 @@ void VoxelEditor::mouseReleaseEvent(QMouseEvent* event) {
 }
 
 void VoxelEditor::mouseMoveEvent(QMouseEvent* event) {
-    core::position2di cursorPos(event->pos().x(), event->pos().y());
-    core::line3df ray = cm->getRayFromScreenCoordinates(cursorPos, mCamera);
     core::vector3df intersection;
-    core::triangle3df hitTriangle;
-    scene::ISceneNode *selectedNode = cm->getSceneNodeAndCollisionPointFromRay(ray, intersection, hitTriangle);
+    scene::ISceneNode *selectedNode = pick(core::position2di(event->pos().x(), event->pos().y()), intersection);
 
     if (selectedNode) {
+        setWindowTitle(QString("Scent %1").arg(mScent->sample(intersection.X, intersection.Y, intersection.Z)));
         if (mRightMousePressed) {
             removeVoxel(selectedNode);
         } else if (mLeftMousePressed) {
@@ -4,11 +4,48 @@
 #include <QOpenGLFunctions>
 #include <QMouseEvent>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QLabel>
 #include <QMenuBar>
+#include <QMessageBox>
+#include <QTimer>
+#include <QActionGroup>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QStatusBar>
+#include <QSurfaceFormat>
+#include <QVector3D>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
-#include <fstream>
 #include <iostream>
-#include <GL/glut.h>
+
+#include "Autosaver.h"
+#include "ChunkRenderer.h"
+#include "ChunkMesher.h"
+#include "MapFile.h"
+#include "SurfaceMesher.h"
+#include "TerrainGenerator.h"
+#include "VoxelLighting.h"
+#include "VoxelMap.h"
+#include "VoxFile.h"
+
+// Light propagation steps done per frame, the rest waits for the next one.
+const int LIGHT_STEPS_PER_FRAME = 20000;
+// Edits since the last autosave are what a crash can lose.
+const int AUTOSAVE_INTERVAL_MS = 5000;
+const int STATUS_MESSAGE_MS = 5000;
+// Far enough to see a whole generated world.
+const float FAR_PLANE = 1000.0f;
+// Frame benchmark: seed of the world and where the camera looks from.
+const int BENCHMARK_SEED = 1;
+const float BENCHMARK_DISTANCE = 250.0f;
+const float BENCHMARK_HEIGHT = 40.0f;
 
 
 class OpenGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
@@ -16,81 +53,202 @@ class OpenGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
 
 public:
     OpenGLWidget(QWidget *parent = nullptr)
-        : QOpenGLWidget(parent), gridSize(10), voxelSize(1.0f), snapToGrid(true), zoomLevel(15.0f), cameraX(0.0f), cameraY(0.0f) {
-        voxelGrid.resize(gridSize * gridSize * gridSize, false);
+        : QOpenGLWidget(parent), gridSize(10), voxelSize(1.0f), snapToGrid(true), zoomLevel(15.0f), cameraX(0.0f), cameraY(0.0f),
+          lighting(voxelMap), mesher(voxelMap), surfaceMesher(voxelMap), meshedStyle(vox::SURFACE_BLOCKS),
+          preferredRenderer(ChunkRenderer::PATH_INDIRECT), benchmarkFrames(0), benchmarkDone(0),
+          benchmarkTotal(0.0), benchmarkWorst(0.0) {
+        currentMaterial = voxelMap.getMaterials().add(vox::Material("red", 0xFFFF0000));
+        mesher.setLighting(&lighting);
+        meshChanges = voxelMap.getChanges().subscribe(vox::CHANGE_ALL);
+    }
+
+    ~OpenGLWidget() override {
+        makeCurrent();
+        renderer.release();
+        doneCurrent();
     }
 
+    // Renders a generated world for frames frames once it is lit and
+    // meshed, prints the mean frame time and quits.
+    void startBenchmark(int frames) {
+        generate(BENCHMARK_SEED);
+        zoomLevel = BENCHMARK_DISTANCE;
+        cameraY = BENCHMARK_HEIGHT;
+        benchmarkFrames = frames;
+        update();
+    }
+
+signals:
+    // The map in the widget changed to or from smooth surfaces.
+    void smoothSurfacesChanged(bool smooth);
+    // The drawing path in use, a ChunkRenderer::Path.
+    void rendererChanged(int path);
+    void frameDrawn(const QString &summary);
+    // One-off feedback for the status bar.
+    void statusMessage(const QString &message);
+
 public slots:
-    // void loadVoxels() {
-    //     QString fileName = QFileDialog::getOpenFileName(this, "Open Voxel File", "", "Voxel Files (*.vox)");
-    //     if (!fileName.isEmpty()) {
-    //         std::ifstream file(fileName.toStdString(), std::ios::binary);
-    //         if (file.is_open()) {
-    //             file.read(reinterpret_cast<char*>(voxelGrid.data()), voxelGrid.size() * sizeof(bool));
-    //             file.close();
-    //             update();
-    //         }
-    //     }
-    // }
-
-    // void saveVoxels() {
-    //     QString fileName = QFileDialog::getSaveFileName(this, "Save Voxel File", "", "Voxel Files (*.vox)");
-    //     if (!fileName.isEmpty()) {
-    //         std::ofstream file(fileName.toStdString(), std::ios::binary);
-    //         if (file.is_open()) {
-    //             file.write(reinterpret_cast<const char*>(voxelGrid.data()), voxelGrid.size() * sizeof(bool));
-    //             file.close();
-    //         }
-    //     }
-    // }
+    // Takes effect right away if the context exists, else when it is made.
+    void setRenderer(int path) {
+        preferredRenderer = ChunkRenderer::Path(path);
+        if (!isValid()) {
+            return;
+        }
+        makeCurrent();
+        initializeRenderer();
+        doneCurrent();
+        update();
+    }
+
+    // Saved with the map; every chunk is remeshed on the next frame.
+    void setSmoothSurfaces(bool smooth) {
+        voxelMap.setSurfaceStyle(smooth ? vox::SURFACE_SMOOTH : vox::SURFACE_BLOCKS);
+        update();
+    }
+
+    void loadVoxels() {
+        QString fileName = QFileDialog::getOpenFileName(this, "Open Voxel Map", "",
+                                                        "Voxel Maps (*.vxm);;MagicaVoxel (*.vox)");
+        if (fileName.isEmpty()) {
+            return;
+        }
+        if (fileName.endsWith(".vox", Qt::CaseInsensitive)) {
+            importVoxels(fileName);
+            return;
+        }
+        autosaver.reset(); // finish writing the previous map first
+        std::string error;
+        if (!vox::loadMap(voxelMap, fileName.toStdString(), &error)) {
+            QMessageBox::warning(this, "Open Voxel Map", QString::fromStdString(error));
+            return;
+        }
+        currentMaterial = voxelMap.getMaterials().findByName("red");
+        if (currentMaterial == vox::AIR) {
+            currentMaterial = voxelMap.getMaterials().add(vox::Material("red", 0xFFFF0000));
+        }
+        autosaver.reset(new vox::Autosaver(voxelMap, fileName.toStdString()));
+        autosaver->reset();
+        lighting.relightAll();
+        emit smoothSurfacesChanged(voxelMap.getSurfaceStyle() == vox::SURFACE_SMOOTH);
+        update();
+    }
+
+    // Adds a MagicaVoxel scene to the current map.
+    void importVoxels(const QString &fileName) {
+        vox::ImportStats stats;
+        std::string error;
+        if (!vox::importVox(voxelMap, fileName.toStdString(), vox::ImportOptions(), &stats, &error)) {
+            QMessageBox::warning(this, "Import MagicaVoxel", QString::fromStdString(error));
+            return;
+        }
+        emit statusMessage(QString("Imported %1 voxels into %2 chunks").arg(stats.voxels).arg(stats.chunks));
+        lighting.relightAll();
+        update();
+    }
+
+    // Replaces the map with a generated world around the origin. The same
+    // seed always gives the same world.
+    void generateTerrain() {
+        bool ok = false;
+        int seed = QInputDialog::getInt(this, "Generate Terrain", "Seed", 1, 0, 1 << 30, 1, &ok);
+        if (ok) {
+            generate(uint32_t(seed));
+        }
+    }
+
+    void generate(uint32_t seed) {
+        autosaver.reset();
+        voxelMap.clear();
+        vox::TerrainSettings settings;
+        settings.seed = seed;
+        vox::TerrainGenerator generator(settings, voxelMap.getMaterials());
+        vox::TerrainStats stats;
+        generator.generate(voxelMap, vox::Vec3i(-4, 0, -4), vox::Vec3i(3, 2, 3), nullptr, &stats);
+        emit statusMessage(QString("Generated %1 chunks from seed %2").arg(stats.chunks).arg(seed));
+        currentMaterial = voxelMap.getMaterials().add(vox::Material("red", 0xFFFF0000));
+        lighting.relightAll();
+        emit smoothSurfacesChanged(false);
+        update();
+    }
+
+    void saveVoxels() {
+        if (!autosaver) {
+            QString fileName = QFileDialog::getSaveFileName(this, "Save Voxel Map", "", "Voxel Maps (*.vxm)");
+            if (fileName.isEmpty()) {
+                return;
+            }
+            autosaver.reset(new vox::Autosaver(voxelMap, fileName.toStdString()));
+        }
+        // Written in the background, the editor keeps running meanwhile.
+        autosaver->save();
+    }
+
+    void autosave() {
+        if (autosaver) {
+            autosaver->autosave();
+        }
+    }
 
 protected:
     void initializeGL() override {
         initializeOpenGLFunctions();
         glEnable(GL_DEPTH_TEST);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        initializeRenderer();
     }
 
     void resizeGL(int w, int h) override {
         glViewport(0, 0, w, h);
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        gluPerspective(45.0, static_cast<double>(w) / h, 0.1, 100.0);
-        glMatrixMode(GL_MODELVIEW);
+        projection.setToIdentity();
+        projection.perspective(45.0f, static_cast<float>(w) / (h ? h : 1), 0.1f, FAR_PLANE);
     }
 
     void paintGL() override {
+        QElapsedTimer frameTimer;
+        frameTimer.start();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glLoadIdentity();
-        gluLookAt(cameraX, cameraY, zoomLevel, cameraX, cameraY, 0.0, 0.0, 1.0, 0.0);
-
-        for (int x = 0; x < gridSize; ++x) {
-            for (int y = 0; y < gridSize; ++y) {
-                for (int z = 0; z < gridSize; ++z) {
-                    if (voxelGrid[index(x, y, z)]) {
-                        drawVoxel(x, y, z);
-                    }
-                }
-            }
+        view.setToIdentity();
+        view.lookAt(QVector3D(cameraX, cameraY, zoomLevel), QVector3D(cameraX, cameraY, 0.0f), QVector3D(0.0f, 1.0f, 0.0f));
+
+        bool settling = lighting.update(LIGHT_STEPS_PER_FRAME) > 0;
+        if (settling) {
+            update(); // keep spreading light next frame
         }
+        renderer.beginFrame();
+        settling = updateMeshes() || settling;
+
+        QMatrix4x4 model;
+        model.translate(-gridSize / 2 * voxelSize, -gridSize / 2 * voxelSize, -gridSize / 2 * voxelSize);
+        model.scale(voxelSize);
+        renderer.draw(projection, view, model);
+
+        if (benchmarkFrames > 0) {
+            // Wait for the GPU (or llvmpipe) so the time is the whole frame.
+            glFinish();
+            benchmarkFrame(frameTimer.nsecsElapsed() / 1e6, settling);
+        }
+        emit frameDrawn(QString("%1: %2 ms, %3 of %4 chunks drawn")
+                            .arg(ChunkRenderer::pathName(renderer.getPath()))
+                            .arg(frameTimer.nsecsElapsed() / 1e6, 0, 'f', 2)
+                            .arg(renderer.getDrawnChunkCount())
+                            .arg(renderer.getChunkCount()));
     }
 
     void mousePressEvent(QMouseEvent *event) override {
         GLint viewport[4];
-        GLdouble modelview[16];
-        GLdouble projection[16];
         GLfloat winX, winY, winZ;
-        GLdouble posX, posY, posZ;
 
+        // The depth buffer is only readable with the widget's context current.
+        makeCurrent();
         glGetIntegerv(GL_VIEWPORT, viewport);
-        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-        glGetDoublev(GL_PROJECTION_MATRIX, projection);
-
         winX = (float)event->x();
         winY = (float)viewport[3] - (float)event->y() - 1;
         glReadPixels(event->x(), int(winY), 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
+        doneCurrent();
 
-        gluUnProject(winX, winY, winZ, modelview, projection, viewport, &posX, &posY, &posZ);
+        QVector3D position = QVector3D(winX, winY, winZ)
+                                 .unproject(view, projection, QRect(viewport[0], viewport[1], viewport[2], viewport[3]));
+        float posX = position.x(), posY = position.y(), posZ = position.z();
 
         int voxelX = static_cast<int>(qRound(posX / voxelSize + gridSize / 2));
         int voxelY = static_cast<int>(qRound(posY / voxelSize + gridSize / 2));
@@ -106,9 +264,9 @@ protected:
             voxelY >= 0 && voxelY < gridSize &&
             voxelZ >= 0 && voxelZ < gridSize) {
             if (event->button() == Qt::LeftButton) {
-                voxelGrid[index(voxelX, voxelY, voxelZ)] = true;
+                setVoxel(voxelX, voxelY, voxelZ, currentMaterial);
             } else if (event->button() == Qt::RightButton) {
-                voxelGrid[index(voxelX, voxelY, voxelZ)] = false;
+                setVoxel(voxelX, voxelY, voxelZ, vox::AIR);
             }
             update();
         }
@@ -130,55 +288,77 @@ protected:
     }
 
 private:
-    void drawVoxel(int x, int y, int z) {
-        glPushMatrix();
-        glTranslatef(x * voxelSize - gridSize / 2 * voxelSize, y * voxelSize - gridSize / 2 * voxelSize, z * voxelSize - gridSize / 2 * voxelSize);
-
-        glBegin(GL_QUADS);
-        glColor3f(1.0, 0.0, 0.0);
-
-        // Front face
-        glVertex3f(-0.5, -0.5,  0.5);
-        glVertex3f( 0.5, -0.5,  0.5);
-        glVertex3f( 0.5,  0.5,  0.5);
-        glVertex3f(-0.5,  0.5,  0.5);
-
-        // Back face
-        glVertex3f(-0.5, -0.5, -0.5);
-        glVertex3f( 0.5, -0.5, -0.5);
-        glVertex3f( 0.5,  0.5, -0.5);
-        glVertex3f(-0.5,  0.5, -0.5);
-
-        // Left face
-        glVertex3f(-0.5, -0.5, -0.5);
-        glVertex3f(-0.5, -0.5,  0.5);
-        glVertex3f(-0.5,  0.5,  0.5);
-        glVertex3f(-0.5,  0.5, -0.5);
-
-        // Right face
-        glVertex3f(0.5, -0.5, -0.5);
-        glVertex3f(0.5, -0.5,  0.5);
-        glVertex3f(0.5,  0.5,  0.5);
-        glVertex3f(0.5,  0.5, -0.5);
-
-        // Top face
-        glVertex3f(-0.5,  0.5, -0.5);
-        glVertex3f( 0.5,  0.5, -0.5);
-        glVertex3f( 0.5,  0.5,  0.5);
-        glVertex3f(-0.5,  0.5,  0.5);
+    // Uploads every mesh again: a new path starts with nothing on the GPU.
+    void initializeRenderer() {
+        renderer.initialize(preferredRenderer);
+        for (const auto &entry : meshes) {
+            renderer.upload(entry.first, entry.second);
+        }
+        emit rendererChanged(renderer.getPath());
+    }
 
-        // Bottom face
-        glVertex3f(-0.5, -0.5, -0.5);
-        glVertex3f( 0.5, -0.5, -0.5);
-        glVertex3f( 0.5, -0.5,  0.5);
-        glVertex3f(-0.5, -0.5,  0.5);
+    // Frames still lighting or meshing the world are not counted.
+    void benchmarkFrame(double ms, bool settling) {
+        update();
+        if (settling) {
+            return;
+        }
+        ++benchmarkDone;
+        benchmarkTotal += ms;
+        benchmarkWorst = std::max(benchmarkWorst, ms);
+        // Pan across the world so every frame draws a different view.
+        cameraX = 40.0f * std::sin(benchmarkDone * 0.05f);
+        if (benchmarkDone < benchmarkFrames) {
+            return;
+        }
+        std::cout << "renderer " << ChunkRenderer::pathName(renderer.getPath()) << " on "
+                  << reinterpret_cast<const char *>(glGetString(GL_RENDERER)) << ": "
+                  << benchmarkTotal / benchmarkDone << " ms per frame (worst " << benchmarkWorst << " ms) over "
+                  << benchmarkDone << " frames, " << renderer.getDrawnChunkCount() << " of "
+                  << renderer.getChunkCount() << " chunks drawn" << std::endl;
+        benchmarkFrames = 0;
+        QTimer::singleShot(0, qApp, &QApplication::quit);
+    }
 
-        glEnd();
-        glPopMatrix();
+    void setVoxel(int x, int y, int z, vox::MaterialId material) {
+        if (voxelMap.getMaterial(x, y, z) == material) {
+            return;
+        }
+        voxelMap.setMaterial(x, y, z, material);
+        lighting.onVoxelChanged(x, y, z);
     }
 
-    int index(int x, int y, int z) const {
-        return x + gridSize * (y + gridSize * z);
+    // Remeshes only the chunks that were edited or relit since the last frame.
+    // Returns whether any were.
+    bool updateMeshes() {
+        std::vector<vox::ChunkChange> changes;
+        voxelMap.getChanges().poll(meshChanges, changes);
+        std::vector<vox::Vec3i> relit;
+        lighting.takeChangedChunks(relit);
+        std::unordered_set<vox::Vec3i, vox::Vec3iHash> dirty(relit.begin(), relit.end());
+        for (const vox::ChunkChange &change : changes) {
+            dirty.insert(change.chunk);
+        }
+        if (voxelMap.getSurfaceStyle() != meshedStyle) {
+            meshedStyle = voxelMap.getSurfaceStyle();
+            for (const auto &entry : voxelMap.getChunks()) {
+                dirty.insert(entry.first);
+            }
+        }
+        for (const vox::Vec3i &chunk : dirty) {
+            if (!voxelMap.hasChunk(chunk)) {
+                meshes.erase(chunk);
+                renderer.remove(chunk);
+                continue;
+            }
+            if (meshedStyle == vox::SURFACE_SMOOTH) {
+                surfaceMesher.mesh(chunk, meshes[chunk]);
+            } else {
+                mesher.mesh(chunk, meshes[chunk]);
+            }
+            renderer.upload(chunk, meshes[chunk]);
+        }
+        return !dirty.empty();
     }
 
     int gridSize;
@@ -187,16 +367,33 @@ private:
     float zoomLevel;
     float cameraX, cameraY;
     QPoint lastMousePosition;
-    std::vector<bool> voxelGrid;
+    vox::VoxelMap voxelMap;
+    vox::VoxelLighting lighting;
+    vox::ChunkMesher mesher;
+    vox::SurfaceMesher surfaceMesher;
+    vox::SurfaceStyle meshedStyle;
+    vox::MaterialId currentMaterial;
+    vox::ChangeTracker::Subscriber meshChanges;
+    std::unordered_map<vox::Vec3i, vox::ChunkMesh, vox::Vec3iHash> meshes;
+    std::unique_ptr<vox::Autosaver> autosaver;
+    ChunkRenderer renderer;
+    ChunkRenderer::Path preferredRenderer;
+    QMatrix4x4 projection;
+    QMatrix4x4 view;
+    int benchmarkFrames;
+    int benchmarkDone;
+    double benchmarkTotal;
+    double benchmarkWorst;
 };
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr)
+    MainWindow(ChunkRenderer::Path renderer, QWidget *parent = nullptr)
         : QMainWindow(parent) {
         openGLWidget = new OpenGLWidget(this);
+        openGLWidget->setRenderer(renderer);
         setCentralWidget(openGLWidget);
         resize(800, 600); // Set initial window size
 
@@ -206,19 +403,100 @@ public:
         QMenu *fileMenu = menuBar->addMenu("File");
         QAction *loadAction = fileMenu->addAction("Load");
         QAction *saveAction = fileMenu->addAction("Save");
+        QAction *generateAction = fileMenu->addAction("Generate Terrain");
+
+        connect(loadAction, &QAction::triggered, openGLWidget, &OpenGLWidget::loadVoxels);
+        connect(saveAction, &QAction::triggered, openGLWidget, &OpenGLWidget::saveVoxels);
+        connect(generateAction, &QAction::triggered, openGLWidget, &OpenGLWidget::generateTerrain);
+
+        QMenu *viewMenu = menuBar->addMenu("View");
+        QAction *smoothAction = viewMenu->addAction("Smooth Surfaces");
+        smoothAction->setCheckable(true);
+        // triggered, not toggled: only the user's clicks change the map.
+        connect(smoothAction, &QAction::triggered, openGLWidget, &OpenGLWidget::setSmoothSurfaces);
+        connect(openGLWidget, &OpenGLWidget::smoothSurfacesChanged, smoothAction, &QAction::setChecked);
+
+        // The widget may fall back to another path than the one picked.
+        QMenu *rendererMenu = viewMenu->addMenu("Renderer");
+        QActionGroup *rendererGroup = new QActionGroup(this);
+        for (int path = ChunkRenderer::PATH_LEGACY; path <= ChunkRenderer::PATH_INDIRECT; ++path) {
+            QAction *action = rendererMenu->addAction(ChunkRenderer::pathName(ChunkRenderer::Path(path)));
+            action->setCheckable(true);
+            action->setChecked(path == renderer);
+            rendererGroup->addAction(action);
+            connect(action, &QAction::triggered, openGLWidget, [this, path]() { openGLWidget->setRenderer(path); });
+        }
+        connect(openGLWidget, &OpenGLWidget::rendererChanged, rendererGroup,
+                [rendererGroup](int path) { rendererGroup->actions().at(path)->setChecked(true); });
+        // Frame figures stay on the right, messages come and go on the left.
+        QLabel *frameLabel = new QLabel(this);
+        statusBar()->addPermanentWidget(frameLabel);
+        connect(openGLWidget, &OpenGLWidget::frameDrawn, frameLabel, &QLabel::setText);
+        connect(openGLWidget, &OpenGLWidget::statusMessage, statusBar(), [this](const QString &message) {
+            statusBar()->showMessage(message, STATUS_MESSAGE_MS);
+        });
+
+        QTimer *autosaveTimer = new QTimer(this);
+        connect(autosaveTimer, &QTimer::timeout, openGLWidget, &OpenGLWidget::autosave);
+        autosaveTimer->start(AUTOSAVE_INTERVAL_MS);
+    }
 
-    //    connect(loadAction, &QAction::triggered, openGLWidget, &OpenGLWidget::loadVoxels);
-     //   connect(saveAction, &QAction::triggered, openGLWidget, &OpenGLWidget::saveVoxels);
+    void startBenchmark(int frames) {
+        openGLWidget->startBenchmark(frames);
     }
 
 private:
     OpenGLWidget *openGLWidget;
 };
 
+// The context format has to be set before QApplication exists, so the
+// renderer option is looked up ahead of the command line parser.
+ChunkRenderer::Path requestedRenderer(int argc, char *argv[]) {
+    ChunkRenderer::Path path = ChunkRenderer::PATH_INDIRECT;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--renderer=", 11) == 0) {
+            ChunkRenderer::parsePath(argv[i] + 11, path);
+        } else if (std::strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+            ChunkRenderer::parsePath(argv[i + 1], path);
+        }
+    }
+    return path;
+}
+
 int main(int argc, char *argv[]) {
+    ChunkRenderer::Path renderer = requestedRenderer(argc, argv);
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+    // Fixed function drawing needs a compatibility context. A driver that
+    // cannot make the core one gives an older context instead, and the
+    // renderer falls back to what that one has.
+    if (renderer != ChunkRenderer::PATH_LEGACY) {
+        format.setVersion(renderer == ChunkRenderer::PATH_INDIRECT ? 4 : 3, renderer == ChunkRenderer::PATH_INDIRECT ? 4 : 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    }
+    QSurfaceFormat::setDefaultFormat(format);
+
     QApplication a(argc, argv);
-    MainWindow w;
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption rendererOption("renderer", "Chunk drawing path: legacy, core or indirect.", "path", "indirect");
+    QCommandLineOption benchmarkOption("benchmark-frames",
+                                       "Render a generated world for this many frames, print the mean frame time and quit.",
+                                       "frames");
+    parser.addOption(rendererOption);
+    parser.addOption(benchmarkOption);
+    parser.process(a);
+    ChunkRenderer::Path checked;
+    if (!ChunkRenderer::parsePath(parser.value(rendererOption).toLatin1().constData(), checked)) {
+        std::cerr << "unknown renderer " << parser.value(rendererOption).toStdString() << std::endl;
+        return 1;
+    }
+
+    MainWindow w(renderer);
     w.show();
+    if (parser.isSet(benchmarkOption)) {
+        w.startBenchmark(std::max(1, parser.value(benchmarkOption).toInt()));
+    }
     return a.exec();
 }
 
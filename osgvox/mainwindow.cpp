@@ -1,16 +1,25 @@
 #include "mainwindow.h"
 
+#include <algorithm>
+#include <QFileDialog>
+#include <QLabel>
+#include <QProgressBar>
+#include <QStatusBar>
+#include <QTimer>
+#include <sstream>
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/ShapeDrawable>
-#include <osg/TriangleFunctor>
-#include <osgDB/ReadFile>
 #include <osgUtil/SmoothingVisitor>
 #include <osgUtil/Tessellator>
 
+#include "MeshVoxelizer.h"
+#include "TerrainGenerator.h"
+#include "model_loader.h"
 #include "osg_utils.h"
 #include "osg_widget.h"
 #include "ui_mainwindow.h"
+#include "voxel_view.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
@@ -20,10 +29,68 @@ MainWindow::MainWindow(QWidget *parent)
   setCentralWidget(osg_widget_);
   setMinimumSize(800, 600);
 
-  connect(ui->actionDefault, &QAction::triggered, [this]() {
-    osg::ref_ptr<osg::Node> node = osgDB::readNodeFile("cessna.osg");
-    osg_widget_->setSceneData(node);
+  auto frame_label = new QLabel(this);
+  statusBar()->addPermanentWidget(frame_label);
+  auto frame_stats = new QTimer(this);
+  connect(frame_stats, &QTimer::timeout, [this, frame_label]() {
+    frame_label->setText(QString("%1 ms/frame, GUI busy %2 ms")
+                             .arg(osg_widget_->GetFrameTimeMs(), 0, 'f', 1)
+                             .arg(osg_widget_->GetGuiTimeMs(), 0, 'f', 1));
   });
+  frame_stats->start(500);
+
+  loader_.reset(new ModelLoader);
+  progress_ = new QProgressBar(this);
+  progress_->setMaximumWidth(200);
+  progress_->hide();
+  statusBar()->addPermanentWidget(progress_);
+  auto loading = new QTimer(this);
+  connect(loading, &QTimer::timeout, [this]() { pollLoading(); });
+  loading->start(100);
+
+  connect(ui->actionOpen, &QAction::triggered, [this]() {
+    QString file = QFileDialog::getOpenFileName(
+        this, "Open", QString(),
+        "Models (*.osg *.osgt *.osgb *.ive *.obj *.3ds *.fbx *.dae);;"
+        "Voxel Maps (*.vxm);;All Files (*)");
+    if (!file.isEmpty()) {
+      startLoading(file.toStdString());
+    }
+  });
+
+  connect(ui->actionCancel_Loading, &QAction::triggered, [this]() {
+    loader_->CancelAll();
+  });
+
+  connect(ui->actionVoxelize, &QAction::triggered, [this]() {
+    osg::ref_ptr<osg::Node> scene = osg_widget_->getSceneData();
+    std::vector<float> corners;
+    osg_util::CollectTriangles(scene, corners);
+    if (corners.empty()) {
+      statusBar()->showMessage("Nothing to voxelize");
+      return;
+    }
+    // About 128 voxels across the model.
+    vox::VoxelizeSettings settings;
+    settings.voxelSize = std::max(scene->getBound().radius() / 64.0f, 1e-3f);
+    auto map = std::make_shared<vox::VoxelMap>();
+    vox::VoxelizeStats stats;
+    vox::voxelizeMesh(corners.data(), corners.size() / 9, *map, settings,
+                      &stats);
+    osg_widget_->setSceneData(new VoxelView(map));
+    statusBar()->showMessage(
+        QString("%1 triangles at %2 M/s, %3 chunks, %4 surface + %5 filled "
+                "voxels, %6 open columns")
+            .arg(stats.triangles)
+            .arg(stats.trianglesPerSecond() / 1e6, 0, 'f', 2)
+            .arg(stats.chunks)
+            .arg(stats.surfaceVoxels)
+            .arg(stats.filledVoxels)
+            .arg(stats.openColumns));
+  });
+
+  connect(ui->actionDefault, &QAction::triggered,
+          [this]() { startLoading("cessna.osg"); });
 
   connect(ui->actionSimple_Object, &QAction::triggered, [this]() {
     osg::ref_ptr<osg::ShapeDrawable> box =
@@ -135,14 +202,69 @@ MainWindow::MainWindow(QWidget *parent)
     geom->setNormalArray(normals);
     geom->setNormalBinding(osg::Geometry::BIND_OVERALL);
     geom->addPrimitiveSet(new osg::DrawArrays(GL_QUAD_STRIP, 0, 10));
-    osg::TriangleFunctor<osg_util::FaceCollector> functor;
-    geom->accept(functor);
     osg::ref_ptr<osg::Geode> root = new osg::Geode;
     root->addDrawable(geom);
     osg_widget_->setSceneData(root);
+    showMeshStats(root);
+  });
+
+  connect(ui->actionVoxel_Map, &QAction::triggered, [this]() {
+    auto map = std::make_shared<vox::VoxelMap>();
+    vox::TerrainGenerator generator(vox::TerrainSettings(),
+                                    map->getMaterials());
+    generator.generate(*map, vox::Vec3i(-4, 0, -4), vox::Vec3i(3, 2, 3));
+    // Chunks are meshed a batch per frame once the view is in the scene.
+    osg::ref_ptr<VoxelView> view = new VoxelView(map);
+    osg_widget_->setSceneData(view);
+    statusBar()->showMessage(
+        QString("%1 chunks").arg(map->getChunkCount()));
   });
 
   ui->actionDefault->trigger();
 }
 
 MainWindow::~MainWindow() { delete ui; }
+
+void MainWindow::startLoading(const std::string& path) {
+  if (loading_id_) {
+    loader_->Cancel(loading_id_);
+  }
+  loading_id_ = loader_->Load(path);
+  progress_->setRange(0, 0);
+  progress_->show();
+  statusBar()->showMessage(QString("Loading %1...").arg(
+      QString::fromStdString(path)));
+}
+
+void MainWindow::pollLoading() {
+  std::vector<ModelLoader::Result> results;
+  loader_->TakeResults(results);
+  for (const ModelLoader::Result& result : results) {
+    if (result.id != loading_id_) {
+      continue;  // replaced by a later load
+    }
+    loading_id_ = 0;
+    progress_->hide();
+    if (result.node) {
+      osg_widget_->setSceneData(result.node);
+      showMeshStats(result.node);
+    } else if (result.cancelled) {
+      statusBar()->showMessage("Loading cancelled");
+    } else {
+      statusBar()->showMessage(QString::fromStdString(result.error));
+    }
+  }
+  if (loading_id_) {
+    double progress = loader_->GetProgress(loading_id_);
+    if (progress >= 0.0) {
+      progress_->setRange(0, 1000);
+      progress_->setValue(int(progress * 1000.0));
+    }
+  }
+}
+
+void MainWindow::showMeshStats(osg::Node* node) {
+  std::ostringstream summary;
+  summary << osg_util::AnalyzeMesh(node);
+  statusBar()->showMessage(QString::fromStdString(summary.str()));
+}
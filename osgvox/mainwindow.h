@@ -2,8 +2,16 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <memory>
+#include <string>
 
+class ModelLoader;
 class OsgWidget;
+class QProgressBar;
+
+namespace osg {
+class Node;
+}
 
 namespace Ui {
 class MainWindow;
@@ -18,8 +26,18 @@ public:
     ~MainWindow();
 
 private:
+    // Puts a summary of node's triangles in the status bar.
+    void showMeshStats(osg::Node *node);
+    // Loads path in the background, replacing any load still running; the
+    // scene changes once it is done.
+    void startLoading(const std::string &path);
+    void pollLoading();
+
     Ui::MainWindow *ui;
     OsgWidget* osg_widget_ = nullptr;
+    std::unique_ptr<ModelLoader> loader_;
+    int loading_id_ = 0;
+    QProgressBar* progress_ = nullptr;
 };
 
 #endif // MAINWINDOW_H
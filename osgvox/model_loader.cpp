@@ -0,0 +1,230 @@
+#include "model_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+
+#include "MapFile.h"
+#include "voxel_view.h"
+
+namespace {
+
+const size_t kReadBlock = 1 << 16;
+
+// Stream over a file that counts what the parser has read and reports end
+// of file once the load is cancelled, so parsers stop at their next read.
+class CountingBuffer : public std::streambuf {
+ public:
+  CountingBuffer(FILE* file, std::atomic<uint64_t>& read,
+                 const std::atomic<bool>& cancel)
+      : file_(file), read_(read), cancel_(cancel), buffer_(kReadBlock) {}
+
+ protected:
+  int_type underflow() override {
+    if (cancel_) {
+      return traits_type::eof();
+    }
+    size_t n = std::fread(buffer_.data(), 1, buffer_.size(), file_);
+    if (n == 0) {
+      return traits_type::eof();
+    }
+    read_ += n;
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode) override {
+    // Where the parser is, behind the file by what is still buffered.
+    off_type here = off_type(std::ftell(file_)) - (egptr() - gptr());
+    if (dir == std::ios_base::cur) {
+      if (off == 0) {
+        return pos_type(here);
+      }
+      off += here;
+      dir = std::ios_base::beg;
+    }
+    if (std::fseek(file_, long(off),
+                   dir == std::ios_base::beg ? SEEK_SET : SEEK_END) != 0) {
+      return pos_type(off_type(-1));
+    }
+    setg(nullptr, nullptr, nullptr);
+    return pos_type(off_type(std::ftell(file_)));
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+
+ private:
+  FILE* file_;
+  std::atomic<uint64_t>& read_;
+  const std::atomic<bool>& cancel_;
+  std::vector<char> buffer_;
+};
+
+}  // namespace
+
+ModelLoader::ModelLoader(int threads) {
+  for (int i = 0; i < std::max(threads, 1); ++i) {
+    threads_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ModelLoader::~ModelLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    for (auto& entry : jobs_) {
+      entry.second->cancel = true;
+    }
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+int ModelLoader::Load(const std::string& path) {
+  auto job = std::make_shared<Job>();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->id = next_id_++;
+    job->path = path;
+    queue_.push_back(job);
+    jobs_[job->id] = job;
+  }
+  wake_.notify_one();
+  return job->id;
+}
+
+void ModelLoader::Cancel(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  if (it != jobs_.end()) {
+    it->second->cancel = true;
+  }
+}
+
+void ModelLoader::CancelAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : jobs_) {
+    entry.second->cancel = true;
+  }
+}
+
+double ModelLoader::GetProgress(int id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  if (it == jobs_.end() || it->second->size == 0) {
+    return -1.0;
+  }
+  return std::min(1.0, double(it->second->read) / double(it->second->size));
+}
+
+size_t ModelLoader::GetPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size();
+}
+
+bool ModelLoader::TakeResults(std::vector<Result>& out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (done_.empty()) {
+    return false;
+  }
+  for (Result& result : done_) {
+    out.push_back(std::move(result));
+  }
+  done_.clear();
+  return true;
+}
+
+void ModelLoader::WorkerLoop() {
+  for (;;) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      job = queue_.front();
+      queue_.pop_front();
+    }
+    Result result = job->cancel ? Result() : Run(*job);
+    result.id = job->id;
+    result.path = job->path;
+    if (job->cancel) {
+      result.node = nullptr;
+      result.cancelled = true;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.erase(job->id);
+    done_.push_back(std::move(result));
+  }
+}
+
+ModelLoader::Result ModelLoader::Run(Job& job) {
+  Result result;
+  std::string ext = osgDB::getLowerCaseFileExtension(job.path);
+  if (ext == "vxm") {
+    auto map = std::make_shared<vox::VoxelMap>();
+    if (!vox::loadMap(*map, job.path, &result.error)) {
+      return result;
+    }
+    // Chunks are meshed a batch per frame once the view is in the scene.
+    result.node = new VoxelView(map);
+    return result;
+  }
+
+  std::string file = osgDB::findDataFile(job.path);
+  if (file.empty()) {
+    result.error = "File not found: " + job.path;
+    return result;
+  }
+  osgDB::ReaderWriter* reader =
+      osgDB::Registry::instance()->getReaderWriterForExtension(ext);
+  FILE* handle = reader ? std::fopen(file.c_str(), "rb") : nullptr;
+  if (handle) {
+    std::fseek(handle, 0, SEEK_END);
+    job.size = uint64_t(std::ftell(handle));
+    std::fseek(handle, 0, SEEK_SET);
+    CountingBuffer buffer(handle, job.read, job.cancel);
+    std::istream stream(&buffer);
+    // Relative paths inside the model resolve next to it.
+    osg::ref_ptr<osgDB::Options> options =
+        osgDB::Registry::instance()->getOptions()
+            ? osgDB::Registry::instance()->getOptions()->cloneOptions()
+            : new osgDB::Options;
+    options->setDatabasePath(osgDB::getFilePath(file));
+    osgDB::ReaderWriter::ReadResult read = reader->readNode(stream, options);
+    std::fclose(handle);
+    if (read.validNode()) {
+      result.node = read.getNode();
+      return result;
+    }
+    if (job.cancel) {
+      return result;
+    }
+    if (read.status() != osgDB::ReaderWriter::ReadResult::FILE_NOT_HANDLED &&
+        read.status() != osgDB::ReaderWriter::ReadResult::NOT_IMPLEMENTED) {
+      result.error = read.message().empty() ? "Could not read " + job.path
+                                            : read.message();
+      return result;
+    }
+    // The plugin cannot read streams, fall back to the file name.
+    job.size = 0;
+  }
+  result.node = osgDB::readNodeFile(file);
+  if (!result.node) {
+    result.error = "Could not read " + job.path;
+  }
+  return result;
+}
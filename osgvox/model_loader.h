@@ -0,0 +1,74 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <osg/Node>
+
+// Loads models and voxel maps on worker threads so the GUI thread never
+// waits on the disk or a parser. Finished subgraphs wait in a queue until
+// the GUI thread takes them and puts them in the scene.
+//
+// Models whose plugin reads from a stream are fed through one that counts
+// bytes, which gives real progress and lets a cancel stop the parser at its
+// next read. Other files load in one call: their progress is unknown and a
+// cancel only drops the result. .vxm maps come back as a VoxelView.
+class ModelLoader {
+ public:
+  struct Result {
+    int id = 0;
+    std::string path;
+    osg::ref_ptr<osg::Node> node;  // null on failure or cancel
+    std::string error;
+    bool cancelled = false;
+  };
+
+  explicit ModelLoader(int threads = 2);
+  // Cancels everything still loading and waits for the workers.
+  ~ModelLoader();
+
+  // Queues path and returns the id its Result will carry.
+  int Load(const std::string& path);
+  void Cancel(int id);
+  void CancelAll();
+
+  // 0..1 for a load in progress, -1 when it cannot be told or id is done.
+  double GetProgress(int id) const;
+  size_t GetPendingCount() const;
+
+  // Moves finished loads into out, oldest first. Returns false when there
+  // were none.
+  bool TakeResults(std::vector<Result>& out);
+
+ private:
+  struct Job {
+    int id;
+    std::string path;
+    std::atomic<uint64_t> read{0};
+    std::atomic<uint64_t> size{0};
+    std::atomic<bool> cancel{false};
+  };
+
+  void WorkerLoop();
+  Result Run(Job& job);
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::shared_ptr<Job>> queue_;
+  std::unordered_map<int, std::shared_ptr<Job>> jobs_;  // queued or running
+  std::vector<Result> done_;
+  std::vector<std::thread> threads_;
+  int next_id_ = 1;
+  bool stop_ = false;
+};
+
+#endif  // MODEL_LOADER_H
@@ -0,0 +1,216 @@
+#include "osg_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <unordered_map>
+
+#include <osg/Array>
+#include <osg/Drawable>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/TriangleFunctor>
+#include <osg/Version>
+
+#include "Parallel.h"
+
+namespace osg_util {
+
+namespace {
+
+// Below this the triangle has no surface worth drawing.
+const float kDegenerateArea = 1e-12f;
+
+struct DrawableRef {
+  osg::ref_ptr<osg::Drawable> drawable;
+  osg::Matrix matrix;
+};
+
+// Drawables sit in Geodes, and since OSG 3.4 may also be children of any
+// group.
+class DrawableFinder : public osg::NodeVisitor {
+ public:
+  DrawableFinder() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN) {}
+
+  void apply(osg::Geode& geode) override {
+    osg::Matrix matrix = osg::computeLocalToWorld(getNodePath());
+    for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+      found.push_back({geode.getDrawable(i), matrix});
+    }
+  }
+
+#if OSG_MIN_VERSION_REQUIRED(3, 4, 0)
+  void apply(osg::Drawable& drawable) override {
+    found.push_back({&drawable, osg::computeLocalToWorld(getNodePath())});
+  }
+#endif
+
+  std::vector<DrawableRef> found;
+};
+
+struct PositionKey {
+  uint32_t bits[3];
+
+  explicit PositionKey(const osg::Vec3& v) { std::memcpy(bits, v.ptr(), 12); }
+
+  bool operator==(const PositionKey& o) const {
+    return bits[0] == o.bits[0] && bits[1] == o.bits[1] &&
+           bits[2] == o.bits[2];
+  }
+};
+
+struct PositionHash {
+  size_t operator()(const PositionKey& k) const {
+    return (k.bits[0] * 0x8DA6B343u) ^ (k.bits[1] * 0xD8163841u) ^
+           (k.bits[2] * 0xCB1AB31Fu);
+  }
+};
+
+typedef std::unordered_map<PositionKey, uint32_t, PositionHash> PositionIds;
+
+uint32_t IdOf(PositionIds& ids, const osg::Vec3& v) {
+  return ids.emplace(PositionKey(v), uint32_t(ids.size())).first->second;
+}
+
+void CountDuplicates(const osg::Drawable& drawable, MeshStats& stats) {
+  const osg::Geometry* geom = drawable.asGeometry();
+  const osg::Vec3Array* array =
+      geom ? dynamic_cast<const osg::Vec3Array*>(geom->getVertexArray())
+           : nullptr;
+  if (!array) {
+    return;
+  }
+  PositionIds seen;
+  seen.reserve(array->size());
+  for (const osg::Vec3& v : *array) {
+    IdOf(seen, v);
+  }
+  stats.vertices += array->size();
+  stats.duplicate_vertices += array->size() - seen.size();
+}
+
+void Analyze(const DrawableRef& ref, osg::TriangleFunctor<FaceCollector>& faces,
+             PositionIds& ids, std::unordered_map<uint64_t, uint32_t>& edges,
+             MeshStats& stats) {
+  faces.corners.clear();
+  faces.matrix = ref.matrix;
+  ref.drawable->accept(faces);
+  CountDuplicates(*ref.drawable, stats);
+
+  ids.clear();
+  edges.clear();
+  const std::vector<osg::Vec3>& corners = faces.corners;
+  for (size_t i = 0; i + 2 < corners.size(); i += 3) {
+    const osg::Vec3& a = corners[i];
+    const osg::Vec3& b = corners[i + 1];
+    const osg::Vec3& c = corners[i + 2];
+    stats.bounds.expandBy(a);
+    stats.bounds.expandBy(b);
+    stats.bounds.expandBy(c);
+    float area = ((b - a) ^ (c - a)).length() * 0.5f;
+    if (area <= kDegenerateArea) {
+      ++stats.degenerate;
+      continue;
+    }
+    stats.area += area;
+    uint32_t id[3] = {IdOf(ids, a), IdOf(ids, b), IdOf(ids, c)};
+    for (int k = 0; k < 3; ++k) {
+      uint32_t p = id[k];
+      uint32_t q = id[(k + 1) % 3];
+      uint64_t key = p < q ? (uint64_t(p) << 32 | q) : (uint64_t(q) << 32 | p);
+      ++edges[key];
+    }
+  }
+  stats.triangles += corners.size() / 3;
+  for (const auto& edge : edges) {
+    stats.boundary_edges += edge.second == 1 ? 1 : 0;
+    stats.non_manifold_edges += edge.second > 2 ? 1 : 0;
+  }
+  ++stats.drawables;
+}
+
+}  // namespace
+
+std::ostream& operator<<(std::ostream& os, const osg::Vec3& v) {
+  return os << v.x() << ", " << v.y() << ", " << v.z();
+}
+
+void MeshStats::Merge(const MeshStats& other) {
+  drawables += other.drawables;
+  triangles += other.triangles;
+  degenerate += other.degenerate;
+  vertices += other.vertices;
+  duplicate_vertices += other.duplicate_vertices;
+  boundary_edges += other.boundary_edges;
+  non_manifold_edges += other.non_manifold_edges;
+  area += other.area;
+  bounds.expandBy(other.bounds);
+}
+
+std::ostream& operator<<(std::ostream& os, const MeshStats& stats) {
+  os << stats.drawables << " drawables, " << stats.triangles << " triangles ("
+     << stats.degenerate << " degenerate), " << stats.vertices
+     << " vertices (" << stats.duplicate_vertices << " duplicate), "
+     << stats.boundary_edges << " boundary edges, "
+     << stats.non_manifold_edges << " non-manifold edges, area "
+     << stats.area;
+  if (stats.bounds.valid()) {
+    os << ", bounds (" << stats.bounds._min << ") - (" << stats.bounds._max
+       << ")";
+  }
+  return os << ", " << stats.milliseconds << " ms";
+}
+
+void CollectTriangles(osg::Node* root, std::vector<float>& corners) {
+  corners.clear();
+  if (!root) {
+    return;
+  }
+  DrawableFinder finder;
+  root->accept(finder);
+  osg::TriangleFunctor<FaceCollector> faces;
+  for (const DrawableRef& ref : finder.found) {
+    faces.corners.clear();
+    faces.matrix = ref.matrix;
+    ref.drawable->accept(faces);
+    for (const osg::Vec3& v : faces.corners) {
+      corners.insert(corners.end(), {v.x(), v.y(), v.z()});
+    }
+  }
+}
+
+MeshStats AnalyzeMesh(osg::Node* root, vox::ThreadPool* pool) {
+  auto start = std::chrono::steady_clock::now();
+  MeshStats total;
+  if (!root) {
+    return total;
+  }
+  DrawableFinder finder;
+  root->accept(finder);
+  const std::vector<DrawableRef>& drawables = finder.found;
+
+  vox::ThreadPool& threads = pool ? *pool : vox::defaultThreadPool();
+  size_t blocks = std::min(size_t(threads.getThreadCount()), drawables.size());
+  std::vector<MeshStats> partial(blocks);
+  threads.parallelFor(blocks, [&](size_t block) {
+    // Scratch reused across this thread's drawables.
+    osg::TriangleFunctor<FaceCollector> faces;
+    PositionIds ids;
+    std::unordered_map<uint64_t, uint32_t> edges;
+    for (size_t i = block; i < drawables.size(); i += blocks) {
+      Analyze(drawables[i], faces, ids, edges, partial[block]);
+    }
+  });
+  for (const MeshStats& stats : partial) {
+    total.Merge(stats);
+  }
+  total.milliseconds = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  return total;
+}
+
+}  // namespace osg_util
@@ -1,18 +1,60 @@
 #pragma once
 
-#include <iostream>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+#include <osg/BoundingBox>
+#include <osg/Matrix>
+#include <osg/Node>
 #include <osg/Vec3>
 
-namespace osg_util {
-std::ostream& operator<<(std::ostream& os, const osg::Vec3& v) {
-  return os << v.x() << ", " << v.y() << ", " << v.z();
+namespace vox {
+class ThreadPool;
 }
 
+namespace osg_util {
+std::ostream& operator<<(std::ostream& os, const osg::Vec3& v);
+
+// Summary of the triangles under a node, in world coordinates. Vertices and
+// edges are matched by exact position within each drawable; edges shared
+// between drawables are not joined up.
+struct MeshStats {
+  size_t drawables = 0;
+  size_t triangles = 0;
+  size_t degenerate = 0;          // zero area, not counted in the edges
+  size_t vertices = 0;            // entries of the vertex arrays
+  size_t duplicate_vertices = 0;  // entries repeating an earlier position
+  size_t boundary_edges = 0;      // used by one triangle
+  size_t non_manifold_edges = 0;  // used by more than two
+  double area = 0.0;
+  osg::BoundingBox bounds;
+  double milliseconds = 0.0;
+
+  void Merge(const MeshStats& other);
+};
+
+std::ostream& operator<<(std::ostream& os, const MeshStats& stats);
+
+// For osg::TriangleFunctor: gathers the corners of every triangle, moved
+// by matrix, three per face.
 struct FaceCollector {
+  osg::Matrix matrix;
+  std::vector<osg::Vec3> corners;
+
   void operator()(const osg::Vec3& v1, const osg::Vec3& v2,
                   const osg::Vec3& v3) {
-    std::cout << "Face vertices: (" << v1 << "); (" << v2 << "); (" << v3 << ")"
-              << std::endl;
+    corners.push_back(v1 * matrix);
+    corners.push_back(v2 * matrix);
+    corners.push_back(v3 * matrix);
   }
 };
-}  // namespace osg_util
\ No newline at end of file
+
+// World space corners of every triangle under root, 9 floats per triangle,
+// in the layout vox::voxelizeMesh() takes.
+void CollectTriangles(osg::Node* root, std::vector<float>& corners);
+
+// Walks root, then analyses its drawables on the pool, each thread adding
+// into its own MeshStats that are merged at the end.
+MeshStats AnalyzeMesh(osg::Node* root, vox::ThreadPool* pool = nullptr);
+}  // namespace osg_util
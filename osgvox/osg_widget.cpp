@@ -1,9 +1,20 @@
 #include "osg_widget.h"
 #include <QMouseEvent>
-#include <QPainter>
 #include <QWheelEvent>
 #include <osgGA/TrackballManipulator>
 
+namespace {
+
+// Weight of the newest frame in the running timing averages.
+const double kTimingSmoothing = 0.05;
+
+double Smooth(double average, double sample) {
+  return average > 0.0 ? average + (sample - average) * kTimingSmoothing
+                       : sample;
+}
+
+}  // namespace
+
 OsgWidget::OsgWidget(QWidget* parent, Qt::WindowFlags f)
     : QOpenGLWidget(parent, f) {
   graph_win_embed_rp_ =
@@ -19,8 +30,19 @@ OsgWidget::OsgWidget(QWidget* parent, Qt::WindowFlags f)
   setMouseTracking(true);
 }
 
-void OsgWidget::paintGL() {
+void OsgWidget::TimedFrame() {
+  QElapsedTimer busy;
+  busy.start();
   frame();
+  gui_ms_ = Smooth(gui_ms_, busy.nsecsElapsed() / 1e6);
+  if (frame_clock_.isValid()) {
+    frame_ms_ = Smooth(frame_ms_, frame_clock_.nsecsElapsed() / 1e6);
+  }
+  frame_clock_.start();
+}
+
+void OsgWidget::paintGL() {
+  TimedFrame();
   update();
 }
 
@@ -63,19 +85,6 @@ void OsgWidget::wheelEvent(QWheelEvent* event) {
                                 : osgGA::GUIEventAdapter::SCROLL_RIGHT));
 }
 
-void OsgWidget::paintEvent(QPaintEvent* event) {
-  QOpenGLWidget::makeCurrent();
-
-  QPainter painter(this);
-  painter.setRenderHint(QPainter::Antialiasing);
-  paintGL();
-
-  QOpenGLWidget::paintEvent(event);
-  painter.end();
-
-  QOpenGLWidget::doneCurrent();
-}
-
 unsigned int OsgWidget::GetOsgMouseButton(const Qt::MouseButton& qt_mouse_btn) {
   if (Qt::LeftButton == qt_mouse_btn) return 1;
   if (Qt::MiddleButton == qt_mouse_btn) return 2;
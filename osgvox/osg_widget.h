@@ -1,13 +1,21 @@
 #ifndef OSG_WIDGET_H
 #define OSG_WIDGET_H
 
+#include <QElapsedTimer>
 #include <QOpenGLWidget>
 #include <osgViewer/Viewer>
 
+// An embedded viewer: update, cull and draw all run inside paintGL on the
+// GUI thread.
 class OsgWidget : public QOpenGLWidget, public osgViewer::Viewer {
 public:
   OsgWidget(QWidget* parent = Q_NULLPTR, Qt::WindowFlags f = Qt::WindowFlags());
 
+  // Averages over recent frames: time between frames, and how long each
+  // frame() call kept the GUI thread busy.
+  double GetFrameTimeMs() const { return frame_ms_; }
+  double GetGuiTimeMs() const { return gui_ms_; }
+
  protected:
   // reimplement from QOpenGLWidget
   void paintGL() override;
@@ -20,13 +28,17 @@ public:
   void mouseDoubleClickEvent(QMouseEvent* event) override;
   void wheelEvent(QWheelEvent* event) override;
 
-  void paintEvent(QPaintEvent* event) override;
-
  private:
   static unsigned int GetOsgMouseButton(const Qt::MouseButton& qt_mouse_btn);
 
+  // Runs one frame() and updates the timings.
+  void TimedFrame();
+
  private:
   osg::ref_ptr<osgViewer::GraphicsWindowEmbedded> graph_win_embed_rp_;
+  QElapsedTimer frame_clock_;
+  double frame_ms_ = 0.0;
+  double gui_ms_ = 0.0;
 };
 
 #endif  // OSG_WIDGET_H
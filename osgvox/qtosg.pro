@@ -6,18 +6,26 @@ QT += core gui
 # Define your source and header files
 SOURCES += main.cpp \
     mainwindow.cpp \
-    osg_widget.cpp
+    model_loader.cpp \
+    osg_utils.cpp \
+    osg_widget.cpp \
+    voxel_view.cpp
 
 HEADERS += \
     mainwindow.h \
     mainwindow.h \
+    model_loader.h \
     osg_utils.h \
-    osg_widget.h
+    osg_widget.h \
+    voxel_view.h
 
 FORMS += \
     mainwindow.ui \
     mainwindow.ui
 
+# Shared voxel storage and meshing
+include(../voxcore/voxcore.pri)
+
 # Include OpenSceneGraph
 INCLUDEPATH += /usr/local/include/osg
 INCLUDEPATH += /usr/local/include/osgViewer
@@ -51,7 +59,7 @@ INCLUDEPATH += /usr/include/qt/QtGui
 INCLUDEPATH += /usr/include/qt/QtCore
 
 # Additional compiler options
-QMAKE_CXXFLAGS += -std=c++11
+CONFIG += c++17
 
 # Add any necessary DEFINES
 DEFINES += OSG_LIBRARY_STATIC
@@ -0,0 +1,157 @@
+#include "voxel_view.h"
+
+#include <algorithm>
+
+#include <osg/CullFace>
+#include <osg/NodeCallback>
+
+#include "Parallel.h"
+
+namespace {
+
+// Enough to load a few hundred chunks in a second or two without a hitch
+// on each frame.
+const size_t kChunksPerFrame = 64;
+
+}  // namespace
+
+class VoxelView::Updater : public osg::NodeCallback {
+ public:
+  void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+    static_cast<VoxelView*>(node)->Refresh();
+    traverse(node, nv);
+  }
+};
+
+VoxelView::VoxelView(std::shared_ptr<vox::VoxelMap> map, vox::ThreadPool* pool)
+    : map_(std::move(map)),
+      pool_(pool ? pool : &vox::defaultThreadPool()),
+      changes_(map_->getChanges().subscribe(vox::CHANGE_ALL)),
+      chunks_per_frame_(kChunksPerFrame),
+      style_(map_->getSurfaceStyle()),
+      geode_(new osg::Geode) {
+  for (const auto& entry : map_->getChunks()) {
+    pending_.insert(entry.first);
+  }
+  for (int i = 0; i < pool_->getThreadCount(); ++i) {
+    meshers_.emplace_back(new vox::ChunkMesher(*map_));
+    surface_meshers_.emplace_back(new vox::SurfaceMesher(*map_));
+  }
+
+  // Light and occlusion are baked into the vertex colours, so every chunk
+  // draws with the same unlit state.
+  osg::StateSet* state = getOrCreateStateSet();
+  state->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+  state->setAttributeAndModes(new osg::CullFace(osg::CullFace::BACK),
+                              osg::StateAttribute::ON);
+
+  addChild(geode_);
+  setUpdateCallback(new Updater);
+}
+
+VoxelView::~VoxelView() { map_->getChanges().unsubscribe(changes_); }
+
+osg::ref_ptr<osg::Geometry> VoxelView::BuildGeometry(
+    const vox::ChunkMesh& mesh) {
+  size_t count = mesh.vertices.size();
+  osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array(count);
+  osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(count);
+  osg::ref_ptr<osg::Vec4ubArray> colors = new osg::Vec4ubArray(count);
+  for (size_t i = 0; i < count; ++i) {
+    const vox::MeshVertex& v = mesh.vertices[i];
+    (*vertices)[i].set(v.x, v.y, v.z);
+    (*normals)[i].set(v.nx, v.ny, v.nz);
+    (*colors)[i].set(v.r, v.g, v.b, v.a);
+  }
+
+  osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+  geom->setUseDisplayList(false);
+  geom->setUseVertexBufferObjects(true);
+  geom->setDataVariance(osg::Object::STATIC);
+  geom->setVertexArray(vertices);
+  geom->setNormalArray(normals);
+  geom->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+  colors->setNormalize(true);
+  geom->setColorArray(colors);
+  geom->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
+  if (count <= 0x10000) {
+    osg::ref_ptr<osg::DrawElementsUShort> indices =
+        new osg::DrawElementsUShort(GL_TRIANGLES);
+    indices->reserve(mesh.indices.size());
+    for (uint32_t index : mesh.indices) {
+      indices->push_back(GLushort(index));
+    }
+    geom->addPrimitiveSet(indices);
+  } else {
+    // Only a chunk full of isolated cells gets here.
+    geom->addPrimitiveSet(new osg::DrawElementsUInt(
+        GL_TRIANGLES, mesh.indices.begin(), mesh.indices.end()));
+  }
+  return geom;
+}
+
+void VoxelView::Refresh() {
+  // By the next update every draw of the frame that retired them is done.
+  retired_.clear();
+
+  std::vector<vox::ChunkChange> changes;
+  map_->getChanges().poll(changes_, changes);
+  for (const vox::ChunkChange& change : changes) {
+    pending_.insert(change.chunk);
+  }
+  if (map_->getSurfaceStyle() != style_) {
+    style_ = map_->getSurfaceStyle();
+    for (const auto& entry : map_->getChunks()) {
+      pending_.insert(entry.first);
+    }
+  }
+  if (pending_.empty()) {
+    return;
+  }
+
+  std::vector<vox::Vec3i> batch;
+  for (auto it = pending_.begin();
+       it != pending_.end() && batch.size() < chunks_per_frame_;) {
+    batch.push_back(*it);
+    it = pending_.erase(it);
+  }
+
+  // Meshing and filling the arrays run on the pool; only the swap below
+  // touches the scene graph.
+  std::vector<osg::ref_ptr<osg::Geometry>> built(batch.size());
+  size_t blocks = std::min(meshers_.size(), batch.size());
+  const bool smooth = style_ == vox::SURFACE_SMOOTH;
+  pool_->parallelFor(blocks, [&](size_t block) {
+    vox::ChunkMesh mesh;
+    for (size_t i = block; i < batch.size(); i += blocks) {
+      if (!map_->hasChunk(batch[i])) {
+        continue;
+      }
+      if (smooth) {
+        surface_meshers_[block]->mesh(batch[i], mesh);
+      } else {
+        meshers_[block]->mesh(batch[i], mesh);
+      }
+      if (!mesh.empty()) {
+        built[i] = BuildGeometry(mesh);
+      }
+    }
+  });
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    auto it = drawables_.find(batch[i]);
+    if (it != drawables_.end()) {
+      retired_.push_back(it->second);
+      if (built[i]) {
+        geode_->replaceDrawable(it->second, built[i]);
+        it->second = built[i];
+      } else {
+        geode_->removeDrawable(it->second);
+        drawables_.erase(it);
+      }
+    } else if (built[i]) {
+      geode_->addDrawable(built[i]);
+      drawables_[batch[i]] = built[i];
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef VOXEL_VIEW_H
+#define VOXEL_VIEW_H
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Group>
+
+#include "ChangeTracker.h"
+#include "ChunkMesher.h"
+#include "SurfaceMesher.h"
+#include "VoxelMap.h"
+
+namespace vox {
+class ThreadPool;
+}
+
+// Scene graph view of a vox::VoxelMap: one osg::Geometry per chunk, drawn
+// from vertex buffer objects with 16-bit indices, all under one StateSet
+// set on this group, so cull sees one drawable per chunk and draw never
+// switches state between them.
+//
+// Changed chunks are remeshed from the map's change log in the update
+// traversal and their geometry replaced whole, never edited in place. The
+// old geometry is held until the next update, so a draw thread still on
+// the previous frame is unaffected. Chunks are meshed as
+// cubes or as a smooth surface following the map's surface style, and all
+// of them are remeshed when it changes. The view keeps the map alive as
+// long as the scene graph holds it; edit the map only from the thread
+// running the update traversal.
+class VoxelView : public osg::Group {
+ public:
+  explicit VoxelView(std::shared_ptr<vox::VoxelMap> map, vox::ThreadPool* pool = nullptr);
+
+  // Chunks remeshed per update traversal; the rest wait for the next frame.
+  void SetChunksPerFrame(size_t chunks) { chunks_per_frame_ = chunks; }
+  size_t GetPendingChunks() const { return pending_.size(); }
+  size_t GetChunkDrawables() const { return drawables_.size(); }
+
+  // Remeshes up to chunks_per_frame_ changed chunks and swaps their geometry.
+  void Refresh();
+
+ protected:
+  ~VoxelView() override;
+
+ private:
+  class Updater;
+
+  static osg::ref_ptr<osg::Geometry> BuildGeometry(const vox::ChunkMesh& mesh);
+
+  std::shared_ptr<vox::VoxelMap> map_;
+  vox::ThreadPool* pool_;
+  vox::ChangeTracker::Subscriber changes_;
+  size_t chunks_per_frame_;
+  std::unordered_set<vox::Vec3i, vox::Vec3iHash> pending_;
+  vox::SurfaceStyle style_;
+  // One per pool thread, each keeps its scratch buffers between frames.
+  std::vector<std::unique_ptr<vox::ChunkMesher>> meshers_;
+  std::vector<std::unique_ptr<vox::SurfaceMesher>> surface_meshers_;
+  // Holds every chunk's geometry.
+  osg::ref_ptr<osg::Geode> geode_;
+  std::unordered_map<vox::Vec3i, osg::ref_ptr<osg::Geometry>, vox::Vec3iHash>
+      drawables_;
+  // Taken out of the scene by the last Refresh.
+  std::vector<osg::ref_ptr<osg::Geometry>> retired_;
+};
+
+#endif  // VOXEL_VIEW_H
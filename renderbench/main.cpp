@@ -0,0 +1,251 @@
+// Frame times of ChunkRenderer's paths on llvmpipe, without Qt or a display.
+//
+// Renders the world and camera pan of the editor's --benchmark-frames mode:
+// the same generated world, lighting and remeshing per frame, and a context
+// of the version main() asks Qt for, made through EGL with no surface and
+// drawn into an offscreen framebuffer. The Qt classes ChunkRenderer uses
+// come from standin/, so these are the renderer's numbers, not the
+// editor's: no widget, event loop or compositing.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QOpenGLContext>
+
+#include "ChunkMesher.h"
+#include "ChunkRenderer.h"
+#include "TerrainGenerator.h"
+#include "VoxelLighting.h"
+#include "VoxelMap.h"
+
+namespace {
+
+// As in main.cpp.
+const int LIGHT_STEPS_PER_FRAME = 20000;
+const float FAR_PLANE = 1000.0f;
+const int BENCHMARK_SEED = 1;
+const float BENCHMARK_DISTANCE = 250.0f;
+const float BENCHMARK_HEIGHT = 40.0f;
+const int GRID_SIZE = 10;
+// The editor's default window and background.
+const int WIDTH = 800;
+const int HEIGHT = 600;
+const float CLEAR_GREY = 0.1f;
+
+double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The editor's world and paintGL, without the widget.
+class Scene {
+public:
+    Scene() : mLighting(mMap), mMesher(mMap), mCameraX(0.0f) {
+        mMesher.setLighting(&mLighting);
+        mChanges = mMap.getChanges().subscribe(vox::CHANGE_ALL);
+        vox::TerrainSettings settings;
+        settings.seed = BENCHMARK_SEED;
+        vox::TerrainGenerator generator(settings, mMap.getMaterials());
+        generator.generate(mMap, vox::Vec3i(-4, 0, -4), vox::Vec3i(3, 2, 3));
+        mLighting.relightAll();
+        mProjection.perspective(45.0f, float(WIDTH) / HEIGHT, 0.1f, FAR_PLANE);
+    }
+
+    ChunkRenderer &getRenderer() { return mRenderer; }
+    void setCameraX(float x) { mCameraX = x; }
+
+    size_t getVertexCount() const {
+        size_t vertices = 0;
+        for (const auto &entry : mMeshes) {
+            vertices += entry.second.vertices.size();
+        }
+        return vertices;
+    }
+
+    // Returns whether the world was still being lit or meshed.
+    bool paint() {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        QMatrix4x4 view;
+        view.lookAt(QVector3D(mCameraX, BENCHMARK_HEIGHT, BENCHMARK_DISTANCE), QVector3D(mCameraX, BENCHMARK_HEIGHT, 0.0f),
+                    QVector3D(0.0f, 1.0f, 0.0f));
+        bool settling = mLighting.update(LIGHT_STEPS_PER_FRAME) > 0;
+        mRenderer.beginFrame();
+        settling = updateMeshes() || settling;
+        QMatrix4x4 model;
+        model.translate(-GRID_SIZE / 2, -GRID_SIZE / 2, -GRID_SIZE / 2);
+        mRenderer.draw(mProjection, view, model);
+        return settling;
+    }
+
+private:
+    bool updateMeshes() {
+        std::vector<vox::ChunkChange> changes;
+        mMap.getChanges().poll(mChanges, changes);
+        std::vector<vox::Vec3i> relit;
+        mLighting.takeChangedChunks(relit);
+        std::unordered_set<vox::Vec3i, vox::Vec3iHash> dirty(relit.begin(), relit.end());
+        for (const vox::ChunkChange &change : changes) {
+            dirty.insert(change.chunk);
+        }
+        for (const vox::Vec3i &chunk : dirty) {
+            if (!mMap.hasChunk(chunk)) {
+                mMeshes.erase(chunk);
+                mRenderer.remove(chunk);
+                continue;
+            }
+            mMesher.mesh(chunk, mMeshes[chunk]);
+            mRenderer.upload(chunk, mMeshes[chunk]);
+        }
+        return !dirty.empty();
+    }
+
+    vox::VoxelMap mMap;
+    vox::VoxelLighting mLighting;
+    vox::ChunkMesher mMesher;
+    vox::ChangeTracker::Subscriber mChanges;
+    std::unordered_map<vox::Vec3i, vox::ChunkMesh, vox::Vec3iHash> mMeshes;
+    ChunkRenderer mRenderer;
+    QMatrix4x4 mProjection;
+    float mCameraX;
+};
+
+// A context like the one main() asks Qt for: compatibility for legacy,
+// 3.3 core for core and 4.4 core for indirect. Describes what was made to
+// the stand-in QOpenGLContext.
+bool makeContext(ChunkRenderer::Path path, QOpenGLContext &context) {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (!getPlatformDisplay) {
+        return false;
+    }
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+        return false;
+    }
+    const bool legacy = path == ChunkRenderer::PATH_LEGACY;
+    const bool indirect = path == ChunkRenderer::PATH_INDIRECT;
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, legacy ? 2 : (indirect ? 4 : 3),
+        EGL_CONTEXT_MINOR_VERSION, legacy ? 0 : (indirect ? 4 : 3),
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        legacy ? EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT : EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    EGLContext egl = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (egl == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl)) {
+        return false;
+    }
+
+    GLint major = 0, minor = 0, mask = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &mask);
+    QSurfaceFormat format;
+    format.setVersion(major, minor);
+    format.setProfile(mask & GL_CONTEXT_CORE_PROFILE_BIT ? QSurfaceFormat::CoreProfile
+                                                         : QSurfaceFormat::CompatibilityProfile);
+    context.setFormat(format);
+    context.makeCurrent();
+    return true;
+}
+
+// Stands in for the widget's framebuffer: colour and a 24 bit depth buffer.
+void makeFramebuffer() {
+    GLuint framebuffer, buffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, buffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, buffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, buffers[1]);
+    glViewport(0, 0, WIDTH, HEIGHT);
+}
+
+// Share of the pixels that are not the background.
+double coverage() {
+    std::vector<unsigned char> pixels(size_t(WIDTH) * HEIGHT * 4);
+    glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    const unsigned char grey = (unsigned char)(CLEAR_GREY * 255.0f + 0.5f);
+    size_t covered = 0;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        if (pixels[i] != grey || pixels[i + 1] != grey || pixels[i + 2] != grey) {
+            ++covered;
+        }
+    }
+    return double(covered) / (size_t(WIDTH) * HEIGHT);
+}
+
+void usage() {
+    std::printf("usage: renderbench legacy|core|indirect [--frames N]\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    ChunkRenderer::Path path = ChunkRenderer::PATH_INDIRECT;
+    if (argc < 2 || !ChunkRenderer::parsePath(argv[1], path)) {
+        usage();
+        return 1;
+    }
+    int frames = 300;
+    for (int i = 2; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    QOpenGLContext context;
+    if (!makeContext(path, context)) {
+        std::fprintf(stderr, "renderbench: cannot create an OpenGL context through EGL\n");
+        return 1;
+    }
+    makeFramebuffer();
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(CLEAR_GREY, CLEAR_GREY, CLEAR_GREY, 1.0f);
+
+    Scene scene;
+    scene.getRenderer().initialize(path);
+
+    // Frames still lighting or meshing the world are not counted, as in the
+    // editor; each frame waits for llvmpipe so its time is the whole frame.
+    int settled = 0, done = 0;
+    double total = 0.0, worst = 0.0;
+    while (done < frames) {
+        double start = nowMs();
+        bool settling = scene.paint();
+        glFinish();
+        double ms = nowMs() - start;
+        if (settling) {
+            ++settled;
+            continue;
+        }
+        ++done;
+        total += ms;
+        worst = std::max(worst, ms);
+        // Pan across the world so every frame draws a different view.
+        scene.setCameraX(40.0f * std::sin(done * 0.05f));
+    }
+
+    const ChunkRenderer &renderer = scene.getRenderer();
+    std::printf("renderer %s on %s (GL %s): %.2f ms per frame (worst %.2f ms) over %d frames after %d settling, "
+                "%zu of %zu chunks drawn, %.2f M vertices, %.0f%% of pixels covered, GL error 0x%x\n",
+                ChunkRenderer::pathName(renderer.getPath()), reinterpret_cast<const char *>(glGetString(GL_RENDERER)),
+                reinterpret_cast<const char *>(glGetString(GL_VERSION)), total / done, worst, done, settled,
+                renderer.getDrawnChunkCount(), renderer.getChunkCount(), scene.getVertexCount() / 1e6,
+                coverage() * 100.0, glGetError());
+    scene.getRenderer().release();
+    return 0;
+}
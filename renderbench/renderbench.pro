@@ -0,0 +1,17 @@
+TEMPLATE = app
+TARGET = renderbench
+CONFIG += console
+CONFIG -= qt app_bundle
+
+include(../voxcore/voxcore.pri)
+
+# Stand-ins for Qt's OpenGL classes, see standin/StandInGL.h.
+INCLUDEPATH += .. standin
+
+HEADERS += ../ChunkRenderer.h \
+    standin/StandInGL.h
+
+SOURCES += main.cpp \
+    ../ChunkRenderer.cpp
+
+LIBS += -lEGL -lGL
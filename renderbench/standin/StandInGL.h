@@ -0,0 +1,101 @@
+#ifndef STANDIN_GL_H
+#define STANDIN_GL_H
+
+// Stand-ins for the few Qt OpenGL classes ChunkRenderer uses, so renderbench
+// builds without Qt. Functions forward straight to the system libGL; this is
+// not Qt and only covers what ChunkRenderer calls.
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <cstdio>
+
+class QSurfaceFormat {
+public:
+    enum OpenGLContextProfile { NoProfile, CoreProfile, CompatibilityProfile };
+
+    QSurfaceFormat() : mMajor(2), mMinor(0), mProfile(CompatibilityProfile) {}
+
+    void setVersion(int major, int minor) {
+        mMajor = major;
+        mMinor = minor;
+    }
+    void setProfile(OpenGLContextProfile profile) { mProfile = profile; }
+    int majorVersion() const { return mMajor; }
+    int minorVersion() const { return mMinor; }
+    OpenGLContextProfile profile() const { return mProfile; }
+
+private:
+    int mMajor, mMinor;
+    OpenGLContextProfile mProfile;
+};
+
+#define STANDIN_FORWARD(name) \
+    template <class... Args> auto name(Args... args) { return ::name(args...); }
+
+#define STANDIN_GL33_FUNCTIONS \
+    STANDIN_FORWARD(glGenBuffers) \
+    STANDIN_FORWARD(glBindBuffer) \
+    STANDIN_FORWARD(glBufferData) \
+    STANDIN_FORWARD(glBufferSubData) \
+    STANDIN_FORWARD(glCopyBufferSubData) \
+    STANDIN_FORWARD(glDeleteBuffers) \
+    STANDIN_FORWARD(glMapBufferRange) \
+    STANDIN_FORWARD(glUnmapBuffer) \
+    STANDIN_FORWARD(glGenVertexArrays) \
+    STANDIN_FORWARD(glBindVertexArray) \
+    STANDIN_FORWARD(glDeleteVertexArrays) \
+    STANDIN_FORWARD(glEnableVertexAttribArray) \
+    STANDIN_FORWARD(glVertexAttribPointer) \
+    STANDIN_FORWARD(glDrawElementsBaseVertex) \
+    STANDIN_FORWARD(glFenceSync) \
+    STANDIN_FORWARD(glClientWaitSync) \
+    STANDIN_FORWARD(glDeleteSync) \
+    STANDIN_FORWARD(glFinish)
+
+class QOpenGLFunctions_3_3_Core {
+public:
+    enum { VERSION = 33 };
+    bool initializeOpenGLFunctions() { return true; }
+    STANDIN_GL33_FUNCTIONS
+};
+
+class QOpenGLFunctions_4_4_Core {
+public:
+    enum { VERSION = 44 };
+    bool initializeOpenGLFunctions() { return true; }
+    STANDIN_GL33_FUNCTIONS
+    STANDIN_FORWARD(glBufferStorage)
+    STANDIN_FORWARD(glMultiDrawElementsIndirect)
+};
+
+// The caller creates the real context and says which version and profile it
+// got with setFormat(); versionFunctions() is null below the class's version,
+// as with Qt.
+class QOpenGLContext {
+public:
+    void setFormat(const QSurfaceFormat &format) { mFormat = format; }
+    QSurfaceFormat format() const { return mFormat; }
+    void makeCurrent() { current() = this; }
+    static QOpenGLContext *currentContext() { return current(); }
+
+    template <class Functions> Functions *versionFunctions() {
+        static Functions functions;
+        return mFormat.majorVersion() * 10 + mFormat.minorVersion() >= Functions::VERSION ? &functions : nullptr;
+    }
+
+private:
+    static QOpenGLContext *&current() {
+        static QOpenGLContext *context = nullptr;
+        return context;
+    }
+
+    QSurfaceFormat mFormat;
+};
+
+class QOpenGLShader {
+public:
+    enum ShaderTypeBit { Vertex = 1, Fragment = 2 };
+};
+
+#endif // STANDIN_GL_H
@@ -3,11 +3,13 @@ QT += widgets charts opengl
 TARGET = ToneGenerator
 TEMPLATE = app
 
-SOURCES += main.cpp
+SOURCES += main.cpp ChunkRenderer.cpp
 
-HEADERS +=
+HEADERS += ChunkRenderer.h
 
 INCLUDEPATH +=
 
-LIBS += -lglut -lGLU
+LIBS += -lGL
+
+include(voxcore/voxcore.pri)
 
@@ -0,0 +1,43 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <string>
+
+struct BenchOptions {
+    int size;
+    int iterations;
+    int threads;
+};
+
+class BenchTimer {
+public:
+    BenchTimer() : mStart(std::chrono::steady_clock::now()) {}
+
+    void restart() { mStart = std::chrono::steady_clock::now(); }
+
+    double elapsedMs() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStart).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point mStart;
+};
+
+// Prints one result line: name, time per iteration and a free-form detail.
+void report(const std::string &name, double msPerIteration, const std::string &detail = std::string());
+
+void benchOccupancy(const BenchOptions &options);
+void benchImport(const BenchOptions &options);
+void benchTerrain(const BenchOptions &options);
+void benchCollision(const BenchOptions &options);
+void benchCrowd(const BenchOptions &options);
+void benchSight(const BenchOptions &options);
+void benchDistance(const BenchOptions &options);
+void benchSmooth(const BenchOptions &options);
+void benchVoxelize(const BenchOptions &options);
+void benchSurface(const BenchOptions &options);
+void benchPhysics(const BenchOptions &options);
+void benchDiffusion(const BenchOptions &options);
+
+#endif // BENCH_H
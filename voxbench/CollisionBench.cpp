@@ -0,0 +1,140 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Bench.h"
+#include "OccupancyMask.h"
+#include "Parallel.h"
+#include "TerrainGenerator.h"
+#include "VoxelCollider.h"
+
+using namespace vox;
+
+namespace {
+
+const int AGENTS = 10000;
+const int TICKS_PER_ITERATION = 30;
+const float DT = 1.0f / 30.0f;
+const float SPEED = 4.0f;
+const int MARGIN = 4;
+
+uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7FEB352Du;
+    v ^= v >> 15;
+    v *= 0x846CA68Bu;
+    return v ^ (v >> 16);
+}
+
+float unit(uint32_t v) {
+    return (hash(v) >> 8) * (1.0f / 16777216.0f);
+}
+
+int surface(const OccupancyMask &mask, int x, int z) {
+    for (int y = mask.getSize().y - 1; y >= 0; --y) {
+        if (mask.get(x, y, z)) {
+            return y;
+        }
+    }
+    return -1;
+}
+
+std::vector<AgentBody> spawn(const OccupancyMask &mask) {
+    std::vector<AgentBody> bodies(AGENTS);
+    int side = mask.getSize().x;
+    for (int i = 0; i < AGENTS; ++i) {
+        AgentBody &body = bodies[i];
+        int x = MARGIN + int(unit(i * 4) * (side - 2 * MARGIN));
+        int z = MARGIN + int(unit(i * 4 + 1) * (side - 2 * MARGIN));
+        float angle = unit(i * 4 + 2) * 6.2831853f;
+        body.x = float(x);
+        body.z = float(z);
+        body.y = float(surface(mask, x, z)) + 0.5f + 0.01f;
+        body.vx = std::cos(angle) * SPEED;
+        body.vy = 0.0f;
+        body.vz = std::sin(angle) * SPEED;
+        body.halfWidth = 0.3f;
+        body.height = 1.8f;
+        body.flags = 0;
+    }
+    return bodies;
+}
+
+// Walkers pick a new heading when stopped by a wall and turn back at the
+// edge of the map.
+void steer(std::vector<AgentBody> &bodies, int side, int tick) {
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        AgentBody &body = bodies[i];
+        if (body.vx == 0.0f && body.vz == 0.0f) {
+            float angle = unit(uint32_t(i) * 7919u + uint32_t(tick)) * 6.2831853f;
+            body.vx = std::cos(angle) * SPEED;
+            body.vz = std::sin(angle) * SPEED;
+        }
+        if ((body.x < MARGIN && body.vx < 0.0f) || (body.x > side - MARGIN && body.vx > 0.0f)) {
+            body.vx = -body.vx;
+        }
+        if ((body.z < MARGIN && body.vz < 0.0f) || (body.z > side - MARGIN && body.vz > 0.0f)) {
+            body.vz = -body.vz;
+        }
+    }
+}
+
+struct RunResult {
+    std::vector<AgentBody> bodies;
+    size_t inside;
+    size_t grounded;
+};
+
+RunResult run(const OccupancyMask &mask, ThreadPool &pool, const BenchOptions &options, const std::string &label) {
+    VoxelCollider collider(mask);
+    RunResult result;
+    result.bodies = spawn(mask);
+    int ticks = options.iterations * TICKS_PER_ITERATION;
+    double moveMs = 0.0;
+    for (int t = 0; t < ticks; ++t) {
+        steer(result.bodies, mask.getSize().x, t);
+        BenchTimer timer;
+        collider.move(result.bodies.data(), result.bodies.size(), DT, MoveSettings(), &pool);
+        moveMs += timer.elapsedMs();
+    }
+
+    result.inside = 0;
+    result.grounded = 0;
+    for (const AgentBody &body : result.bodies) {
+        CollisionBox box = {{body.x - body.halfWidth, body.y, body.z - body.halfWidth},
+                            {body.x + body.halfWidth, body.y + body.height, body.z + body.halfWidth}};
+        result.inside += collider.overlaps(box) ? 1 : 0;
+        result.grounded += (body.flags & AGENT_ON_GROUND) ? 1 : 0;
+    }
+    char detail[160];
+    std::snprintf(detail, sizeof(detail), "%.2f M agent moves/s, %zu grounded, %zu inside walls%s",
+                  double(AGENTS) * ticks / moveMs / 1000.0, result.grounded, result.inside,
+                  result.inside ? "  FAIL" : "");
+    report(label, moveMs / ticks, detail);
+    return result;
+}
+
+} // namespace
+
+void benchCollision(const BenchOptions &options) {
+    int side = options.size < 64 ? 64 : options.size;
+    TerrainSettings settings;
+    settings.seed = 99;
+    VoxelMap map;
+    TerrainGenerator generator(settings, map.getMaterials());
+    int chunks = (side + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    generator.generate(map, Vec3i(0, 0, 0), Vec3i(chunks - 1, 2, chunks - 1));
+    OccupancyMask mask = OccupancyMask::fromMap(map, Vec3i(0, 0, 0), Vec3i(side, 3 * CHUNK_SIZE, side));
+
+    std::printf("  %d agents on a %dx%d generated map, %d ticks of %.0f ms\n", AGENTS, side, side,
+                options.iterations * TICKS_PER_ITERATION, DT * 1000.0f);
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    RunResult one = run(mask, single, options, "collision/1 thread per tick");
+    char label[64];
+    std::snprintf(label, sizeof(label), "collision/%d threads per tick", pool.getThreadCount());
+    RunResult many = run(mask, pool, options, label);
+    bool same = std::memcmp(one.bodies.data(), many.bodies.data(), one.bodies.size() * sizeof(AgentBody)) == 0;
+    report("collision/deterministic", 0.0, same ? "same result on every thread count" : "MISMATCH");
+}
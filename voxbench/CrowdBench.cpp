@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Bench.h"
+#include "LocalAvoidance.h"
+#include "Parallel.h"
+#include "SpatialHash.h"
+
+using namespace vox;
+
+namespace {
+
+const int AGENTS = 16384;
+const int TICKS_PER_ITERATION = 10;
+const float DT = 1.0f / 30.0f;
+const float SPEED = 3.0f;
+const float AREA_PER_AGENT = 6.0f;
+const int CHECKED_QUERIES = 500;
+
+uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7FEB352Du;
+    v ^= v >> 15;
+    v *= 0x846CA68Bu;
+    return v ^ (v >> 16);
+}
+
+float unit(uint32_t v) {
+    return (hash(v) >> 8) * (1.0f / 16777216.0f);
+}
+
+struct Crowd {
+    std::vector<AgentBody> bodies;
+    std::vector<float> goals;       // x, z pairs
+    std::vector<float> preferred;   // vx, vz pairs
+    std::vector<uint32_t> trips;
+    float side;
+};
+
+Crowd makeCrowd() {
+    Crowd crowd;
+    crowd.side = std::sqrt(float(AGENTS) * AREA_PER_AGENT);
+    crowd.bodies.resize(AGENTS);
+    crowd.goals.resize(AGENTS * 2);
+    crowd.preferred.resize(AGENTS * 2);
+    crowd.trips.assign(AGENTS, 0);
+    // Start on a jittered grid so nobody overlaps, then cross the area.
+    int perRow = int(std::ceil(std::sqrt(float(AGENTS))));
+    float spacing = crowd.side / perRow;
+    for (int i = 0; i < AGENTS; ++i) {
+        AgentBody &body = crowd.bodies[i];
+        body.x = (float(i % perRow) + 0.5f + (unit(i * 3) - 0.5f) * 0.3f) * spacing;
+        body.y = 0.0f;
+        body.z = (float(i / perRow) + 0.5f + (unit(i * 3 + 1) - 0.5f) * 0.3f) * spacing;
+        body.vx = body.vy = body.vz = 0.0f;
+        body.halfWidth = 0.4f;
+        body.height = 1.8f;
+        body.flags = AGENT_ON_GROUND;
+        crowd.goals[i * 2] = unit(i * 5 + 2) * crowd.side;
+        crowd.goals[i * 2 + 1] = unit(i * 5 + 3) * crowd.side;
+    }
+    return crowd;
+}
+
+// Heads every agent for its goal and hands out a new one on arrival.
+void steer(Crowd &crowd) {
+    for (size_t i = 0; i < crowd.bodies.size(); ++i) {
+        const AgentBody &body = crowd.bodies[i];
+        float dx = crowd.goals[i * 2] - body.x;
+        float dz = crowd.goals[i * 2 + 1] - body.z;
+        float dist = std::sqrt(dx * dx + dz * dz);
+        if (dist < 1.0f) {
+            uint32_t trip = ++crowd.trips[i];
+            crowd.goals[i * 2] = unit(uint32_t(i) * 5 + trip * 7919u) * crowd.side;
+            crowd.goals[i * 2 + 1] = unit(uint32_t(i) * 5 + trip * 7919u + 1) * crowd.side;
+            dist = 0.0f;
+        }
+        float scale = dist > 0.0f ? SPEED / std::max(dist, 1.0f) : 0.0f;
+        crowd.preferred[i * 2] = dx * scale;
+        crowd.preferred[i * 2 + 1] = dz * scale;
+    }
+}
+
+void integrate(Crowd &crowd) {
+    for (AgentBody &body : crowd.bodies) {
+        body.x += body.vx * DT;
+        body.z += body.vz * DT;
+    }
+}
+
+size_t overlapping(const Crowd &crowd, const SpatialHash &grid) {
+    size_t pairs = 0;
+    std::vector<uint32_t> found;
+    for (size_t i = 0; i < crowd.bodies.size(); ++i) {
+        const AgentBody &body = crowd.bodies[i];
+        found.clear();
+        grid.queryRadius(body.x, body.y, body.z, 2.0f * body.halfWidth, found);
+        for (uint32_t id : found) {
+            const AgentBody &other = crowd.bodies[id];
+            float dx = other.x - body.x;
+            float dz = other.z - body.z;
+            // Deeper than 10% of the combined radius counts as a collision.
+            float limit = 0.9f * (body.halfWidth + other.halfWidth);
+            pairs += id > i && dx * dx + dz * dz < limit * limit ? 1 : 0;
+        }
+    }
+    return pairs;
+}
+
+struct RunResult {
+    std::vector<AgentBody> bodies;
+    size_t overlaps;
+};
+
+RunResult run(ThreadPool &pool, const BenchOptions &options, bool avoid, const std::string &label) {
+    Crowd crowd = makeCrowd();
+    SpatialHash grid(4.0f);
+    int ticks = options.iterations * TICKS_PER_ITERATION;
+    double buildMs = 0.0;
+    double avoidMs = 0.0;
+    for (int t = 0; t < ticks; ++t) {
+        steer(crowd);
+        BenchTimer timer;
+        grid.build(&crowd.bodies[0].x, crowd.bodies.size(), sizeof(AgentBody), &pool);
+        buildMs += timer.elapsedMs();
+        if (avoid) {
+            timer.restart();
+            avoidNeighbours(crowd.bodies.data(), crowd.bodies.size(), crowd.preferred.data(), grid, DT,
+                            AvoidanceSettings(), &pool);
+            avoidMs += timer.elapsedMs();
+        } else {
+            for (size_t i = 0; i < crowd.bodies.size(); ++i) {
+                crowd.bodies[i].vx = crowd.preferred[i * 2];
+                crowd.bodies[i].vz = crowd.preferred[i * 2 + 1];
+            }
+        }
+        integrate(crowd);
+    }
+    grid.build(&crowd.bodies[0].x, crowd.bodies.size(), sizeof(AgentBody), &pool);
+    RunResult result;
+    result.overlaps = overlapping(crowd, grid);
+    result.bodies = crowd.bodies;
+
+    char detail[160];
+    if (avoid) {
+        std::snprintf(detail, sizeof(detail), "build %.3f ms + avoid %.3f ms, %.2f M agents/s, %zu overlapping",
+                      buildMs / ticks, avoidMs / ticks, double(AGENTS) * ticks / (buildMs + avoidMs) / 1000.0,
+                      result.overlaps);
+    } else {
+        std::snprintf(detail, sizeof(detail), "build %.3f ms, %zu overlapping", buildMs / ticks, result.overlaps);
+    }
+    report(label, (buildMs + avoidMs) / ticks, detail);
+    return result;
+}
+
+// Compares hash queries with a brute force scan.
+void checkQueries(ThreadPool &pool) {
+    Crowd crowd = makeCrowd();
+    SpatialHash grid(4.0f);
+    grid.build(&crowd.bodies[0].x, crowd.bodies.size(), sizeof(AgentBody), &pool);
+    std::vector<uint32_t> found;
+    std::vector<uint32_t> expected;
+    size_t mismatches = 0;
+    size_t total = 0;
+    BenchTimer timer;
+    double hashMs = 0.0;
+    double bruteMs = 0.0;
+    for (int q = 0; q < CHECKED_QUERIES; ++q) {
+        float x = unit(q * 11) * crowd.side;
+        float z = unit(q * 11 + 1) * crowd.side;
+        float radius = 0.5f + unit(q * 11 + 2) * 12.0f;
+        bool box = q & 1;
+        const float min[3] = {x - radius, -1.0f, z - radius * 0.5f};
+        const float max[3] = {x + radius, 1.0f, z + radius * 0.5f};
+        found.clear();
+        timer.restart();
+        if (box) {
+            grid.queryBox(min, max, found);
+        } else {
+            grid.queryRadius(x, 0.0f, z, radius, found);
+        }
+        hashMs += timer.elapsedMs();
+        expected.clear();
+        timer.restart();
+        for (size_t i = 0; i < crowd.bodies.size(); ++i) {
+            const AgentBody &body = crowd.bodies[i];
+            bool inside = box ? body.x >= min[0] && body.x <= max[0] && body.z >= min[2] && body.z <= max[2]
+                              : (body.x - x) * (body.x - x) + (body.z - z) * (body.z - z) <= radius * radius;
+            if (inside) {
+                expected.push_back(uint32_t(i));
+            }
+        }
+        bruteMs += timer.elapsedMs();
+        std::sort(found.begin(), found.end());
+        mismatches += found == expected ? 0 : 1;
+        total += found.size();
+    }
+    char detail[160];
+    std::snprintf(detail, sizeof(detail), "%.1f hits/query, brute force %.3f ms/query, %zu mismatches%s",
+                  double(total) / CHECKED_QUERIES, bruteMs / CHECKED_QUERIES, mismatches, mismatches ? "  FAIL" : "");
+    report("crowd/query", hashMs / CHECKED_QUERIES, detail);
+}
+
+} // namespace
+
+void benchCrowd(const BenchOptions &options) {
+    std::printf("  %d agents, %d ticks of %.0f ms\n", AGENTS, options.iterations * TICKS_PER_ITERATION,
+                DT * 1000.0f);
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    checkQueries(pool);
+    run(pool, options, false, "crowd/no avoidance");
+    RunResult one = run(single, options, true, "crowd/avoid 1 thread");
+    char label[64];
+    std::snprintf(label, sizeof(label), "crowd/avoid %d threads", pool.getThreadCount());
+    RunResult many = run(pool, options, true, label);
+    bool same = std::memcmp(one.bodies.data(), many.bodies.data(), one.bodies.size() * sizeof(AgentBody)) == 0;
+    report("crowd/deterministic", 0.0, same ? "same result on every thread count" : "MISMATCH");
+}
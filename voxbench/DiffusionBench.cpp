@@ -0,0 +1,161 @@
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "DiffusionField.h"
+#include "OccupancyKernels.h"
+#include "Parallel.h"
+#include "Serialization.h"
+#include "TerrainGenerator.h"
+
+using namespace vox;
+
+namespace {
+
+// The field box is 256³ whatever --size says.
+const int FIELD_CHUNKS = 8;
+const int FIELD_SIDE = FIELD_CHUNKS * CHUNK_SIZE;
+const int EMITTERS = 64;
+const int SINKS = 16;
+const int MAX_TICKS = 4000;
+const int QUERIES = 1000000;
+const int CLIMB_STEPS = 32;
+// A source hanging in the open, for the uphill check.
+const Vec3i BEACON(128, 160, 128);
+const int BEACON_OFFSET = 6;
+
+uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7FEB352Du;
+    v ^= v >> 15;
+    v *= 0x846CA68Bu;
+    return v ^ (v >> 16);
+}
+
+int topSolid(const VoxelMap &map, int x, int z) {
+    int y = FIELD_SIDE - 1;
+    while (y > 0 && map.getMaterial(x, y, z) == AIR) {
+        --y;
+    }
+    return y;
+}
+
+// Terrain with caves, emitters on the surface, a few sinks and the beacon.
+void buildMap(VoxelMap &map) {
+    TerrainSettings settings;
+    settings.seed = 4321;
+    TerrainGenerator generator(settings, map.getMaterials());
+    generator.generate(map, Vec3i(0, 0, 0), Vec3i(FIELD_CHUNKS - 1, FIELD_CHUNKS - 1, FIELD_CHUNKS - 1));
+    MaterialId beacon = map.getMaterials().add(Material("beacon", 0xFFFF4040));
+    for (int i = 0; i < EMITTERS + SINKS; ++i) {
+        int x = int(hash(uint32_t(2 * i)) % FIELD_SIDE);
+        int z = int(hash(uint32_t(2 * i + 1)) % FIELD_SIDE);
+        map.setAttribute(ATTR_AFFECTOR, x, topSolid(map, x, z), z, packAffector(i < EMITTERS ? 1.0f : -0.5f));
+    }
+    map.setMaterial(BEACON.x, BEACON.y, BEACON.z, beacon);
+    map.setAttribute(ATTR_AFFECTOR, BEACON.x, BEACON.y, BEACON.z, packAffector(1.0f));
+}
+
+uint32_t digest(const DiffusionField &field) {
+    std::vector<float> row(FIELD_SIDE);
+    uint32_t total = 0;
+    for (int z = 0; z < FIELD_SIDE; ++z) {
+        for (int y = 0; y < FIELD_SIDE; ++y) {
+            for (int x = 0; x < FIELD_SIDE; ++x) {
+                row[x] = field.sample(x, y, z);
+            }
+            total = total * 31 + checksum(reinterpret_cast<const uint8_t *>(row.data()), row.size() * sizeof(float));
+        }
+    }
+    return total;
+}
+
+// Every chunk of the box awake: the cost of the stencil itself.
+uint32_t runFull(VoxelMap &map, const BenchOptions &options, const char *label) {
+    DiffusionField field(map);
+    field.wake(Vec3i(0, 0, 0), Vec3i(FIELD_CHUNKS - 1, FIELD_CHUNKS - 1, FIELD_CHUNKS - 1));
+    DiffusionStats stats;
+    double ms = 0.0;
+    for (int i = 0; i < options.iterations; ++i) {
+        // Keep every chunk awake even where nothing changes yet.
+        field.wake(Vec3i(0, 0, 0), Vec3i(FIELD_CHUNKS - 1, FIELD_CHUNKS - 1, FIELD_CHUNKS - 1));
+        field.step(&stats);
+        ms += stats.seconds * 1000.0;
+    }
+    ms /= options.iterations;
+    char detail[160];
+    std::snprintf(detail, sizeof(detail), "%zu chunks, %.2f ns per cell, %.1f MB", stats.activeChunks,
+                  ms * 1e6 / (double(stats.activeChunks) * CHUNK_VOLUME), field.memoryUsage() / 1048576.0);
+    report(label, ms, detail);
+    return digest(field);
+}
+
+// From the sources only, until every chunk sleeps.
+uint32_t runSettle(VoxelMap &map, ThreadPool &pool, const char *label, bool query) {
+    DiffusionSettings settings;
+    settings.pool = &pool;
+    DiffusionField field(map, settings);
+    DiffusionStats stats;
+    double ms = 0.0;
+    size_t peak = 0, peakChunks = 0;
+    int ticks = 0;
+    while (ticks < MAX_TICKS && field.getActiveChunkCount() > 0) {
+        field.step(&stats);
+        ms += stats.seconds * 1000.0;
+        peak = stats.activeChunks > peak ? stats.activeChunks : peak;
+        peakChunks = stats.fieldChunks > peakChunks ? stats.fieldChunks : peakChunks;
+        ++ticks;
+    }
+    char detail[200];
+    std::snprintf(detail, sizeof(detail), "%d ticks to settle%s, peak %zu awake of %zu, %zu kept, %.1f MB", ticks,
+                  field.getActiveChunkCount() ? " (never settled  FAIL)" : "", peak, peakChunks,
+                  field.getChunkCount(), field.memoryUsage() / 1048576.0);
+    report(label, ticks ? ms / ticks : 0.0, detail);
+
+    if (query) {
+        BenchTimer timer;
+        float sum = 0.0f;
+        for (int i = 0; i < QUERIES; ++i) {
+            float x = (hash(uint32_t(3 * i)) >> 8) * (FIELD_SIDE / 16777216.0f);
+            float y = (hash(uint32_t(3 * i + 1)) >> 8) * (FIELD_SIDE / 16777216.0f);
+            float z = (hash(uint32_t(3 * i + 2)) >> 8) * (FIELD_SIDE / 16777216.0f);
+            sum += field.sample(x, y, z);
+        }
+        double queryMs = timer.elapsedMs();
+
+        // Following the field uphill from a few cells away finds the beacon.
+        Vec3i at = BEACON + Vec3i(BEACON_OFFSET, BEACON_OFFSET / 2, -BEACON_OFFSET / 2);
+        int steps = 0;
+        for (Vec3i next = field.uphill(at); next != at && steps < CLIMB_STEPS; next = field.uphill(at)) {
+            at = next;
+            ++steps;
+        }
+        bool found = at.x == BEACON.x && at.y == BEACON.y && at.z == BEACON.z;
+        std::snprintf(detail, sizeof(detail), "%.1f M trilinear samples/s (sum %.1f), beacon %s in %d steps%s",
+                      QUERIES / queryMs / 1000.0, sum, found ? "reached" : "missed", steps, found ? "" : "  FAIL");
+        report("diffusion/query", queryMs / QUERIES, detail);
+    }
+    return digest(field);
+}
+
+} // namespace
+
+void benchDiffusion(const BenchOptions &options) {
+    VoxelMap map;
+    buildMap(map);
+
+    bool simd = kernels::isSimdEnabled();
+    uint32_t vector = runFull(map, options, "diffusion/256^3 awake");
+    kernels::setSimdEnabled(false);
+    uint32_t scalar = runFull(map, options, "diffusion/256^3 awake scalar");
+    kernels::setSimdEnabled(simd);
+    report("diffusion/kernels", 0.0, vector == scalar ? "scalar and vector match" : "MISMATCH  FAIL");
+
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    uint32_t expected = runSettle(map, single, "diffusion/settle 1 thread", false);
+    char label[64];
+    std::snprintf(label, sizeof(label), "diffusion/settle %d threads", pool.getThreadCount());
+    bool same = runSettle(map, pool, label, true) == expected;
+    report("diffusion/deterministic", 0.0, same ? "same field with any thread count" : "MISMATCH  FAIL");
+}
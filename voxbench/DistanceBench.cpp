@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "DistanceField.h"
+#include "GridPathfinder.h"
+#include "OccupancyMask.h"
+#include "Parallel.h"
+#include "TerrainGenerator.h"
+#include "VoxelCollider.h"
+
+using namespace vox;
+
+namespace {
+
+const float MAX_DISTANCE = 16.0f;
+const int CHECKED_CELLS = 2000;
+const int CLEARANCE_QUERIES = 1000000;
+const float CLEARANCE_RADIUS = 2.0f;
+const int PATHS = 50;
+const int FALLING_BODIES = 10000;
+
+uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7FEB352Du;
+    v ^= v >> 15;
+    v *= 0x846CA68Bu;
+    return v ^ (v >> 16);
+}
+
+int pick(uint32_t v, int range) {
+    return int(hash(v) % uint32_t(range));
+}
+
+// Nearest solid cell centre by looking at every cell in reach.
+float scanDistance(const OccupancyMask &mask, int x, int y, int z, float limit) {
+    int reach = int(std::ceil(limit));
+    float best = limit * limit;
+    for (int dz = -reach; dz <= reach; ++dz) {
+        for (int dy = -reach; dy <= reach; ++dy) {
+            for (int dx = -reach; dx <= reach; ++dx) {
+                float d = float(dx * dx + dy * dy + dz * dz);
+                if (d < best && mask.get(x + dx, y + dy, z + dz)) {
+                    best = d;
+                }
+            }
+        }
+    }
+    return std::sqrt(best);
+}
+
+int groundLevel(const OccupancyMask &mask, int x, int z) {
+    int y = mask.getSize().y - 1;
+    while (y > 0 && !mask.get(x, y - 1, z)) {
+        --y;
+    }
+    return y;
+}
+
+void benchPaths(const OccupancyMask &mask, const DistanceField &field) {
+    GridPathfinder finder(mask, &field);
+    int side = mask.getSize().x;
+    const float radii[2] = {0.0f, 0.6f};
+    for (float radius : radii) {
+        PathSettings settings;
+        settings.radius = radius;
+        double ms = 0.0;
+        size_t expanded = 0;
+        int found = 0;
+        std::vector<Vec3i> path;
+        for (int i = 0; i < PATHS; ++i) {
+            int x0 = pick(i * 4, side), z0 = pick(i * 4 + 1, side);
+            int x1 = pick(i * 4 + 2, side), z1 = pick(i * 4 + 3, side);
+            Vec3i start(x0, groundLevel(mask, x0, z0), z0);
+            Vec3i goal(x1, groundLevel(mask, x1, z1), z1);
+            PathStats stats;
+            found += finder.findPath(start, goal, path, settings, &stats) ? 1 : 0;
+            ms += stats.milliseconds;
+            expanded += stats.expanded;
+        }
+        char label[64];
+        char detail[160];
+        std::snprintf(label, sizeof(label), "distance/path radius %.1f", radius);
+        std::snprintf(detail, sizeof(detail), "%d/%d found, %zu cells expanded per path", found, PATHS,
+                      expanded / PATHS);
+        report(label, ms / PATHS, detail);
+    }
+}
+
+void benchFalling(const OccupancyMask &mask, const DistanceField &field) {
+    int side = mask.getSize().x;
+    std::vector<AgentBody> start(FALLING_BODIES);
+    for (int i = 0; i < FALLING_BODIES; ++i) {
+        AgentBody &body = start[i];
+        int x = pick(i * 2, side), z = pick(i * 2 + 1, side);
+        body.x = float(x);
+        body.y = float(mask.getSize().y - 4);
+        body.z = float(z);
+        body.vx = body.vz = 1.0f;
+        body.vy = 0.0f;
+        body.halfWidth = 0.3f;
+        body.height = 1.8f;
+        body.flags = 0;
+    }
+    VoxelCollider collider(mask);
+    ThreadPool single(1);
+    for (int withField = 0; withField < 2; ++withField) {
+        collider.setDistanceField(withField ? &field : nullptr);
+        std::vector<AgentBody> bodies = start;
+        BenchTimer timer;
+        const int ticks = 60;
+        for (int t = 0; t < ticks; ++t) {
+            collider.move(bodies.data(), bodies.size(), 1.0f / 30.0f, MoveSettings(), &single);
+        }
+        size_t grounded = 0;
+        for (const AgentBody &body : bodies) {
+            grounded += body.flags & AGENT_ON_GROUND ? 1 : 0;
+        }
+        char detail[160];
+        std::snprintf(detail, sizeof(detail), "%d falling bodies, %zu landed", FALLING_BODIES, grounded);
+        report(withField ? "distance/collider with field" : "distance/collider sweeps only", timer.elapsedMs() / ticks,
+               detail);
+    }
+}
+
+} // namespace
+
+void benchDistance(const BenchOptions &options) {
+    int side = options.size < 64 ? 64 : options.size;
+    TerrainSettings settings;
+    settings.seed = 11;
+    VoxelMap map;
+    TerrainGenerator generator(settings, map.getMaterials());
+    int chunks = (side + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    generator.generate(map, Vec3i(0, 0, 0), Vec3i(chunks - 1, 2, chunks - 1));
+    OccupancyMask mask = OccupancyMask::fromMap(map, Vec3i(0, 0, 0), Vec3i(side, 3 * CHUNK_SIZE, side));
+    size_t cells = size_t(side) * 3 * CHUNK_SIZE * side;
+
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    DistanceField field(MAX_DISTANCE);
+    char label[64];
+    char detail[160];
+    ThreadPool *pools[2] = {&single, &pool};
+    for (ThreadPool *threads : pools) {
+        BenchTimer timer;
+        for (int i = 0; i < options.iterations; ++i) {
+            field.build(mask, threads);
+        }
+        double ms = timer.elapsedMs() / options.iterations;
+        std::snprintf(label, sizeof(label), "distance/build %d threads", threads->getThreadCount());
+        std::snprintf(detail, sizeof(detail), "%.1f M cells/s, %.1f MB", cells / ms / 1000.0,
+                      field.memoryUsage() / (1024.0 * 1024.0));
+        report(label, ms, detail);
+    }
+
+    float worst = 0.0f;
+    size_t wrong = 0;
+    float step = MAX_DISTANCE / 255.0f;
+    for (int i = 0; i < CHECKED_CELLS; ++i) {
+        int x = pick(i * 3, side), y = pick(i * 3 + 1, 3 * CHUNK_SIZE), z = pick(i * 3 + 2, side);
+        float error = scanDistance(mask, x, y, z, MAX_DISTANCE) - field.distance(x, y, z);
+        worst = std::max(worst, std::fabs(error));
+        wrong += error < 0.0f || error > step + 1e-4f ? 1 : 0;
+    }
+    std::snprintf(detail, sizeof(detail), "%d cells against a scan, worst %.3f (step %.3f), %zu wrong%s", CHECKED_CELLS,
+                  worst, step, wrong, wrong ? "  FAIL" : "");
+    report("distance/accuracy", 0.0, detail);
+
+    // Dig a room out of a chunk and refresh only around it.
+    Vec3i min(side / 2, 40, side / 2);
+    Vec3i max(min.x + CHUNK_MASK, min.y + 15, min.z + CHUNK_MASK);
+    for (int z = min.z; z <= max.z; ++z) {
+        for (int y = min.y; y <= max.y; ++y) {
+            for (int x = min.x; x <= max.x; ++x) {
+                mask.set(x, y, z, false);
+            }
+        }
+    }
+    BenchTimer timer;
+    field.update(mask, min, max, &pool);
+    double updateMs = timer.elapsedMs();
+    DistanceField fresh(MAX_DISTANCE);
+    fresh.build(mask, &pool);
+    size_t differing = 0;
+    for (int z = 0; z < side; ++z) {
+        for (int y = 0; y < 3 * CHUNK_SIZE; ++y) {
+            for (int x = 0; x < side; ++x) {
+                differing += field.getRaw(x, y, z) != fresh.getRaw(x, y, z) ? 1 : 0;
+            }
+        }
+    }
+    std::snprintf(detail, sizeof(detail), "32x16x32 edit, %zu cells differ from a rebuild%s", differing,
+                  differing ? "  FAIL" : "");
+    report("distance/update", updateMs, detail);
+
+    // One read against a scan of the neighbourhood.
+    size_t clear = 0;
+    timer.restart();
+    for (int i = 0; i < CLEARANCE_QUERIES; ++i) {
+        clear += field.hasClearance(pick(i * 3, side), pick(i * 3 + 1, 3 * CHUNK_SIZE), pick(i * 3 + 2, side),
+                                    CLEARANCE_RADIUS) ? 1 : 0;
+    }
+    double fieldMs = timer.elapsedMs();
+    size_t scanned = 0;
+    const int scans = CLEARANCE_QUERIES / 100;
+    timer.restart();
+    for (int i = 0; i < scans; ++i) {
+        int x = pick(i * 3, side), y = pick(i * 3 + 1, 3 * CHUNK_SIZE), z = pick(i * 3 + 2, side);
+        scanned += scanDistance(mask, x, y, z, CLEARANCE_RADIUS) >= CLEARANCE_RADIUS ? 1 : 0;
+    }
+    double scanMs = timer.elapsedMs();
+    std::snprintf(detail, sizeof(detail), "%.1f ns per check, scanning %.1f ns, %.0f%% clear",
+                  fieldMs * 1e6 / CLEARANCE_QUERIES, scanMs * 1e6 / scans, 100.0 * clear / CLEARANCE_QUERIES);
+    report("distance/clearance r=2", fieldMs, detail);
+
+    benchPaths(mask, fresh);
+    benchFalling(mask, fresh);
+}
@@ -0,0 +1,201 @@
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#include "Bench.h"
+#include "Parallel.h"
+#include "RegionFile.h"
+#include "Serialization.h"
+#include "VoxFile.h"
+
+using namespace vox;
+
+namespace {
+
+const int MODELS_PER_SIDE = 2;
+
+bool voxelAt(int x, int y, int z) {
+    return std::sin(x * 0.11f) + std::cos(y * 0.13f) + std::sin(z * 0.07f) > 0.2f;
+}
+
+void putChunk(std::vector<uint8_t> &out, const char *id, const std::vector<uint8_t> &content) {
+    ByteWriter w(out);
+    w.putBytes(id, 4);
+    w.putU32(uint32_t(content.size()));
+    w.putU32(0);
+    w.putBytes(content.data(), content.size());
+}
+
+void putDict(ByteWriter &w, const char *key, const std::string &value) {
+    w.putU32(key ? 1 : 0);
+    if (key) {
+        w.putString(key);
+        w.putString(value);
+    }
+}
+
+// A scene of MODELS_PER_SIDE^2 models placed side by side with nTRN nodes,
+// the way MagicaVoxel saves multi-model files. Returns the voxel count.
+size_t writeVoxScene(const std::string &path, int size) {
+    std::vector<uint8_t> children;
+    std::vector<uint8_t> content;
+    size_t voxels = 0;
+    const int models = MODELS_PER_SIDE * MODELS_PER_SIDE;
+    for (int m = 0; m < models; ++m) {
+        content.clear();
+        ByteWriter s(content);
+        s.putI32(size);
+        s.putI32(size);
+        s.putI32(size);
+        putChunk(children, "SIZE", content);
+
+        content.clear();
+        ByteWriter v(content);
+        v.putU32(0);
+        uint32_t count = 0;
+        for (int z = 0; z < size; ++z) {
+            for (int y = 0; y < size; ++y) {
+                for (int x = 0; x < size; ++x) {
+                    if (voxelAt(x + m * size, y, z)) {
+                        v.putU8(uint8_t(x));
+                        v.putU8(uint8_t(y));
+                        v.putU8(uint8_t(z));
+                        v.putU8(uint8_t(1 + (x + y + z) % 8));
+                        ++count;
+                    }
+                }
+            }
+        }
+        content[0] = uint8_t(count);
+        content[1] = uint8_t(count >> 8);
+        content[2] = uint8_t(count >> 16);
+        content[3] = uint8_t(count >> 24);
+        putChunk(children, "XYZI", content);
+        voxels += count;
+    }
+
+    // Root transform -> group -> one transform and shape per model.
+    content.clear();
+    ByteWriter root(content);
+    root.putI32(0);
+    putDict(root, nullptr, "");
+    root.putI32(1);
+    root.putI32(-1);
+    root.putI32(0);
+    root.putU32(1);
+    putDict(root, nullptr, "");
+    putChunk(children, "nTRN", content);
+
+    content.clear();
+    ByteWriter group(content);
+    group.putI32(1);
+    putDict(group, nullptr, "");
+    group.putU32(uint32_t(models));
+    for (int m = 0; m < models; ++m) {
+        group.putI32(2 + 2 * m);
+    }
+    putChunk(children, "nGRP", content);
+
+    for (int m = 0; m < models; ++m) {
+        content.clear();
+        ByteWriter t(content);
+        t.putI32(2 + 2 * m);
+        putDict(t, nullptr, "");
+        t.putI32(3 + 2 * m);
+        t.putI32(-1);
+        t.putI32(0);
+        t.putU32(1);
+        char translation[64];
+        std::snprintf(translation, sizeof(translation), "%d %d 0", (m % MODELS_PER_SIDE) * size, (m / MODELS_PER_SIDE) * size);
+        putDict(t, "_t", translation);
+        putChunk(children, "nTRN", content);
+
+        content.clear();
+        ByteWriter shape(content);
+        shape.putI32(3 + 2 * m);
+        putDict(shape, nullptr, "");
+        shape.putU32(1);
+        shape.putI32(m);
+        putDict(shape, nullptr, "");
+        putChunk(children, "nSHP", content);
+    }
+
+    std::vector<uint8_t> file;
+    ByteWriter w(file);
+    w.putBytes("VOX ", 4);
+    w.putU32(150);
+    w.putBytes("MAIN", 4);
+    w.putU32(0);
+    w.putU32(uint32_t(children.size()));
+    w.putBytes(children.data(), children.size());
+
+    FILE *out = std::fopen(path.c_str(), "wb");
+    if (out) {
+        std::fwrite(file.data(), 1, file.size(), out);
+        std::fclose(out);
+    }
+    return voxels;
+}
+
+size_t countSolid(const VoxelMap &map) {
+    size_t solid = 0;
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    for (const auto &entry : map.getChunks()) {
+        entry.second->getMaterials().decode(cells.data());
+        for (uint32_t cell : cells) {
+            solid += cell != AIR;
+        }
+    }
+    return solid;
+}
+
+std::string throughput(const ImportStats &stats, bool matches) {
+    char text[128];
+    std::snprintf(text, sizeof(text), "%.1f MB at %.0f MB/s, %zu chunks%s", stats.bytes / (1024.0 * 1024.0),
+                  stats.megabytesPerSecond(), stats.chunks, matches ? "" : "  MISMATCH");
+    return text;
+}
+
+} // namespace
+
+void benchImport(const BenchOptions &options) {
+    const int size = options.size > 256 ? 256 : options.size;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "voxbench-import";
+    std::filesystem::create_directories(dir);
+    const std::string voxPath = (dir / "scene.vox").string();
+    const std::string regionDir = (dir / "regions").string();
+    size_t voxels = writeVoxScene(voxPath, size);
+
+    ThreadPool pool(options.threads);
+    ImportOptions importOptions;
+    importOptions.pool = &pool;
+
+    ImportStats stats;
+    VoxelMap map;
+    double total = 0.0;
+    for (int i = 0; i < options.iterations; ++i) {
+        map.clear();
+        importVox(map, voxPath, importOptions, &stats);
+        total += stats.seconds;
+    }
+    stats.seconds = total / options.iterations;
+    report("vox import", stats.seconds * 1000.0, throughput(stats, countSolid(map) == voxels));
+
+    std::filesystem::remove_all(regionDir);
+    BenchTimer timer;
+    saveRegions(map, regionDir, &pool);
+    report("region save", timer.elapsedMs());
+
+    VoxelMap loaded;
+    total = 0.0;
+    for (int i = 0; i < options.iterations; ++i) {
+        loaded.clear();
+        importRegions(loaded, regionDir, importOptions, &stats);
+        total += stats.seconds;
+    }
+    stats.seconds = total / options.iterations;
+    report("region import", stats.seconds * 1000.0, throughput(stats, countSolid(loaded) == voxels));
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,212 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "OccupancyKernels.h"
+#include "OccupancyMask.h"
+#include "VoxelMap.h"
+
+using namespace vox;
+
+namespace {
+
+const int HEIGHT = 64;
+
+// The per-cell layout main.cpp uses: one bool per cell, x fastest.
+struct BoolGrid {
+    int sx, sy, sz;
+    std::vector<bool> cells;
+
+    BoolGrid(int sx, int sy, int sz) : sx(sx), sy(sy), sz(sz), cells(size_t(sx) * sy * sz, false) {}
+
+    int index(int x, int y, int z) const { return x + sx * (y + sy * z); }
+
+    bool solid(int x, int y, int z) const {
+        if (x < 0 || y < 0 || z < 0 || x >= sx || y >= sy || z >= sz) {
+            return false;
+        }
+        return cells[index(x, y, z)];
+    }
+};
+
+bool terrainAt(int x, int y, int z) {
+    float h = 24.0f + 10.0f * std::sin(x * 0.07f) * std::cos(z * 0.05f) + 4.0f * std::sin((x + z) * 0.21f);
+    if (y > h) {
+        return false;
+    }
+    // Thin tunnels so the mask is not just a heightfield.
+    return std::fabs(std::sin(x * 0.15f) + std::cos(y * 0.3f) + std::sin(z * 0.12f)) > 0.35f;
+}
+
+size_t gridFaces(const BoolGrid &grid) {
+    size_t faces = 0;
+    for (int z = 0; z < grid.sz; ++z) {
+        for (int y = 0; y < grid.sy; ++y) {
+            for (int x = 0; x < grid.sx; ++x) {
+                if (!grid.cells[grid.index(x, y, z)]) {
+                    continue;
+                }
+                faces += !grid.solid(x + 1, y, z) + !grid.solid(x - 1, y, z)
+                       + !grid.solid(x, y + 1, z) + !grid.solid(x, y - 1, z)
+                       + !grid.solid(x, y, z + 1) + !grid.solid(x, y, z - 1);
+            }
+        }
+    }
+    return faces;
+}
+
+size_t gridWalkable(const BoolGrid &grid, int clearance) {
+    size_t count = 0;
+    for (int z = 0; z < grid.sz; ++z) {
+        for (int x = 0; x < grid.sx; ++x) {
+            for (int y = 1; y < grid.sy; ++y) {
+                if (!grid.solid(x, y - 1, z)) {
+                    continue;
+                }
+                bool open = true;
+                for (int k = 0; k < clearance && open; ++k) {
+                    open = !grid.solid(x, y + k, z);
+                }
+                count += open;
+            }
+        }
+    }
+    return count;
+}
+
+size_t gridColumnTotal(const BoolGrid &grid) {
+    size_t total = 0;
+    for (int z = 0; z < grid.sz; ++z) {
+        for (int x = 0; x < grid.sx; ++x) {
+            int column = 0;
+            for (int y = 0; y < grid.sy; ++y) {
+                column += grid.cells[grid.index(x, y, z)];
+            }
+            total += column;
+        }
+    }
+    return total;
+}
+
+template <typename Fn>
+double timeIt(int iterations, Fn fn) {
+    BenchTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    return timer.elapsedMs() / iterations;
+}
+
+std::string compare(double baseline, double ms, size_t expected, size_t got) {
+    char text[128];
+    std::snprintf(text, sizeof(text), "x%.1f vs per-cell%s", baseline / ms,
+                  expected == got ? "" : "  MISMATCH");
+    return text;
+}
+
+void runMaskKernels(const BoolGrid &a, const BoolGrid &b, const OccupancyMask &maskA, const OccupancyMask &maskB,
+                    int iterations, const char *label) {
+    const std::string prefix = std::string("mask/") + label + " ";
+    volatile size_t sink = 0;
+
+    size_t expectedFaces = gridFaces(a);
+    double cellFaces = timeIt(iterations, [&]() { sink = gridFaces(a); });
+    size_t faces = 0;
+    double maskFaces = timeIt(iterations, [&]() { faces = maskA.countFaces(); });
+    report(prefix + "faces", maskFaces, compare(cellFaces, maskFaces, expectedFaces, faces));
+
+    size_t expectedWalk = gridWalkable(a, 2);
+    double cellWalk = timeIt(iterations, [&]() { sink = gridWalkable(a, 2); });
+    OccupancyMask walk;
+    double maskWalk = timeIt(iterations, [&]() { maskA.extractWalkable(2, walk); });
+    report(prefix + "walkable", maskWalk, compare(cellWalk, maskWalk, expectedWalk, walk.count()));
+
+    size_t expectedColumns = gridColumnTotal(a);
+    double cellColumns = timeIt(iterations, [&]() { sink = gridColumnTotal(a); });
+    std::vector<uint16_t> counts;
+    double maskColumns = timeIt(iterations, [&]() { maskA.columnCounts(counts); });
+    size_t columns = 0;
+    for (uint16_t c : counts) {
+        columns += c;
+    }
+    report(prefix + "column counts", maskColumns, compare(cellColumns, maskColumns, expectedColumns, columns));
+
+    std::vector<bool> cellOut(a.cells.size());
+    size_t expectedSub = 0;
+    for (size_t i = 0; i < a.cells.size(); ++i) {
+        expectedSub += a.cells[i] && !b.cells[i];
+    }
+    double cellBool = timeIt(iterations, [&]() {
+        for (size_t i = 0; i < a.cells.size(); ++i) {
+            cellOut[i] = a.cells[i] || b.cells[i];
+        }
+        for (size_t i = 0; i < a.cells.size(); ++i) {
+            cellOut[i] = a.cells[i] && !b.cells[i];
+        }
+        for (size_t i = 0; i < a.cells.size(); ++i) {
+            cellOut[i] = a.cells[i] && b.cells[i];
+        }
+    });
+    OccupancyMask scratch;
+    size_t sub = 0;
+    double maskBool = timeIt(iterations, [&]() {
+        scratch = maskA;
+        scratch.unite(maskB);
+        scratch = maskA;
+        scratch.subtract(maskB);
+        sub = scratch.count();
+        scratch = maskA;
+        scratch.intersect(maskB);
+    });
+    report(prefix + "union+subtract+intersect", maskBool, compare(cellBool, maskBool, expectedSub, sub));
+    (void)sink;
+}
+
+} // namespace
+
+void benchOccupancy(const BenchOptions &options) {
+    const int size = options.size;
+    VoxelMap map;
+    MaterialId stone = map.getMaterials().add(Material("stone"));
+    BoolGrid grid(size, HEIGHT, size);
+    BoolGrid shifted(size, HEIGHT, size);
+    for (int z = 0; z < size; ++z) {
+        for (int y = 0; y < HEIGHT; ++y) {
+            for (int x = 0; x < size; ++x) {
+                if (terrainAt(x, y, z)) {
+                    map.setMaterial(x, y, z, stone);
+                    grid.cells[grid.index(x, y, z)] = true;
+                }
+                if (terrainAt(x + 7, y, z + 3)) {
+                    shifted.cells[shifted.index(x, y, z)] = true;
+                }
+            }
+        }
+    }
+
+    const Vec3i origin(0, 0, 0);
+    const Vec3i extent(size, HEIGHT, size);
+    OccupancyMask mask;
+    double build = timeIt(options.iterations, [&]() { mask = OccupancyMask::fromMap(map, origin, extent); });
+    char detail[64];
+    std::snprintf(detail, sizeof(detail), "%dx%dx%d, %zu solid", size, HEIGHT, size, mask.count());
+    report("mask from chunks", build, detail);
+
+    OccupancyMask other(origin, extent);
+    for (int z = 0; z < size; ++z) {
+        for (int y = 0; y < HEIGHT; ++y) {
+            for (int x = 0; x < size; ++x) {
+                other.set(x, y, z, shifted.cells[shifted.index(x, y, z)]);
+            }
+        }
+    }
+
+    bool simd = kernels::isSimdEnabled();
+    runMaskKernels(grid, shifted, mask, other, options.iterations, kernels::instructionSet());
+    if (simd) {
+        kernels::setSimdEnabled(false);
+        runMaskKernels(grid, shifted, mask, other, options.iterations, kernels::instructionSet());
+        kernels::setSimdEnabled(true);
+    }
+}
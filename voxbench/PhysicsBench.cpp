@@ -0,0 +1,132 @@
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "CellularPhysics.h"
+#include "Parallel.h"
+#include "Serialization.h"
+
+using namespace vox;
+
+namespace {
+
+const int MAX_TICKS = 2000;
+const int SAND_BOTTOM = 40;
+const int SAND_HEIGHT = 32;
+const int BEAM_HEIGHT = 24;
+const int BEAM_LENGTH = 16;
+
+struct Scene {
+    MaterialId stone;
+    MaterialId sand;
+    MaterialId wood;
+    int side;
+};
+
+// A stone floor, a block of sand in the air above it and a stone pillar
+// with a wooden beam sticking out further than it can carry.
+Scene buildScene(VoxelMap &map, int size) {
+    Scene scene;
+    scene.side = size;
+    scene.stone = map.getMaterials().add(Material("stone", 0xFF808080));
+    scene.sand = map.getMaterials().add(Material("sand", 0xFFE0C070));
+    scene.wood = map.getMaterials().add(Material("wood", 0xFF8B5A2B));
+    for (int z = 0; z < size; ++z) {
+        for (int x = 0; x < size; ++x) {
+            map.setMaterial(x, 0, z, scene.stone);
+        }
+    }
+    uint32_t sand = packWeight(1.0f, true);
+    for (int z = size / 4; z < size * 3 / 4; ++z) {
+        for (int y = SAND_BOTTOM; y < SAND_BOTTOM + SAND_HEIGHT; ++y) {
+            for (int x = size / 4; x < size * 3 / 4; ++x) {
+                map.setMaterial(x, y, z, scene.sand);
+                map.setAttribute(ATTR_WEIGHT, x, y, z, sand);
+            }
+        }
+    }
+    for (int y = 1; y <= BEAM_HEIGHT; ++y) {
+        map.setMaterial(2, y, 2, scene.stone);
+    }
+    uint32_t wood = packWeight(1.0f, false);
+    for (int x = 3; x < 3 + BEAM_LENGTH; ++x) {
+        map.setMaterial(x, BEAM_HEIGHT, 2, scene.wood);
+        map.setAttribute(ATTR_WEIGHT, x, BEAM_HEIGHT, 2, wood);
+    }
+    return scene;
+}
+
+size_t countMaterial(const VoxelMap &map, MaterialId material) {
+    size_t count = 0;
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    for (const auto &entry : map.getChunks()) {
+        entry.second->getMaterials().decode(cells.data());
+        for (uint32_t cell : cells) {
+            count += cell == material;
+        }
+    }
+    return count;
+}
+
+uint32_t digest(const VoxelMap &map) {
+    uint32_t total = 0;
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    for (const auto &entry : map.getChunks()) {
+        entry.second->getMaterials().decode(cells.data());
+        uint32_t h = checksum(reinterpret_cast<const uint8_t *>(cells.data()), cells.size() * sizeof(uint32_t));
+        total += h ^ uint32_t(Vec3iHash()(entry.first));
+    }
+    return total;
+}
+
+uint32_t runScene(const BenchOptions &options, ThreadPool &pool, const char *label) {
+    VoxelMap map;
+    Scene scene = buildScene(map, options.size);
+    size_t sandBefore = countMaterial(map, scene.sand);
+    size_t woodBefore = countMaterial(map, scene.wood);
+
+    PhysicsSettings settings;
+    settings.pool = &pool;
+    CellularPhysics physics(map, settings);
+    PhysicsStats stats;
+    double seconds = 0.0, worst = 0.0;
+    size_t moves = 0, peakActive = 0;
+    int ticks = 0;
+    std::vector<CellMove> taken;
+    while (ticks < MAX_TICKS && (ticks == 0 || physics.getActiveChunkCount() > 0)) {
+        physics.step(&stats);
+        physics.takeMoves(taken);
+        taken.clear();
+        seconds += stats.seconds;
+        worst = stats.seconds > worst ? stats.seconds : worst;
+        moves += stats.moves;
+        peakActive = stats.activeChunks > peakActive ? stats.activeChunks : peakActive;
+        ++ticks;
+    }
+
+    // What is left of the beam: the part the pillar can carry.
+    int held = 0;
+    while (held < BEAM_LENGTH && map.getMaterial(3 + held, BEAM_HEIGHT, 2) == scene.wood) {
+        ++held;
+    }
+    bool conserved = countMaterial(map, scene.sand) == sandBefore && countMaterial(map, scene.wood) == woodBefore;
+    char detail[200];
+    std::snprintf(detail, sizeof(detail),
+                  "%d ticks to rest, worst %.2f ms, peak %zu active chunks, %.1f M moves/s, beam holds %d of %d%s",
+                  ticks, worst * 1000.0, peakActive, seconds > 0.0 ? moves / seconds / 1e6 : 0.0, held,
+                  BEAM_LENGTH, conserved ? "" : ", cells lost  FAIL");
+    report(label, ticks ? seconds * 1000.0 / ticks : 0.0, detail);
+    return digest(map);
+}
+
+} // namespace
+
+void benchPhysics(const BenchOptions &options) {
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    uint32_t expected = runScene(options, single, "physics/1 thread");
+    char label[64];
+    std::snprintf(label, sizeof(label), "physics/%d threads", pool.getThreadCount());
+    bool same = runScene(options, pool, label) == expected;
+    report("physics/deterministic", 0.0, same ? "same cells with any thread count" : "MISMATCH  FAIL");
+}
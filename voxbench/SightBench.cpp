@@ -0,0 +1,144 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "LineOfSight.h"
+#include "Parallel.h"
+#include "TerrainGenerator.h"
+
+using namespace vox;
+
+namespace {
+
+const int QUERIES = 100000;
+const float MAX_RANGE = 64.0f;
+const float EYE_HEIGHT = 1.6f;
+const float LOOKOUT_HEIGHT = 24.0f;
+const float VIEW_RADII[] = {32.0f, 64.0f};
+
+uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7FEB352Du;
+    v ^= v >> 15;
+    v *= 0x846CA68Bu;
+    return v ^ (v >> 16);
+}
+
+float unit(uint32_t v) {
+    return (hash(v) >> 8) * (1.0f / 16777216.0f);
+}
+
+float eyeLevel(const OccupancyMask &mask, int x, int z) {
+    int y = mask.getSize().y - 1;
+    while (y > 0 && !mask.get(x, y, z)) {
+        --y;
+    }
+    return float(y) + 0.5f + EYE_HEIGHT;
+}
+
+// Pairs of eyes up to MAX_RANGE apart: two people standing, or someone
+// up a tower (raised) looking down at someone standing.
+std::vector<SightQuery> makeQueries(const OccupancyMask &mask, float raised) {
+    std::vector<SightQuery> queries(QUERIES);
+    int side = mask.getSize().x;
+    for (int i = 0; i < QUERIES; ++i) {
+        int x0 = int(unit(i * 4) * (side - 1));
+        int z0 = int(unit(i * 4 + 1) * (side - 1));
+        float angle = unit(i * 4 + 2) * 6.2831853f;
+        float range = unit(i * 4 + 3) * MAX_RANGE;
+        int x1 = std::min(std::max(int(x0 + std::cos(angle) * range), 0), side - 1);
+        int z1 = std::min(std::max(int(z0 + std::sin(angle) * range), 0), side - 1);
+        SightQuery &query = queries[i];
+        query.from[0] = float(x0);
+        query.from[1] = eyeLevel(mask, x0, z0) + raised;
+        query.from[2] = float(z0);
+        query.to[0] = float(x1);
+        query.to[1] = eyeLevel(mask, x1, z1);
+        query.to[2] = float(z1);
+    }
+    return queries;
+}
+
+} // namespace
+
+void benchSight(const BenchOptions &options) {
+    int side = options.size < 64 ? 64 : options.size;
+    TerrainSettings settings;
+    settings.seed = 7;
+    VoxelMap map;
+    TerrainGenerator generator(settings, map.getMaterials());
+    int chunks = (side + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    generator.generate(map, Vec3i(0, 0, 0), Vec3i(chunks - 1, 2, chunks - 1));
+    OccupancyMask mask = OccupancyMask::fromMap(map, Vec3i(0, 0, 0), Vec3i(side, 3 * CHUNK_SIZE, side));
+
+    BenchTimer timer;
+    LineOfSight sight(mask);
+    report("sight/build levels", timer.elapsedMs(), "4^3 and 16^3 empty-space levels");
+
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    char detail[160];
+    char label[64];
+    const float heights[2] = {0.0f, LOOKOUT_HEIGHT};
+    const char *names[2] = {"ground", "lookout"};
+    for (int set = 0; set < 2; ++set) {
+        std::vector<SightQuery> queries = makeQueries(mask, heights[set]);
+        std::vector<uint8_t> plain(queries.size());
+        std::vector<uint8_t> skipping(queries.size());
+
+        sight.setEmptySkipping(false);
+        double plainMs = 0.0;
+        for (int i = 0; i < options.iterations; ++i) {
+            timer.restart();
+            sight.canSeeBatch(queries.data(), queries.size(), plain.data(), &single);
+            plainMs += timer.elapsedMs();
+        }
+        std::snprintf(detail, sizeof(detail), "%.2f M queries/s, every voxel",
+                      QUERIES * options.iterations / plainMs / 1000.0);
+        std::snprintf(label, sizeof(label), "sight/%s dda 1 thread", names[set]);
+        report(label, plainMs / options.iterations, detail);
+
+        sight.setEmptySkipping(true);
+        double skipMs = 0.0;
+        for (int i = 0; i < options.iterations; ++i) {
+            timer.restart();
+            sight.canSeeBatch(queries.data(), queries.size(), skipping.data(), &single);
+            skipMs += timer.elapsedMs();
+        }
+        size_t visible = 0;
+        size_t mismatches = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            visible += skipping[i];
+            mismatches += skipping[i] != plain[i] ? 1 : 0;
+        }
+        std::snprintf(detail, sizeof(detail), "%.2f M queries/s, %.1fx, %.0f%% visible, %zu mismatches%s",
+                      QUERIES * options.iterations / skipMs / 1000.0, plainMs / skipMs,
+                      100.0 * visible / queries.size(), mismatches, mismatches ? "  FAIL" : "");
+        std::snprintf(label, sizeof(label), "sight/%s skipping 1 thread", names[set]);
+        report(label, skipMs / options.iterations, detail);
+
+        double poolMs = 0.0;
+        for (int i = 0; i < options.iterations; ++i) {
+            timer.restart();
+            sight.canSeeBatch(queries.data(), queries.size(), skipping.data(), &pool);
+            poolMs += timer.elapsedMs();
+        }
+        std::snprintf(detail, sizeof(detail), "%.2f M queries/s", QUERIES * options.iterations / poolMs / 1000.0);
+        std::snprintf(label, sizeof(label), "sight/%s skipping %d threads", names[set], pool.getThreadCount());
+        report(label, poolMs / options.iterations, detail);
+    }
+
+    const float eye[3] = {side * 0.5f, eyeLevel(mask, side / 2, side / 2), side * 0.5f};
+    for (float radius : VIEW_RADII) {
+        std::vector<Vec3i> seen;
+        timer.restart();
+        for (int i = 0; i < options.iterations; ++i) {
+            seen.clear();
+            sight.visibleVoxels(eye, radius, seen, &pool);
+        }
+        std::snprintf(detail, sizeof(detail), "%zu voxels seen", seen.size());
+        std::snprintf(label, sizeof(label), "sight/visible voxels r=%.0f", radius);
+        report(label, timer.elapsedMs() / options.iterations, detail);
+    }
+}
@@ -0,0 +1,130 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "DistanceField.h"
+#include "GridPathfinder.h"
+#include "OccupancyMask.h"
+#include "PathSmoother.h"
+#include "TerrainGenerator.h"
+
+using namespace vox;
+
+namespace {
+
+const int PATHS = 50;
+const size_t SMALL_BUDGET = 200;
+
+uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7FEB352Du;
+    v ^= v >> 15;
+    v *= 0x846CA68Bu;
+    return v ^ (v >> 16);
+}
+
+int pick(uint32_t v, int range) {
+    return int(hash(v) % uint32_t(range));
+}
+
+int groundLevel(const OccupancyMask &mask, int x, int z) {
+    int y = mask.getSize().y - 1;
+    while (y > 0 && !mask.get(x, y - 1, z)) {
+        --y;
+    }
+    return y;
+}
+
+struct Mode {
+    const char *name;
+    bool spline;
+    size_t maxChecks;
+};
+
+} // namespace
+
+void benchSmooth(const BenchOptions &options) {
+    int side = options.size < 64 ? 64 : options.size;
+    TerrainSettings terrain;
+    terrain.seed = 11;
+    VoxelMap map;
+    TerrainGenerator generator(terrain, map.getMaterials());
+    int chunks = (side + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    generator.generate(map, Vec3i(0, 0, 0), Vec3i(chunks - 1, 2, chunks - 1));
+    OccupancyMask mask = OccupancyMask::fromMap(map, Vec3i(0, 0, 0), Vec3i(side, 3 * CHUNK_SIZE, side));
+    DistanceField field;
+    field.build(mask);
+    GridPathfinder finder(mask, &field);
+    PathSmoother smoother(finder);
+
+    PathSettings settings;
+    settings.radius = 0.6f;
+    std::vector<std::vector<Vec3i>> paths;
+    double findMs = 0.0;
+    std::vector<Vec3i> path;
+    for (int i = 0; i < PATHS; ++i) {
+        int x0 = pick(i * 4, side), z0 = pick(i * 4 + 1, side);
+        int x1 = pick(i * 4 + 2, side), z1 = pick(i * 4 + 3, side);
+        PathStats stats;
+        if (finder.findPath(Vec3i(x0, groundLevel(mask, x0, z0), z0), Vec3i(x1, groundLevel(mask, x1, z1), z1), path,
+                            settings, &stats)) {
+            paths.push_back(path);
+        }
+        findMs += stats.milliseconds;
+    }
+    char detail[200];
+    std::snprintf(detail, sizeof(detail), "%zu/%d paths found, for comparison", paths.size(), PATHS);
+    report("smooth/find path", findMs / PATHS, detail);
+    if (paths.empty()) {
+        return;
+    }
+
+    const Mode modes[3] = {{"smooth/pull", false, 0}, {"smooth/pull + spline", true, 0},
+                           {"smooth/pull, small budget", false, SMALL_BUDGET}};
+    for (const Mode &mode : modes) {
+        SmoothSettings smooth;
+        smooth.spline = mode.spline;
+        smooth.maxChecks = mode.maxChecks;
+        SmoothStats total;
+        size_t worstChecks = 0;
+        size_t broken = 0;
+        std::vector<Waypoint> out;
+        std::vector<Vec3i> corners;
+        for (int i = 0; i < options.iterations; ++i) {
+            for (const std::vector<Vec3i> &cells : paths) {
+                SmoothStats stats;
+                smoother.smooth(cells, out, settings, smooth, &stats);
+                total.cellsIn += stats.cellsIn;
+                total.corners += stats.corners;
+                total.points += stats.points;
+                total.checks += stats.checks;
+                total.lengthIn += stats.lengthIn;
+                total.lengthOut += stats.lengthOut;
+                total.milliseconds += stats.milliseconds;
+                worstChecks = std::max(worstChecks, stats.checks);
+                if (i) {
+                    continue;
+                }
+                // Every leg of the output must be walkable.
+                smoother.pull(cells, corners, settings, smooth);
+                for (size_t k = 1; k < corners.size(); ++k) {
+                    broken += finder.canWalkStraight(corners[k - 1], corners[k], settings) ? 0 : 1;
+                }
+                for (const Waypoint &point : out) {
+                    Vec3i cell(int(std::floor(point.x + 0.5f)), int(std::floor(point.y + 1.0f)),
+                               int(std::floor(point.z + 0.5f)));
+                    broken += finder.isWalkable(cell, settings) ? 0 : 1;
+                }
+            }
+        }
+        size_t runs = paths.size() * options.iterations;
+        std::snprintf(detail, sizeof(detail),
+                      "%.1f cells -> %.1f corners -> %.1f points, length %.1f%% of grid, %zu checks (worst %zu), "
+                      "%zu broken%s",
+                      double(total.cellsIn) / runs, double(total.corners) / runs, double(total.points) / runs,
+                      100.0 * total.lengthOut / total.lengthIn, total.checks / runs, worstChecks, broken,
+                      broken ? "  FAIL" : "");
+        report(mode.name, total.milliseconds / runs, detail);
+    }
+}
@@ -0,0 +1,145 @@
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "Bench.h"
+#include "ChunkMesher.h"
+#include "SurfaceMesher.h"
+#include "TerrainGenerator.h"
+
+using namespace vox;
+
+namespace {
+
+const int HEIGHT_CHUNKS = 3;
+
+// Rolling hills with densities that fall off over a couple of cells, so
+// the surface passes between cell centres instead of through them.
+void buildField(VoxelMap &map, int side) {
+    MaterialId grass = map.getMaterials().add(Material("grass", 0xFF4CAF50));
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    std::vector<uint32_t> density(CHUNK_VOLUME);
+    for (int cz = 0; cz < side; ++cz) {
+        for (int cy = 0; cy < HEIGHT_CHUNKS; ++cy) {
+            for (int cx = 0; cx < side; ++cx) {
+                bool any = false;
+                for (int z = 0; z < CHUNK_SIZE; ++z) {
+                    for (int x = 0; x < CHUNK_SIZE; ++x) {
+                        float wx = float(cx * CHUNK_SIZE + x);
+                        float wz = float(cz * CHUNK_SIZE + z);
+                        float height = 40.0f + 14.0f * std::sin(wx * 0.07f) * std::cos(wz * 0.05f)
+                                       + 5.0f * std::sin((wx + wz) * 0.13f);
+                        for (int y = 0; y < CHUNK_SIZE; ++y) {
+                            float d = 128.0f + (height - float(cy * CHUNK_SIZE + y)) * 48.0f;
+                            uint32_t value = uint32_t(d < 0.0f ? 0.0f : (d > 255.0f ? 255.0f : d));
+                            int index = cellIndex(x, y, z);
+                            density[index] = value;
+                            cells[index] = value >= DENSITY_ISO ? grass : AIR;
+                            any = any || value != 0;
+                        }
+                    }
+                }
+                if (!any) {
+                    continue;
+                }
+                std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+                chunk->getMaterials().encode(cells.data());
+                chunk->getOrCreateAttributes(ATTR_DENSITY).encode(density.data());
+                chunk->compact();
+                map.setChunk(Vec3i(cx, cy, cz), chunk);
+            }
+        }
+    }
+}
+
+// Directed edges of every triangle, keyed by their end positions. On a
+// closed, consistently wound surface every edge is matched by as many
+// edges running the other way; a mismatch is a crack at a chunk seam, a
+// hole or a flipped triangle. Cells touching only along an edge share it
+// between two pairs of triangles, which still balances.
+size_t countUnmatchedEdges(const std::vector<ChunkMesh> &meshes) {
+    typedef std::array<uint32_t, 6> EdgeKey;
+    std::map<EdgeKey, int> edges;
+    auto key = [](const MeshVertex &a, const MeshVertex &b) {
+        EdgeKey k;
+        const float values[6] = {a.x, a.y, a.z, b.x, b.y, b.z};
+        std::memcpy(k.data(), values, sizeof(values));
+        return k;
+    };
+    for (const ChunkMesh &mesh : meshes) {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                const MeshVertex &a = mesh.vertices[mesh.indices[i + k]];
+                const MeshVertex &b = mesh.vertices[mesh.indices[i + (k + 1) % 3]];
+                ++edges[key(a, b)];
+            }
+        }
+    }
+    size_t unmatched = 0;
+    for (const auto &entry : edges) {
+        const EdgeKey &k = entry.first;
+        EdgeKey reverse = {k[3], k[4], k[5], k[0], k[1], k[2]};
+        auto it = edges.find(reverse);
+        if (it == edges.end() || it->second != entry.second) {
+            ++unmatched;
+        }
+    }
+    return unmatched;
+}
+
+template <class Mesher>
+void runMesher(const VoxelMap &map, const BenchOptions &options, const std::string &label, bool checkSeams) {
+    Mesher mesher(map);
+    std::vector<Vec3i> chunks;
+    for (const auto &entry : map.getChunks()) {
+        chunks.push_back(entry.first);
+    }
+    std::vector<ChunkMesh> meshes(chunks.size());
+    BenchTimer timer;
+    for (int i = 0; i < options.iterations; ++i) {
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            mesher.mesh(chunks[c], meshes[c]);
+        }
+    }
+    double ms = timer.elapsedMs() / options.iterations;
+
+    size_t vertices = 0, triangles = 0;
+    for (const ChunkMesh &mesh : meshes) {
+        vertices += mesh.vertices.size();
+        triangles += mesh.indices.size() / 3;
+    }
+    char detail[160];
+    int length = std::snprintf(detail, sizeof(detail), "%.3f ms per chunk, %zu chunks, %zu triangles, %.2f vertices per triangle",
+                               ms / chunks.size(), chunks.size(), triangles,
+                               triangles ? double(vertices) / triangles : 0.0);
+    if (checkSeams) {
+        size_t unmatched = countUnmatchedEdges(meshes);
+        std::snprintf(detail + length, sizeof(detail) - length, ", %zu unmatched edges%s", unmatched,
+                      unmatched ? "  FAIL" : "");
+    }
+    report(label, ms, detail);
+}
+
+} // namespace
+
+void benchSurface(const BenchOptions &options) {
+    int side = options.size / CHUNK_SIZE > 0 ? options.size / CHUNK_SIZE : 1;
+
+    VoxelMap field;
+    buildField(field, side);
+    runMesher<ChunkMesher>(field, options, "surface/field blocks", false);
+    runMesher<SurfaceMesher>(field, options, "surface/field smooth", true);
+
+    // Generated terrain has no densities: caves, overhangs and single
+    // cells all come from the materials alone.
+    VoxelMap terrain;
+    TerrainSettings settings;
+    settings.seed = 1234;
+    TerrainGenerator generator(settings, terrain.getMaterials());
+    generator.generate(terrain, Vec3i(0, 0, 0), Vec3i(side - 1, HEIGHT_CHUNKS - 1, side - 1));
+    runMesher<ChunkMesher>(terrain, options, "surface/terrain blocks", false);
+    runMesher<SurfaceMesher>(terrain, options, "surface/terrain smooth", true);
+}
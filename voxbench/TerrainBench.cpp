@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "NoiseKernels.h"
+#include "OccupancyKernels.h"
+#include "Parallel.h"
+#include "Serialization.h"
+#include "TerrainGenerator.h"
+
+using namespace vox;
+
+namespace {
+
+// Terrain tops out at baseHeight + heightRange, three chunks high.
+const int HEIGHT_CHUNKS = 3;
+const int NOISE_ROWS = 20000;
+
+// Order independent digest of the generated cells, to check that every
+// configuration builds the same world.
+uint32_t digest(const VoxelMap &map) {
+    uint32_t total = 0;
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    for (const auto &entry : map.getChunks()) {
+        entry.second->getMaterials().decode(cells.data());
+        uint32_t h = checksum(reinterpret_cast<const uint8_t *>(cells.data()), cells.size() * sizeof(uint32_t));
+        total += h ^ uint32_t(Vec3iHash()(entry.first));
+    }
+    return total;
+}
+
+void runNoise(const char *label) {
+    std::vector<float> row(CHUNK_SIZE);
+    volatile float sink = 0.0f;
+    BenchTimer timer;
+    for (int i = 0; i < NOISE_ROWS; ++i) {
+        kernels::fbmRow(0.0f, 1.0f / 96.0f, i * 0.25f, i * 0.5f, 7, 5, 0.5f, row.data(), row.size());
+        sink = sink + row[i % CHUNK_SIZE];
+    }
+    double ms = timer.elapsedMs();
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "%.1f M samples/s, 5 octaves",
+                  NOISE_ROWS * double(CHUNK_SIZE) * 5 / ms / 1000.0);
+    report(std::string("noise/") + label + " fbm rows", ms, detail);
+}
+
+uint32_t runGenerate(const BenchOptions &options, ThreadPool &pool, const std::string &label) {
+    int side = options.size / CHUNK_SIZE > 0 ? options.size / CHUNK_SIZE : 1;
+    TerrainSettings settings;
+    settings.seed = 1234;
+    VoxelMap map;
+    TerrainGenerator generator(settings, map.getMaterials());
+    TerrainStats stats;
+    double seconds = 0.0;
+    for (int i = 0; i < options.iterations; ++i) {
+        map.clear();
+        generator.generate(map, Vec3i(0, 0, 0), Vec3i(side - 1, HEIGHT_CHUNKS - 1, side - 1), &pool, &stats);
+        seconds += stats.seconds;
+    }
+    stats.seconds = seconds / options.iterations;
+    char detail[128];
+    std::snprintf(detail, sizeof(detail), "%zu chunks (%zu stored) at %.0f chunks/s", stats.chunks, stats.stored,
+                  stats.chunksPerSecond());
+    report(label, stats.seconds * 1000.0, detail);
+    return digest(map);
+}
+
+} // namespace
+
+void benchTerrain(const BenchOptions &options) {
+    runNoise(kernels::instructionSet());
+    kernels::setSimdEnabled(false);
+    runNoise(kernels::instructionSet());
+    kernels::setSimdEnabled(true);
+
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    const std::string simd = kernels::instructionSet();
+    uint32_t expected = runGenerate(options, single, "generate/" + simd + " 1 thread");
+    char label[64];
+    std::snprintf(label, sizeof(label), "generate/%s %d threads", simd.c_str(), pool.getThreadCount());
+    bool same = runGenerate(options, pool, label) == expected;
+    kernels::setSimdEnabled(false);
+    std::snprintf(label, sizeof(label), "generate/scalar %d threads", pool.getThreadCount());
+    same = runGenerate(options, pool, label) == expected && same;
+    kernels::setSimdEnabled(true);
+    report("generate/deterministic", 0.0, same ? "all runs built the same cells" : "MISMATCH");
+}
@@ -0,0 +1,112 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "MeshVoxelizer.h"
+#include "Parallel.h"
+
+using namespace vox;
+
+namespace {
+
+const float PI = 3.14159265f;
+const int STACKS = 256;
+const int SLICES = 512;
+const float RADIUS = 60.0f;
+
+struct Point {
+    float x, y, z;
+};
+
+void addTriangle(std::vector<float> &corners, const Point &a, const Point &b, const Point &c) {
+    const Point *points[3] = {&a, &b, &c};
+    for (const Point *p : points) {
+        corners.push_back(p->x);
+        corners.push_back(p->y);
+        corners.push_back(p->z);
+    }
+}
+
+// Closed UV sphere. Shared corners are computed from the same indices so
+// neighbouring triangles meet exactly.
+Point spherePoint(int stack, int slice) {
+    float theta = PI * float(stack) / float(STACKS);
+    float phi = 2.0f * PI * float(slice % SLICES) / float(SLICES);
+    if (stack == 0 || stack == STACKS) {
+        return Point{0.0f, stack ? -RADIUS : RADIUS, 0.0f};
+    }
+    return Point{RADIUS * std::sin(theta) * std::cos(phi), RADIUS * std::cos(theta),
+                 RADIUS * std::sin(theta) * std::sin(phi)};
+}
+
+std::vector<float> sphere() {
+    std::vector<float> corners;
+    for (int i = 0; i < STACKS; ++i) {
+        for (int j = 0; j < SLICES; ++j) {
+            Point a = spherePoint(i, j), b = spherePoint(i + 1, j);
+            Point c = spherePoint(i + 1, j + 1), d = spherePoint(i, j + 1);
+            if (i != 0) {
+                addTriangle(corners, a, b, d);
+            }
+            if (i != STACKS - 1) {
+                addTriangle(corners, b, c, d);
+            }
+        }
+    }
+    return corners;
+}
+
+// Voxels clearly inside the sphere that are empty and clearly outside that
+// are set. The surface band in between can go either way.
+size_t countWrong(const VoxelMap &map, float voxelSize) {
+    int reach = int(std::ceil(RADIUS / voxelSize)) + 2;
+    size_t wrong = 0;
+    for (int z = -reach; z <= reach; ++z) {
+        for (int y = -reach; y <= reach; ++y) {
+            for (int x = -reach; x <= reach; ++x) {
+                float d = std::sqrt(float(x * x + y * y + z * z)) * voxelSize;
+                bool solid = map.isSolid(x, y, z);
+                if ((d < RADIUS - voxelSize && !solid) || (d > RADIUS + voxelSize && solid)) {
+                    ++wrong;
+                }
+            }
+        }
+    }
+    return wrong;
+}
+
+} // namespace
+
+void benchVoxelize(const BenchOptions &options) {
+    std::vector<float> corners = sphere();
+    size_t triangles = corners.size() / 9;
+    ThreadPool single(1);
+    ThreadPool pool(options.threads);
+    ThreadPool *pools[2] = {&single, &pool};
+    const float sizes[2] = {1.0f, 0.5f};
+    for (float size : sizes) {
+        for (ThreadPool *threads : pools) {
+            VoxelizeSettings settings;
+            settings.voxelSize = size;
+            settings.pool = threads;
+            VoxelizeStats stats;
+            double seconds = 0.0;
+            VoxelMap map;
+            for (int i = 0; i < options.iterations; ++i) {
+                map.clear();
+                voxelizeMesh(corners.data(), triangles, map, settings, &stats);
+                seconds += stats.seconds;
+            }
+            size_t wrong = countWrong(map, size);
+            char label[64];
+            char detail[200];
+            std::snprintf(label, sizeof(label), "voxelize/sphere %.1f %d threads", size, threads->getThreadCount());
+            std::snprintf(detail, sizeof(detail),
+                          "%.2f M tris/s, %zu tris, %zu chunks, %zu surface + %zu filled, %zu open, %zu wrong%s",
+                          triangles * options.iterations / seconds / 1e6, triangles, stats.chunks,
+                          stats.surfaceVoxels, stats.filledVoxels, stats.openColumns, wrong, wrong ? "  FAIL" : "");
+            report(label, seconds * 1000.0 / options.iterations, detail);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "OccupancyKernels.h"
+
+namespace {
+
+struct BenchEntry {
+    const char *name;
+    void (*run)(const BenchOptions &);
+};
+
+const BenchEntry BENCHMARKS[] = {
+    {"occupancy", benchOccupancy},
+    {"import", benchImport},
+    {"terrain", benchTerrain},
+    {"collision", benchCollision},
+    {"crowd", benchCrowd},
+    {"sight", benchSight},
+    {"distance", benchDistance},
+    {"smooth", benchSmooth},
+    {"voxelize", benchVoxelize},
+    {"surface", benchSurface},
+    {"physics", benchPhysics},
+    {"diffusion", benchDiffusion},
+};
+
+void usage() {
+    std::printf("usage: voxbench [--size N] [--iterations N] [--threads N] [--scalar] [benchmark...]\n");
+    std::printf("benchmarks:");
+    for (const BenchEntry &entry : BENCHMARKS) {
+        std::printf(" %s", entry.name);
+    }
+    std::printf("\n");
+}
+
+} // namespace
+
+void report(const std::string &name, double msPerIteration, const std::string &detail) {
+    std::printf("  %-36s %10.3f ms  %s\n", name.c_str(), msPerIteration, detail.c_str());
+    std::fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    options.size = 128;
+    options.iterations = 10;
+    options.threads = int(std::thread::hardware_concurrency());
+    if (options.threads < 1) {
+        options.threads = 1;
+    }
+
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--size") && i + 1 < argc) {
+            options.size = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--scalar")) {
+            vox::kernels::setSimdEnabled(false);
+        } else if (!std::strcmp(argv[i], "--help")) {
+            usage();
+            return 0;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            selected.push_back(argv[i]);
+        }
+    }
+    if (options.size < 1 || options.iterations < 1 || options.threads < 1) {
+        usage();
+        return 1;
+    }
+
+    std::printf("voxbench: size %d, %d iterations, %d threads, kernels %s\n",
+                options.size, options.iterations, options.threads, vox::kernels::instructionSet());
+    bool ran = false;
+    for (const BenchEntry &entry : BENCHMARKS) {
+        bool wanted = selected.empty();
+        for (const std::string &name : selected) {
+            wanted = wanted || name == entry.name;
+        }
+        if (wanted) {
+            std::printf("%s\n", entry.name);
+            entry.run(options);
+            ran = true;
+        }
+    }
+    if (!ran) {
+        usage();
+        return 1;
+    }
+    return 0;
+}
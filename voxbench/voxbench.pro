@@ -0,0 +1,22 @@
+TEMPLATE = app
+TARGET = voxbench
+CONFIG += console
+CONFIG -= qt app_bundle
+
+include(../voxcore/voxcore.pri)
+
+HEADERS += Bench.h
+
+SOURCES += main.cpp \
+    OccupancyBench.cpp \
+    ImportBench.cpp \
+    TerrainBench.cpp \
+    CollisionBench.cpp \
+    CrowdBench.cpp \
+    SightBench.cpp \
+    DistanceBench.cpp \
+    SmoothBench.cpp \
+    VoxelizeBench.cpp \
+    SurfaceBench.cpp \
+    PhysicsBench.cpp \
+    DiffusionBench.cpp
@@ -0,0 +1,359 @@
+#include "Autosaver.h"
+
+#include "Serialization.h"
+
+namespace vox {
+
+namespace {
+
+const uint64_t DEFAULT_COMPACTION_THRESHOLD = 16u << 20;
+
+bool fileExists(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fclose(file);
+    return true;
+}
+
+void encodeChunk(const Chunk &chunk, std::vector<uint8_t> &out) {
+    out.clear();
+    ByteWriter writer(out);
+    chunk.write(writer);
+}
+
+} // namespace
+
+Autosaver::Autosaver(VoxelMap &map, const std::string &path)
+    : mMap(map), mPath(path), mNeedsFullSnapshot(true),
+      mWorking(false), mStop(false), mLogSize(0),
+      mCompactionThreshold(DEFAULT_COMPACTION_THRESHOLD) {
+    mSubscriber = mMap.getChanges().subscribe(CHANGE_CONTENT | CHANGE_REMOVED);
+    mThread = std::thread(&Autosaver::run, this);
+}
+
+Autosaver::~Autosaver() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+    mMap.getChanges().unsubscribe(mSubscriber);
+}
+
+const std::string &Autosaver::getPath() const {
+    return mPath;
+}
+
+bool Autosaver::autosave() {
+    std::unique_ptr<Job> job(new Job());
+    job->version = mMap.getVersion();
+    job->full = mNeedsFullSnapshot;
+    job->compact = false;
+
+    if (job->full) {
+        mMap.getChanges().skip(mSubscriber);
+        for (const auto &entry : mMap.getChunks()) {
+            job->chunks.push_back(Snapshot{entry.first, entry.second});
+        }
+        mNeedsFullSnapshot = false;
+    } else {
+        std::vector<ChunkChange> changes;
+        mMap.getChanges().poll(mSubscriber, changes);
+        for (const ChunkChange &change : changes) {
+            std::shared_ptr<const Chunk> chunk = mMap.shareChunk(change.chunk);
+            if (chunk) {
+                job->chunks.push_back(Snapshot{change.chunk, chunk});
+            } else {
+                job->removed.push_back(change.chunk);
+            }
+        }
+    }
+
+    std::vector<uint8_t> materials;
+    encodeMaterials(mMap.getMaterials(), materials);
+    if (job->full || materials != mSavedMaterials) {
+        job->materials = materials;
+        mSavedMaterials.swap(materials);
+    }
+    std::vector<uint8_t> settings;
+    encodeSettings(mMap, settings);
+    if (job->full || settings != mSavedSettings) {
+        job->settings = settings;
+        mSavedSettings.swap(settings);
+    }
+
+    if (!job->full && job->chunks.empty() && job->removed.empty() && job->materials.empty()
+        && job->settings.empty()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+    mWake.notify_one();
+    return true;
+}
+
+void Autosaver::save() {
+    autosave();
+    std::unique_ptr<Job> job(new Job());
+    job->version = mMap.getVersion();
+    job->full = false;
+    job->compact = true;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+    mWake.notify_one();
+}
+
+void Autosaver::reset() {
+    mMap.getChanges().skip(mSubscriber);
+    encodeMaterials(mMap.getMaterials(), mSavedMaterials);
+    encodeSettings(mMap, mSavedSettings);
+    mNeedsFullSnapshot = false;
+}
+
+void Autosaver::wait() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this] { return mJobs.empty() && !mWorking; });
+}
+
+bool Autosaver::isBusy() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return !mJobs.empty() || mWorking;
+}
+
+std::string Autosaver::getLastError() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastError;
+}
+
+uint64_t Autosaver::getLogSize() const {
+    return mLogSize;
+}
+
+void Autosaver::setCompactionThreshold(uint64_t bytes) {
+    mCompactionThreshold = bytes;
+}
+
+void Autosaver::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mWake.wait(lock, [this] { return mStop || !mJobs.empty(); });
+        if (mJobs.empty()) {
+            break; // stopping, everything queued has been written
+        }
+        std::unique_ptr<Job> job = std::move(mJobs.front());
+        mJobs.pop_front();
+        mWorking = true;
+        lock.unlock();
+
+        bool ok;
+        if (job->full) {
+            ok = writeFull(*job);
+        } else {
+            ok = writeJob(*job);
+            if (ok && (job->compact || mLogSize >= mCompactionThreshold)) {
+                ok = compact();
+            }
+        }
+        job.reset(); // release the shared chunks outside the lock
+
+        lock.lock();
+        mWorking = false;
+        if (ok) {
+            mLastError.clear();
+        }
+        if (mJobs.empty()) {
+            mIdle.notify_all();
+        }
+    }
+    mLog.close();
+}
+
+bool Autosaver::writeFull(const Job &job) {
+    mLog.close();
+    const std::string temp = mPath + ".tmp";
+    MapRecordWriter writer;
+    if (!writer.open(temp, MAP_MAGIC, false)) {
+        setError("Cannot write " + temp);
+        return false;
+    }
+    bool ok = writer.write(RECORD_MATERIALS, Vec3i(), job.version, job.materials);
+    ok = ok && writer.write(RECORD_SETTINGS, Vec3i(), job.version, job.settings);
+    std::vector<uint8_t> payload;
+    for (const Snapshot &snapshot : job.chunks) {
+        if (!ok) {
+            break;
+        }
+        encodeChunk(*snapshot.cells, payload);
+        ok = writer.write(RECORD_CHUNK, snapshot.chunk, snapshot.cells->getVersion(), payload);
+    }
+    payload.clear();
+    ok = ok && writer.write(RECORD_END, Vec3i(), job.version, payload);
+    ok = writer.close() && ok;
+    if (!ok || !replaceFile(temp, mPath)) {
+        std::remove(temp.c_str());
+        setError("Failed writing " + mPath);
+        return false;
+    }
+    if (!mLog.open(mapLogPath(mPath), LOG_MAGIC, false)) {
+        setError("Cannot write " + mapLogPath(mPath));
+        return false;
+    }
+    mLogSize = mLog.getSize();
+    return true;
+}
+
+bool Autosaver::writeJob(const Job &job) {
+    const std::string logPath = mapLogPath(mPath);
+    if (!mLog.isOpen()) {
+        // A log left by an earlier session may end in a torn record; fold it
+        // into the map file first so new records are not appended after it.
+        if (fileExists(logPath)) {
+            if (!compact()) {
+                return false;
+            }
+        } else if (!mLog.open(logPath, LOG_MAGIC, false)) {
+            setError("Cannot write " + logPath);
+            return false;
+        }
+    }
+
+    bool ok = true;
+    if (!job.materials.empty()) {
+        ok = mLog.write(RECORD_MATERIALS, Vec3i(), job.version, job.materials);
+    }
+    if (ok && !job.settings.empty()) {
+        ok = mLog.write(RECORD_SETTINGS, Vec3i(), job.version, job.settings);
+    }
+    std::vector<uint8_t> payload;
+    for (const Snapshot &snapshot : job.chunks) {
+        if (!ok) {
+            break;
+        }
+        encodeChunk(*snapshot.cells, payload);
+        ok = mLog.write(RECORD_CHUNK, snapshot.chunk, snapshot.cells->getVersion(), payload);
+    }
+    payload.clear();
+    for (const Vec3i &chunk : job.removed) {
+        if (!ok) {
+            break;
+        }
+        ok = mLog.write(RECORD_REMOVE, chunk, job.version, payload);
+    }
+    ok = mLog.flush() && ok;
+    mLogSize = mLog.getSize();
+    if (!ok) {
+        setError("Failed writing " + logPath);
+    }
+    return ok;
+}
+
+bool Autosaver::compact() {
+    const std::string logPath = mapLogPath(mPath);
+    mLog.close();
+
+    // Latest state of every chunk the log touches.
+    std::unordered_map<Vec3i, MapRecord, Vec3iHash> latest;
+    MapRecord materials;
+    materials.type = 0;
+    MapRecord settings;
+    settings.type = 0;
+    MapRecordReader log;
+    if (log.open(logPath, LOG_MAGIC)) {
+        MapRecord record;
+        while (log.next(record)) {
+            if (record.type == RECORD_MATERIALS) {
+                materials = record;
+            } else if (record.type == RECORD_SETTINGS) {
+                settings = record;
+            } else if (record.type == RECORD_CHUNK || record.type == RECORD_REMOVE) {
+                latest[record.chunk] = record;
+            }
+        }
+        log.close();
+    }
+
+    const std::string temp = mPath + ".tmp";
+    MapRecordWriter writer;
+    if (!writer.open(temp, MAP_MAGIC, false)) {
+        setError("Cannot write " + temp);
+        return false;
+    }
+
+    // Stream the old map file across, replacing what the log overrides.
+    bool ok = true;
+    bool wroteMaterials = false;
+    bool wroteSettings = false;
+    uint64_t version = 0;
+    MapRecordReader base;
+    if (base.open(mPath, MAP_MAGIC)) {
+        MapRecord record;
+        bool ended = false;
+        while (ok && base.next(record)) {
+            version = record.version > version ? record.version : version;
+            if (record.type == RECORD_END) {
+                ended = true;
+                break;
+            }
+            if (record.type == RECORD_MATERIALS) {
+                ok = writer.write(materials.type ? materials : record);
+                wroteMaterials = true;
+            } else if (record.type == RECORD_SETTINGS) {
+                ok = writer.write(settings.type ? settings : record);
+                wroteSettings = true;
+            } else if (record.type == RECORD_CHUNK && !latest.count(record.chunk)) {
+                ok = writer.write(record);
+            }
+        }
+        if (!ended) {
+            ok = false;
+        }
+    }
+    if (ok && !wroteMaterials && materials.type) {
+        ok = writer.write(materials);
+    }
+    if (ok && !wroteSettings && settings.type) {
+        ok = writer.write(settings);
+    }
+    for (const auto &entry : latest) {
+        if (!ok) {
+            break;
+        }
+        version = entry.second.version > version ? entry.second.version : version;
+        if (entry.second.type == RECORD_CHUNK) {
+            ok = writer.write(entry.second);
+        }
+    }
+    ok = ok && writer.write(RECORD_END, Vec3i(), version, std::vector<uint8_t>());
+    ok = writer.close() && ok;
+    if (!ok || !replaceFile(temp, mPath)) {
+        std::remove(temp.c_str());
+        setError("Failed compacting " + mPath);
+        // Keep appending to the old log so nothing is lost.
+        mLog.open(logPath, LOG_MAGIC, true);
+        mLogSize = mLog.getSize();
+        return false;
+    }
+
+    // Replaying the log over the new map file is harmless, so a crash before
+    // the truncation below loses nothing.
+    if (!mLog.open(logPath, LOG_MAGIC, false)) {
+        setError("Cannot write " + logPath);
+        return false;
+    }
+    mLogSize = mLog.getSize();
+    return true;
+}
+
+void Autosaver::setError(const std::string &error) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLastError = error;
+}
+
+} // namespace vox
@@ -0,0 +1,96 @@
+#ifndef AUTOSAVER_H
+#define AUTOSAVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MapFile.h"
+#include "VoxelMap.h"
+
+namespace vox {
+
+// Background incremental saving for a map bound to a .vxm file.
+// autosave() runs on the editing thread and only takes shared references to
+// the chunks changed since the previous call; the map copies one of them only
+// if it is edited again before the worker is done with it. The worker
+// serializes those chunks and appends them to the chunk log next to the map
+// file. Once the log outgrows the compaction threshold the worker folds it
+// into a new map file, so a crash loses at most the edits since the last
+// autosave.
+class Autosaver {
+public:
+    Autosaver(VoxelMap &map, const std::string &path);
+    ~Autosaver();
+
+    const std::string &getPath() const;
+
+    // Queues the chunks changed since the last call. Returns false when
+    // nothing changed.
+    bool autosave();
+    // Queues the pending changes and a compaction, leaving a complete map file.
+    void save();
+    // Declares the map equal to the file on disk, e.g. right after loading
+    // it. Until then the first autosave writes the whole map.
+    void reset();
+
+    // Blocks until the worker has written everything queued so far.
+    void wait();
+    bool isBusy() const;
+    std::string getLastError() const;
+
+    uint64_t getLogSize() const;
+    void setCompactionThreshold(uint64_t bytes);
+
+private:
+    struct Snapshot {
+        Vec3i chunk;
+        std::shared_ptr<const Chunk> cells;
+    };
+
+    struct Job {
+        std::vector<Snapshot> chunks;
+        std::vector<Vec3i> removed;
+        std::vector<uint8_t> materials;   // empty when unchanged
+        std::vector<uint8_t> settings;    // empty when unchanged
+        uint64_t version;
+        bool full;        // chunks is the whole map, rewrite the map file
+        bool compact;
+    };
+
+    void run();
+    bool writeFull(const Job &job);
+    bool writeJob(const Job &job);
+    bool compact();
+    void setError(const std::string &error);
+
+    VoxelMap &mMap;
+    std::string mPath;
+    ChangeTracker::Subscriber mSubscriber;
+    std::vector<uint8_t> mSavedMaterials;
+    std::vector<uint8_t> mSavedSettings;
+    bool mNeedsFullSnapshot;
+
+    // Worker state, only touched by the worker thread.
+    MapRecordWriter mLog;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mIdle;
+    std::deque<std::unique_ptr<Job>> mJobs;
+    bool mWorking;
+    bool mStop;
+    std::string mLastError;
+    std::atomic<uint64_t> mLogSize;
+    std::atomic<uint64_t> mCompactionThreshold;
+    std::thread mThread;
+};
+
+} // namespace vox
+
+#endif // AUTOSAVER_H
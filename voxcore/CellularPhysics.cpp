@@ -0,0 +1,419 @@
+#include "CellularPhysics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+// Load of a cell that has nothing left to hang from.
+const uint16_t LOAD_FALL = 0xFFFF;
+
+const int SELF = 13;
+
+const int SLIDES[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+// Which of the 27 chunks around a chunk holds local cell (x, y, z), for
+// coordinates from -1 to CHUNK_SIZE.
+inline int windowIndex(int x, int y, int z) {
+    return ((x >> CHUNK_BITS) + 1) + 3 * (((y >> CHUNK_BITS) + 1) + 3 * ((z >> CHUNK_BITS) + 1));
+}
+
+inline int windowIndex(const Vec3i &d) {
+    return (d.x + 1) + 3 * ((d.y + 1) + 3 * (d.z + 1));
+}
+
+inline bool isGranular(uint32_t weight) {
+    return (weight & WEIGHT_GRANULAR) != 0;
+}
+
+inline int parity(const Vec3i &chunk) {
+    return (chunk.x & 1) | ((chunk.y & 1) << 1) | ((chunk.z & 1) << 2);
+}
+
+inline bool keyLess(const Vec3i &a, const Vec3i &b) {
+    if (a.z != b.z) {
+        return a.z < b.z;
+    }
+    if (a.y != b.y) {
+        return a.y < b.y;
+    }
+    return a.x < b.x;
+}
+
+} // namespace
+
+uint32_t packWeight(float weight, bool granular) {
+    float units = std::round(weight * 16.0f);
+    uint32_t packed = units < 1.0f ? 1u : (units > float(WEIGHT_UNITS) ? WEIGHT_UNITS : uint32_t(units));
+    return granular ? packed | WEIGHT_GRANULAR : packed;
+}
+
+float unpackWeight(uint32_t packed) {
+    return float(packed & WEIGHT_UNITS) / 16.0f;
+}
+
+struct CellularPhysics::SimChunk {
+    Vec3i key;
+    std::vector<uint32_t> cells;
+    std::vector<uint32_t> weights;
+    std::vector<uint16_t> loads;
+    std::vector<CellMove> moves;
+    SimChunk *window[27];   // neighbours by windowIndex, set before each tick
+    uint32_t spilled;       // window entries whose cells the last tick changed
+    int quiet;              // ticks since the last change
+    bool active;
+    bool wakeNext;
+    bool touched;           // the last tick changed a cell or a load
+    bool dirty;             // cells differ from the map
+    bool hasDynamic;        // may hold weighted cells
+
+    explicit SimChunk(const Vec3i &key)
+        : key(key), cells(CHUNK_VOLUME), weights(CHUNK_VOLUME), loads(CHUNK_VOLUME), spilled(0), quiet(0),
+          active(false), wakeNext(false), touched(false), dirty(false), hasDynamic(false) {
+        std::fill(window, window + 27, nullptr);
+    }
+};
+
+CellularPhysics::CellularPhysics(VoxelMap &map, const PhysicsSettings &settings)
+    : mMap(map), mSettings(settings), mTick(0) {
+    float units = std::round(settings.maxLoad * 16.0f);
+    mMaxLoad = uint16_t(units < 0.0f ? 0.0f : (units > float(LOAD_FALL - 1) ? float(LOAD_FALL - 1) : units));
+    mSubscriber = mMap.getChanges().subscribe(CHANGE_CONTENT | CHANGE_REMOVED);
+    wakeAll();
+}
+
+CellularPhysics::~CellularPhysics() {
+    mMap.getChanges().unsubscribe(mSubscriber);
+}
+
+CellularPhysics::SimChunk &CellularPhysics::mirror(const Vec3i &chunk) {
+    std::unique_ptr<SimChunk> &slot = mChunks[chunk];
+    if (!slot) {
+        slot.reset(new SimChunk(chunk));
+        reload(*slot);
+    }
+    return *slot;
+}
+
+void CellularPhysics::reload(SimChunk &sim) {
+    const Chunk *chunk = static_cast<const VoxelMap &>(mMap).findChunk(sim.key);
+    const PaletteStorage *weights = chunk ? chunk->getAttributes(ATTR_WEIGHT) : nullptr;
+    if (chunk) {
+        chunk->getMaterials().decode(sim.cells.data());
+    } else {
+        std::fill(sim.cells.begin(), sim.cells.end(), uint32_t(AIR));
+    }
+    if (weights) {
+        weights->decode(sim.weights.data());
+    } else {
+        std::fill(sim.weights.begin(), sim.weights.end(), 0u);
+    }
+    // Loads start out optimistic and settle over the next ticks.
+    std::fill(sim.loads.begin(), sim.loads.end(), uint16_t(0));
+    sim.hasDynamic = false;
+    for (int i = 0; i < CHUNK_VOLUME && weights && !sim.hasDynamic; ++i) {
+        sim.hasDynamic = sim.weights[i] && sim.cells[i] != AIR;
+    }
+    sim.dirty = false;
+}
+
+void CellularPhysics::wake(const Vec3i &chunk) {
+    // An edit can take support away from cells in the chunks around it.
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                Vec3i key = chunk + Vec3i(dx, dy, dz);
+                if (key == chunk || mMap.hasChunk(key) || mChunks.count(key)) {
+                    SimChunk &sim = mirror(key);
+                    sim.active = true;
+                    sim.quiet = 0;
+                }
+            }
+        }
+    }
+}
+
+void CellularPhysics::wakeAll() {
+    for (const auto &entry : mMap.getChunks()) {
+        if (entry.second->hasAttribute(ATTR_WEIGHT)) {
+            wake(entry.first);
+        }
+    }
+}
+
+void CellularPhysics::takeMoves(std::vector<CellMove> &out) {
+    out.insert(out.end(), mMoves.begin(), mMoves.end());
+    mMoves.clear();
+}
+
+size_t CellularPhysics::getActiveChunkCount() const {
+    size_t count = 0;
+    for (const auto &entry : mChunks) {
+        count += entry.second->active;
+    }
+    return count;
+}
+
+uint64_t CellularPhysics::getTick() const {
+    return mTick;
+}
+
+void CellularPhysics::step(PhysicsStats *stats) {
+    auto start = std::chrono::steady_clock::now();
+    ++mTick;
+
+    // Edits since the last step replace the decoded cells and wake the
+    // chunks around them.
+    std::vector<ChunkChange> changes;
+    mMap.getChanges().poll(mSubscriber, changes);
+    for (const ChunkChange &change : changes) {
+        auto it = mChunks.find(change.chunk);
+        if (it != mChunks.end()) {
+            reload(*it->second);
+        }
+        wake(change.chunk);
+    }
+
+    std::vector<SimChunk *> active;
+    for (const auto &entry : mChunks) {
+        if (entry.second->active) {
+            active.push_back(entry.second.get());
+        }
+    }
+    std::sort(active.begin(), active.end(),
+              [](const SimChunk *a, const SimChunk *b) { return keyLess(a->key, b->key); });
+    for (SimChunk *sim : active) {
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    Vec3i d(dx, dy, dz);
+                    sim->window[windowIndex(d)] = &mirror(sim->key + d);
+                }
+            }
+        }
+    }
+
+    ThreadPool &pool = mSettings.pool ? *mSettings.pool : defaultThreadPool();
+    size_t moves = 0;
+    std::vector<SimChunk *> phase;
+    for (int p = 0; p < 8; ++p) {
+        phase.clear();
+        for (SimChunk *sim : active) {
+            if (parity(sim->key) == p) {
+                phase.push_back(sim);
+            }
+        }
+        pool.parallelFor(phase.size(), [&](size_t i) { tick(*phase[i]); });
+
+        // Cells moved into other chunks are only noted now, single threaded.
+        for (SimChunk *sim : phase) {
+            for (uint32_t bits = sim->spilled; bits; bits &= bits - 1) {
+                int w = 0;
+                while (!(bits & (1u << w))) {
+                    ++w;
+                }
+                SimChunk *target = sim->window[w];
+                target->dirty = true;
+                target->hasDynamic = true;
+                target->wakeNext = target->wakeNext || w != SELF;
+            }
+            moves += sim->moves.size();
+            mMoves.insert(mMoves.end(), sim->moves.begin(), sim->moves.end());
+            sim->moves.clear();
+        }
+    }
+
+    for (SimChunk *sim : active) {
+        if (sim->touched) {
+            sim->quiet = 0;
+            for (SimChunk *neighbour : sim->window) {
+                neighbour->wakeNext = neighbour->wakeNext || neighbour != sim;
+            }
+        } else if (++sim->quiet >= mSettings.quietTicks) {
+            sim->active = false;
+        }
+    }
+
+    size_t written = 0;
+    for (auto &entry : mChunks) {
+        SimChunk &sim = *entry.second;
+        if (sim.wakeNext) {
+            sim.active = true;
+            sim.quiet = 0;
+            sim.wakeNext = false;
+        }
+        if (sim.dirty) {
+            writeBack(sim);
+            ++written;
+        }
+    }
+    // Our own writes are not edits to react to.
+    mMap.getChanges().skip(mSubscriber);
+
+    // Sleeping chunks away from any active one are in the map already.
+    for (auto it = mChunks.begin(); it != mChunks.end();) {
+        bool keep = it->second->active;
+        for (int dz = -1; dz <= 1 && !keep; ++dz) {
+            for (int dy = -1; dy <= 1 && !keep; ++dy) {
+                for (int dx = -1; dx <= 1 && !keep; ++dx) {
+                    auto neighbour = mChunks.find(it->first + Vec3i(dx, dy, dz));
+                    keep = neighbour != mChunks.end() && neighbour->second->active;
+                }
+            }
+        }
+        it = keep ? std::next(it) : mChunks.erase(it);
+    }
+
+    if (stats) {
+        stats->activeChunks = active.size();
+        stats->mirroredChunks = mChunks.size();
+        stats->moves = moves;
+        stats->writtenChunks = written;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void CellularPhysics::tick(SimChunk &sim) {
+    sim.spilled = 0;
+    sim.touched = false;
+    if (!sim.hasDynamic) {
+        return;
+    }
+
+    struct Ref {
+        SimChunk *chunk;
+        int index;
+        int window;
+
+        uint32_t cell() const { return chunk->cells[index]; }
+        uint32_t weight() const { return chunk->weights[index]; }
+        uint16_t load() const { return chunk->loads[index]; }
+    };
+    auto at = [&sim](int x, int y, int z) {
+        int w = windowIndex(x, y, z);
+        return Ref{sim.window[w], cellIndex(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK), w};
+    };
+    // What a cell gives the one resting on it or hanging from it.
+    auto support = [](const Ref &r, bool below) -> uint16_t {
+        if (r.cell() == AIR) {
+            return LOAD_FALL;
+        }
+        if (!r.weight()) {
+            return 0;
+        }
+        // Loose cells bear weight from above but nothing hangs from them.
+        if (isGranular(r.weight())) {
+            return below ? 0 : LOAD_FALL;
+        }
+        return r.load();
+    };
+
+    const Vec3i base(sim.key.x * CHUNK_SIZE, sim.key.y * CHUNK_SIZE, sim.key.z * CHUNK_SIZE);
+    uint32_t *cells = sim.cells.data();
+    uint32_t *weights = sim.weights.data();
+    uint16_t *loads = sim.loads.data();
+    bool anyDynamic = false;
+
+    auto move = [&](int index, int x, int y, int z, const Ref &to, int tx, int ty, int tz) {
+        to.chunk->cells[to.index] = cells[index];
+        to.chunk->weights[to.index] = weights[index];
+        to.chunk->loads[to.index] = loads[index];
+        cells[index] = AIR;
+        weights[index] = 0;
+        loads[index] = 0;
+        sim.spilled |= (1u << to.window) | (1u << SELF);
+        sim.touched = true;
+        sim.moves.push_back(CellMove{base + Vec3i(x, y, z), base + Vec3i(tx, ty, tz)});
+    };
+
+    // Bottom up, so a cell never moves twice in one tick within the chunk
+    // and whole columns fall together.
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        const bool canFall = base.y + y > mSettings.floor;
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const int index = cellIndex(x, y, z);
+                const uint32_t weight = weights[index];
+                if (!weight || cells[index] == AIR) {
+                    continue;
+                }
+                anyDynamic = true;
+                const bool granular = isGranular(weight);
+
+                if (canFall) {
+                    Ref below = at(x, y - 1, z);
+                    if (below.cell() == AIR) {
+                        if (granular || loads[index] == LOAD_FALL) {
+                            move(index, x, y, z, below, x, y - 1, z);
+                            continue;
+                        }
+                    } else if (granular) {
+                        uint32_t h = uint32_t(base.x + x) * 73856093u ^ uint32_t(base.z + z) * 19349663u
+                                     ^ uint32_t(mTick) * 83492791u;
+                        int first = int((h >> 7) & 3);
+                        bool slid = false;
+                        for (int k = 0; k < 4 && !slid; ++k) {
+                            const int *d = SLIDES[(first + k) & 3];
+                            if (at(x + d[0], y, z + d[1]).cell() != AIR) {
+                                continue;
+                            }
+                            Ref low = at(x + d[0], y - 1, z + d[1]);
+                            if (low.cell() == AIR) {
+                                move(index, x, y, z, low, x + d[0], y - 1, z + d[1]);
+                                slid = true;
+                            }
+                        }
+                        if (slid) {
+                            continue;
+                        }
+                    }
+                }
+                if (granular) {
+                    continue;
+                }
+
+                uint16_t load = 0;
+                if (canFall) {
+                    Ref below = at(x, y - 1, z);
+                    if (below.cell() != AIR) {
+                        load = support(below, true);
+                    } else {
+                        uint16_t best = support(at(x, y + 1, z), false);
+                        best = std::min(best, support(at(x + 1, y, z), false));
+                        best = std::min(best, support(at(x - 1, y, z), false));
+                        best = std::min(best, support(at(x, y, z + 1), false));
+                        best = std::min(best, support(at(x, y, z - 1), false));
+                        uint32_t carried = uint32_t(best) + (weight & WEIGHT_UNITS);
+                        load = best == LOAD_FALL || carried > mMaxLoad ? LOAD_FALL : uint16_t(carried);
+                    }
+                }
+                if (load != loads[index]) {
+                    loads[index] = load;
+                    sim.touched = true;
+                }
+            }
+        }
+    }
+    sim.hasDynamic = anyDynamic;
+}
+
+void CellularPhysics::writeBack(SimChunk &sim) {
+    Chunk &chunk = mMap.getOrCreateChunk(sim.key);
+    chunk.getMaterials().encode(sim.cells.data());
+    bool weighted = std::any_of(sim.weights.begin(), sim.weights.end(), [](uint32_t w) { return w != 0; });
+    if (weighted) {
+        chunk.getOrCreateAttributes(ATTR_WEIGHT).encode(sim.weights.data());
+    } else {
+        chunk.clearAttribute(ATTR_WEIGHT);
+    }
+    chunk.compact();
+    mMap.markChunkChanged(sim.key);
+    sim.dirty = false;
+}
+
+} // namespace vox
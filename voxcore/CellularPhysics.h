@@ -0,0 +1,107 @@
+#ifndef CELLULARPHYSICS_H
+#define CELLULARPHYSICS_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+class ThreadPool;
+
+// ATTR_WEIGHT of a cell: 0 for cells that never move, otherwise the weight
+// in sixteenths (at least 1) with WEIGHT_GRANULAR set for loose material
+// such as sand.
+const uint32_t WEIGHT_GRANULAR = 0x80000000u;
+const uint32_t WEIGHT_UNITS = 0xFFFFu;
+
+uint32_t packWeight(float weight, bool granular);
+float unpackWeight(uint32_t packed);
+
+struct PhysicsSettings {
+    float maxLoad;      // weight an overhang may carry before it breaks off
+    int floor;          // nothing falls below this height
+    int quietTicks;     // ticks without a change before a chunk sleeps
+    ThreadPool *pool;   // null uses defaultThreadPool()
+
+    PhysicsSettings() : maxLoad(6.0f), floor(0), quietTicks(4), pool(nullptr) {}
+};
+
+struct PhysicsStats {
+    size_t activeChunks;
+    size_t mirroredChunks;
+    size_t moves;
+    size_t writtenChunks;
+    double seconds;
+
+    PhysicsStats() : activeChunks(0), mirroredChunks(0), moves(0), writtenChunks(0), seconds(0.0) {}
+};
+
+// One cell moving from one place to another during a step.
+struct CellMove {
+    Vec3i from;
+    Vec3i to;
+};
+
+// Falling sand and collapsing structures as a cellular automaton over the
+// cells with a weight. Each step:
+//   - a granular cell falls into air below it, or else slides diagonally
+//     down when both the side and the cell under it are free;
+//   - any other weighted cell rests on what is below it. With air below it
+//     hangs from its side and upper neighbours and carries the weight of
+//     the path back to something resting: the load of its best neighbour
+//     plus its own. Past maxLoad it breaks off and falls. Loads settle over
+//     a few steps, so unsupported parts give way progressively.
+//
+// Only chunks that changed recently are stepped; the rest sleep until an
+// edit or a neighbour wakes them. Active chunks and their neighbours are
+// kept decoded. Chunks are stepped in 8 phases by the parity of their
+// coordinates; no two chunks of a phase touch each other or a common cell,
+// so each phase runs in parallel without locks and the result does not
+// depend on the thread count.
+//
+// Changed chunks are written back to the map at the end of each step, which
+// records them in its change log for meshers; renderers that track cells
+// one by one can take the individual moves instead.
+class CellularPhysics {
+public:
+    explicit CellularPhysics(VoxelMap &map, const PhysicsSettings &settings = PhysicsSettings());
+    ~CellularPhysics();
+
+    // Wakes the chunks edited since the last step, then advances every
+    // active chunk by one tick.
+    void step(PhysicsStats *stats = nullptr);
+
+    // Wakes every chunk with weighted cells, for a map that was just loaded.
+    void wakeAll();
+    void wake(const Vec3i &chunk);
+
+    // Moves since the last call, in the order they were made.
+    void takeMoves(std::vector<CellMove> &out);
+
+    size_t getActiveChunkCount() const;
+    uint64_t getTick() const;
+
+private:
+    struct SimChunk;
+    typedef std::unordered_map<Vec3i, std::unique_ptr<SimChunk>, Vec3iHash> SimTable;
+
+    SimChunk &mirror(const Vec3i &chunk);
+    void reload(SimChunk &sim);
+    void tick(SimChunk &sim);
+    void writeBack(SimChunk &sim);
+
+    VoxelMap &mMap;
+    PhysicsSettings mSettings;
+    uint16_t mMaxLoad;
+    ChangeTracker::Subscriber mSubscriber;
+    SimTable mChunks;
+    std::vector<CellMove> mMoves;
+    uint64_t mTick;
+};
+
+} // namespace vox
+
+#endif // CELLULARPHYSICS_H
@@ -0,0 +1,109 @@
+#include "ChangeTracker.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace vox {
+
+ChangeTracker::ChangeTracker()
+    : mLastVersion(0) {}
+
+ChangeTracker::Subscriber ChangeTracker::subscribe(unsigned flags) {
+    Cursor cursor = {true, flags, mLastVersion};
+    for (size_t i = 0; i < mSubscribers.size(); ++i) {
+        if (!mSubscribers[i].active) {
+            mSubscribers[i] = cursor;
+            return Subscriber(i);
+        }
+    }
+    mSubscribers.push_back(cursor);
+    return Subscriber(mSubscribers.size() - 1);
+}
+
+void ChangeTracker::unsubscribe(Subscriber subscriber) {
+    if (subscriber >= 0 && size_t(subscriber) < mSubscribers.size()) {
+        mSubscribers[subscriber].active = false;
+        trim();
+    }
+}
+
+bool ChangeTracker::hasSubscribers() const {
+    for (const Cursor &cursor : mSubscribers) {
+        if (cursor.active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChangeTracker::record(const Vec3i &chunk, unsigned flags, uint64_t version) {
+    mLastVersion = std::max(mLastVersion, version);
+    if (!hasSubscribers()) {
+        return;
+    }
+    // Strokes of edits usually hit the same chunk over and over.
+    if (!mLog.empty() && mLog.back().chunk == chunk && mLog.back().flags == flags) {
+        mLog.back().version = version;
+        return;
+    }
+    Record entry = {version, chunk, flags};
+    mLog.push_back(entry);
+}
+
+void ChangeTracker::poll(Subscriber subscriber, std::vector<ChunkChange> &out) {
+    out.clear();
+    Cursor &cursor = mSubscribers[subscriber];
+    std::unordered_map<Vec3i, size_t, Vec3iHash> seen;
+    auto it = std::upper_bound(mLog.begin(), mLog.end(), cursor.seen,
+                               [](uint64_t version, const Record &entry) { return version < entry.version; });
+    for (; it != mLog.end(); ++it) {
+        unsigned flags = it->flags & cursor.flags;
+        if (!flags) {
+            continue;
+        }
+        auto found = seen.find(it->chunk);
+        if (found == seen.end()) {
+            seen.emplace(it->chunk, out.size());
+            ChunkChange change = {it->chunk, flags};
+            out.push_back(change);
+        } else {
+            ChunkChange &change = out[found->second];
+            // A later edit brings a removed chunk back.
+            if ((flags & CHANGE_CONTENT) && !(flags & CHANGE_REMOVED)) {
+                change.flags &= ~unsigned(CHANGE_REMOVED);
+            }
+            change.flags |= flags;
+        }
+    }
+    cursor.seen = mLastVersion;
+    trim();
+}
+
+bool ChangeTracker::hasChanges(Subscriber subscriber) const {
+    const Cursor &cursor = mSubscribers[subscriber];
+    for (auto it = mLog.rbegin(); it != mLog.rend() && it->version > cursor.seen; ++it) {
+        if (it->flags & cursor.flags) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChangeTracker::skip(Subscriber subscriber) {
+    mSubscribers[subscriber].seen = mLastVersion;
+    trim();
+}
+
+void ChangeTracker::trim() {
+    uint64_t oldest = mLastVersion;
+    for (const Cursor &cursor : mSubscribers) {
+        if (cursor.active) {
+            oldest = std::min(oldest, cursor.seen);
+        }
+    }
+    while (!mLog.empty() && mLog.front().version <= oldest) {
+        mLog.pop_front();
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,69 @@
+#ifndef CHANGETRACKER_H
+#define CHANGETRACKER_H
+
+#include <deque>
+#include <vector>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+enum ChangeFlags {
+    CHANGE_CONTENT = 1,     // cells of the chunk itself changed
+    CHANGE_NEIGHBOUR = 2,   // a cell the chunk's mesh or light reads changed
+    CHANGE_REMOVED = 4,     // the chunk no longer exists
+    CHANGE_ALL = 7
+};
+
+struct ChunkChange {
+    Vec3i chunk;
+    unsigned flags;
+};
+
+// Log of chunk changes in edit order. Each consumer (mesher, lighting,
+// navigation, save...) subscribes once and then polls for the chunks that
+// changed since its last poll, so the work it does is proportional to the
+// edits rather than to the map. Entries every subscriber has seen are dropped.
+class ChangeTracker {
+public:
+    typedef int Subscriber;
+
+    ChangeTracker();
+
+    Subscriber subscribe(unsigned flags = CHANGE_ALL);
+    void unsubscribe(Subscriber subscriber);
+    bool hasSubscribers() const;
+
+    void record(const Vec3i &chunk, unsigned flags, uint64_t version);
+
+    // Chunks changed since the previous poll, each listed once with the union
+    // of its flags. Advances the subscriber.
+    void poll(Subscriber subscriber, std::vector<ChunkChange> &out);
+    bool hasChanges(Subscriber subscriber) const;
+
+    // Marks everything recorded so far as seen without reporting it.
+    void skip(Subscriber subscriber);
+
+private:
+    struct Record {
+        uint64_t version;
+        Vec3i chunk;
+        unsigned flags;
+    };
+
+    struct Cursor {
+        bool active;
+        unsigned flags;
+        uint64_t seen;
+    };
+
+    void trim();
+
+    std::deque<Record> mLog;
+    std::vector<Cursor> mSubscribers;
+    uint64_t mLastVersion;
+};
+
+} // namespace vox
+
+#endif // CHANGETRACKER_H
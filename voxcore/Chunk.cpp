@@ -0,0 +1,170 @@
+#include "Chunk.h"
+
+#include "Serialization.h"
+
+namespace vox {
+
+Chunk::Chunk()
+    : mVersion(0), mMaterials(AIR) {}
+
+Chunk::Chunk(const Chunk &other)
+    : mVersion(other.mVersion), mMaterials(other.mMaterials) {
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (other.mAttributes[c]) {
+            mAttributes[c].reset(new PaletteStorage(*other.mAttributes[c]));
+        }
+    }
+}
+
+Chunk &Chunk::operator=(const Chunk &other) {
+    if (this != &other) {
+        mVersion = other.mVersion;
+        mMaterials = other.mMaterials;
+        for (int c = 0; c < ATTR_COUNT; ++c) {
+            mAttributes[c].reset(other.mAttributes[c] ? new PaletteStorage(*other.mAttributes[c]) : nullptr);
+        }
+    }
+    return *this;
+}
+
+MaterialId Chunk::getMaterial(int index) const {
+    return MaterialId(mMaterials.get(index));
+}
+
+MaterialId Chunk::getMaterial(int lx, int ly, int lz) const {
+    return getMaterial(cellIndex(lx, ly, lz));
+}
+
+bool Chunk::setMaterial(int index, MaterialId material) {
+    return mMaterials.set(index, material);
+}
+
+bool Chunk::setMaterial(int lx, int ly, int lz, MaterialId material) {
+    return setMaterial(cellIndex(lx, ly, lz), material);
+}
+
+uint32_t Chunk::getAttribute(AttributeChannel channel, int index) const {
+    return mAttributes[channel] ? mAttributes[channel]->get(index) : 0;
+}
+
+bool Chunk::setAttribute(AttributeChannel channel, int index, uint32_t value) {
+    if (!mAttributes[channel]) {
+        if (value == 0) {
+            return false;
+        }
+        mAttributes[channel].reset(new PaletteStorage(0));
+    }
+    return mAttributes[channel]->set(index, value);
+}
+
+bool Chunk::hasAttribute(AttributeChannel channel) const {
+    return mAttributes[channel] != nullptr;
+}
+
+bool Chunk::hasAttributes() const {
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (mAttributes[c]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Chunk::clearAttribute(AttributeChannel channel) {
+    mAttributes[channel].reset();
+}
+
+const PaletteStorage &Chunk::getMaterials() const {
+    return mMaterials;
+}
+
+PaletteStorage &Chunk::getMaterials() {
+    return mMaterials;
+}
+
+const PaletteStorage *Chunk::getAttributes(AttributeChannel channel) const {
+    return mAttributes[channel].get();
+}
+
+PaletteStorage &Chunk::getOrCreateAttributes(AttributeChannel channel) {
+    if (!mAttributes[channel]) {
+        mAttributes[channel].reset(new PaletteStorage(0));
+    }
+    return *mAttributes[channel];
+}
+
+uint64_t Chunk::getVersion() const {
+    return mVersion;
+}
+
+void Chunk::setVersion(uint64_t version) {
+    mVersion = version;
+}
+
+bool Chunk::isEmpty() const {
+    return mMaterials.isUniform() && mMaterials.get(0) == AIR;
+}
+
+void Chunk::compact() {
+    mMaterials.compact();
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (!mAttributes[c]) {
+            continue;
+        }
+        mAttributes[c]->compact();
+        // A channel that went back to all zeroes is dropped entirely.
+        if (mAttributes[c]->isUniform() && mAttributes[c]->get(0) == 0) {
+            mAttributes[c].reset();
+        }
+    }
+}
+
+void Chunk::write(ByteWriter &out) const {
+    uint8_t present = 0;
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (mAttributes[c]) {
+            present |= uint8_t(1 << c);
+        }
+    }
+    out.putU8(present);
+    mMaterials.write(out);
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (mAttributes[c]) {
+            mAttributes[c]->write(out);
+        }
+    }
+}
+
+bool Chunk::read(ByteReader &in) {
+    uint8_t present = in.getU8();
+    PaletteStorage materials;
+    if (!in.ok() || !materials.read(in)) {
+        return false;
+    }
+    std::unique_ptr<PaletteStorage> attributes[ATTR_COUNT];
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (present & (1 << c)) {
+            attributes[c].reset(new PaletteStorage(0));
+            if (!attributes[c]->read(in)) {
+                return false;
+            }
+        }
+    }
+    mMaterials = materials;
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        mAttributes[c] = std::move(attributes[c]);
+    }
+    return true;
+}
+
+size_t Chunk::memoryUsage() const {
+    size_t bytes = sizeof(*this) + mMaterials.memoryUsage() - sizeof(mMaterials);
+    for (int c = 0; c < ATTR_COUNT; ++c) {
+        if (mAttributes[c]) {
+            bytes += mAttributes[c]->memoryUsage();
+        }
+    }
+    return bytes;
+}
+
+} // namespace vox
@@ -0,0 +1,54 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <memory>
+
+#include "PaletteStorage.h"
+
+namespace vox {
+
+// A CHUNK_SIZE^3 block of voxels. The material is always stored, attribute
+// channels are only allocated once a cell gets a non-zero value.
+class Chunk {
+public:
+    Chunk();
+    Chunk(const Chunk &other);
+    Chunk &operator=(const Chunk &other);
+
+    MaterialId getMaterial(int index) const;
+    MaterialId getMaterial(int lx, int ly, int lz) const;
+    // Setters return false when nothing changed.
+    bool setMaterial(int index, MaterialId material);
+    bool setMaterial(int lx, int ly, int lz, MaterialId material);
+
+    uint32_t getAttribute(AttributeChannel channel, int index) const;
+    bool setAttribute(AttributeChannel channel, int index, uint32_t value);
+    bool hasAttribute(AttributeChannel channel) const;
+    bool hasAttributes() const;
+    void clearAttribute(AttributeChannel channel);
+
+    const PaletteStorage &getMaterials() const;
+    PaletteStorage &getMaterials();
+    const PaletteStorage *getAttributes(AttributeChannel channel) const;
+    PaletteStorage &getOrCreateAttributes(AttributeChannel channel);
+
+    // Stamped by VoxelMap from its edit counter on every change.
+    uint64_t getVersion() const;
+    void setVersion(uint64_t version);
+
+    bool isEmpty() const;
+    void compact();
+
+    void write(ByteWriter &out) const;
+    bool read(ByteReader &in);
+    size_t memoryUsage() const;
+
+private:
+    uint64_t mVersion;
+    PaletteStorage mMaterials;
+    std::unique_ptr<PaletteStorage> mAttributes[ATTR_COUNT];
+};
+
+} // namespace vox
+
+#endif // CHUNK_H
@@ -0,0 +1,220 @@
+#include "ChunkMesher.h"
+
+#include <cmath>
+
+#include "VoxelLighting.h"
+
+namespace vox {
+
+namespace {
+
+const int CORNERS[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+const float AO_FACTOR[4] = {0.45f, 0.65f, 0.82f, 1.0f};
+
+const uint64_t INTERIOR_BITS = ((uint64_t(1) << CHUNK_SIZE) - 1) << 1;
+
+struct LightTable {
+    float factor[MAX_LIGHT + 1];
+
+    LightTable() {
+        for (int l = 0; l <= MAX_LIGHT; ++l) {
+            factor[l] = 0.08f + 0.92f * std::pow(0.8f, float(MAX_LIGHT - l));
+        }
+    }
+};
+
+const LightTable LIGHT_TABLE;
+
+inline int ctz64(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    int n = 0;
+    while (!(v & 1)) {
+        v >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+} // namespace
+
+const FaceAxes FACE_AXES[FACE_COUNT] = {
+    {0, 1, 1, 2}, {0, -1, 2, 1},
+    {1, 1, 2, 0}, {1, -1, 0, 2},
+    {2, 1, 0, 1}, {2, -1, 1, 0}
+};
+
+void gatherPadded(const VoxelMap &map, const Vec3i &chunk, std::vector<MaterialId> &cells,
+                  std::vector<uint32_t> &scratch) {
+    const int PADDED = PADDED_SIZE;
+    cells.resize(PADDED * PADDED * PADDED);
+    scratch.resize(CHUNK_VOLUME);
+
+    const Chunk *neighbours[27];
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                neighbours[(dx + 1) + 3 * ((dy + 1) + 3 * (dz + 1))] = map.findChunk(chunk + Vec3i(dx, dy, dz));
+            }
+        }
+    }
+
+    neighbours[13]->getMaterials().decode(scratch.data());
+    for (int z = 0; z < CHUNK_SIZE; ++z) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            MaterialId *row = &cells[1 + PADDED * ((y + 1) + PADDED * (z + 1))];
+            const uint32_t *src = &scratch[cellIndex(0, y, z)];
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                row[x] = MaterialId(src[x]);
+            }
+        }
+    }
+
+    // One layer of border cells from the 26 neighbours.
+    for (int z = -1; z <= CHUNK_SIZE; ++z) {
+        for (int y = -1; y <= CHUNK_SIZE; ++y) {
+            bool innerRow = z >= 0 && z < CHUNK_SIZE && y >= 0 && y < CHUNK_SIZE;
+            for (int x = -1; x <= CHUNK_SIZE; x += (innerRow && x == -1) ? CHUNK_SIZE + 1 : 1) {
+                int dx = x < 0 ? 0 : (x >= CHUNK_SIZE ? 2 : 1);
+                int dy = y < 0 ? 0 : (y >= CHUNK_SIZE ? 2 : 1);
+                int dz = z < 0 ? 0 : (z >= CHUNK_SIZE ? 2 : 1);
+                const Chunk *source = neighbours[dx + 3 * (dy + 3 * dz)];
+                cells[(x + 1) + PADDED * ((y + 1) + PADDED * (z + 1))] =
+                    source ? source->getMaterial(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK) : AIR;
+            }
+        }
+    }
+}
+
+ChunkMesher::ChunkMesher(const VoxelMap &map)
+    : mMap(map),
+      mLighting(nullptr),
+      mAmbientOcclusion(true),
+      mCells(PADDED * PADDED * PADDED, AIR),
+      mDecoded(CHUNK_VOLUME) {}
+
+void ChunkMesher::setLighting(const VoxelLighting *lighting) {
+    mLighting = lighting;
+}
+
+void ChunkMesher::setAmbientOcclusion(bool enabled) {
+    mAmbientOcclusion = enabled;
+}
+
+void ChunkMesher::mesh(const Vec3i &chunk, ChunkMesh &out) {
+    out.clear();
+    out.chunk = chunk;
+    const Chunk *center = mMap.findChunk(chunk);
+    if (!center || center->isEmpty()) {
+        return;
+    }
+    mBase = Vec3i(chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, chunk.z * CHUNK_SIZE);
+    gatherPadded(mMap, chunk, mCells, mDecoded);
+
+    mSolid.reset(Vec3i(mBase.x - 1, mBase.y - 1, mBase.z - 1), Vec3i(PADDED, PADDED, PADDED));
+    for (int z = 0; z < PADDED; ++z) {
+        for (int x = 0; x < PADDED; ++x) {
+            uint64_t bits = 0;
+            for (int y = 0; y < PADDED; ++y) {
+                bits |= uint64_t(mCells[x + PADDED * (y + PADDED * z)] != AIR) << y;
+            }
+            mSolid.getColumn(x, z)[0] = bits;
+        }
+    }
+
+    for (int f = 0; f < FACE_COUNT; ++f) {
+        mSolid.extractFaces(Face(f), mFaces);
+        for (int z = 1; z <= CHUNK_SIZE; ++z) {
+            for (int x = 1; x <= CHUNK_SIZE; ++x) {
+                uint64_t bits = mFaces.getColumn(x, z)[0] & INTERIOR_BITS;
+                while (bits) {
+                    int y = ctz64(bits);
+                    bits &= bits - 1;
+                    emitFace(Face(f), x - 1, y - 1, z - 1, out);
+                }
+            }
+        }
+    }
+}
+
+MaterialId ChunkMesher::cell(int x, int y, int z) const {
+    return mCells[(x + 1) + PADDED * ((y + 1) + PADDED * (z + 1))];
+}
+
+bool ChunkMesher::solid(int x, int y, int z) const {
+    return cell(x, y, z) != AIR;
+}
+
+void ChunkMesher::emitFace(Face face, int x, int y, int z, ChunkMesh &out) {
+    const FaceAxes &axes = FACE_AXES[face];
+    int p[3] = {x, y, z};
+    int front[3] = {x, y, z};
+    front[axes.axis] += axes.dir;
+
+    const Material &material = mMap.getMaterials().get(cell(x, y, z));
+    int level = MAX_LIGHT;
+    if (mLighting) {
+        level = mLighting->getLevel(mBase.x + front[0], mBase.y + front[1], mBase.z + front[2]);
+    }
+    float light = LIGHT_TABLE.factor[level];
+
+    int ao[4];
+    uint32_t first = uint32_t(out.vertices.size());
+    for (int k = 0; k < 4; ++k) {
+        int su = CORNERS[k][0] ? 1 : -1;
+        int sv = CORNERS[k][1] ? 1 : -1;
+        ao[k] = 3;
+        if (mAmbientOcclusion) {
+            int a[3] = {front[0], front[1], front[2]};
+            int b[3] = {front[0], front[1], front[2]};
+            a[axes.u] += su;
+            b[axes.v] += sv;
+            int c[3] = {a[0], a[1], a[2]};
+            c[axes.v] += sv;
+            bool side1 = solid(a[0], a[1], a[2]);
+            bool side2 = solid(b[0], b[1], b[2]);
+            bool corner = solid(c[0], c[1], c[2]);
+            ao[k] = (side1 && side2) ? 0 : 3 - (int(side1) + int(side2) + int(corner));
+        }
+
+        float position[3];
+        position[axes.axis] = p[axes.axis] + 0.5f * axes.dir;
+        position[axes.u] = p[axes.u] + (CORNERS[k][0] ? 0.5f : -0.5f);
+        position[axes.v] = p[axes.v] + (CORNERS[k][1] ? 0.5f : -0.5f);
+
+        float normal[3] = {0.0f, 0.0f, 0.0f};
+        normal[axes.axis] = float(axes.dir);
+
+        float shade = light * AO_FACTOR[ao[k]];
+        MeshVertex vertex;
+        vertex.x = mBase.x + position[0];
+        vertex.y = mBase.y + position[1];
+        vertex.z = mBase.z + position[2];
+        vertex.nx = normal[0];
+        vertex.ny = normal[1];
+        vertex.nz = normal[2];
+        vertex.r = uint8_t(((material.color >> 16) & 0xFF) * shade);
+        vertex.g = uint8_t(((material.color >> 8) & 0xFF) * shade);
+        vertex.b = uint8_t((material.color & 0xFF) * shade);
+        vertex.a = uint8_t(material.color >> 24);
+        out.vertices.push_back(vertex);
+    }
+
+    // Split along the brighter diagonal so occlusion interpolates evenly.
+    if (ao[0] + ao[2] >= ao[1] + ao[3]) {
+        const uint32_t quad[6] = {0, 1, 2, 0, 2, 3};
+        for (uint32_t i : quad) {
+            out.indices.push_back(first + i);
+        }
+    } else {
+        const uint32_t quad[6] = {1, 2, 3, 1, 3, 0};
+        for (uint32_t i : quad) {
+            out.indices.push_back(first + i);
+        }
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,87 @@
+#ifndef CHUNKMESHER_H
+#define CHUNKMESHER_H
+
+#include <vector>
+
+#include "OccupancyMask.h"
+#include "VoxelMap.h"
+
+namespace vox {
+
+class VoxelLighting;
+
+// The axis a face points along, its sign and the two in-plane axes. u x v
+// points along the normal, so corners (0,0) (1,0) (1,1) (0,1) wind
+// counter-clockwise seen from outside.
+struct FaceAxes {
+    int axis;
+    int dir;
+    int u;
+    int v;
+};
+
+extern const FaceAxes FACE_AXES[FACE_COUNT];
+
+// A chunk plus one layer of cells from its 26 neighbours.
+const int PADDED_SIZE = CHUNK_SIZE + 2;
+
+// Fills cells (PADDED_SIZE^3, x fastest, chunk cell (0,0,0) at (1,1,1)) with
+// the materials around chunk. The chunk must exist; scratch is reused
+// between calls.
+void gatherPadded(const VoxelMap &map, const Vec3i &chunk, std::vector<MaterialId> &cells,
+                  std::vector<uint32_t> &scratch);
+
+// Voxel (x, y, z) covers [x - 0.5, x + 0.5] on each axis, like the cubes the
+// editors draw. Colours are material colour * ambient occlusion * light,
+// ready to be drawn with lighting disabled.
+struct MeshVertex {
+    float x, y, z;
+    float nx, ny, nz;
+    uint8_t r, g, b, a;
+};
+
+struct ChunkMesh {
+    Vec3i chunk;
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    void clear() {
+        vertices.clear();
+        indices.clear();
+    }
+
+    bool empty() const { return indices.empty(); }
+};
+
+// Builds one mesh per chunk with a quad for every solid face next to air.
+// Reuse one mesher per thread, it keeps its scratch buffers between calls.
+class ChunkMesher {
+public:
+    explicit ChunkMesher(const VoxelMap &map);
+
+    // Without lighting every face is shaded as if in full daylight.
+    void setLighting(const VoxelLighting *lighting);
+    void setAmbientOcclusion(bool enabled);
+
+    void mesh(const Vec3i &chunk, ChunkMesh &out);
+
+private:
+    static const int PADDED = PADDED_SIZE;
+
+    MaterialId cell(int x, int y, int z) const;
+    bool solid(int x, int y, int z) const;
+    void emitFace(Face face, int x, int y, int z, ChunkMesh &out);
+
+    const VoxelMap &mMap;
+    const VoxelLighting *mLighting;
+    bool mAmbientOcclusion;
+    Vec3i mBase;
+    std::vector<MaterialId> mCells; // PADDED^3, one cell of border
+    std::vector<uint32_t> mDecoded;
+    OccupancyMask mSolid;
+    OccupancyMask mFaces;
+};
+
+} // namespace vox
+
+#endif // CHUNKMESHER_H
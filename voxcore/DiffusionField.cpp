@@ -0,0 +1,412 @@
+#include "DiffusionField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "DiffusionKernels.h"
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+// Faces in the order -x, +x, -y, +y, -z, +z.
+const int FACE_COUNT = 6;
+const Vec3i FACE_OFFSETS[FACE_COUNT] = {Vec3i(-1, 0, 0), Vec3i(1, 0, 0), Vec3i(0, -1, 0),
+                                        Vec3i(0, 1, 0),  Vec3i(0, 0, -1), Vec3i(0, 0, 1)};
+
+// Stays below 1/6 so a cell never gives away more than it holds.
+const float MAX_RATE = 0.16f;
+
+const float ZERO_ROW[CHUNK_SIZE] = {};
+
+inline int floorInt(float v) {
+    int i = int(v);
+    return float(i) > v ? i - 1 : i;
+}
+
+// Local cell on face f of a chunk, for the two in-face coordinates a, b.
+inline int faceCell(int f, int a, int b) {
+    const int edge = (f & 1) ? CHUNK_MASK : 0;
+    switch (f >> 1) {
+    case 0:
+        return cellIndex(edge, a, b);
+    case 1:
+        return cellIndex(a, edge, b);
+    default:
+        return cellIndex(a, b, edge);
+    }
+}
+
+} // namespace
+
+uint32_t packAffector(float value) {
+    uint32_t packed;
+    std::memcpy(&packed, &value, sizeof(packed));
+    // -0 is no affector too.
+    return value == 0.0f ? 0u : packed;
+}
+
+float unpackAffector(uint32_t packed) {
+    float value;
+    std::memcpy(&value, &packed, sizeof(value));
+    return value;
+}
+
+struct DiffusionField::FieldChunk {
+    Vec3i key;
+    std::vector<float> values;
+    std::vector<float> next;     // only while awake
+    std::vector<float> keep;     // 0 for walls
+    std::vector<float> source;   // empty without affectors
+    const FieldChunk *faces[FACE_COUNT];   // set before each tick
+    float change;
+    int quiet;
+    bool active;
+    bool wakeNext;
+
+    explicit FieldChunk(const Vec3i &key)
+        : key(key), values(CHUNK_VOLUME, 0.0f), keep(CHUNK_VOLUME), change(0.0f), quiet(0), active(false),
+          wakeNext(false) {
+        std::fill(faces, faces + FACE_COUNT, nullptr);
+    }
+};
+
+DiffusionField::DiffusionField(VoxelMap &map, const DiffusionSettings &settings)
+    : mMap(map), mSettings(settings), mTick(0) {
+    mSettings.rate = std::min(std::max(mSettings.rate, 0.0f), MAX_RATE);
+    mSettings.decay = std::min(std::max(mSettings.decay, 0.0f), 1.0f);
+    mSubscriber = mMap.getChanges().subscribe(CHANGE_ALL);
+    wakeAll();
+}
+
+DiffusionField::~DiffusionField() {
+    mMap.getChanges().unsubscribe(mSubscriber);
+}
+
+DiffusionField::FieldChunk &DiffusionField::field(const Vec3i &chunk) {
+    std::unique_ptr<FieldChunk> &slot = mChunks[chunk];
+    if (!slot) {
+        slot.reset(new FieldChunk(chunk));
+        reload(*slot);
+    }
+    return *slot;
+}
+
+const DiffusionField::FieldChunk *DiffusionField::findField(const Vec3i &chunk) const {
+    auto it = mChunks.find(chunk);
+    return it != mChunks.end() ? it->second.get() : nullptr;
+}
+
+void DiffusionField::reload(FieldChunk &chunk) {
+    const VoxelMap &map = mMap;
+    const AttributeChannel channel = mSettings.channel;
+    std::vector<uint8_t> open(CHUNK_VOLUME, 1);
+    const Chunk *own = map.findChunk(chunk.key);
+    chunk.source.clear();
+    if (own) {
+        std::vector<uint32_t> cells(CHUNK_VOLUME);
+        own->getMaterials().decode(cells.data());
+        const PaletteStorage *affectors = own->getAttributes(channel);
+        std::vector<uint32_t> packed;
+        if (affectors) {
+            packed.resize(CHUNK_VOLUME);
+            affectors->decode(packed.data());
+        }
+        for (int i = 0; i < CHUNK_VOLUME; ++i) {
+            uint32_t affector = affectors ? packed[i] : 0;
+            open[i] = cells[i] == AIR || affector;
+            if (affector) {
+                if (chunk.source.empty()) {
+                    chunk.source.assign(CHUNK_VOLUME, 0.0f);
+                }
+                chunk.source[i] = unpackAffector(affector);
+            }
+        }
+    }
+
+    // Open cells just across each face, from the neighbouring map chunks.
+    std::vector<uint8_t> across(FACE_COUNT * CHUNK_SIZE * CHUNK_SIZE, 1);
+    for (int f = 0; f < FACE_COUNT; ++f) {
+        const Chunk *neighbour = map.findChunk(chunk.key + FACE_OFFSETS[f]);
+        if (!neighbour) {
+            continue;
+        }
+        uint8_t *face = &across[f * CHUNK_SIZE * CHUNK_SIZE];
+        for (int b = 0; b < CHUNK_SIZE; ++b) {
+            for (int a = 0; a < CHUNK_SIZE; ++a) {
+                int index = faceCell(f ^ 1, a, b);
+                face[a + b * CHUNK_SIZE] =
+                    neighbour->getMaterial(index) == AIR || neighbour->getAttribute(channel, index);
+            }
+        }
+    }
+    auto isOpen = [&](int x, int y, int z) -> int {
+        if (x < 0 || x > CHUNK_MASK) {
+            return across[(x < 0 ? 0 : 1) * CHUNK_SIZE * CHUNK_SIZE + y + z * CHUNK_SIZE];
+        }
+        if (y < 0 || y > CHUNK_MASK) {
+            return across[(y < 0 ? 2 : 3) * CHUNK_SIZE * CHUNK_SIZE + x + z * CHUNK_SIZE];
+        }
+        if (z < 0 || z > CHUNK_MASK) {
+            return across[(z < 0 ? 4 : 5) * CHUNK_SIZE * CHUNK_SIZE + x + y * CHUNK_SIZE];
+        }
+        return open[cellIndex(x, y, z)];
+    };
+
+    const float rate = mSettings.rate;
+    const float decay = mSettings.decay;
+    for (int z = 0; z < CHUNK_SIZE; ++z) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const int index = cellIndex(x, y, z);
+                if (!open[index]) {
+                    chunk.keep[index] = 0.0f;
+                    chunk.values[index] = 0.0f;
+                    continue;
+                }
+                int neighbours = isOpen(x - 1, y, z) + isOpen(x + 1, y, z) + isOpen(x, y - 1, z)
+                                 + isOpen(x, y + 1, z) + isOpen(x, y, z - 1) + isOpen(x, y, z + 1);
+                // Never exactly 0, which marks walls.
+                chunk.keep[index] = std::max(decay * (1.0f - rate * float(neighbours)), 1e-30f);
+            }
+        }
+    }
+}
+
+void DiffusionField::wakeAll() {
+    for (const auto &entry : mMap.getChunks()) {
+        if (entry.second->hasAttribute(mSettings.channel)) {
+            FieldChunk &chunk = field(entry.first);
+            chunk.active = true;
+            chunk.quiet = 0;
+        }
+    }
+}
+
+void DiffusionField::wake(const Vec3i &minChunk, const Vec3i &maxChunk) {
+    for (int z = minChunk.z; z <= maxChunk.z; ++z) {
+        for (int y = minChunk.y; y <= maxChunk.y; ++y) {
+            for (int x = minChunk.x; x <= maxChunk.x; ++x) {
+                FieldChunk &chunk = field(Vec3i(x, y, z));
+                chunk.active = true;
+                chunk.quiet = 0;
+            }
+        }
+    }
+}
+
+void DiffusionField::clear() {
+    mChunks.clear();
+    mMap.getChanges().skip(mSubscriber);
+}
+
+float DiffusionField::advance(FieldChunk &chunk) {
+    const float gain = mSettings.decay * mSettings.rate;
+    const float *values = chunk.values.data();
+    const float *source = chunk.source.empty() ? nullptr : chunk.source.data();
+    float row[CHUNK_SIZE + 2];
+    float change = 0.0f;
+    for (int z = 0; z < CHUNK_SIZE; ++z) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            const int index = cellIndex(0, y, z);
+            const float *centre = values + index;
+            // Cells outside the field read as 0.
+            const FieldChunk *const *faces = chunk.faces;
+            std::memcpy(row + 1, centre, sizeof(float) * CHUNK_SIZE);
+            row[0] = faces[0] ? faces[0]->values[cellIndex(CHUNK_MASK, y, z)] : 0.0f;
+            row[CHUNK_SIZE + 1] = faces[1] ? faces[1]->values[cellIndex(0, y, z)] : 0.0f;
+            const float *down = y > 0 ? centre - CHUNK_SIZE
+                                : faces[2] ? &faces[2]->values[cellIndex(0, CHUNK_MASK, z)] : ZERO_ROW;
+            const float *up = y < CHUNK_MASK ? centre + CHUNK_SIZE
+                              : faces[3] ? &faces[3]->values[cellIndex(0, 0, z)] : ZERO_ROW;
+            const float *back = z > 0 ? centre - CHUNK_SIZE * CHUNK_SIZE
+                                : faces[4] ? &faces[4]->values[cellIndex(0, y, CHUNK_MASK)] : ZERO_ROW;
+            const float *front = z < CHUNK_MASK ? centre + CHUNK_SIZE * CHUNK_SIZE
+                                 : faces[5] ? &faces[5]->values[cellIndex(0, y, 0)] : ZERO_ROW;
+            float rowChange = kernels::diffuseRow(row, down, up, back, front, &chunk.keep[index], gain,
+                                                  source ? source + index : nullptr, &chunk.next[index],
+                                                  CHUNK_SIZE);
+            change = std::max(change, rowChange);
+        }
+    }
+    return change;
+}
+
+void DiffusionField::step(DiffusionStats *stats) {
+    auto start = std::chrono::steady_clock::now();
+    ++mTick;
+
+    // Edits change walls and sources: rebuild the coefficients of the
+    // chunks they touch and let the field flow again.
+    std::vector<ChunkChange> changes;
+    mMap.getChanges().poll(mSubscriber, changes);
+    for (const ChunkChange &change : changes) {
+        auto it = mChunks.find(change.chunk);
+        FieldChunk *chunk = it != mChunks.end() ? it->second.get() : nullptr;
+        if (!chunk) {
+            const Chunk *edited = static_cast<const VoxelMap &>(mMap).findChunk(change.chunk);
+            if (!edited || !edited->hasAttribute(mSettings.channel)) {
+                continue;
+            }
+            chunk = &field(change.chunk);
+        } else {
+            reload(*chunk);
+        }
+        chunk->active = true;
+        chunk->quiet = 0;
+    }
+
+    std::vector<FieldChunk *> active;
+    for (const auto &entry : mChunks) {
+        FieldChunk *chunk = entry.second.get();
+        if (!chunk->active) {
+            continue;
+        }
+        for (int f = 0; f < FACE_COUNT; ++f) {
+            chunk->faces[f] = findField(chunk->key + FACE_OFFSETS[f]);
+        }
+        chunk->next.resize(CHUNK_VOLUME);
+        active.push_back(chunk);
+    }
+
+    ThreadPool &pool = mSettings.pool ? *mSettings.pool : defaultThreadPool();
+    pool.parallelFor(active.size(), [&](size_t i) { active[i]->change = advance(*active[i]); });
+
+    float largest = 0.0f;
+    std::vector<Vec3i> settled;
+    for (FieldChunk *chunk : active) {
+        chunk->values.swap(chunk->next);
+        largest = std::max(largest, chunk->change);
+        if (chunk->change <= mSettings.threshold) {
+            if (++chunk->quiet >= mSettings.quietTicks) {
+                chunk->active = false;
+                std::vector<float>().swap(chunk->next);
+                settled.push_back(chunk->key);
+            }
+            continue;
+        }
+        chunk->quiet = 0;
+        for (int f = 0; f < FACE_COUNT; ++f) {
+            const Vec3i key = chunk->key + FACE_OFFSETS[f];
+            auto it = mChunks.find(key);
+            if (it != mChunks.end()) {
+                it->second->wakeNext = true;
+                continue;
+            }
+            // Extend the field where enough has reached the face.
+            float edge = 0.0f;
+            for (int b = 0; b < CHUNK_SIZE; ++b) {
+                for (int a = 0; a < CHUNK_SIZE; ++a) {
+                    edge = std::max(edge, chunk->values[faceCell(f, a, b)]);
+                }
+            }
+            if (edge > mSettings.spread) {
+                field(key).wakeNext = true;
+            }
+        }
+    }
+
+    for (auto &entry : mChunks) {
+        FieldChunk &chunk = *entry.second;
+        if (chunk.wakeNext) {
+            chunk.active = true;
+            chunk.quiet = 0;
+            chunk.wakeNext = false;
+        }
+    }
+    // Chunks that just settled holding next to nothing are not worth keeping.
+    for (const Vec3i &key : settled) {
+        auto it = mChunks.find(key);
+        const FieldChunk &chunk = *it->second;
+        if (!chunk.active && chunk.source.empty()
+            && *std::max_element(chunk.values.begin(), chunk.values.end()) <= mSettings.spread) {
+            mChunks.erase(it);
+        }
+    }
+
+    if (stats) {
+        stats->activeChunks = active.size();
+        stats->fieldChunks = mChunks.size();
+        stats->largestChange = largest;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+float DiffusionField::sample(int x, int y, int z) const {
+    const FieldChunk *chunk = findField(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    return chunk ? chunk->values[cellIndex(localCoord(x), localCoord(y), localCoord(z))] : 0.0f;
+}
+
+float DiffusionField::sample(float x, float y, float z) const {
+    const int x0 = floorInt(x), y0 = floorInt(y), z0 = floorInt(z);
+    const float tx = x - float(x0), ty = y - float(y0), tz = z - float(z0);
+    float result = 0.0f;
+    for (int k = 0; k < 8; ++k) {
+        const int dx = k & 1, dy = (k >> 1) & 1, dz = k >> 2;
+        const float w = (dx ? tx : 1.0f - tx) * (dy ? ty : 1.0f - ty) * (dz ? tz : 1.0f - tz);
+        if (w > 0.0f) {
+            result += w * sample(x0 + dx, y0 + dy, z0 + dz);
+        }
+    }
+    return result;
+}
+
+Vec3i DiffusionField::climb(const Vec3i &cell, bool up) const {
+    const VoxelMap &map = mMap;
+    Vec3i best = cell;
+    float bestValue = sample(cell.x, cell.y, cell.z);
+    for (int f = 0; f < FACE_COUNT; ++f) {
+        const Vec3i next = cell + FACE_OFFSETS[f];
+        // Walls read 0, which must not look like the way out of a threat.
+        if (map.getMaterial(next.x, next.y, next.z) != AIR
+            && !map.getAttribute(mSettings.channel, next.x, next.y, next.z)) {
+            continue;
+        }
+        const float value = sample(next.x, next.y, next.z);
+        if (up ? value > bestValue : value < bestValue) {
+            best = next;
+            bestValue = value;
+        }
+    }
+    return best;
+}
+
+Vec3i DiffusionField::uphill(const Vec3i &cell) const {
+    return climb(cell, true);
+}
+
+Vec3i DiffusionField::downhill(const Vec3i &cell) const {
+    return climb(cell, false);
+}
+
+size_t DiffusionField::getActiveChunkCount() const {
+    size_t count = 0;
+    for (const auto &entry : mChunks) {
+        count += entry.second->active;
+    }
+    return count;
+}
+
+size_t DiffusionField::getChunkCount() const {
+    return mChunks.size();
+}
+
+uint64_t DiffusionField::getTick() const {
+    return mTick;
+}
+
+size_t DiffusionField::memoryUsage() const {
+    size_t bytes = 0;
+    for (const auto &entry : mChunks) {
+        const FieldChunk &chunk = *entry.second;
+        bytes += sizeof(FieldChunk)
+                 + sizeof(float) * (chunk.values.capacity() + chunk.next.capacity() + chunk.keep.capacity()
+                                    + chunk.source.capacity());
+    }
+    return bytes;
+}
+
+} // namespace vox
@@ -0,0 +1,107 @@
+#ifndef DIFFUSIONFIELD_H
+#define DIFFUSIONFIELD_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+class ThreadPool;
+
+// ATTR_AFFECTOR holds the bits of a float: what a cell adds to the field
+// each tick, negative for cells that soak it up. 0 is no affector.
+uint32_t packAffector(float value);
+float unpackAffector(uint32_t packed);
+
+struct DiffusionSettings {
+    AttributeChannel channel;   // where sources are read from
+    float rate;         // share flowing to each open neighbour per tick, below 1/6
+    float decay;        // fraction kept each tick; sets how far values reach
+    float threshold;    // change per tick under which a chunk counts as settled
+    float spread;       // value at a chunk face that extends the field past it
+    int quietTicks;     // settled ticks before a chunk sleeps
+    ThreadPool *pool;   // null uses defaultThreadPool()
+
+    DiffusionSettings()
+        : channel(ATTR_AFFECTOR), rate(0.15f), decay(0.99f), threshold(1e-4f), spread(1e-3f), quietTicks(8),
+          pool(nullptr) {}
+};
+
+struct DiffusionStats {
+    size_t activeChunks;
+    size_t fieldChunks;
+    float largestChange;
+    double seconds;
+
+    DiffusionStats() : activeChunks(0), fieldChunks(0), largestChange(0.0f), seconds(0.0) {}
+};
+
+// A scalar field spreading through open space from the cells with an
+// affector, for AI that follows a scent or avoids threats. Several fields
+// can read the same sources with different settings, say a threat map that
+// reaches far and a scent that fades quickly.
+//
+// Each tick every open cell keeps part of its value, takes rate of each
+// open neighbour's and loses rate for each of them, times decay, plus its
+// own affector; air and cells with an affector are open, other solid cells
+// are walls. The update is a Jacobi step on a 7-point stencil: each chunk
+// reads only the last tick's values, so chunks run in parallel without
+// locks or phases and the result does not depend on the thread count.
+//
+// The field covers only chunks with sources and the chunks its values
+// reached (past spread at a face). A chunk that settled sleeps until an
+// edit nearby or a changing neighbour wakes it; a settled chunk holding
+// nothing is dropped.
+class DiffusionField {
+public:
+    explicit DiffusionField(VoxelMap &map, const DiffusionSettings &settings = DiffusionSettings());
+    ~DiffusionField();
+
+    // Picks up edits since the last step, then advances the awake chunks.
+    void step(DiffusionStats *stats = nullptr);
+
+    // Wakes every chunk with sources, for a map that was just loaded.
+    void wakeAll();
+    // Adds and wakes every chunk in [minChunk, maxChunk].
+    void wake(const Vec3i &minChunk, const Vec3i &maxChunk);
+    void clear();
+
+    // World voxel coordinates; 0 outside the field.
+    float sample(int x, int y, int z) const;
+    // Trilinear between cell centres; voxel (x, y, z) is centred on
+    // (x, y, z) like in VoxelCollider.
+    float sample(float x, float y, float z) const;
+    // The face neighbour of cell with the highest (uphill) or lowest
+    // (downhill) value, or cell itself when none beats it: one step towards
+    // a scent or away from a threat.
+    Vec3i uphill(const Vec3i &cell) const;
+    Vec3i downhill(const Vec3i &cell) const;
+
+    size_t getActiveChunkCount() const;
+    size_t getChunkCount() const;
+    uint64_t getTick() const;
+    size_t memoryUsage() const;
+
+private:
+    struct FieldChunk;
+    typedef std::unordered_map<Vec3i, std::unique_ptr<FieldChunk>, Vec3iHash> FieldTable;
+
+    FieldChunk &field(const Vec3i &chunk);
+    const FieldChunk *findField(const Vec3i &chunk) const;
+    void reload(FieldChunk &chunk);
+    float advance(FieldChunk &chunk);
+    Vec3i climb(const Vec3i &cell, bool up) const;
+
+    VoxelMap &mMap;
+    DiffusionSettings mSettings;
+    ChangeTracker::Subscriber mSubscriber;
+    FieldTable mChunks;
+    uint64_t mTick;
+};
+
+} // namespace vox
+
+#endif // DIFFUSIONFIELD_H
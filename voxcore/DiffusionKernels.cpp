@@ -0,0 +1,124 @@
+#include "DiffusionKernels.h"
+
+#include "OccupancyKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VOX_DIFFUSION_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VOX_DIFFUSION_SSE2 1
+#endif
+
+namespace vox {
+namespace kernels {
+
+namespace {
+
+inline float cellStep(const float *row, const float *down, const float *up, const float *back,
+                      const float *front, const float *keep, float gain, const float *source, size_t i,
+                      float &change) {
+    float c = row[i + 1];
+    float sum = row[i] + row[i + 2];
+    sum = sum + down[i];
+    sum = sum + up[i];
+    sum = sum + back[i];
+    sum = sum + front[i];
+    float v = keep[i] * c + gain * sum;
+    if (source) {
+        v = v + source[i];
+    }
+    v = keep[i] > 0.0f && v > 0.0f ? v : 0.0f;
+    float d = v > c ? v - c : c - v;
+    change = d > change ? d : change;
+    return v;
+}
+
+#if defined(VOX_DIFFUSION_AVX2)
+
+const size_t LANES = 8;
+typedef __m256 VF;
+
+inline VF fset(float v) { return _mm256_set1_ps(v); }
+inline VF fzero() { return _mm256_setzero_ps(); }
+inline VF fload(const float *p) { return _mm256_loadu_ps(p); }
+inline void fstore(float *p, VF v) { _mm256_storeu_ps(p, v); }
+inline VF fadd(VF a, VF b) { return _mm256_add_ps(a, b); }
+inline VF fsub(VF a, VF b) { return _mm256_sub_ps(a, b); }
+inline VF fmul(VF a, VF b) { return _mm256_mul_ps(a, b); }
+inline VF fmax(VF a, VF b) { return _mm256_max_ps(a, b); }
+inline VF fand(VF a, VF b) { return _mm256_and_ps(a, b); }
+inline VF fgreater(VF a, VF b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+
+#elif defined(VOX_DIFFUSION_SSE2)
+
+const size_t LANES = 4;
+typedef __m128 VF;
+
+inline VF fset(float v) { return _mm_set1_ps(v); }
+inline VF fzero() { return _mm_setzero_ps(); }
+inline VF fload(const float *p) { return _mm_loadu_ps(p); }
+inline void fstore(float *p, VF v) { _mm_storeu_ps(p, v); }
+inline VF fadd(VF a, VF b) { return _mm_add_ps(a, b); }
+inline VF fsub(VF a, VF b) { return _mm_sub_ps(a, b); }
+inline VF fmul(VF a, VF b) { return _mm_mul_ps(a, b); }
+inline VF fmax(VF a, VF b) { return _mm_max_ps(a, b); }
+inline VF fand(VF a, VF b) { return _mm_and_ps(a, b); }
+inline VF fgreater(VF a, VF b) { return _mm_cmpgt_ps(a, b); }
+
+#endif
+
+#if defined(VOX_DIFFUSION_AVX2) || defined(VOX_DIFFUSION_SSE2)
+#define VOX_DIFFUSION_SIMD 1
+
+// Largest lane, folded through memory: it runs once per row.
+inline float hmax(VF v) {
+    float lanes[LANES];
+    fstore(lanes, v);
+    float best = lanes[0];
+    for (size_t i = 1; i < LANES; ++i) {
+        best = lanes[i] > best ? lanes[i] : best;
+    }
+    return best;
+}
+#endif
+
+} // namespace
+
+float diffuseRow(const float *row, const float *down, const float *up, const float *back, const float *front,
+                 const float *keep, float gain, const float *source, float *out, size_t count) {
+    float change = 0.0f;
+    size_t i = 0;
+#ifdef VOX_DIFFUSION_SIMD
+    if (isSimdEnabled()) {
+        const VF g = fset(gain);
+        const VF zero = fzero();
+        VF changes = zero;
+        for (; i + LANES <= count; i += LANES) {
+            VF c = fload(row + i + 1);
+            VF k = fload(keep + i);
+            VF sum = fadd(fload(row + i), fload(row + i + 2));
+            sum = fadd(sum, fload(down + i));
+            sum = fadd(sum, fload(up + i));
+            sum = fadd(sum, fload(back + i));
+            sum = fadd(sum, fload(front + i));
+            VF v = fadd(fmul(k, c), fmul(g, sum));
+            if (source) {
+                v = fadd(v, fload(source + i));
+            }
+            // Walls (keep 0) stay empty; nothing goes below 0.
+            v = fand(fmax(v, zero), fgreater(k, zero));
+            fstore(out + i, v);
+            changes = fmax(changes, fmax(fsub(v, c), fsub(c, v)));
+        }
+        change = hmax(changes);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = cellStep(row, down, up, back, front, keep, gain, source, i, change);
+    }
+    return change;
+}
+
+} // namespace kernels
+} // namespace vox
@@ -0,0 +1,25 @@
+#ifndef DIFFUSIONKERNELS_H
+#define DIFFUSIONKERNELS_H
+
+#include <cstddef>
+
+namespace vox {
+namespace kernels {
+
+// Row kernel behind DiffusionField. Like the other kernels there is an
+// AVX2, SSE2 and scalar build, switched with setSimdEnabled(); all three
+// add in the same order and give bit-identical results.
+
+// One explicit step of the 7-point stencil over count cells:
+//   out[i] = max(0, keep[i] * c + gain * (sum of the 6 neighbours) + source[i])
+// where keep[i] > 0, and 0 elsewhere. row holds the row with one extra cell
+// at each end (row[1] is the first cell); down, up, back and front are the
+// neighbouring rows along y and z. source may be null. Returns the largest
+// change |out[i] - c|.
+float diffuseRow(const float *row, const float *down, const float *up, const float *back, const float *front,
+                 const float *keep, float gain, const float *source, float *out, size_t count);
+
+} // namespace kernels
+} // namespace vox
+
+#endif // DIFFUSIONKERNELS_H
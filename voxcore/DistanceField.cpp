@@ -0,0 +1,213 @@
+#include "DistanceField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "OccupancyMask.h"
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+const uint8_t FAR = 255;
+const int LINES_TOGETHER = 16;
+
+// Scratch for one line of the y and z passes.
+struct Line {
+    std::vector<float> f;
+    std::vector<float> out;
+    std::vector<int> v;
+    std::vector<float> z;
+
+    explicit Line(int n) : f(n), out(n), v(n), z(n + 1) {}
+};
+
+// Lower envelope of the parabolas (q - i)² + f[i], sampled at every q.
+void envelope(Line &line, int n) {
+    const float *f = line.f.data();
+    int *v = line.v.data();
+    float *z = line.z.data();
+    int k = 0;
+    v[0] = 0;
+    z[0] = -std::numeric_limits<float>::infinity();
+    z[1] = std::numeric_limits<float>::infinity();
+    for (int q = 1; q < n; ++q) {
+        float s = ((f[q] + float(q * q)) - (f[v[k]] + float(v[k] * v[k]))) / float(2 * (q - v[k]));
+        while (s <= z[k]) {
+            --k;
+            s = ((f[q] + float(q * q)) - (f[v[k]] + float(v[k] * v[k]))) / float(2 * (q - v[k]));
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = std::numeric_limits<float>::infinity();
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < float(q)) {
+            ++k;
+        }
+        float d = float(q - v[k]);
+        line.out[q] = d * d + f[v[k]];
+    }
+}
+
+// One pass over count neighbouring strided lines of the grid, in place.
+// Lines starting next to each other are gathered together so the long
+// strides of the z pass read whole cache lines.
+void envelopeAlong(float *start, int count, int n, size_t stride, float cap, std::vector<Line> &lines) {
+    for (int q = 0; q < n; ++q) {
+        const float *src = start + q * stride;
+        for (int i = 0; i < count; ++i) {
+            lines[i].f[q] = src[i];
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        envelope(lines[i], n);
+    }
+    for (int q = 0; q < n; ++q) {
+        float *dst = start + q * stride;
+        for (int i = 0; i < count; ++i) {
+            dst[i] = std::min(lines[i].out[q], cap);
+        }
+    }
+}
+
+} // namespace
+
+DistanceField::DistanceField(float maxDistance)
+    : mMaxDistance(maxDistance > 0.0f ? maxDistance : 1.0f), mScale(float(FAR) / mMaxDistance) {}
+
+float DistanceField::getMaxDistance() const {
+    return mMaxDistance;
+}
+
+const Vec3i &DistanceField::getOrigin() const {
+    return mOrigin;
+}
+
+const Vec3i &DistanceField::getSize() const {
+    return mSize;
+}
+
+size_t DistanceField::memoryUsage() const {
+    return mValues.capacity();
+}
+
+uint8_t DistanceField::getRaw(int x, int y, int z) const {
+    x -= mOrigin.x;
+    y -= mOrigin.y;
+    z -= mOrigin.z;
+    if (x < 0 || y < 0 || z < 0 || x >= mSize.x || y >= mSize.y || z >= mSize.z) {
+        return FAR;
+    }
+    return mValues[size_t(x) + size_t(y) * mSize.x + size_t(z) * mSize.x * mSize.y];
+}
+
+float DistanceField::distance(int x, int y, int z) const {
+    return float(getRaw(x, y, z)) / mScale;
+}
+
+bool DistanceField::hasClearance(int x, int y, int z, float radius) const {
+    return float(getRaw(x, y, z)) >= radius * mScale;
+}
+
+void DistanceField::build(const OccupancyMask &mask, ThreadPool *pool) {
+    mOrigin = mask.getOrigin();
+    mSize = mask.getSize();
+    mValues.assign(size_t(mSize.x) * mSize.y * mSize.z, FAR);
+    if (mValues.empty()) {
+        return;
+    }
+    Vec3i last(mSize.x - 1, mSize.y - 1, mSize.z - 1);
+    transform(mask, Vec3i(0, 0, 0), last, Vec3i(0, 0, 0), last, pool);
+}
+
+void DistanceField::update(const OccupancyMask &mask, const Vec3i &min, const Vec3i &max, ThreadPool *pool) {
+    if (mask.getOrigin() != mOrigin || mask.getSize() != mSize) {
+        build(mask, pool);
+        return;
+    }
+    // Cells further than maxDistance from the edit keep their value, and
+    // the new values only depend on solids within maxDistance of them.
+    int reach = int(std::ceil(mMaxDistance)) + 1;
+    auto grow = [&](const Vec3i &a, const Vec3i &b, int by, Vec3i &lo, Vec3i &hi) {
+        lo = Vec3i(std::max(a.x - by, 0), std::max(a.y - by, 0), std::max(a.z - by, 0));
+        hi = Vec3i(std::min(b.x + by, mSize.x - 1), std::min(b.y + by, mSize.y - 1), std::min(b.z + by, mSize.z - 1));
+        return lo.x <= hi.x && lo.y <= hi.y && lo.z <= hi.z;
+    };
+    Vec3i lo, hi, computeLo, computeHi;
+    if (!grow(min - mOrigin, max - mOrigin, reach, lo, hi)) {
+        return;
+    }
+    grow(lo, hi, reach, computeLo, computeHi);
+    transform(mask, computeLo, computeHi, lo, hi, pool);
+}
+
+void DistanceField::transform(const OccupancyMask &mask, const Vec3i &computeLo, const Vec3i &computeHi,
+                              const Vec3i &lo, const Vec3i &hi, ThreadPool *pool) {
+    Vec3i n = computeHi - computeLo + Vec3i(1, 1, 1);
+    size_t layer = size_t(n.x) * n.y;
+    // Squared distances past reach² all end up as FAR, so clamping there
+    // keeps the sums small and exact in single precision.
+    int reach = int(std::ceil(mMaxDistance)) + 1;
+    float cap = float(reach * reach);
+    std::vector<float> grid(layer * n.z);
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+
+    // x: distance to the nearest solid cell along each row, forward then
+    // backward.
+    threads.parallelFor(size_t(n.z), [&](size_t iz) {
+        int z = computeLo.z + int(iz);
+        for (int iy = 0; iy < n.y; ++iy) {
+            int y = computeLo.y + iy;
+            float *row = &grid[iz * layer + size_t(iy) * n.x];
+            int gap = reach;
+            for (int ix = 0; ix < n.x; ++ix) {
+                const uint64_t *column = mask.getColumn(computeLo.x + ix, z);
+                gap = (column[y >> 6] >> (y & 63)) & 1 ? 0 : std::min(gap + 1, reach);
+                row[ix] = float(gap);
+            }
+            gap = reach;
+            for (int ix = n.x - 1; ix >= 0; --ix) {
+                gap = row[ix] == 0.0f ? 0 : std::min(gap + 1, reach);
+                float d = std::min(row[ix], float(gap));
+                row[ix] = std::min(d * d, cap);
+            }
+        }
+    });
+
+    // y along the columns of each z slice, then z along the rows of each
+    // y slice.
+    threads.parallelFor(size_t(n.z), [&](size_t iz) {
+        std::vector<Line> lines(LINES_TOGETHER, Line(n.y));
+        for (int ix = 0; ix < n.x; ix += LINES_TOGETHER) {
+            envelopeAlong(&grid[iz * layer + size_t(ix)], std::min(LINES_TOGETHER, n.x - ix), n.y, size_t(n.x), cap,
+                          lines);
+        }
+    });
+    threads.parallelFor(size_t(n.y), [&](size_t iy) {
+        std::vector<Line> lines(LINES_TOGETHER, Line(n.z));
+        for (int ix = 0; ix < n.x; ix += LINES_TOGETHER) {
+            envelopeAlong(&grid[iy * size_t(n.x) + size_t(ix)], std::min(LINES_TOGETHER, n.x - ix), n.z, layer, cap,
+                          lines);
+        }
+    });
+
+    threads.parallelFor(size_t(hi.z - lo.z + 1), [&](size_t slice) {
+        int z = lo.z + int(slice);
+        for (int y = lo.y; y <= hi.y; ++y) {
+            const float *src = &grid[size_t(z - computeLo.z) * layer + size_t(y - computeLo.y) * n.x
+                                     + size_t(lo.x - computeLo.x)];
+            uint8_t *dst = &mValues[size_t(lo.x) + size_t(y) * mSize.x + size_t(z) * mSize.x * mSize.y];
+            for (int x = 0; x <= hi.x - lo.x; ++x) {
+                float steps = std::sqrt(src[x]) * mScale;
+                dst[x] = steps >= float(FAR) ? FAR : uint8_t(steps);
+            }
+        }
+    });
+}
+
+} // namespace vox
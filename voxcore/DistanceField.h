@@ -0,0 +1,63 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <cstdint>
+#include <vector>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+class OccupancyMask;
+class ThreadPool;
+
+// Euclidean distance from every cell of a box to the nearest solid cell,
+// measured between cell centres (0 in solid cells), for clearance checks
+// that cost one read instead of a neighbourhood scan.
+//
+// Distances are capped at maxDistance and stored as one byte each, rounded
+// down to steps of maxDistance / 255, so a stored distance never claims
+// more room than there is. Cells outside the box read as maxDistance.
+//
+// The transform is the separable one of Felzenszwalb and Huttenlocher:
+// exact 1D passes along x, y and z, each split across the thread pool by
+// slices. Since nothing past maxDistance matters, an edit only changes
+// cells within maxDistance of it and update() redoes just that region.
+class DistanceField {
+public:
+    explicit DistanceField(float maxDistance = 16.0f);
+
+    // Sizes the field to the mask's box and computes every cell.
+    void build(const OccupancyMask &mask, ThreadPool *pool = nullptr);
+    // Recomputes the cells that edits inside [min, max] (world voxel
+    // coordinates) can have changed. mask must have the shape build() saw.
+    void update(const OccupancyMask &mask, const Vec3i &min, const Vec3i &max, ThreadPool *pool = nullptr);
+
+    float getMaxDistance() const;
+    const Vec3i &getOrigin() const;
+    const Vec3i &getSize() const;
+
+    // World voxel coordinates.
+    uint8_t getRaw(int x, int y, int z) const;
+    float distance(int x, int y, int z) const;
+    // distance(x, y, z) >= radius.
+    bool hasClearance(int x, int y, int z, float radius) const;
+
+    size_t memoryUsage() const;
+
+private:
+    // Recomputes [lo, hi] from the cells of [computeLo, computeHi], local
+    // coordinates, inclusive.
+    void transform(const OccupancyMask &mask, const Vec3i &computeLo, const Vec3i &computeHi, const Vec3i &lo,
+                   const Vec3i &hi, ThreadPool *pool);
+
+    float mMaxDistance;
+    float mScale;           // stored steps per voxel
+    Vec3i mOrigin;
+    Vec3i mSize;
+    std::vector<uint8_t> mValues;   // x fastest, then y, then z
+};
+
+} // namespace vox
+
+#endif // DISTANCEFIELD_H
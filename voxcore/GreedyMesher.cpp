@@ -0,0 +1,124 @@
+#include "GreedyMesher.h"
+
+#include <algorithm>
+
+namespace vox {
+
+GreedyMesher::GreedyMesher(const VoxelMap &map)
+    : mMap(map),
+      mSlice(CHUNK_SIZE * CHUNK_SIZE, AIR) {}
+
+void GreedyMesher::mesh(const Vec3i &chunk, GreedyMesh &out) {
+    out.clear();
+    out.chunk = chunk;
+    const Chunk *center = mMap.findChunk(chunk);
+    if (!center || center->isEmpty()) {
+        return;
+    }
+    gatherPadded(mMap, chunk, mCells, mDecoded);
+    mQuads.clear();
+    mWelded.clear();
+
+    for (int f = 0; f < FACE_COUNT; ++f) {
+        const FaceAxes &axes = FACE_AXES[f];
+        for (int d = 0; d < CHUNK_SIZE; ++d) {
+            // Material of every visible face in this slice, indexed u + v * size.
+            bool any = false;
+            for (int v = 0; v < CHUNK_SIZE; ++v) {
+                for (int u = 0; u < CHUNK_SIZE; ++u) {
+                    int p[3];
+                    p[axes.axis] = d;
+                    p[axes.u] = u;
+                    p[axes.v] = v;
+                    MaterialId material = cell(p[0], p[1], p[2]);
+                    p[axes.axis] += axes.dir;
+                    bool visible = material != AIR && cell(p[0], p[1], p[2]) == AIR;
+                    mSlice[u + v * CHUNK_SIZE] = visible ? material : AIR;
+                    any = any || visible;
+                }
+            }
+            if (!any) {
+                continue;
+            }
+
+            int plane = d + (axes.dir > 0 ? 1 : 0);
+            for (int v = 0; v < CHUNK_SIZE; ++v) {
+                for (int u = 0; u < CHUNK_SIZE;) {
+                    MaterialId material = mSlice[u + v * CHUNK_SIZE];
+                    if (material == AIR) {
+                        ++u;
+                        continue;
+                    }
+                    int width = 1;
+                    while (u + width < CHUNK_SIZE && mSlice[u + width + v * CHUNK_SIZE] == material) {
+                        ++width;
+                    }
+                    int height = 1;
+                    for (bool grow = true; grow && v + height < CHUNK_SIZE; ) {
+                        const MaterialId *row = &mSlice[u + (v + height) * CHUNK_SIZE];
+                        for (int k = 0; k < width && grow; ++k) {
+                            grow = row[k] == material;
+                        }
+                        height += grow ? 1 : 0;
+                    }
+                    for (int h = 0; h < height; ++h) {
+                        std::fill_n(&mSlice[u + (v + h) * CHUNK_SIZE], width, AIR);
+                    }
+
+                    const int spans[4][2] = {{0, 0}, {width, 0}, {width, height}, {0, height}};
+                    Quad quad;
+                    quad.material = material;
+                    for (int k = 0; k < 4; ++k) {
+                        int p[3];
+                        p[axes.axis] = plane;
+                        p[axes.u] = u + spans[k][0];
+                        p[axes.v] = v + spans[k][1];
+                        quad.corners[k] = corner(f, material, p, out);
+                    }
+                    mQuads.push_back(quad);
+                    u += width;
+                }
+            }
+        }
+    }
+
+    std::stable_sort(mQuads.begin(), mQuads.end(),
+                     [](const Quad &a, const Quad &b) { return a.material < b.material; });
+    out.indices.reserve(mQuads.size() * 6);
+    for (const Quad &quad : mQuads) {
+        if (out.ranges.empty() || out.ranges.back().material != quad.material) {
+            out.ranges.push_back(MaterialRange{quad.material, uint32_t(out.indices.size()), 0});
+        }
+        const int order[6] = {0, 1, 2, 0, 2, 3};
+        for (int i : order) {
+            out.indices.push_back(quad.corners[i]);
+        }
+        out.ranges.back().indexCount += 6;
+    }
+}
+
+MaterialId GreedyMesher::cell(int x, int y, int z) const {
+    return mCells[(x + 1) + PADDED_SIZE * ((y + 1) + PADDED_SIZE * (z + 1))];
+}
+
+// Corner p is in corner space, 0..CHUNK_SIZE on each axis.
+uint32_t GreedyMesher::corner(int face, MaterialId material, const int p[3], GreedyMesh &out) {
+    uint64_t key = uint64_t(p[0]) | uint64_t(p[1]) << 6 | uint64_t(p[2]) << 12
+                 | uint64_t(face) << 18 | uint64_t(material) << 21;
+    auto it = mWelded.find(key);
+    if (it != mWelded.end()) {
+        return it->second;
+    }
+    GreedyVertex vertex;
+    vertex.x = p[0] - 0.5f;
+    vertex.y = p[1] - 0.5f;
+    vertex.z = p[2] - 0.5f;
+    vertex.face = uint8_t(face);
+    vertex.material = material;
+    uint32_t index = uint32_t(out.vertices.size());
+    out.vertices.push_back(vertex);
+    mWelded.emplace(key, index);
+    return index;
+}
+
+} // namespace vox
@@ -0,0 +1,69 @@
+#ifndef GREEDYMESHER_H
+#define GREEDYMESHER_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkMesher.h"
+
+namespace vox {
+
+// Vertex positions are relative to the chunk's first cell, using the same
+// half-voxel offset as MeshVertex.
+struct GreedyVertex {
+    float x, y, z;
+    uint8_t face;
+    MaterialId material;
+};
+
+// Indices [firstIndex, firstIndex + indexCount) all use one material.
+struct MaterialRange {
+    MaterialId material;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+struct GreedyMesh {
+    Vec3i chunk;
+    std::vector<GreedyVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MaterialRange> ranges;
+
+    void clear() {
+        vertices.clear();
+        indices.clear();
+        ranges.clear();
+    }
+
+    bool empty() const { return indices.empty(); }
+};
+
+// Unlit mesh for export: coplanar faces of one material are merged into as
+// few rectangles as the greedy sweep finds, and quads of the same material
+// and facing share their corner vertices. Reuse one mesher per thread.
+class GreedyMesher {
+public:
+    explicit GreedyMesher(const VoxelMap &map);
+
+    void mesh(const Vec3i &chunk, GreedyMesh &out);
+
+private:
+    struct Quad {
+        MaterialId material;
+        uint32_t corners[4];
+    };
+
+    MaterialId cell(int x, int y, int z) const;
+    uint32_t corner(int face, MaterialId material, const int p[3], GreedyMesh &out);
+
+    const VoxelMap &mMap;
+    std::vector<MaterialId> mCells;
+    std::vector<uint32_t> mDecoded;
+    std::vector<MaterialId> mSlice;
+    std::vector<Quad> mQuads;
+    std::unordered_map<uint64_t, uint32_t> mWelded;
+};
+
+} // namespace vox
+
+#endif // GREEDYMESHER_H
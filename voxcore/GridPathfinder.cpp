@@ -0,0 +1,239 @@
+#include "GridPathfinder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+#include "DistanceField.h"
+#include "OccupancyMask.h"
+
+namespace vox {
+
+namespace {
+
+const float DIAGONAL = 1.41421356f;
+const int DIRECTIONS[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+struct Node {
+    float cost;
+    uint32_t parent;
+    bool closed;
+};
+
+struct Open {
+    float estimate;
+    float cost;
+    uint32_t cell;
+
+    // Lowest estimate first, the deeper of equal ones first.
+    bool operator<(const Open &o) const {
+        return estimate != o.estimate ? estimate > o.estimate : cost < o.cost;
+    }
+};
+
+float octile(int dx, int dz) {
+    dx = std::abs(dx);
+    dz = std::abs(dz);
+    return float(std::max(dx, dz) - std::min(dx, dz)) + DIAGONAL * float(std::min(dx, dz));
+}
+
+} // namespace
+
+GridPathfinder::GridPathfinder(const OccupancyMask &mask, const DistanceField *field)
+    : mMask(mask), mField(field) {}
+
+bool GridPathfinder::isEmpty(int x, int y0, int y1, int z) const {
+    for (int y = y0; y <= y1; ++y) {
+        if (mMask.get(x, y, z)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GridPathfinder::isWalkable(const Vec3i &cell, const PathSettings &settings) const {
+    const Vec3i &origin = mMask.getOrigin();
+    const Vec3i &size = mMask.getSize();
+    int x = cell.x - origin.x;
+    int y = cell.y - origin.y;
+    int z = cell.z - origin.z;
+    if (x < 0 || z < 0 || y < 1 || x >= size.x || z >= size.z || y >= size.y) {
+        return false;
+    }
+    if (!mMask.get(x, y - 1, z) || !isEmpty(x, y, y + settings.height - 1, z)) {
+        return false;
+    }
+    if (mField && settings.radius > 0.0f) {
+        // Distances run between cell centres, walls start half a cell out.
+        int above = std::min(1, settings.height - 1);
+        return mField->hasClearance(cell.x, cell.y + above, cell.z, settings.radius + 0.5f);
+    }
+    return true;
+}
+
+bool GridPathfinder::stepTo(int x, int z, int y, const PathSettings &settings, int &to) const {
+    const Vec3i &origin = mMask.getOrigin();
+    if (isWalkable(Vec3i(x + origin.x, y + origin.y, z + origin.z), settings)) {
+        to = y;
+        return true;
+    }
+    for (int up = 1; up <= settings.maxClimb; ++up) {
+        if (isWalkable(Vec3i(x + origin.x, y + up + origin.y, z + origin.z), settings)) {
+            to = y + up;
+            return true;
+        }
+    }
+    // Down: the body has to fit down the whole drop.
+    for (int down = 1; down <= settings.maxDrop; ++down) {
+        if (mMask.get(x, y - down + settings.height, z)) {
+            return false;
+        }
+        if (isWalkable(Vec3i(x + origin.x, y - down + origin.y, z + origin.z), settings)) {
+            to = y - down;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GridPathfinder::move(const Vec3i &from, int dx, int dz, const PathSettings &settings, int &to) const {
+    if (!stepTo(from.x + dx, from.z + dz, from.y, settings, to)) {
+        return false;
+    }
+    if (dx && dz) {
+        // Diagonals stay level and need both sides open.
+        int side;
+        return to == from.y && stepTo(from.x + dx, from.z, from.y, settings, side) && side == from.y
+            && stepTo(from.x, from.z + dz, from.y, settings, side) && side == from.y;
+    }
+    // Room for the head before stepping up.
+    return to <= from.y || isEmpty(from.x, from.y + settings.height, to + settings.height - 1, from.z);
+}
+
+// Follows the columns the straight line between the two cell centres
+// crosses, each one a legal move from the last. Where the line passes
+// exactly through a corner the move is diagonal.
+bool GridPathfinder::canWalkStraight(const Vec3i &from, const Vec3i &to, const PathSettings &settings,
+                                     size_t *checks) const {
+    const Vec3i &origin = mMask.getOrigin();
+    Vec3i c = from - origin;
+    Vec3i end = to - origin;
+    int adx = std::abs(end.x - c.x);
+    int adz = std::abs(end.z - c.z);
+    int sx = end.x > c.x ? 1 : -1;
+    int sz = end.z > c.z ? 1 : -1;
+    // Boundary i along x is crossed at t = (2i + 1) / (2 adx), so crossings
+    // compare exactly as (2i + 1) adz against (2j + 1) adx.
+    int i = 0;
+    int j = 0;
+    size_t visited = 0;
+    bool ok = true;
+    while (i < adx || j < adz) {
+        long long ex = i < adx ? (2LL * i + 1) * adz : -1;
+        long long ez = j < adz ? (2LL * j + 1) * adx : -1;
+        int dx = 0;
+        int dz = 0;
+        if (ez < 0 || (ex >= 0 && ex <= ez)) {
+            dx = sx;
+        }
+        if (ex < 0 || (ez >= 0 && ez <= ex)) {
+            dz = sz;
+        }
+        int ny;
+        ++visited;
+        if (!move(c, dx, dz, settings, ny)) {
+            ok = false;
+            break;
+        }
+        c = Vec3i(c.x + dx, ny, c.z + dz);
+        i += dx ? 1 : 0;
+        j += dz ? 1 : 0;
+    }
+    if (checks) {
+        *checks += visited;
+    }
+    return ok && c.y == end.y;
+}
+
+bool GridPathfinder::findPath(const Vec3i &start, const Vec3i &goal, std::vector<Vec3i> &path,
+                              const PathSettings &settings, PathStats *stats) const {
+    auto begin = std::chrono::steady_clock::now();
+    path.clear();
+    const Vec3i &origin = mMask.getOrigin();
+    const Vec3i &size = mMask.getSize();
+    auto key = [&](int x, int y, int z) {
+        return uint32_t(x) + uint32_t(y) * uint32_t(size.x) + uint32_t(z) * uint32_t(size.x) * uint32_t(size.y);
+    };
+    auto cellOf = [&](uint32_t k) {
+        return Vec3i(int(k % uint32_t(size.x)), int(k / uint32_t(size.x) % uint32_t(size.y)),
+                     int(k / (uint32_t(size.x) * uint32_t(size.y))));
+    };
+
+    size_t expanded = 0;
+    bool found = false;
+    float pathCost = 0.0f;
+    std::unordered_map<uint32_t, Node> nodes;
+    std::priority_queue<Open> open;
+    Vec3i from = start - origin;
+    Vec3i to = goal - origin;
+    if (isWalkable(start, settings) && isWalkable(goal, settings)) {
+        uint32_t first = key(from.x, from.y, from.z);
+        uint32_t last = key(to.x, to.y, to.z);
+        nodes[first] = Node{0.0f, first, false};
+        open.push(Open{octile(to.x - from.x, to.z - from.z), 0.0f, first});
+        while (!open.empty() && expanded < settings.maxExpanded) {
+            Open top = open.top();
+            open.pop();
+            Node &node = nodes[top.cell];
+            if (node.closed || top.cost > node.cost) {
+                continue;
+            }
+            node.closed = true;
+            ++expanded;
+            if (top.cell == last) {
+                found = true;
+                break;
+            }
+            Vec3i c = cellOf(top.cell);
+            for (int d = 0; d < 8; ++d) {
+                int dx = DIRECTIONS[d][0];
+                int dz = DIRECTIONS[d][1];
+                int ny;
+                if (!move(c, dx, dz, settings, ny)) {
+                    continue;
+                }
+                float horizontal = dx && dz ? DIAGONAL : 1.0f;
+                float dy = float(ny - c.y);
+                float cost = top.cost + std::sqrt(horizontal * horizontal + dy * dy);
+                uint32_t next = key(c.x + dx, ny, c.z + dz);
+                auto it = nodes.find(next);
+                if (it != nodes.end() && (it->second.closed || it->second.cost <= cost)) {
+                    continue;
+                }
+                nodes[next] = Node{cost, top.cell, false};
+                open.push(Open{cost + octile(to.x - c.x - dx, to.z - c.z - dz), cost, next});
+            }
+        }
+        if (found) {
+            for (uint32_t k = last;; k = nodes[k].parent) {
+                path.push_back(cellOf(k) + origin);
+                if (k == first) {
+                    break;
+                }
+            }
+            std::reverse(path.begin(), path.end());
+        }
+        pathCost = found ? nodes[last].cost : 0.0f;
+    }
+    if (stats) {
+        stats->cost = pathCost;
+        stats->expanded = expanded;
+        stats->milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+    return found;
+}
+
+} // namespace vox
@@ -0,0 +1,72 @@
+#ifndef GRIDPATHFINDER_H
+#define GRIDPATHFINDER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+class DistanceField;
+class OccupancyMask;
+
+struct PathSettings {
+    int height;             // empty cells the agent needs above the floor
+    int maxClimb;           // highest step up between neighbouring cells
+    int maxDrop;            // deepest step down
+    float radius;           // clearance from walls, needs a DistanceField; 0 ignores it
+    size_t maxExpanded;     // give up after expanding this many cells
+
+    PathSettings() : height(2), maxClimb(1), maxDrop(3), radius(0.0f), maxExpanded(250000) {}
+};
+
+struct PathStats {
+    size_t expanded;
+    double milliseconds;
+    float cost;             // length of the path in voxels
+
+    PathStats() : expanded(0), milliseconds(0.0), cost(0.0f) {}
+};
+
+// A* for walking agents over the cells of an OccupancyMask. A cell is
+// walkable when it and height - 1 cells above it are empty and the cell
+// below is solid. Agents move to the 8 neighbouring columns, climbing or
+// dropping to the nearest walkable cell there, and never cut corners.
+//
+// With a DistanceField built from the same mask, radius is checked with one
+// read per cell, at the cell above the feet so the floor does not count.
+// That works for radii up to about 1.5.
+class GridPathfinder {
+public:
+    explicit GridPathfinder(const OccupancyMask &mask, const DistanceField *field = nullptr);
+
+    // World voxel coordinates.
+    bool isWalkable(const Vec3i &cell, const PathSettings &settings = PathSettings()) const;
+
+    // Cells from start to goal inclusive, world voxel coordinates. False
+    // when either end is not walkable, no path exists or the search hit
+    // maxExpanded.
+    bool findPath(const Vec3i &start, const Vec3i &goal, std::vector<Vec3i> &path,
+                  const PathSettings &settings = PathSettings(), PathStats *stats = nullptr) const;
+
+    // Whether an agent can walk the straight line between two walkable
+    // cells using only moves findPath() could make, ending at to's height.
+    // Adds the number of columns looked at to checks.
+    bool canWalkStraight(const Vec3i &from, const Vec3i &to, const PathSettings &settings = PathSettings(),
+                         size_t *checks = nullptr) const;
+
+private:
+    bool isEmpty(int x, int y0, int y1, int z) const;
+    // Walkable cell in column (x, z) reachable from height y, or false.
+    bool stepTo(int x, int z, int y, const PathSettings &settings, int &to) const;
+    // One move of the search from local cell from to the next column.
+    bool move(const Vec3i &from, int dx, int dz, const PathSettings &settings, int &to) const;
+
+    const OccupancyMask &mMask;
+    const DistanceField *mField;
+};
+
+} // namespace vox
+
+#endif // GRIDPATHFINDER_H
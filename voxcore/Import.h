@@ -0,0 +1,35 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <cstdint>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+class ThreadPool;
+
+struct ImportOptions {
+    Vec3i offset;       // added to every imported voxel
+    ThreadPool *pool;   // null uses defaultThreadPool()
+    bool skipHidden;    // leave out hidden MagicaVoxel layers and objects
+
+    ImportOptions() : pool(nullptr), skipHidden(true) {}
+};
+
+struct ImportStats {
+    uint64_t bytes;
+    uint64_t voxels;
+    size_t chunks;
+    double seconds;
+
+    ImportStats() : bytes(0), voxels(0), chunks(0), seconds(0.0) {}
+
+    double megabytesPerSecond() const {
+        return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+    }
+};
+
+} // namespace vox
+
+#endif // IMPORT_H
@@ -0,0 +1,380 @@
+#include "LineOfSight.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+const int FINE_SHIFT = 2;       // 4³ blocks
+const int COARSE_SHIFT = 4;     // 16³ blocks
+const size_t QUERIES_PER_BLOCK = 64;
+// Face targets sit this far inside the voxel so rays end up in it.
+const float FACE_INSET = 0.49f;
+const float INF = std::numeric_limits<float>::infinity();
+// Further than this from a cell boundary, rounding cannot change which
+// cell a jump lands in.
+const float BOUNDARY_SLACK = 1e-3f;
+
+inline int floorInt(float v) {
+    int i = int(v);
+    return float(i) > v ? i - 1 : i;
+}
+
+inline int component(const Vec3i &v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+inline Vec3i blocks(const Vec3i &size, int shift) {
+    int round = (1 << shift) - 1;
+    return Vec3i((size.x + round) >> shift, (size.y + round) >> shift, (size.z + round) >> shift);
+}
+
+const int FACE_AXIS[FACE_COUNT] = {0, 0, 1, 1, 2, 2};
+const int FACE_SIGN[FACE_COUNT] = {1, -1, 1, -1, 1, -1};
+
+} // namespace
+
+LineOfSight::LineOfSight(const OccupancyMask &mask)
+    : mMask(mask), mSkipEmpty(true) {
+    rebuild();
+}
+
+void LineOfSight::setEmptySkipping(bool enabled) {
+    mSkipEmpty = enabled;
+}
+
+void LineOfSight::rebuild() {
+    const int shifts[2] = {FINE_SHIFT, COARSE_SHIFT};
+    for (int l = 0; l < 2; ++l) {
+        Level &level = mLevels[l];
+        level.shift = shifts[l];
+        level.size = blocks(mMask.getSize(), level.shift);
+        level.any.assign(size_t(level.size.x) * level.size.y * level.size.z, 0);
+    }
+    const Vec3i &fine = mLevels[0].size;
+    const Vec3i &coarse = mLevels[1].size;
+    if (fine.x && fine.y && fine.z) {
+        buildFine(0, 0, 0, fine.x - 1, fine.y - 1, fine.z - 1, nullptr);
+        buildCoarse(0, 0, 0, coarse.x - 1, coarse.y - 1, coarse.z - 1);
+    }
+}
+
+void LineOfSight::update(const Vec3i &min, const Vec3i &max) {
+    const Vec3i &origin = mMask.getOrigin();
+    const Vec3i &size = mMask.getSize();
+    Vec3i lo(std::max(min.x - origin.x, 0), std::max(min.y - origin.y, 0), std::max(min.z - origin.z, 0));
+    Vec3i hi(std::min(max.x - origin.x, size.x - 1), std::min(max.y - origin.y, size.y - 1),
+             std::min(max.z - origin.z, size.z - 1));
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) {
+        return;
+    }
+    buildFine(lo.x >> FINE_SHIFT, lo.y >> FINE_SHIFT, lo.z >> FINE_SHIFT, hi.x >> FINE_SHIFT, hi.y >> FINE_SHIFT,
+              hi.z >> FINE_SHIFT, nullptr);
+    buildCoarse(lo.x >> COARSE_SHIFT, lo.y >> COARSE_SHIFT, lo.z >> COARSE_SHIFT, hi.x >> COARSE_SHIFT,
+                hi.y >> COARSE_SHIFT, hi.z >> COARSE_SHIFT);
+}
+
+// 4³ blocks straight from the column words: four y bits of a column never
+// straddle two words.
+void LineOfSight::buildFine(int bx0, int by0, int bz0, int bx1, int by1, int bz1, ThreadPool *pool) {
+    Level &level = mLevels[0];
+    const Vec3i &size = mMask.getSize();
+    const int side = 1 << FINE_SHIFT;
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    threads.parallelFor(size_t(bz1 - bz0 + 1), [&](size_t slab) {
+        int bz = bz0 + int(slab);
+        for (int by = by0; by <= by1; ++by) {
+            for (int bx = bx0; bx <= bx1; ++bx) {
+                level.any[size_t(bx) + size_t(by) * level.size.x + size_t(bz) * level.size.x * level.size.y] = 0;
+            }
+        }
+        for (int z = bz * side; z < std::min((bz + 1) * side, size.z); ++z) {
+            for (int x = bx0 * side; x < std::min((bx1 + 1) * side, size.x); ++x) {
+                const uint64_t *column = mMask.getColumn(x, z);
+                for (int by = by0; by <= by1; ++by) {
+                    int y = by * side;
+                    if ((column[y >> 6] >> (y & 63)) & ((uint64_t(1) << side) - 1)) {
+                        level.any[size_t(x >> FINE_SHIFT) + size_t(by) * level.size.x
+                                  + size_t(bz) * level.size.x * level.size.y] = 1;
+                    }
+                }
+            }
+        }
+    });
+}
+
+void LineOfSight::buildCoarse(int bx0, int by0, int bz0, int bx1, int by1, int bz1) {
+    const Level &fine = mLevels[0];
+    Level &coarse = mLevels[1];
+    const int ratio = 1 << (COARSE_SHIFT - FINE_SHIFT);
+    for (int bz = bz0; bz <= bz1; ++bz) {
+        for (int by = by0; by <= by1; ++by) {
+            for (int bx = bx0; bx <= bx1; ++bx) {
+                uint8_t any = 0;
+                for (int z = bz * ratio; z < std::min((bz + 1) * ratio, fine.size.z) && !any; ++z) {
+                    for (int y = by * ratio; y < std::min((by + 1) * ratio, fine.size.y) && !any; ++y) {
+                        for (int x = bx * ratio; x < std::min((bx + 1) * ratio, fine.size.x); ++x) {
+                            if (fine.any[size_t(x) + size_t(y) * fine.size.x + size_t(z) * fine.size.x * fine.size.y]) {
+                                any = 1;
+                                break;
+                            }
+                        }
+                    }
+                }
+                coarse.any[size_t(bx) + size_t(by) * coarse.size.x + size_t(bz) * coarse.size.x * coarse.size.y] = any;
+            }
+        }
+    }
+}
+
+bool LineOfSight::trace(const float from[3], const float to[3], RayHit *hit) const {
+    const Vec3i &origin = mMask.getOrigin();
+    const int size[3] = {mMask.getSize().x, mMask.getSize().y, mMask.getSize().z};
+    float p[3], d[3];
+    int start[3];
+    for (int a = 0; a < 3; ++a) {
+        p[a] = from[a] - float(component(origin, a)) + 0.5f;
+        d[a] = to[a] - from[a];
+        start[a] = floorInt(p[a]);
+    }
+
+    // Clip the segment to the mask, everything outside is empty.
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    int entry = -1;
+    for (int a = 0; a < 3; ++a) {
+        if (d[a] == 0.0f) {
+            if (p[a] < 0.0f || p[a] >= float(size[a])) {
+                return false;
+            }
+            continue;
+        }
+        float ta = -p[a] / d[a];
+        float tb = (float(size[a]) - p[a]) / d[a];
+        if (ta > tb) {
+            std::swap(ta, tb);
+        }
+        if (ta > t0) {
+            t0 = ta;
+            entry = a;
+        }
+        t1 = std::min(t1, tb);
+    }
+    if (t0 >= t1) {
+        return false;
+    }
+
+    // Boundary times are always worked out from the voxel rather than
+    // accumulated, so a jump across an empty block lands on exactly the
+    // voxel that stepping would have reached, ties included.
+    int v[3], step[3];
+    float tNext[3], invD[3];
+    for (int a = 0; a < 3; ++a) {
+        step[a] = d[a] > 0.0f ? 1 : (d[a] < 0.0f ? -1 : 0);
+        invD[a] = d[a] != 0.0f ? 1.0f / d[a] : 0.0f;
+        v[a] = std::min(std::max(floorInt(p[a] + d[a] * t0), 0), size[a] - 1);
+        if (a == entry) {
+            v[a] = d[a] > 0.0f ? 0 : size[a] - 1;
+        }
+    }
+    auto boundary = [&](int a, int cell) {
+        return step[a] ? (float(cell + (step[a] > 0 ? 1 : 0)) - p[a]) * invD[a] : INF;
+    };
+    for (int a = 0; a < 3; ++a) {
+        tNext[a] = boundary(a, v[a]);
+    }
+
+    const uint64_t *words = mMask.getWords().data();
+    const int wordsPerColumn = mMask.getWordsPerColumn();
+    float t = t0;
+    // The levels are only looked at on entering a new 4³ block, stepping
+    // through a busy one costs no more than without skipping. A ray that
+    // starts in a busy block, like one from eyes near the ground, is mostly
+    // among busy blocks: it steps plainly, as the lookups would rarely pay.
+    const bool skip = mSkipEmpty && !mLevels[0].get(v[0], v[1], v[2]);
+    bool newBlock = skip;
+    for (;;) {
+        const Level *empty = nullptr;
+        if (newBlock) {
+            newBlock = false;
+            if (!mLevels[0].get(v[0], v[1], v[2])) {
+                empty = mLevels[1].get(v[0], v[1], v[2]) ? &mLevels[0] : &mLevels[1];
+            }
+        }
+        if (empty) {
+            // Jump to where the ray leaves the empty block. On ties the
+            // highest axis leaves, matching the stepping order below.
+            int lo[3], hi[3];
+            float tExit = INF;
+            int axis = -1;
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = (v[a] >> empty->shift) << empty->shift;
+                hi[a] = lo[a] + (1 << empty->shift);
+                float ta = boundary(a, step[a] > 0 ? hi[a] - 1 : lo[a]);
+                if (step[a] && ta <= tExit) {
+                    tExit = ta;
+                    axis = a;
+                }
+            }
+            if (tExit >= t1) {
+                return false;
+            }
+            for (int a = 0; a < 3; ++a) {
+                if (a == axis) {
+                    v[a] = step[a] > 0 ? hi[a] : lo[a] - 1;
+                } else if (step[a]) {
+                    float at = p[a] + d[a] * tExit;
+                    int cell = std::min(std::max(floorInt(at), lo[a]), hi[a] - 1);
+                    // Near a cell boundary, settle the cell with the same
+                    // comparisons stepping makes: boundaries before tExit
+                    // are crossed, and ones at tExit too on higher axes.
+                    if (std::fabs(at - float(floorInt(at + 0.5f))) < BOUNDARY_SLACK) {
+                        auto crossed = [&](int c) {
+                            float tb = boundary(a, c);
+                            return tb < tExit || (tb == tExit && a > axis);
+                        };
+                        while (cell != (step[a] > 0 ? hi[a] - 1 : lo[a]) && crossed(cell)) {
+                            cell += step[a];
+                        }
+                        while (cell != (step[a] > 0 ? lo[a] : hi[a] - 1) && !crossed(cell - step[a])) {
+                            cell -= step[a];
+                        }
+                    }
+                    v[a] = cell;
+                }
+            }
+            if (v[axis] < 0 || v[axis] >= size[axis]) {
+                return false;
+            }
+            t = std::max(t, tExit);
+            entry = axis;
+            for (int a = 0; a < 3; ++a) {
+                tNext[a] = boundary(a, v[a]);
+            }
+            newBlock = true;
+            continue;
+        }
+
+        const uint64_t *column = words + (size_t(v[0]) + size_t(v[2]) * size[0]) * wordsPerColumn;
+        if (((column[v[1] >> 6] >> (v[1] & 63)) & 1) && (v[0] != start[0] || v[1] != start[1] || v[2] != start[2])) {
+            if (hit) {
+                hit->voxel = Vec3i(v[0] + origin.x, v[1] + origin.y, v[2] + origin.z);
+                hit->face = entry < 0 ? FACE_POS_Y : Face(entry * 2 + (d[entry] > 0.0f ? 1 : 0));
+                hit->distance = t * std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            }
+            return true;
+        }
+
+        int a = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+        if (tNext[a] >= t1) {
+            return false;
+        }
+        t = tNext[a];
+        v[a] += step[a];
+        if (v[a] < 0 || v[a] >= size[a]) {
+            return false;
+        }
+        tNext[a] = boundary(a, v[a]);
+        entry = a;
+        newBlock = skip && (v[a] & ((1 << FINE_SHIFT) - 1)) == (step[a] > 0 ? 0 : (1 << FINE_SHIFT) - 1);
+    }
+}
+
+bool LineOfSight::raycast(const float from[3], const float to[3], RayHit *hit) const {
+    return trace(from, to, hit);
+}
+
+bool LineOfSight::canSee(const float from[3], const float to[3]) const {
+    RayHit hit;
+    if (!trace(from, to, &hit)) {
+        return true;
+    }
+    return hit.voxel == Vec3i(floorInt(to[0] + 0.5f), floorInt(to[1] + 0.5f), floorInt(to[2] + 0.5f));
+}
+
+void LineOfSight::canSeeBatch(const SightQuery *queries, size_t count, uint8_t *visible, ThreadPool *pool) const {
+    size_t blocks = (count + QUERIES_PER_BLOCK - 1) / QUERIES_PER_BLOCK;
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    threads.parallelFor(blocks, [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * QUERIES_PER_BLOCK);
+        for (size_t i = block * QUERIES_PER_BLOCK; i < end; ++i) {
+            visible[i] = canSee(queries[i].from, queries[i].to) ? 1 : 0;
+        }
+    });
+}
+
+void LineOfSight::visibleVoxels(const float eye[3], float radius, std::vector<Vec3i> &out, ThreadPool *pool) const {
+    const Vec3i &origin = mMask.getOrigin();
+    const Vec3i &size = mMask.getSize();
+    int lo[3], hi[3];
+    for (int a = 0; a < 3; ++a) {
+        lo[a] = std::max(floorInt(eye[a] - radius + 0.5f) - component(origin, a), 0);
+        hi[a] = std::min(floorInt(eye[a] + radius + 0.5f) - component(origin, a), component(size, a) - 1);
+        if (lo[a] > hi[a]) {
+            return;
+        }
+    }
+
+    auto solidAt = [&](int x, int y, int z) {
+        return x >= 0 && y >= 0 && z >= 0 && x < size.x && y < size.y && z < size.z && mMask.get(x, y, z);
+    };
+
+    float radiusSq = radius * radius;
+    std::vector<std::vector<Vec3i>> slices(size_t(hi[2] - lo[2] + 1));
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    threads.parallelFor(slices.size(), [&](size_t slice) {
+        int z = lo[2] + int(slice);
+        std::vector<Vec3i> &found = slices[slice];
+        for (int x = lo[0]; x <= hi[0]; ++x) {
+            const uint64_t *column = mMask.getColumn(x, z);
+            for (int w = lo[1] >> 6; w <= hi[1] >> 6; ++w) {
+                uint64_t bits = column[w];
+                while (bits) {
+                    int y = w * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    if (y < lo[1] || y > hi[1]) {
+                        continue;
+                    }
+                    Vec3i voxel(x + origin.x, y + origin.y, z + origin.z);
+                    const float centre[3] = {float(voxel.x), float(voxel.y), float(voxel.z)};
+                    float dx = centre[0] - eye[0];
+                    float dy = centre[1] - eye[1];
+                    float dz = centre[2] - eye[2];
+                    if (dx * dx + dy * dy + dz * dz > radiusSq) {
+                        continue;
+                    }
+                    for (int face = 0; face < FACE_COUNT; ++face) {
+                        int axis = FACE_AXIS[face];
+                        int sign = FACE_SIGN[face];
+                        // Only faces turned towards the eye and open to the air.
+                        if ((eye[axis] - centre[axis]) * float(sign) <= 0.5f) {
+                            continue;
+                        }
+                        int n[3] = {x, y, z};
+                        n[axis] += sign;
+                        if (solidAt(n[0], n[1], n[2])) {
+                            continue;
+                        }
+                        float target[3] = {centre[0], centre[1], centre[2]};
+                        target[axis] += FACE_INSET * float(sign);
+                        RayHit hit;
+                        if (trace(eye, target, &hit) && hit.voxel == voxel) {
+                            found.push_back(voxel);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    });
+    for (const std::vector<Vec3i> &found : slices) {
+        out.insert(out.end(), found.begin(), found.end());
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,87 @@
+#ifndef LINEOFSIGHT_H
+#define LINEOFSIGHT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "OccupancyMask.h"
+
+namespace vox {
+
+class ThreadPool;
+
+struct RayHit {
+    Vec3i voxel;        // first solid voxel on the way, world coordinates
+    Face face;          // face of voxel the ray came in through
+    float distance;     // from the start of the ray to where it enters voxel
+};
+
+struct SightQuery {
+    float from[3];
+    float to[3];
+};
+
+// Line of sight and ray queries against an OccupancyMask, with no renderer
+// involved. Rays step voxel by voxel (3D DDA) but jump straight across
+// 4³ and 16³ blocks that hold no solid cells, using two coarse "any
+// solid" levels built next to the mask. Positions are world units, voxel
+// (x, y, z) covering [x - 0.5, x + 0.5] like in VoxelCollider.
+//
+// The mask is referenced, not copied. After changing it, call update()
+// for the changed region (or rebuild()) so the coarse levels match.
+class LineOfSight {
+public:
+    explicit LineOfSight(const OccupancyMask &mask);
+
+    void rebuild();
+    // Refreshes the coarse levels over [min, max], world voxel coordinates.
+    void update(const Vec3i &min, const Vec3i &max);
+
+    // Skipping is on by default; turning it off walks every voxel, which
+    // is only useful for comparisons.
+    void setEmptySkipping(bool enabled);
+
+    // First solid voxel on the segment from -> to, ignoring the voxel that
+    // from lies in. False when the segment is clear.
+    bool raycast(const float from[3], const float to[3], RayHit *hit = nullptr) const;
+
+    // Nothing solid between the two points. The voxels the points are in
+    // do not block, so eyes inside a wall or targets on one still work.
+    bool canSee(const float from[3], const float to[3]) const;
+
+    // canSee() for count queries at once, split across the pool. visible[i]
+    // is set to 1 or 0.
+    void canSeeBatch(const SightQuery *queries, size_t count, uint8_t *visible, ThreadPool *pool = nullptr) const;
+
+    // Solid voxels within radius of eye that have at least one face it can
+    // see, sorted z, x, y. A face counts as seen when the ray from eye to a
+    // point just inside the face's centre reaches it unblocked, so this is
+    // a per-face ray cast rather than exact shadowcasting: slivers thinner
+    // than a face centre can be missed.
+    void visibleVoxels(const float eye[3], float radius, std::vector<Vec3i> &out, ThreadPool *pool = nullptr) const;
+
+private:
+    struct Level {
+        int shift;
+        Vec3i size;
+        std::vector<uint8_t> any;
+
+        bool get(int x, int y, int z) const {
+            return any[size_t(x >> shift) + size_t(y >> shift) * size.x + size_t(z >> shift) * size.x * size.y] != 0;
+        }
+    };
+
+    void buildFine(int bx0, int by0, int bz0, int bx1, int by1, int bz1, ThreadPool *pool);
+    void buildCoarse(int bx0, int by0, int bz0, int bx1, int by1, int bz1);
+    // Local mask coordinates shifted by 0.5, so voxel i covers [i, i + 1).
+    bool trace(const float from[3], const float to[3], RayHit *hit) const;
+
+    const OccupancyMask &mMask;
+    Level mLevels[2];
+    bool mSkipEmpty;
+};
+
+} // namespace vox
+
+#endif // LINEOFSIGHT_H
@@ -0,0 +1,176 @@
+#include "LocalAvoidance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Parallel.h"
+#include "SpatialHash.h"
+
+namespace vox {
+
+namespace {
+
+const int MAX_NEIGHBOURS = 16;
+const size_t AGENTS_PER_BLOCK = 256;
+
+struct Vec2 {
+    float x, z;
+
+    Vec2() : x(0.0f), z(0.0f) {}
+    Vec2(float x, float z) : x(x), z(z) {}
+
+    Vec2 operator+(const Vec2 &o) const { return Vec2(x + o.x, z + o.z); }
+    Vec2 operator-(const Vec2 &o) const { return Vec2(x - o.x, z - o.z); }
+    Vec2 operator*(float s) const { return Vec2(x * s, z * s); }
+};
+
+inline float dot(const Vec2 &a, const Vec2 &b) {
+    return a.x * b.x + a.z * b.z;
+}
+
+inline float det(const Vec2 &a, const Vec2 &b) {
+    return a.x * b.z - a.z * b.x;
+}
+
+// Velocities v with det(direction, point - v) <= 0 are allowed.
+struct HalfPlane {
+    Vec2 point;
+    Vec2 direction;
+};
+
+struct Neighbour {
+    uint32_t id;
+    float distSq;
+};
+
+inline Vec2 clampSpeed(const Vec2 &v, float maxSpeed) {
+    float lenSq = dot(v, v);
+    return lenSq > maxSpeed * maxSpeed ? v * (maxSpeed / std::sqrt(lenSq)) : v;
+}
+
+// Half-plane of velocities for a that avoid b, as in ORCA: take the
+// smallest change u that leaves the truncated velocity obstacle and let a
+// make half of it.
+HalfPlane orcaPlane(const AgentBody &a, const AgentBody &b, float timeHorizon, float dt) {
+    Vec2 relPos(b.x - a.x, b.z - a.z);
+    Vec2 velocity(a.vx, a.vz);
+    Vec2 relVel = velocity - Vec2(b.vx, b.vz);
+    float distSq = dot(relPos, relPos);
+    float radius = a.halfWidth + b.halfWidth;
+    float radiusSq = radius * radius;
+
+    HalfPlane plane;
+    Vec2 u;
+    if (distSq > radiusSq) {
+        float invHorizon = 1.0f / timeHorizon;
+        Vec2 w = relVel - relPos * invHorizon;
+        float wLenSq = dot(w, w);
+        float wDot = dot(w, relPos);
+        if (wDot < 0.0f && wDot * wDot > radiusSq * wLenSq) {
+            // Closest to the cut-off circle at the front of the cone.
+            float wLen = std::sqrt(wLenSq);
+            Vec2 unit = w * (1.0f / wLen);
+            plane.direction = Vec2(unit.z, -unit.x);
+            u = unit * (radius * invHorizon - wLen);
+        } else {
+            // Closest to one of the cone's legs.
+            float leg = std::sqrt(distSq - radiusSq);
+            if (det(relPos, w) > 0.0f) {
+                plane.direction = Vec2(relPos.x * leg - relPos.z * radius, relPos.x * radius + relPos.z * leg)
+                    * (1.0f / distSq);
+            } else {
+                plane.direction = Vec2(relPos.x * leg + relPos.z * radius, -relPos.x * radius + relPos.z * leg)
+                    * (-1.0f / distSq);
+            }
+            u = plane.direction * dot(relVel, plane.direction) - relVel;
+        }
+    } else {
+        // Already overlapping: push apart within one tick.
+        float invStep = 1.0f / dt;
+        Vec2 w = relVel - relPos * invStep;
+        float wLen = std::sqrt(dot(w, w));
+        Vec2 unit = wLen > 0.0f ? w * (1.0f / wLen) : Vec2(1.0f, 0.0f);
+        plane.direction = Vec2(unit.z, -unit.x);
+        u = unit * (radius * invStep - wLen);
+    }
+    plane.point = velocity + u * 0.5f;
+    return plane;
+}
+
+Vec2 solve(const HalfPlane *planes, int count, const Vec2 &preferred, const AvoidanceSettings &settings) {
+    Vec2 v = clampSpeed(preferred, settings.maxSpeed);
+    for (int pass = 0; pass < settings.iterations; ++pass) {
+        bool clear = true;
+        for (int i = 0; i < count; ++i) {
+            const HalfPlane &plane = planes[i];
+            if (det(plane.direction, plane.point - v) > 0.0f) {
+                v = plane.point + plane.direction * dot(plane.direction, v - plane.point);
+                clear = false;
+            }
+        }
+        v = clampSpeed(v, settings.maxSpeed);
+        if (clear) {
+            break;
+        }
+    }
+    return v;
+}
+
+} // namespace
+
+void avoidNeighbours(AgentBody *bodies, size_t count, const float *preferred, const SpatialHash &hash,
+                     float dt, const AvoidanceSettings &settings, ThreadPool *pool) {
+    int maxNeighbours = std::max(0, std::min(settings.maxNeighbours, MAX_NEIGHBOURS));
+    float rangeSq = settings.neighbourDistance * settings.neighbourDistance;
+    std::vector<float> result(count * 2);
+    size_t blocks = (count + AGENTS_PER_BLOCK - 1) / AGENTS_PER_BLOCK;
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    threads.parallelFor(blocks, [&](size_t block) {
+        std::vector<uint32_t> found;
+        Neighbour nearest[MAX_NEIGHBOURS];
+        HalfPlane planes[MAX_NEIGHBOURS];
+        size_t end = std::min(count, (block + 1) * AGENTS_PER_BLOCK);
+        for (size_t i = block * AGENTS_PER_BLOCK; i < end; ++i) {
+            const AgentBody &body = bodies[i];
+            found.clear();
+            hash.queryRadius(body.x, body.y, body.z, settings.neighbourDistance, found);
+
+            // Keep the closest few on the plane, sorted by insertion.
+            int kept = 0;
+            for (uint32_t id : found) {
+                const AgentBody &other = bodies[id];
+                float dy = other.y - body.y;
+                if (id == i || dy >= body.height || -dy >= other.height) {
+                    continue;
+                }
+                float dx = other.x - body.x;
+                float dz = other.z - body.z;
+                float distSq = dx * dx + dz * dz;
+                if (distSq > rangeSq || (kept == maxNeighbours && distSq >= nearest[kept - 1].distSq)) {
+                    continue;
+                }
+                int at = kept < maxNeighbours ? kept++ : kept - 1;
+                while (at > 0 && nearest[at - 1].distSq > distSq) {
+                    nearest[at] = nearest[at - 1];
+                    --at;
+                }
+                nearest[at].id = id;
+                nearest[at].distSq = distSq;
+            }
+
+            for (int n = 0; n < kept; ++n) {
+                planes[n] = orcaPlane(body, bodies[nearest[n].id], settings.timeHorizon, dt);
+            }
+            Vec2 v = solve(planes, kept, Vec2(preferred[i * 2], preferred[i * 2 + 1]), settings);
+            result[i * 2] = v.x;
+            result[i * 2 + 1] = v.z;
+        }
+    });
+    for (size_t i = 0; i < count; ++i) {
+        bodies[i].vx = result[i * 2];
+        bodies[i].vz = result[i * 2 + 1];
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,42 @@
+#ifndef LOCALAVOIDANCE_H
+#define LOCALAVOIDANCE_H
+
+#include <cstddef>
+
+#include "VoxelCollider.h"
+
+namespace vox {
+
+class SpatialHash;
+class ThreadPool;
+
+struct AvoidanceSettings {
+    float neighbourDistance;    // only agents this close are considered
+    int maxNeighbours;          // nearest ones kept, at most 16
+    float timeHorizon;          // seconds ahead that collisions are avoided
+    float maxSpeed;
+    int iterations;             // relaxation passes over the constraints
+
+    AvoidanceSettings()
+        : neighbourDistance(4.0f), maxNeighbours(10), timeHorizon(2.0f), maxSpeed(5.0f), iterations(4) {}
+};
+
+// Reciprocal velocity obstacle steering on the horizontal plane, a light
+// form of ORCA: every neighbour contributes a half-plane of velocities
+// that stay clear of it for timeHorizon, each side taking half of the
+// correction. Instead of ORCA's linear program the half-planes are
+// enforced by repeated projection, which is cheaper and close enough for
+// crowds.
+//
+// preferred holds the wanted (vx, vz) of every body as pairs. The result
+// replaces vx and vz of bodies; vertical motion is left alone. hash must
+// be built from the positions of the same bodies so its ids are body
+// indices. Agents are split across the pool and read only the old
+// velocities, so the result does not depend on the thread count.
+void avoidNeighbours(AgentBody *bodies, size_t count, const float *preferred, const SpatialHash &hash,
+                     float dt, const AvoidanceSettings &settings = AvoidanceSettings(),
+                     ThreadPool *pool = nullptr);
+
+} // namespace vox
+
+#endif // LOCALAVOIDANCE_H
@@ -0,0 +1,330 @@
+#include "MapFile.h"
+
+#include <cstring>
+
+#include "Serialization.h"
+
+namespace vox {
+
+const char MAP_MAGIC[4] = {'V', 'X', 'M', '1'};
+const char LOG_MAGIC[4] = {'V', 'X', 'L', '1'};
+
+namespace {
+
+const uint32_t FORMAT_VERSION = 1;
+const uint32_t MATERIALS_VERSION = 1;
+const uint32_t SETTINGS_VERSION = 1;
+const size_t RECORD_HEADER = 1 + 12 + 8 + 4;
+const uint32_t MAX_PAYLOAD = 64u << 20;
+
+bool fail(std::string *error, const std::string &message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+} // namespace
+
+MapRecordWriter::MapRecordWriter()
+    : mFile(nullptr), mSize(0) {}
+
+MapRecordWriter::~MapRecordWriter() {
+    close();
+}
+
+bool MapRecordWriter::open(const std::string &path, const char magic[4], bool append) {
+    close();
+    mFile = std::fopen(path.c_str(), append ? "ab" : "wb");
+    if (!mFile) {
+        return false;
+    }
+    std::fseek(mFile, 0, SEEK_END);
+    long size = std::ftell(mFile);
+    mSize = size > 0 ? uint64_t(size) : 0;
+    if (mSize == 0) {
+        std::vector<uint8_t> header;
+        ByteWriter out(header);
+        out.putBytes(magic, 4);
+        out.putU32(FORMAT_VERSION);
+        if (std::fwrite(header.data(), 1, header.size(), mFile) != header.size()) {
+            close();
+            return false;
+        }
+        mSize = header.size();
+    }
+    return true;
+}
+
+bool MapRecordWriter::write(uint8_t type, const Vec3i &chunk, uint64_t version, const std::vector<uint8_t> &payload) {
+    if (!mFile || payload.size() > MAX_PAYLOAD) {
+        return false;
+    }
+    std::vector<uint8_t> bytes;
+    bytes.reserve(RECORD_HEADER + payload.size() + 4);
+    ByteWriter out(bytes);
+    out.putU8(type);
+    out.putI32(chunk.x);
+    out.putI32(chunk.y);
+    out.putI32(chunk.z);
+    out.putU64(version);
+    out.putU32(uint32_t(payload.size()));
+    out.putBytes(payload.data(), payload.size());
+    out.putU32(checksum(bytes.data(), bytes.size()));
+    if (std::fwrite(bytes.data(), 1, bytes.size(), mFile) != bytes.size()) {
+        return false;
+    }
+    mSize += bytes.size();
+    return true;
+}
+
+bool MapRecordWriter::write(const MapRecord &record) {
+    return write(record.type, record.chunk, record.version, record.payload);
+}
+
+bool MapRecordWriter::flush() {
+    return mFile && std::fflush(mFile) == 0;
+}
+
+bool MapRecordWriter::close() {
+    if (!mFile) {
+        return true;
+    }
+    bool ok = std::fclose(mFile) == 0;
+    mFile = nullptr;
+    return ok;
+}
+
+bool MapRecordWriter::isOpen() const {
+    return mFile != nullptr;
+}
+
+uint64_t MapRecordWriter::getSize() const {
+    return mSize;
+}
+
+MapRecordReader::MapRecordReader()
+    : mFile(nullptr) {}
+
+MapRecordReader::~MapRecordReader() {
+    close();
+}
+
+bool MapRecordReader::open(const std::string &path, const char magic[4]) {
+    close();
+    mFile = std::fopen(path.c_str(), "rb");
+    if (!mFile) {
+        return false;
+    }
+    uint8_t header[8];
+    if (std::fread(header, 1, sizeof(header), mFile) != sizeof(header) || std::memcmp(header, magic, 4) != 0) {
+        close();
+        return false;
+    }
+    ByteReader in(header + 4, 4);
+    if (in.getU32() != FORMAT_VERSION) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MapRecordReader::next(MapRecord &record) {
+    if (!mFile) {
+        return false;
+    }
+    uint8_t header[RECORD_HEADER];
+    if (std::fread(header, 1, sizeof(header), mFile) != sizeof(header)) {
+        return false;
+    }
+    ByteReader in(header, sizeof(header));
+    record.type = in.getU8();
+    record.chunk.x = in.getI32();
+    record.chunk.y = in.getI32();
+    record.chunk.z = in.getI32();
+    record.version = in.getU64();
+    uint32_t length = in.getU32();
+    if (length > MAX_PAYLOAD) {
+        return false;
+    }
+    record.payload.resize(length);
+    uint8_t sum[4];
+    if (std::fread(record.payload.data(), 1, length, mFile) != length
+        || std::fread(sum, 1, sizeof(sum), mFile) != sizeof(sum)) {
+        return false;
+    }
+    uint32_t expected = checksum(header, sizeof(header));
+    // Continue the FNV state over the payload.
+    for (uint8_t b : record.payload) {
+        expected = (expected ^ b) * 16777619u;
+    }
+    ByteReader sumIn(sum, sizeof(sum));
+    return sumIn.getU32() == expected;
+}
+
+void MapRecordReader::close() {
+    if (mFile) {
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+std::string mapLogPath(const std::string &mapPath) {
+    return mapPath + ".log";
+}
+
+bool replaceFile(const std::string &from, const std::string &to) {
+    if (std::rename(from.c_str(), to.c_str()) == 0) {
+        return true;
+    }
+    // Windows will not rename over an existing file.
+    std::remove(to.c_str());
+    return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+void encodeMaterials(const MaterialRegistry &materials, std::vector<uint8_t> &out) {
+    out.clear();
+    ByteWriter w(out);
+    w.putU32(MATERIALS_VERSION);
+    w.putU32(uint32_t(materials.size()));
+    for (size_t i = 0; i < materials.size(); ++i) {
+        const Material &m = materials.get(MaterialId(i));
+        w.putString(m.name);
+        w.putString(m.texture);
+        w.putU32(m.color);
+        w.putU8(m.opaque ? 1 : 0);
+        w.putU8(m.emission);
+    }
+}
+
+bool decodeMaterials(const std::vector<uint8_t> &payload, MaterialRegistry &materials) {
+    ByteReader in(payload.data(), payload.size());
+    uint32_t version = in.getU32();
+    uint32_t count = in.getU32();
+    if (!in.ok() || version != MATERIALS_VERSION || count == 0 || count > 0x10000) {
+        return false;
+    }
+    std::vector<Material> decoded(count);
+    for (Material &m : decoded) {
+        m.name = in.getString();
+        m.texture = in.getString();
+        m.color = in.getU32();
+        m.opaque = in.getU8() != 0;
+        m.emission = in.getU8();
+    }
+    if (!in.ok()) {
+        return false;
+    }
+    materials.clear();
+    for (size_t i = 1; i < decoded.size(); ++i) {
+        materials.add(decoded[i]);
+    }
+    return true;
+}
+
+void encodeSettings(const VoxelMap &map, std::vector<uint8_t> &out) {
+    out.clear();
+    ByteWriter w(out);
+    w.putU32(SETTINGS_VERSION);
+    w.putU8(uint8_t(map.getSurfaceStyle()));
+}
+
+bool decodeSettings(const std::vector<uint8_t> &payload, VoxelMap &map) {
+    ByteReader in(payload.data(), payload.size());
+    uint32_t version = in.getU32();
+    uint8_t style = in.getU8();
+    if (!in.ok() || version != SETTINGS_VERSION || style > SURFACE_SMOOTH) {
+        return false;
+    }
+    map.setSurfaceStyle(SurfaceStyle(style));
+    return true;
+}
+
+bool saveMap(const VoxelMap &map, const std::string &path, std::string *error) {
+    const std::string temp = path + ".tmp";
+    MapRecordWriter writer;
+    if (!writer.open(temp, MAP_MAGIC, false)) {
+        return fail(error, "Cannot write " + temp);
+    }
+    std::vector<uint8_t> payload;
+    encodeMaterials(map.getMaterials(), payload);
+    bool ok = writer.write(RECORD_MATERIALS, Vec3i(), map.getVersion(), payload);
+    encodeSettings(map, payload);
+    ok = ok && writer.write(RECORD_SETTINGS, Vec3i(), map.getVersion(), payload);
+    for (const auto &entry : map.getChunks()) {
+        if (!ok) {
+            break;
+        }
+        payload.clear();
+        ByteWriter out(payload);
+        entry.second->write(out);
+        ok = writer.write(RECORD_CHUNK, entry.first, entry.second->getVersion(), payload);
+    }
+    payload.clear();
+    ok = ok && writer.write(RECORD_END, Vec3i(), map.getVersion(), payload);
+    ok = writer.close() && ok;
+    if (!ok || !replaceFile(temp, path)) {
+        std::remove(temp.c_str());
+        return fail(error, "Failed writing " + path);
+    }
+    std::remove(mapLogPath(path).c_str());
+    return true;
+}
+
+bool loadMap(VoxelMap &map, const std::string &path, std::string *error) {
+    MapRecordReader base;
+    MapRecordReader log;
+    bool haveBase = base.open(path, MAP_MAGIC);
+    bool haveLog = log.open(mapLogPath(path), LOG_MAGIC);
+    if (!haveBase && !haveLog) {
+        return fail(error, "Cannot read " + path);
+    }
+
+    map.clear();
+    MapRecord record;
+    auto apply = [&](const MapRecord &r) {
+        switch (r.type) {
+        case RECORD_MATERIALS:
+            return decodeMaterials(r.payload, map.getMaterials());
+        case RECORD_SETTINGS:
+            return decodeSettings(r.payload, map);
+        case RECORD_CHUNK: {
+            std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+            ByteReader in(r.payload.data(), r.payload.size());
+            if (!chunk->read(in)) {
+                return false;
+            }
+            map.setChunk(r.chunk, std::move(chunk));
+            return true;
+        }
+        case RECORD_REMOVE:
+            map.removeChunk(r.chunk);
+            return true;
+        default:
+            return true;
+        }
+    };
+
+    bool ended = !haveBase;
+    while (haveBase && base.next(record)) {
+        if (record.type == RECORD_END) {
+            ended = true;
+            break;
+        }
+        if (!apply(record)) {
+            return fail(error, "Corrupt chunk data in " + path);
+        }
+    }
+    if (!ended) {
+        return fail(error, "Truncated map file " + path);
+    }
+    // The log may end in a half written record after a crash, keep what is whole.
+    while (haveLog && log.next(record)) {
+        if (!apply(record)) {
+            break;
+        }
+    }
+    return true;
+}
+
+} // namespace vox
@@ -0,0 +1,87 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+// Map files (.vxm) and their chunk logs (.vxm.log) share one record framing:
+//   u8 type, i32 x y z, u64 version, u32 length, payload, u32 checksum
+// A map file is a header, one materials record, an optional settings
+// record, chunk records and an end record. The log is a header followed by
+// records appended by autosave; loading replays it over the map file and
+// ignores a torn last record.
+enum MapRecordType {
+    RECORD_MATERIALS = 1,
+    RECORD_CHUNK = 2,
+    RECORD_REMOVE = 3,
+    RECORD_END = 4,
+    RECORD_SETTINGS = 5
+};
+
+struct MapRecord {
+    uint8_t type;
+    Vec3i chunk;
+    uint64_t version;
+    std::vector<uint8_t> payload;
+};
+
+class MapRecordWriter {
+public:
+    MapRecordWriter();
+    ~MapRecordWriter();
+
+    // Creates (or with append, extends) a file starting with magic.
+    bool open(const std::string &path, const char magic[4], bool append);
+    bool write(uint8_t type, const Vec3i &chunk, uint64_t version, const std::vector<uint8_t> &payload);
+    bool write(const MapRecord &record);
+    bool flush();
+    bool close();
+    bool isOpen() const;
+    uint64_t getSize() const;
+
+private:
+    FILE *mFile;
+    uint64_t mSize;
+};
+
+class MapRecordReader {
+public:
+    MapRecordReader();
+    ~MapRecordReader();
+
+    bool open(const std::string &path, const char magic[4]);
+    // False at the end of the file or at the first damaged record.
+    bool next(MapRecord &record);
+    void close();
+
+private:
+    FILE *mFile;
+};
+
+extern const char MAP_MAGIC[4];
+extern const char LOG_MAGIC[4];
+
+std::string mapLogPath(const std::string &mapPath);
+// Renames from over to, replacing it where the platform will not.
+bool replaceFile(const std::string &from, const std::string &to);
+
+void encodeMaterials(const MaterialRegistry &materials, std::vector<uint8_t> &out);
+bool decodeMaterials(const std::vector<uint8_t> &payload, MaterialRegistry &materials);
+// Map wide settings that are not materials, currently the surface style.
+// Files without the record load with the defaults.
+void encodeSettings(const VoxelMap &map, std::vector<uint8_t> &out);
+bool decodeSettings(const std::vector<uint8_t> &payload, VoxelMap &map);
+
+// Writes the whole map and drops the chunk log.
+bool saveMap(const VoxelMap &map, const std::string &path, std::string *error = nullptr);
+// Reads the map file, then replays its chunk log if there is one.
+bool loadMap(VoxelMap &map, const std::string &path, std::string *error = nullptr);
+
+} // namespace vox
+
+#endif // MAPFILE_H
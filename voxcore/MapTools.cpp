@@ -0,0 +1,499 @@
+#include "MapTools.h"
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Parallel.h"
+#include "Serialization.h"
+
+namespace vox {
+
+namespace {
+
+const size_t MAX_PROBLEMS_PER_CHUNK = 4;
+
+ThreadPool &poolOrDefault(ThreadPool *pool) {
+    return pool ? *pool : defaultThreadPool();
+}
+
+std::vector<Vec3i> chunkKeys(const VoxelMap &map) {
+    std::vector<Vec3i> keys;
+    keys.reserve(map.getChunkCount());
+    for (const auto &entry : map.getChunks()) {
+        keys.push_back(entry.first);
+    }
+    return keys;
+}
+
+Vec3i chunkBase(const Vec3i &chunk) {
+    return Vec3i(chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, chunk.z * CHUNK_SIZE);
+}
+
+std::string chunkName(const Vec3i &chunk) {
+    return "chunk " + std::to_string(chunk.x) + " " + std::to_string(chunk.y) + " " + std::to_string(chunk.z);
+}
+
+VoxelBox intersect(const VoxelBox &a, const VoxelBox &b) {
+    return VoxelBox(Vec3i(std::max(a.min.x, b.min.x), std::max(a.min.y, b.min.y), std::max(a.min.z, b.min.z)),
+                    Vec3i(std::min(a.max.x, b.max.x), std::min(a.max.y, b.max.y), std::min(a.max.z, b.max.z)));
+}
+
+void include(VoxelBox &box, const Vec3i &p) {
+    if (box.empty()) {
+        box = VoxelBox(p, p);
+        return;
+    }
+    box.min = Vec3i(std::min(box.min.x, p.x), std::min(box.min.y, p.y), std::min(box.min.z, p.z));
+    box.max = Vec3i(std::max(box.max.x, p.x), std::max(box.max.y, p.y), std::max(box.max.z, p.z));
+}
+
+int axisOf(const Vec3i &v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+int &axisOf(Vec3i &v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+// Source cells are looked up through the last chunk touched, neighbouring
+// destination cells mostly come from the same source chunk.
+class CellReader {
+public:
+    explicit CellReader(const VoxelMap &map) : mMap(map), mChunk(nullptr), mValid(false) {}
+
+    const Chunk *find(const Vec3i &p, int &index) {
+        Vec3i key = chunkOf(p);
+        if (!mValid || key != mKey) {
+            mChunk = mMap.findChunk(key);
+            mKey = key;
+            mValid = true;
+        }
+        index = cellIndex(localCoord(p.x), localCoord(p.y), localCoord(p.z));
+        return mChunk;
+    }
+
+private:
+    const VoxelMap &mMap;
+    const Chunk *mChunk;
+    Vec3i mKey;
+    bool mValid;
+};
+
+// A mapping tells resample() which source cell lands on a destination cell
+// (source) and which destination cells a source box can reach (target).
+
+struct CropMapping {
+    VoxelBox box;
+
+    bool source(const Vec3i &p, Vec3i &from) const {
+        from = p;
+        return box.contains(p);
+    }
+    VoxelBox target(const VoxelBox &b) const { return intersect(b, box); }
+};
+
+struct TranslateMapping {
+    Vec3i offset;
+
+    bool source(const Vec3i &p, Vec3i &from) const {
+        from = p - offset;
+        return true;
+    }
+    VoxelBox target(const VoxelBox &b) const { return VoxelBox(b.min + offset, b.max + offset); }
+};
+
+struct ResizeMapping {
+    VoxelBox from;
+    Vec3i size;
+
+    bool source(const Vec3i &p, Vec3i &out) const {
+        Vec3i r = p - from.min;
+        Vec3i s = from.size();
+        if (r.x < 0 || r.y < 0 || r.z < 0 || r.x >= size.x || r.y >= size.y || r.z >= size.z) {
+            return false;
+        }
+        out = from.min + Vec3i(int(int64_t(r.x) * s.x / size.x), int(int64_t(r.y) * s.y / size.y),
+                               int(int64_t(r.z) * s.z / size.z));
+        return true;
+    }
+
+    VoxelBox target(const VoxelBox &b) const {
+        VoxelBox clipped = intersect(b, from);
+        if (clipped.empty()) {
+            return clipped;
+        }
+        Vec3i s = from.size();
+        VoxelBox out;
+        for (int a = 0; a < 3; ++a) {
+            int64_t lo = axisOf(clipped.min, a) - axisOf(from.min, a);
+            int64_t hi = axisOf(clipped.max, a) - axisOf(from.min, a) + 1;
+            int64_t n = axisOf(size, a);
+            int64_t d = axisOf(s, a);
+            axisOf(out.min, a) = int(lo * n / d);
+            axisOf(out.max, a) = int(std::min(n, (hi * n + d - 1) / d) - 1);
+        }
+        return VoxelBox(out.min + from.min, out.max + from.min);
+    }
+};
+
+struct RotateMapping {
+    VoxelBox from;
+    int axis;
+    int turns;
+
+    // One counter-clockwise quarter turn of r inside a box of size, which
+    // is updated to the turned box.
+    Vec3i turn(const Vec3i &r, Vec3i &size) const {
+        Vec3i s = size;
+        switch (axis) {
+        case 0:
+            size = Vec3i(s.x, s.z, s.y);
+            return Vec3i(r.x, s.z - 1 - r.z, r.y);
+        case 1:
+            size = Vec3i(s.z, s.y, s.x);
+            return Vec3i(s.z - 1 - r.z, r.y, r.x);
+        default:
+            size = Vec3i(s.y, s.x, s.z);
+            return Vec3i(s.y - 1 - r.y, r.x, r.z);
+        }
+    }
+
+    Vec3i turnedSize() const {
+        Vec3i size = from.size();
+        for (int t = 0; t < turns; ++t) {
+            turn(Vec3i(), size);
+        }
+        return size;
+    }
+
+    bool source(const Vec3i &p, Vec3i &out) const {
+        Vec3i r = p - from.min;
+        Vec3i size = turnedSize();
+        if (r.x < 0 || r.y < 0 || r.z < 0 || r.x >= size.x || r.y >= size.y || r.z >= size.z) {
+            return false;
+        }
+        // Turning the rest of the way round brings r back to the source.
+        for (int t = turns; t < 4; ++t) {
+            r = turn(r, size);
+        }
+        out = from.min + r;
+        return true;
+    }
+
+    VoxelBox target(const VoxelBox &b) const {
+        VoxelBox clipped = intersect(b, from);
+        VoxelBox out;
+        if (clipped.empty()) {
+            return out;
+        }
+        for (int c = 0; c < 8; ++c) {
+            Vec3i r((c & 1 ? clipped.max.x : clipped.min.x), (c & 2 ? clipped.max.y : clipped.min.y),
+                    (c & 4 ? clipped.max.z : clipped.min.z));
+            r = r - from.min;
+            Vec3i size = from.size();
+            for (int t = 0; t < turns; ++t) {
+                r = turn(r, size);
+            }
+            include(out, from.min + r);
+        }
+        return out;
+    }
+};
+
+// Fills the dst chunks that mapping can reach from src. With overlay the
+// existing dst cells are kept wherever the source cell is air. remap
+// translates source material ids, empty means they are used as they are.
+template <typename Mapping>
+void resample(const VoxelMap &src, const Mapping &mapping, const std::vector<uint32_t> &remap, bool overlay,
+              VoxelMap &dst, ThreadPool *pool) {
+    std::unordered_set<Vec3i, Vec3iHash> targets;
+    for (const auto &entry : src.getChunks()) {
+        if (entry.second->isEmpty() && !entry.second->hasAttributes()) {
+            continue;
+        }
+        Vec3i base = chunkBase(entry.first);
+        VoxelBox box = mapping.target(VoxelBox(base, base + Vec3i(CHUNK_MASK, CHUNK_MASK, CHUNK_MASK)));
+        if (box.empty()) {
+            continue;
+        }
+        Vec3i lo = chunkOf(box.min);
+        Vec3i hi = chunkOf(box.max);
+        for (int z = lo.z; z <= hi.z; ++z) {
+            for (int y = lo.y; y <= hi.y; ++y) {
+                for (int x = lo.x; x <= hi.x; ++x) {
+                    targets.insert(Vec3i(x, y, z));
+                }
+            }
+        }
+    }
+
+    std::vector<Vec3i> keys(targets.begin(), targets.end());
+    std::vector<std::shared_ptr<Chunk>> results(keys.size());
+    poolOrDefault(pool).parallelFor(keys.size(), [&](size_t i) {
+        std::shared_ptr<const Chunk> existing = overlay ? dst.shareChunk(keys[i]) : nullptr;
+        std::shared_ptr<Chunk> chunk = existing ? std::make_shared<Chunk>(*existing) : std::make_shared<Chunk>();
+        std::vector<uint32_t> materials(CHUNK_VOLUME);
+        chunk->getMaterials().decode(materials.data());
+        std::vector<uint32_t> attributes[ATTR_COUNT];
+        for (int c = 0; c < ATTR_COUNT; ++c) {
+            if (chunk->hasAttribute(AttributeChannel(c))) {
+                attributes[c].resize(CHUNK_VOLUME);
+                chunk->getAttributes(AttributeChannel(c))->decode(attributes[c].data());
+            }
+        }
+
+        CellReader reader(src);
+        Vec3i base = chunkBase(keys[i]);
+        bool changed = false;
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                for (int x = 0; x < CHUNK_SIZE; ++x) {
+                    Vec3i from;
+                    int index;
+                    const Chunk *cells = mapping.source(base + Vec3i(x, y, z), from) ? reader.find(from, index) : nullptr;
+                    if (!cells) {
+                        continue;
+                    }
+                    MaterialId material = cells->getMaterial(index);
+                    if (overlay && material == AIR) {
+                        continue;
+                    }
+                    int cell = cellIndex(x, y, z);
+                    materials[cell] = material < remap.size() ? remap[material] : material;
+                    for (int c = 0; c < ATTR_COUNT; ++c) {
+                        AttributeChannel channel = AttributeChannel(c);
+                        uint32_t value = cells->hasAttribute(channel) ? cells->getAttribute(channel, index) : 0;
+                        if (value && attributes[c].empty()) {
+                            attributes[c].assign(CHUNK_VOLUME, 0);
+                        }
+                        if (!attributes[c].empty()) {
+                            attributes[c][cell] = value;
+                        }
+                    }
+                    changed = true;
+                }
+            }
+        }
+        if (!changed) {
+            return;
+        }
+        chunk->getMaterials().encode(materials.data());
+        for (int c = 0; c < ATTR_COUNT; ++c) {
+            if (!attributes[c].empty()) {
+                chunk->getOrCreateAttributes(AttributeChannel(c)).encode(attributes[c].data());
+            }
+        }
+        chunk->compact();
+        if (!chunk->isEmpty() || chunk->hasAttributes()) {
+            results[i] = std::move(chunk);
+        }
+    });
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (results[i]) {
+            dst.setChunk(keys[i], std::move(results[i]));
+        }
+    }
+}
+
+void startCopy(const VoxelMap &src, VoxelMap &dst) {
+    dst.clear();
+    dst.getMaterials() = src.getMaterials();
+}
+
+struct ChunkCounts {
+    std::vector<std::pair<uint32_t, uint32_t>> materials;   // id, cells
+    VoxelBox bounds;
+    bool empty;
+    bool uniform;
+    bool attributes;
+    size_t bytes;
+};
+
+} // namespace
+
+void computeMapStats(const VoxelMap &map, MapStats &stats, ThreadPool *pool) {
+    std::vector<Vec3i> keys = chunkKeys(map);
+    std::vector<ChunkCounts> counts(keys.size());
+    poolOrDefault(pool).parallelFor(keys.size(), [&](size_t i) {
+        const Chunk &chunk = *map.findChunk(keys[i]);
+        ChunkCounts &out = counts[i];
+        out.empty = chunk.isEmpty() && !chunk.hasAttributes();
+        out.uniform = chunk.getMaterials().isUniform();
+        out.attributes = chunk.hasAttributes();
+        out.bytes = chunk.memoryUsage();
+        Vec3i base = chunkBase(keys[i]);
+        if (out.uniform) {
+            uint32_t material = chunk.getMaterials().get(0);
+            out.materials.emplace_back(material, CHUNK_VOLUME);
+            if (material != AIR) {
+                out.bounds = VoxelBox(base, base + Vec3i(CHUNK_MASK, CHUNK_MASK, CHUNK_MASK));
+            }
+            return;
+        }
+        std::vector<uint32_t> values(CHUNK_VOLUME);
+        chunk.getMaterials().decode(values.data());
+        std::unordered_map<uint32_t, uint32_t> cells;
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                const uint32_t *row = &values[cellIndex(0, y, z)];
+                for (int x = 0; x < CHUNK_SIZE; ++x) {
+                    ++cells[row[x]];
+                    if (row[x] != AIR) {
+                        include(out.bounds, base + Vec3i(x, y, z));
+                    }
+                }
+            }
+        }
+        out.materials.assign(cells.begin(), cells.end());
+    });
+
+    stats = MapStats();
+    stats.chunks = keys.size();
+    stats.materialVoxels.assign(map.getMaterials().size(), 0);
+    stats.memoryBytes = map.memoryUsage();
+    for (const ChunkCounts &chunk : counts) {
+        stats.emptyChunks += chunk.empty ? 1 : 0;
+        stats.uniformChunks += chunk.uniform ? 1 : 0;
+        stats.attributeChunks += chunk.attributes ? 1 : 0;
+        for (const auto &entry : chunk.materials) {
+            if (entry.first >= stats.materialVoxels.size()) {
+                stats.materialVoxels.resize(entry.first + 1, 0);
+            }
+            stats.materialVoxels[entry.first] += entry.second;
+            stats.solidVoxels += entry.first != AIR ? entry.second : 0;
+        }
+        if (!chunk.bounds.empty()) {
+            include(stats.bounds, chunk.bounds.min);
+            include(stats.bounds, chunk.bounds.max);
+        }
+    }
+}
+
+std::vector<std::string> validateMap(const VoxelMap &map, ThreadPool *pool) {
+    std::vector<Vec3i> keys = chunkKeys(map);
+    std::vector<std::vector<std::string>> found(keys.size());
+    size_t materialCount = map.getMaterials().size();
+    uint64_t mapVersion = map.getVersion();
+    poolOrDefault(pool).parallelFor(keys.size(), [&](size_t i) {
+        const Chunk &chunk = *map.findChunk(keys[i]);
+        std::vector<std::string> &problems = found[i];
+        std::string name = chunkName(keys[i]);
+        if (chunk.getVersion() > mapVersion) {
+            problems.push_back(name + ": version " + std::to_string(chunk.getVersion()) + " is newer than the map");
+        }
+
+        std::vector<uint32_t> values(CHUNK_VOLUME);
+        chunk.getMaterials().decode(values.data());
+        for (int cell = 0; cell < CHUNK_VOLUME; ++cell) {
+            if (values[cell] >= materialCount) {
+                problems.push_back(name + ": unknown material id " + std::to_string(values[cell]));
+                break;
+            }
+        }
+
+        // Whatever is saved has to come back the same.
+        std::vector<uint8_t> bytes;
+        ByteWriter out(bytes);
+        chunk.write(out);
+        ByteReader in(bytes.data(), bytes.size());
+        Chunk copy;
+        if (!copy.read(in)) {
+            problems.push_back(name + ": storage does not read back");
+            return;
+        }
+        std::vector<uint32_t> reread(CHUNK_VOLUME);
+        copy.getMaterials().decode(reread.data());
+        if (reread != values) {
+            problems.push_back(name + ": materials change when written and read back");
+        }
+        for (int c = 0; c < ATTR_COUNT && problems.size() < MAX_PROBLEMS_PER_CHUNK; ++c) {
+            AttributeChannel channel = AttributeChannel(c);
+            for (int cell = 0; cell < CHUNK_VOLUME; ++cell) {
+                if (chunk.getAttribute(channel, cell) != copy.getAttribute(channel, cell)) {
+                    problems.push_back(name + ": attribute channel " + std::to_string(c)
+                                       + " changes when written and read back");
+                    break;
+                }
+            }
+        }
+    });
+
+    std::vector<std::string> problems;
+    const MaterialRegistry &materials = map.getMaterials();
+    std::unordered_map<std::string, size_t> names;
+    for (size_t i = 1; i < materials.size(); ++i) {
+        const std::string &name = materials.get(MaterialId(i)).name;
+        if (name.empty()) {
+            continue;
+        }
+        auto it = names.emplace(name, i);
+        if (!it.second) {
+            problems.push_back("materials " + std::to_string(it.first->second) + " and " + std::to_string(i)
+                               + " are both named \"" + name + "\"");
+        }
+    }
+    for (std::vector<std::string> &chunk : found) {
+        problems.insert(problems.end(), chunk.begin(), chunk.end());
+    }
+    return problems;
+}
+
+void compactMap(VoxelMap &map, ThreadPool *pool) {
+    std::vector<Chunk *> chunks;
+    chunks.reserve(map.getChunkCount());
+    for (const auto &entry : map.getChunks()) {
+        // Same rule as VoxelMap::compact(): chunks a snapshot holds are skipped.
+        if (entry.second.use_count() == 1) {
+            chunks.push_back(entry.second.get());
+        }
+    }
+    poolOrDefault(pool).parallelFor(chunks.size(), [&](size_t i) {
+        chunks[i]->compact();
+    });
+    // Only empty chunks are left to drop, their compact() is a no-op.
+    map.compact();
+}
+
+void cropMap(const VoxelMap &src, const VoxelBox &box, VoxelMap &dst, ThreadPool *pool) {
+    startCopy(src, dst);
+    if (!box.empty()) {
+        resample(src, CropMapping{box}, std::vector<uint32_t>(), false, dst, pool);
+    }
+}
+
+void resizeMap(const VoxelMap &src, const Vec3i &size, VoxelMap &dst, ThreadPool *pool) {
+    MapStats stats;
+    computeMapStats(src, stats, pool);
+    startCopy(src, dst);
+    if (!stats.bounds.empty() && size.x > 0 && size.y > 0 && size.z > 0) {
+        resample(src, ResizeMapping{stats.bounds, size}, std::vector<uint32_t>(), false, dst, pool);
+    }
+}
+
+void rotateMap(const VoxelMap &src, int axis, int quarterTurns, VoxelMap &dst, ThreadPool *pool) {
+    MapStats stats;
+    computeMapStats(src, stats, pool);
+    startCopy(src, dst);
+    if (!stats.bounds.empty()) {
+        int turns = ((quarterTurns % 4) + 4) % 4;
+        resample(src, RotateMapping{stats.bounds, std::min(std::max(axis, 0), 2), turns},
+                 std::vector<uint32_t>(), false, dst, pool);
+    }
+}
+
+void mergeMap(VoxelMap &dst, const VoxelMap &src, const Vec3i &offset, ThreadPool *pool) {
+    const MaterialRegistry &from = src.getMaterials();
+    MaterialRegistry &to = dst.getMaterials();
+    std::vector<uint32_t> remap(from.size(), AIR);
+    for (size_t i = 1; i < from.size(); ++i) {
+        const Material &material = from.get(MaterialId(i));
+        MaterialId id = material.name.empty() ? AIR : to.findByName(material.name);
+        remap[i] = id != AIR ? id : to.add(material);
+    }
+    resample(src, TranslateMapping{offset}, remap, true, dst, pool);
+}
+
+} // namespace vox
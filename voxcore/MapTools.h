@@ -0,0 +1,76 @@
+#ifndef MAPTOOLS_H
+#define MAPTOOLS_H
+
+#include <string>
+#include <vector>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+class ThreadPool;
+
+// Inclusive range of voxel coordinates. Default constructed boxes are empty.
+struct VoxelBox {
+    Vec3i min;
+    Vec3i max;
+
+    VoxelBox() : min(0, 0, 0), max(-1, -1, -1) {}
+    VoxelBox(const Vec3i &min, const Vec3i &max) : min(min), max(max) {}
+
+    bool empty() const { return max.x < min.x || max.y < min.y || max.z < min.z; }
+    Vec3i size() const { return empty() ? Vec3i() : max - min + Vec3i(1, 1, 1); }
+    bool contains(const Vec3i &p) const {
+        return p.x >= min.x && p.y >= min.y && p.z >= min.z && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+    }
+};
+
+struct MapStats {
+    size_t chunks;
+    size_t emptyChunks;     // no solid cells and no attributes, compact() drops them
+    size_t uniformChunks;   // one material throughout, stored without index words
+    size_t attributeChunks;
+    uint64_t solidVoxels;
+    std::vector<uint64_t> materialVoxels;   // indexed by material id
+    VoxelBox bounds;                        // of the solid voxels
+    size_t memoryBytes;
+
+    MapStats()
+        : chunks(0), emptyChunks(0), uniformChunks(0), attributeChunks(0), solidVoxels(0), memoryBytes(0) {}
+};
+
+// Chunks are counted in parallel; a null pool uses defaultThreadPool().
+void computeMapStats(const VoxelMap &map, MapStats &stats, ThreadPool *pool = nullptr);
+
+// Checks every chunk for unknown material ids, versions newer than the map
+// and storage that does not survive a write/read round trip, and the
+// registry for duplicate names. Returns what was found, empty when the map
+// is consistent.
+std::vector<std::string> validateMap(const VoxelMap &map, ThreadPool *pool = nullptr);
+
+// Compacts every chunk in parallel, then drops the empty ones.
+void compactMap(VoxelMap &map, ThreadPool *pool = nullptr);
+
+// The transforms below write a new map into dst (cleared first, materials
+// copied from src) and carry attributes along with materials. Destination
+// chunks are filled in parallel, each from the source cells it covers.
+
+// Keeps the cells inside box where they are.
+void cropMap(const VoxelMap &src, const VoxelBox &box, VoxelMap &dst, ThreadPool *pool = nullptr);
+
+// Scales the solid bounds to size with nearest neighbour sampling, keeping
+// the bounds' minimum corner in place.
+void resizeMap(const VoxelMap &src, const Vec3i &size, VoxelMap &dst, ThreadPool *pool = nullptr);
+
+// Rotates the solid bounds by quarterTurns * 90 degrees about axis (0 x,
+// 1 y, 2 z, counter-clockwise looking down the axis), keeping the bounds'
+// minimum corner in place.
+void rotateMap(const VoxelMap &src, int axis, int quarterTurns, VoxelMap &dst, ThreadPool *pool = nullptr);
+
+// Pastes the solid cells of src into dst at offset; air in src leaves dst
+// alone. src materials are matched to dst's by name and added when missing.
+void mergeMap(VoxelMap &dst, const VoxelMap &src, const Vec3i &offset, ThreadPool *pool = nullptr);
+
+} // namespace vox
+
+#endif // MAPTOOLS_H
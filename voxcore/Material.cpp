@@ -0,0 +1,65 @@
+#include "Material.h"
+
+#include <stdexcept>
+
+namespace vox {
+
+MaterialRegistry::MaterialRegistry() {
+    clear();
+}
+
+MaterialId MaterialRegistry::add(const Material &material) {
+    if (mMaterials.size() > 0xFFFF) {
+        throw std::runtime_error("Too many materials");
+    }
+    mMaterials.push_back(material);
+    return MaterialId(mMaterials.size() - 1);
+}
+
+const Material &MaterialRegistry::get(MaterialId id) const {
+    return id < mMaterials.size() ? mMaterials[id] : mMaterials[AIR];
+}
+
+Material &MaterialRegistry::get(MaterialId id) {
+    return id < mMaterials.size() ? mMaterials[id] : mMaterials[AIR];
+}
+
+MaterialId MaterialRegistry::findByName(const std::string &name) const {
+    for (size_t i = 1; i < mMaterials.size(); ++i) {
+        if (mMaterials[i].name == name) {
+            return MaterialId(i);
+        }
+    }
+    return AIR;
+}
+
+MaterialId MaterialRegistry::findByTexture(const std::string &texture) const {
+    for (size_t i = 1; i < mMaterials.size(); ++i) {
+        if (mMaterials[i].texture == texture) {
+            return MaterialId(i);
+        }
+    }
+    return AIR;
+}
+
+MaterialId MaterialRegistry::getOrAddTexture(const std::string &texture) {
+    MaterialId id = findByTexture(texture);
+    if (id == AIR) {
+        Material material(texture);
+        material.texture = texture;
+        id = add(material);
+    }
+    return id;
+}
+
+size_t MaterialRegistry::size() const {
+    return mMaterials.size();
+}
+
+void MaterialRegistry::clear() {
+    Material air("air", 0);
+    air.opaque = false;
+    mMaterials.assign(1, air);
+}
+
+} // namespace vox
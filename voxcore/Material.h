@@ -0,0 +1,48 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <string>
+#include <vector>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+struct Material {
+    std::string name;
+    std::string texture;
+    uint32_t color;     // 0xAARRGGBB
+    bool opaque;
+    uint8_t emission;   // block light level 0..15
+
+    Material(const std::string &name = std::string(), uint32_t color = 0xFFFFFFFF)
+        : name(name), color(color), opaque(true), emission(0) {}
+};
+
+// Maps the small material ids stored in chunks to their description.
+// Id 0 is reserved for air and always present.
+class MaterialRegistry {
+public:
+    MaterialRegistry();
+
+    MaterialId add(const Material &material);
+    const Material &get(MaterialId id) const;
+    Material &get(MaterialId id);
+
+    // Returns AIR when nothing matches.
+    MaterialId findByName(const std::string &name) const;
+    MaterialId findByTexture(const std::string &texture) const;
+
+    // Registers a textured material once and returns its id.
+    MaterialId getOrAddTexture(const std::string &texture);
+
+    size_t size() const;
+    void clear();
+
+private:
+    std::vector<Material> mMaterials;
+};
+
+} // namespace vox
+
+#endif // MATERIAL_H
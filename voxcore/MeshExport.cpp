@@ -0,0 +1,443 @@
+#include "MeshExport.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include "GreedyMesher.h"
+#include "Parallel.h"
+#include "Serialization.h"
+
+namespace vox {
+
+namespace {
+
+const float FACE_NORMALS[FACE_COUNT][3] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+};
+
+const size_t COPY_BLOCK = 1 << 20;
+const uint32_t GLB_MAGIC = 0x46546C67;     // "glTF"
+const uint32_t GLB_JSON = 0x4E4F534A;      // "JSON"
+const uint32_t GLB_BIN = 0x004E4942;       // "BIN\0"
+const int GL_FLOAT = 5126;
+const int GL_UNSIGNED_SHORT = 5123;
+const int GL_UNSIGNED_INT = 5125;
+const int GL_ARRAY_BUFFER = 34962;
+const int GL_ELEMENT_ARRAY_BUFFER = 34963;
+
+bool fail(std::string *error, const std::string &message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+void appendf(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+void appendf(std::string &out, const char *format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int n = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (n > 0) {
+        out.append(buffer, size_t(n) < sizeof(buffer) ? size_t(n) : sizeof(buffer) - 1);
+    }
+}
+
+std::vector<Vec3i> sortedChunks(const VoxelMap &map) {
+    std::vector<Vec3i> chunks;
+    chunks.reserve(map.getChunkCount());
+    for (const auto &entry : map.getChunks()) {
+        chunks.push_back(entry.first);
+    }
+    std::sort(chunks.begin(), chunks.end(), [](const Vec3i &a, const Vec3i &b) {
+        return a.z != b.z ? a.z < b.z : (a.y != b.y ? a.y < b.y : a.x < b.x);
+    });
+    return chunks;
+}
+
+// Meshes the map batch by batch. encode(mesh, slot) runs on the pool right
+// after meshing, write(slot) runs on the calling thread in chunk order.
+bool meshInBatches(const VoxelMap &map, const ExportOptions &options,
+                   const std::function<void(const GreedyMesh &, size_t)> &encode,
+                   const std::function<bool(const GreedyMesh &, size_t)> &write,
+                   ExportStats &stats) {
+    ThreadPool &pool = options.pool ? *options.pool : defaultThreadPool();
+    std::vector<Vec3i> chunks = sortedChunks(map);
+    size_t batchSize = std::max<size_t>(1, options.batchChunks);
+    std::vector<GreedyMesh> meshes(std::min(batchSize, chunks.size()));
+    for (size_t first = 0; first < chunks.size(); first += batchSize) {
+        size_t count = std::min(batchSize, chunks.size() - first);
+        pool.parallelFor(count, [&](size_t i) {
+            GreedyMesher mesher(map);
+            mesher.mesh(chunks[first + i], meshes[i]);
+            if (!meshes[i].empty()) {
+                encode(meshes[i], i);
+            }
+        });
+        for (size_t i = 0; i < count; ++i) {
+            if (meshes[i].empty()) {
+                continue;
+            }
+            if (!write(meshes[i], i)) {
+                return false;
+            }
+            ++stats.chunks;
+            stats.vertices += meshes[i].vertices.size();
+            stats.triangles += meshes[i].indices.size() / 3;
+            meshes[i].clear();
+        }
+    }
+    return true;
+}
+
+std::string materialName(const MaterialRegistry &materials, MaterialId id) {
+    std::string name = "m" + std::to_string(id);
+    const std::string &label = materials.get(id).name;
+    if (!label.empty()) {
+        name += "_";
+        for (char c : label) {
+            name += (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.') ? c : '_';
+        }
+    }
+    return name;
+}
+
+float channel(uint32_t color, int shift) {
+    return ((color >> shift) & 0xFF) / 255.0f;
+}
+
+float srgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+bool writeMtl(const MaterialRegistry &materials, const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    for (size_t i = 1; i < materials.size(); ++i) {
+        const Material &material = materials.get(MaterialId(i));
+        float emit = material.emission / 15.0f;
+        std::fprintf(file, "newmtl %s\n", materialName(materials, MaterialId(i)).c_str());
+        std::fprintf(file, "Kd %.4f %.4f %.4f\n", channel(material.color, 16), channel(material.color, 8), channel(material.color, 0));
+        std::fprintf(file, "d %.4f\n", channel(material.color, 24));
+        if (emit > 0.0f) {
+            std::fprintf(file, "Ke %.4f %.4f %.4f\n", channel(material.color, 16) * emit,
+                         channel(material.color, 8) * emit, channel(material.color, 0) * emit);
+        }
+        if (!material.texture.empty()) {
+            std::fprintf(file, "map_Kd %s\n", material.texture.c_str());
+        }
+        std::fprintf(file, "\n");
+    }
+    return std::fclose(file) == 0;
+}
+
+class GlbBuilder {
+public:
+    explicit GlbBuilder(const MaterialRegistry &materials) : mMaterials(materials) {}
+
+    // Blob layout: positions, normals, then the index ranges back to back,
+    // each part padded to 4 bytes.
+    static void encode(const GreedyMesh &mesh, std::vector<uint8_t> &blob) {
+        blob.clear();
+        ByteWriter out(blob);
+        for (const GreedyVertex &v : mesh.vertices) {
+            out.putF32(v.x);
+            out.putF32(v.y);
+            out.putF32(v.z);
+        }
+        for (const GreedyVertex &v : mesh.vertices) {
+            out.putF32(FACE_NORMALS[v.face][0]);
+            out.putF32(FACE_NORMALS[v.face][1]);
+            out.putF32(FACE_NORMALS[v.face][2]);
+        }
+        bool shortIndices = mesh.vertices.size() <= 0xFFFF;
+        for (uint32_t index : mesh.indices) {
+            if (shortIndices) {
+                out.putU16(uint16_t(index));
+            } else {
+                out.putU32(index);
+            }
+        }
+        blob.resize((blob.size() + 3) & ~size_t(3), 0);
+    }
+
+    void add(const GreedyMesh &mesh, uint64_t blobOffset) {
+        size_t vertexBytes = mesh.vertices.size() * 12;
+        bool shortIndices = mesh.vertices.size() <= 0xFFFF;
+        size_t indexSize = shortIndices ? 2 : 4;
+
+        float lo[3] = {1e30f, 1e30f, 1e30f};
+        float hi[3] = {-1e30f, -1e30f, -1e30f};
+        for (const GreedyVertex &v : mesh.vertices) {
+            const float p[3] = {v.x, v.y, v.z};
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = std::min(lo[a], p[a]);
+                hi[a] = std::max(hi[a], p[a]);
+            }
+        }
+
+        size_t positionView = addView(blobOffset, vertexBytes, GL_ARRAY_BUFFER);
+        size_t normalView = addView(blobOffset + vertexBytes, vertexBytes, GL_ARRAY_BUFFER);
+        size_t indexView = addView(blobOffset + 2 * vertexBytes, mesh.indices.size() * indexSize, GL_ELEMENT_ARRAY_BUFFER);
+
+        size_t position = mAccessorCount++;
+        appendf(mAccessors, "%s{\"bufferView\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC3\","
+                "\"min\":[%g,%g,%g],\"max\":[%g,%g,%g]}", position ? "," : "", positionView, GL_FLOAT,
+                mesh.vertices.size(), lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+        size_t normal = mAccessorCount++;
+        appendf(mAccessors, ",{\"bufferView\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC3\"}",
+                normalView, GL_FLOAT, mesh.vertices.size());
+
+        size_t meshIndex = mMeshCount++;
+        appendf(mMeshes, "%s{\"primitives\":[", meshIndex ? "," : "");
+        for (size_t r = 0; r < mesh.ranges.size(); ++r) {
+            const MaterialRange &range = mesh.ranges[r];
+            size_t indices = mAccessorCount++;
+            appendf(mAccessors, ",{\"bufferView\":%zu,\"byteOffset\":%zu,\"componentType\":%d,\"count\":%u,\"type\":\"SCALAR\"}",
+                    indexView, range.firstIndex * indexSize, shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                    range.indexCount);
+            appendf(mMeshes, "%s{\"attributes\":{\"POSITION\":%zu,\"NORMAL\":%zu},\"indices\":%zu,\"material\":%zu}",
+                    r ? "," : "", position, normal, indices, materialIndex(range.material));
+        }
+        mMeshes += "]}";
+
+        appendf(mNodes, "%s{\"name\":\"chunk_%d_%d_%d\",\"mesh\":%zu,\"translation\":[%d,%d,%d]}",
+                meshIndex ? "," : "", mesh.chunk.x, mesh.chunk.y, mesh.chunk.z, meshIndex,
+                mesh.chunk.x * CHUNK_SIZE, mesh.chunk.y * CHUNK_SIZE, mesh.chunk.z * CHUNK_SIZE);
+    }
+
+    std::string json(uint64_t bufferBytes) const {
+        std::string out = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"voxcore\"},\"scene\":0,\"scenes\":[{\"nodes\":[";
+        for (size_t i = 0; i < mMeshCount; ++i) {
+            appendf(out, "%s%zu", i ? "," : "", i);
+        }
+        out += "]}]";
+        if (mMeshCount) {
+            out += ",\"nodes\":[" + mNodes + "],\"meshes\":[" + mMeshes + "],\"accessors\":[" + mAccessors
+                 + "],\"bufferViews\":[" + mViews + "],\"materials\":[" + mMaterialJson + "]";
+            appendf(out, ",\"buffers\":[{\"byteLength\":%llu}]", (unsigned long long)bufferBytes);
+        }
+        out += "}";
+        return out;
+    }
+
+private:
+    size_t addView(uint64_t offset, size_t length, int target) {
+        appendf(mViews, "%s{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%zu,\"target\":%d}",
+                mViewCount ? "," : "", (unsigned long long)offset, length, target);
+        return mViewCount++;
+    }
+
+    size_t materialIndex(MaterialId id) {
+        auto it = mMaterialIndex.find(id);
+        if (it != mMaterialIndex.end()) {
+            return it->second;
+        }
+        const Material &material = mMaterials.get(id);
+        size_t index = mMaterialIndex.size();
+        float alpha = channel(material.color, 24);
+        float emit = material.emission / 15.0f;
+        appendf(mMaterialJson, "%s{\"name\":\"%s\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[%.4f,%.4f,%.4f,%.4f],"
+                "\"metallicFactor\":0,\"roughnessFactor\":1}", index ? "," : "",
+                materialName(mMaterials, id).c_str(), srgbToLinear(channel(material.color, 16)),
+                srgbToLinear(channel(material.color, 8)), srgbToLinear(channel(material.color, 0)), alpha);
+        if (emit > 0.0f) {
+            appendf(mMaterialJson, ",\"emissiveFactor\":[%.4f,%.4f,%.4f]", srgbToLinear(channel(material.color, 16)) * emit,
+                    srgbToLinear(channel(material.color, 8)) * emit, srgbToLinear(channel(material.color, 0)) * emit);
+        }
+        if (!material.opaque || alpha < 1.0f) {
+            mMaterialJson += ",\"alphaMode\":\"BLEND\"";
+        }
+        mMaterialJson += "}";
+        mMaterialIndex.emplace(id, index);
+        return index;
+    }
+
+    const MaterialRegistry &mMaterials;
+    size_t mViewCount = 0;
+    size_t mAccessorCount = 0;
+    size_t mMeshCount = 0;
+    std::string mViews;
+    std::string mAccessors;
+    std::string mMeshes;
+    std::string mNodes;
+    std::string mMaterialJson;
+    std::unordered_map<MaterialId, size_t> mMaterialIndex;
+};
+
+bool appendFile(FILE *to, FILE *from) {
+    std::vector<uint8_t> block(COPY_BLOCK);
+    size_t n;
+    while ((n = std::fread(block.data(), 1, block.size(), from)) > 0) {
+        if (std::fwrite(block.data(), 1, n, to) != n) {
+            return false;
+        }
+    }
+    return !std::ferror(from);
+}
+
+} // namespace
+
+bool exportObj(const VoxelMap &map, const std::string &path, const ExportOptions &options,
+               ExportStats *stats, std::string *error) {
+    auto start = std::chrono::steady_clock::now();
+    std::string base = path;
+    size_t dot = base.find_last_of('.');
+    size_t slash = base.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+        base.erase(dot);
+    }
+    std::string mtlPath = base + ".mtl";
+    std::string mtlName = slash == std::string::npos ? mtlPath : mtlPath.substr(mtlPath.find_last_of("/\\") + 1);
+    const MaterialRegistry &materials = map.getMaterials();
+    if (!writeMtl(materials, mtlPath)) {
+        return fail(error, "Cannot write " + mtlPath);
+    }
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return fail(error, "Cannot write " + path);
+    }
+    std::unique_ptr<FILE, int (*)(FILE *)> closer(file, std::fclose);
+    std::string header = "# voxcore greedy mesh export\nmtllib " + mtlName + "\n";
+    for (const float *n : FACE_NORMALS) {
+        appendf(header, "vn %g %g %g\n", n[0], n[1], n[2]);
+    }
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+
+    // Material names are looked up once here, the workers only read them.
+    std::vector<std::string> names(materials.size());
+    for (size_t i = 1; i < materials.size(); ++i) {
+        names[i] = materialName(materials, MaterialId(i));
+    }
+
+    ExportStats local;
+    local.bytes = header.size();
+    std::vector<std::string> texts(std::max<size_t>(1, options.batchChunks));
+    ok = ok && meshInBatches(map, options,
+        [&](const GreedyMesh &mesh, size_t slot) {
+            std::string &text = texts[slot];
+            text.clear();
+            Vec3i origin(mesh.chunk.x * CHUNK_SIZE, mesh.chunk.y * CHUNK_SIZE, mesh.chunk.z * CHUNK_SIZE);
+            appendf(text, "o chunk_%d_%d_%d\n", mesh.chunk.x, mesh.chunk.y, mesh.chunk.z);
+            for (const GreedyVertex &v : mesh.vertices) {
+                appendf(text, "v %g %g %g\n", origin.x + v.x, origin.y + v.y, origin.z + v.z);
+            }
+            // Negative indices count back from the last vertex written so far.
+            long count = long(mesh.vertices.size());
+            for (const MaterialRange &range : mesh.ranges) {
+                text += "usemtl " + names[range.material] + "\n";
+                for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i += 3) {
+                    int normal = mesh.vertices[mesh.indices[i]].face + 1;
+                    appendf(text, "f %ld//%d %ld//%d %ld//%d\n",
+                            long(mesh.indices[i]) - count, normal,
+                            long(mesh.indices[i + 1]) - count, normal,
+                            long(mesh.indices[i + 2]) - count, normal);
+                }
+            }
+        },
+        [&](const GreedyMesh &, size_t slot) {
+            const std::string &text = texts[slot];
+            local.bytes += text.size();
+            bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+            std::string().swap(texts[slot]);
+            return written;
+        },
+        local);
+    if (!ok) {
+        return fail(error, "Failed writing " + path);
+    }
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+bool exportGlb(const VoxelMap &map, const std::string &path, const ExportOptions &options,
+               ExportStats *stats, std::string *error) {
+    auto start = std::chrono::steady_clock::now();
+    const std::string binPath = path + ".bin.tmp";
+    FILE *bin = std::fopen(binPath.c_str(), "w+b");
+    if (!bin) {
+        return fail(error, "Cannot write " + binPath);
+    }
+    std::unique_ptr<FILE, int (*)(FILE *)> binCloser(bin, std::fclose);
+    struct Remover {
+        std::string path;
+        ~Remover() { std::remove(path.c_str()); }
+    } remover = {binPath};
+
+    GlbBuilder builder(map.getMaterials());
+    ExportStats local;
+    uint64_t offset = 0;
+    std::vector<std::vector<uint8_t>> blobs(std::max<size_t>(1, options.batchChunks));
+    bool ok = meshInBatches(map, options,
+        [&](const GreedyMesh &mesh, size_t slot) {
+            GlbBuilder::encode(mesh, blobs[slot]);
+        },
+        [&](const GreedyMesh &mesh, size_t slot) {
+            std::vector<uint8_t> &blob = blobs[slot];
+            builder.add(mesh, offset);
+            bool written = std::fwrite(blob.data(), 1, blob.size(), bin) == blob.size();
+            offset += blob.size();
+            std::vector<uint8_t>().swap(blob);
+            return written;
+        },
+        local);
+    if (!ok) {
+        return fail(error, "Failed writing " + binPath);
+    }
+
+    std::string json = builder.json(offset);
+    json.resize((json.size() + 3) & ~size_t(3), ' ');
+    uint64_t total = 12 + 8 + json.size() + (offset ? 8 + offset : 0);
+    if (total > 0xFFFFFFFFull) {
+        return fail(error, "Map is too large for a single .glb, export OBJ instead");
+    }
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return fail(error, "Cannot write " + path);
+    }
+    std::unique_ptr<FILE, int (*)(FILE *)> closer(file, std::fclose);
+    std::vector<uint8_t> header;
+    ByteWriter out(header);
+    out.putU32(GLB_MAGIC);
+    out.putU32(2);
+    out.putU32(uint32_t(total));
+    out.putU32(uint32_t(json.size()));
+    out.putU32(GLB_JSON);
+    out.putBytes(json.data(), json.size());
+    if (offset) {
+        out.putU32(uint32_t(offset));
+        out.putU32(GLB_BIN);
+    }
+    ok = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+    std::rewind(bin);
+    ok = ok && appendFile(file, bin);
+    if (!ok) {
+        return fail(error, "Failed writing " + path);
+    }
+
+    local.bytes = total;
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+} // namespace vox
@@ -0,0 +1,45 @@
+#ifndef MESHEXPORT_H
+#define MESHEXPORT_H
+
+#include <string>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+class ThreadPool;
+
+struct ExportOptions {
+    ThreadPool *pool;       // null uses defaultThreadPool()
+    size_t batchChunks;     // chunks meshed before their geometry is written
+
+    ExportOptions() : pool(nullptr), batchChunks(256) {}
+};
+
+struct ExportStats {
+    size_t chunks;
+    uint64_t vertices;
+    uint64_t triangles;
+    uint64_t bytes;
+    double seconds;
+
+    ExportStats() : chunks(0), vertices(0), triangles(0), bytes(0), seconds(0.0) {}
+};
+
+// Both exporters mesh the map with GreedyMesher, one object or glTF node per
+// chunk. Chunks are meshed in parallel batches and written as each batch
+// finishes, so only batchChunks meshes are held in memory at a time.
+
+// Wavefront OBJ plus a .mtl next to it with one material per map material.
+// Faces use relative indices so chunks are formatted independently.
+bool exportObj(const VoxelMap &map, const std::string &path, const ExportOptions &options = ExportOptions(),
+               ExportStats *stats = nullptr, std::string *error = nullptr);
+
+// Binary glTF 2.0. Geometry is streamed to a temporary file while the JSON
+// is built, then both are joined into the .glb.
+bool exportGlb(const VoxelMap &map, const std::string &path, const ExportOptions &options = ExportOptions(),
+               ExportStats *stats = nullptr, std::string *error = nullptr);
+
+} // namespace vox
+
+#endif // MESHEXPORT_H
@@ -0,0 +1,387 @@
+#include "MeshVoxelizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+const uint32_t DEFAULT_COLOR = 0xFFB4B4B4;
+// Widens the plane slab so rounding never drops a voxel the full test keeps.
+const float SLAB_EPS = 1e-4f;
+
+inline int floorInt(float v) {
+    int i = int(v);
+    return float(i) > v ? i - 1 : i;
+}
+
+inline int ceilInt(float v) {
+    int i = int(v);
+    return float(i) < v ? i + 1 : i;
+}
+
+inline int popcount(uint64_t v) {
+    return __builtin_popcountll(v);
+}
+
+// Corners in voxel units and the voxels whose boxes the bounds overlap.
+struct Triangle {
+    float v[3][3];
+    int min[3];
+    int max[3];
+};
+
+// Separating axis test between the triangle and unit voxel boxes, set up
+// once per triangle so each voxel costs a dot product per axis. The box
+// face axes are covered by clipping to the triangle's bounds.
+struct OverlapTest {
+    float normal[3];
+    float plane;
+    float planeRadius;
+    float axis[9][3];
+    float lo[9];
+    float hi[9];
+    float radius[9];
+
+    explicit OverlapTest(const Triangle &t) {
+        float e[3][3];
+        for (int i = 0; i < 3; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                e[i][k] = t.v[(i + 1) % 3][k] - t.v[i][k];
+            }
+        }
+        normal[0] = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+        normal[1] = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+        normal[2] = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+        plane = dot(normal, t.v[0]);
+        planeRadius = halfExtent(normal);
+        for (int i = 0; i < 3; ++i) {
+            // e x (1,0,0), e x (0,1,0), e x (0,0,1)
+            set(axis[i * 3 + 0], 0.0f, e[i][2], -e[i][1]);
+            set(axis[i * 3 + 1], -e[i][2], 0.0f, e[i][0]);
+            set(axis[i * 3 + 2], e[i][1], -e[i][0], 0.0f);
+        }
+        for (int a = 0; a < 9; ++a) {
+            float p0 = dot(axis[a], t.v[0]);
+            float p1 = dot(axis[a], t.v[1]);
+            float p2 = dot(axis[a], t.v[2]);
+            lo[a] = std::min(p0, std::min(p1, p2));
+            hi[a] = std::max(p0, std::max(p1, p2));
+            radius[a] = halfExtent(axis[a]);
+        }
+    }
+
+    bool overlaps(float x, float y, float z) const {
+        float c[3] = {x, y, z};
+        if (std::fabs(dot(normal, c) - plane) > planeRadius) {
+            return false;
+        }
+        for (int a = 0; a < 9; ++a) {
+            float d = dot(axis[a], c);
+            if (d < lo[a] - radius[a] || d > hi[a] + radius[a]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static float dot(const float *a, const float *b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Projection of a unit box's half diagonal onto a.
+    static float halfExtent(const float *a) {
+        return 0.5f * (std::fabs(a[0]) + std::fabs(a[1]) + std::fabs(a[2]));
+    }
+
+    static void set(float *a, float x, float y, float z) {
+        a[0] = x;
+        a[1] = y;
+        a[2] = z;
+    }
+};
+
+// Edge functions of the triangle projected onto xz, for crossing vertical
+// lines with it. Points on an edge shared by two triangles count for
+// exactly one of them, so a closed mesh is crossed an even number of times.
+struct Crossing {
+    double x[3];
+    double z[3];
+    bool valid;
+
+    explicit Crossing(const Triangle &t) {
+        for (int i = 0; i < 3; ++i) {
+            x[i] = t.v[i][0];
+            z[i] = t.v[i][2];
+        }
+        double area = (x[1] - x[0]) * (z[2] - z[0]) - (z[1] - z[0]) * (x[2] - x[0]);
+        valid = area != 0.0;
+        if (area < 0.0) {
+            std::swap(x[1], x[2]);
+            std::swap(z[1], z[2]);
+        }
+    }
+
+    bool contains(double px, double pz) const {
+        for (int i = 0; i < 3; ++i) {
+            int j = (i + 1) % 3;
+            double dx = x[j] - x[i];
+            double dz = z[j] - z[i];
+            double e = dx * (pz - z[i]) - dz * (px - x[i]);
+            // On the edge: keep it only for one direction of travel.
+            if (e < 0.0 || (e == 0.0 && !(dz > 0.0 || (dz == 0.0 && dx < 0.0)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Occupancy of one chunk column: 64-bit words along y for each of its
+// CHUNK_SIZE^2 voxel columns, like OccupancyMask.
+struct ColumnBits {
+    int yMin;
+    int words;
+    std::vector<uint64_t> bits;
+
+    ColumnBits(int cyMin, int cyMax)
+        : yMin(cyMin * CHUNK_SIZE), words(((cyMax - cyMin + 1) * CHUNK_SIZE + 63) / 64),
+          bits(size_t(words) * CHUNK_SIZE * CHUNK_SIZE, 0) {}
+
+    uint64_t *column(int lx, int lz) { return &bits[size_t(lx + lz * CHUNK_SIZE) * words]; }
+
+    void set(int lx, int y, int lz) {
+        int i = y - yMin;
+        column(lx, lz)[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+
+    // y0..y1 inclusive.
+    void fill(int lx, int y0, int y1, int lz) {
+        uint64_t *words = column(lx, lz);
+        for (int i = y0 - yMin; i <= y1 - yMin;) {
+            int bit = i & 63;
+            int n = std::min(64 - bit, y1 - yMin - i + 1);
+            words[i >> 6] |= (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+            i += n;
+        }
+    }
+
+    bool get(int lx, int y, int lz) const {
+        int i = y - yMin;
+        return (bits[size_t(lx + lz * CHUNK_SIZE) * words + (i >> 6)] >> (i & 63)) & 1;
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        for (uint64_t w : bits) {
+            n += popcount(w);
+        }
+        return n;
+    }
+};
+
+struct ColumnResult {
+    std::vector<std::pair<Vec3i, std::shared_ptr<Chunk>>> chunks;
+    size_t surface = 0;
+    size_t filled = 0;
+    size_t open = 0;
+};
+
+void voxelizeColumn(const Vec3i &key, const std::vector<Triangle> &triangles, const std::vector<uint32_t> &bucket,
+                    bool solid, MaterialId material, ColumnResult &out) {
+    int x0 = key.x * CHUNK_SIZE;
+    int z0 = key.z * CHUNK_SIZE;
+    int x1 = x0 + CHUNK_MASK;
+    int z1 = z0 + CHUNK_MASK;
+    int yLo = triangles[bucket[0]].min[1];
+    int yHi = triangles[bucket[0]].max[1];
+    for (uint32_t i : bucket) {
+        yLo = std::min(yLo, triangles[i].min[1]);
+        yHi = std::max(yHi, triangles[i].max[1]);
+    }
+    int cyMin = chunkCoord(yLo);
+    int cyMax = chunkCoord(yHi);
+    ColumnBits bits(cyMin, cyMax);
+
+    for (uint32_t i : bucket) {
+        const Triangle &t = triangles[i];
+        OverlapTest test(t);
+        int ax = std::max(t.min[0], x0), bx = std::min(t.max[0], x1);
+        int az = std::max(t.min[2], z0), bz = std::min(t.max[2], z1);
+        float ny = test.normal[1];
+        for (int z = az; z <= bz; ++z) {
+            for (int x = ax; x <= bx; ++x) {
+                int y0 = t.min[1];
+                int y1 = t.max[1];
+                if (ny != 0.0f) {
+                    // Only the slab around the plane can overlap.
+                    float rest = test.plane - test.normal[0] * float(x) - test.normal[2] * float(z);
+                    float a = (rest - test.planeRadius) / ny;
+                    float b = (rest + test.planeRadius) / ny;
+                    if (a > b) {
+                        std::swap(a, b);
+                    }
+                    y0 = std::max(y0, ceilInt(a - SLAB_EPS));
+                    y1 = std::min(y1, floorInt(b + SLAB_EPS));
+                }
+                for (int y = y0; y <= y1; ++y) {
+                    if (test.overlaps(float(x), float(y), float(z))) {
+                        bits.set(x - x0, y, z - z0);
+                    }
+                }
+            }
+        }
+    }
+    out.surface = bits.count();
+
+    if (solid) {
+        // (voxel column, height) of every crossing, sorted by column then y.
+        std::vector<std::pair<uint32_t, float>> hits;
+        for (uint32_t i : bucket) {
+            const Triangle &t = triangles[i];
+            Crossing crossing(t);
+            if (!crossing.valid) {
+                continue;
+            }
+            OverlapTest plane(t);
+            int ax = std::max(t.min[0], x0), bx = std::min(t.max[0], x1);
+            int az = std::max(t.min[2], z0), bz = std::min(t.max[2], z1);
+            for (int z = az; z <= bz; ++z) {
+                for (int x = ax; x <= bx; ++x) {
+                    if (crossing.contains(x, z)) {
+                        float y = (plane.plane - plane.normal[0] * float(x) - plane.normal[2] * float(z))
+                                  / plane.normal[1];
+                        hits.push_back(std::make_pair(uint32_t((x - x0) + (z - z0) * CHUNK_SIZE), y));
+                    }
+                }
+            }
+        }
+        std::sort(hits.begin(), hits.end());
+        for (size_t first = 0; first < hits.size();) {
+            size_t last = first;
+            while (last < hits.size() && hits[last].first == hits[first].first) {
+                ++last;
+            }
+            int lx = int(hits[first].first % CHUNK_SIZE);
+            int lz = int(hits[first].first / CHUNK_SIZE);
+            if ((last - first) % 2) {
+                ++out.open;
+            } else {
+                for (size_t k = first; k < last; k += 2) {
+                    int y0 = std::max(ceilInt(hits[k].second), yLo);
+                    int y1 = std::min(floorInt(hits[k + 1].second), yHi);
+                    if (y0 <= y1) {
+                        bits.fill(lx, y0, y1, lz);
+                    }
+                }
+            }
+            first = last;
+        }
+        out.filled = bits.count() - out.surface;
+    }
+
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    for (int cy = cyMin; cy <= cyMax; ++cy) {
+        bool any = false;
+        int base = cy * CHUNK_SIZE;
+        for (int lz = 0; lz < CHUNK_SIZE; ++lz) {
+            for (int ly = 0; ly < CHUNK_SIZE; ++ly) {
+                uint32_t *row = &cells[cellIndex(0, ly, lz)];
+                for (int lx = 0; lx < CHUNK_SIZE; ++lx) {
+                    bool set = bits.get(lx, base + ly, lz);
+                    row[lx] = set ? material : AIR;
+                    any = any || set;
+                }
+            }
+        }
+        if (!any) {
+            continue;
+        }
+        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+        chunk->getMaterials().encode(cells.data());
+        chunk->compact();
+        out.chunks.push_back(std::make_pair(Vec3i(key.x, cy, key.z), std::move(chunk)));
+    }
+}
+
+} // namespace
+
+void voxelizeMesh(const float *corners, size_t triangleCount, VoxelMap &map, const VoxelizeSettings &settings,
+                  VoxelizeStats *stats) {
+    auto start = std::chrono::steady_clock::now();
+    MaterialId material = settings.material;
+    if (material == AIR) {
+        MaterialRegistry &materials = map.getMaterials();
+        material = materials.findByName("mesh");
+        if (material == AIR) {
+            material = materials.add(Material("mesh", DEFAULT_COLOR));
+        }
+    }
+
+    float scale = 1.0f / settings.voxelSize;
+    std::vector<Triangle> triangles(triangleCount);
+    std::unordered_map<Vec3i, std::vector<uint32_t>, Vec3iHash> buckets;
+    for (size_t i = 0; i < triangleCount; ++i) {
+        Triangle &t = triangles[i];
+        for (int k = 0; k < 3; ++k) {
+            float lo = 0.0f, hi = 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                float v = corners[i * 9 + c * 3 + k] * scale;
+                t.v[c][k] = v;
+                lo = c ? std::min(lo, v) : v;
+                hi = c ? std::max(hi, v) : v;
+            }
+            t.min[k] = floorInt(lo + 0.5f);
+            t.max[k] = floorInt(hi + 0.5f);
+        }
+        // Buckets are whole chunk columns rather than chunks: the parity
+        // fill of a voxel needs every crossing above and below it, and
+        // those may come from triangles in other chunks of the column.
+        for (int cz = chunkCoord(t.min[2]); cz <= chunkCoord(t.max[2]); ++cz) {
+            for (int cx = chunkCoord(t.min[0]); cx <= chunkCoord(t.max[0]); ++cx) {
+                buckets[Vec3i(cx, 0, cz)].push_back(uint32_t(i));
+            }
+        }
+    }
+
+    std::vector<Vec3i> keys;
+    keys.reserve(buckets.size());
+    for (const auto &entry : buckets) {
+        keys.push_back(entry.first);
+    }
+    std::vector<ColumnResult> results(keys.size());
+    ThreadPool &threads = settings.pool ? *settings.pool : defaultThreadPool();
+    threads.parallelFor(keys.size(), [&](size_t i) {
+        voxelizeColumn(keys[i], triangles, buckets.find(keys[i])->second, settings.solid, material, results[i]);
+    });
+
+    size_t chunks = 0;
+    size_t surface = 0, filled = 0, open = 0;
+    for (ColumnResult &result : results) {
+        for (auto &chunk : result.chunks) {
+            map.setChunk(chunk.first, std::move(chunk.second));
+            ++chunks;
+        }
+        surface += result.surface;
+        filled += result.filled;
+        open += result.open;
+    }
+    if (stats) {
+        stats->triangles = triangleCount;
+        stats->columns = keys.size();
+        stats->chunks = chunks;
+        stats->surfaceVoxels = surface;
+        stats->filledVoxels = filled;
+        stats->openColumns = open;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,53 @@
+#ifndef MESHVOXELIZER_H
+#define MESHVOXELIZER_H
+
+#include <cstddef>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+class ThreadPool;
+
+struct VoxelizeSettings {
+    float voxelSize;        // world units per voxel edge
+    bool solid;             // fill closed parts of the mesh, not only the surface
+    MaterialId material;    // AIR adds or reuses a material called "mesh"
+    ThreadPool *pool;       // null uses defaultThreadPool()
+
+    VoxelizeSettings() : voxelSize(1.0f), solid(true), material(AIR), pool(nullptr) {}
+};
+
+struct VoxelizeStats {
+    size_t triangles;
+    size_t columns;         // chunk columns worked on in parallel
+    size_t chunks;          // chunks written to the map
+    size_t surfaceVoxels;
+    size_t filledVoxels;    // inside the mesh but not on its surface
+    size_t openColumns;     // voxel columns left hollow, the mesh was not closed there
+    double seconds;
+
+    VoxelizeStats()
+        : triangles(0), columns(0), chunks(0), surfaceVoxels(0), filledVoxels(0), openColumns(0), seconds(0.0) {}
+
+    double trianglesPerSecond() const { return seconds > 0.0 ? triangles / seconds : 0.0; }
+};
+
+// Turns a triangle soup into voxels. corners holds 9 floats per triangle,
+// three xyz corners in world units; voxel (x, y, z) covers
+// [x - 0.5, x + 0.5] * voxelSize on each axis.
+//
+// Triangles are binned by the chunk columns their bounds touch and each
+// column is worked on by one thread. A voxel is on the surface when its box
+// overlaps a triangle (separating axis test). With solid set, the vertical
+// line through each voxel centre is crossed with the triangles and the
+// stretches between an entry and an exit are filled; a line crossing the
+// mesh an odd number of times meets a hole and is left hollow.
+//
+// Chunks that end up holding voxels replace whatever map had there.
+void voxelizeMesh(const float *corners, size_t triangles, VoxelMap &map,
+                  const VoxelizeSettings &settings = VoxelizeSettings(), VoxelizeStats *stats = nullptr);
+
+} // namespace vox
+
+#endif // MESHVOXELIZER_H
@@ -0,0 +1,225 @@
+#include "NoiseKernels.h"
+
+#include "OccupancyKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VOX_NOISE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VOX_NOISE_SSE2 1
+#endif
+
+namespace vox {
+namespace kernels {
+
+namespace {
+
+// Lattice hash: one multiply per axis, combined with xor so the y and z
+// terms of a row can be folded together once.
+const uint32_t PRIME_X = 0x8DA6B343u;
+const uint32_t PRIME_Y = 0xD8163841u;
+const uint32_t PRIME_Z = 0xCB1AB31Fu;
+const uint32_t MIX_1 = 0x2C1B3C6Du;
+const uint32_t MIX_2 = 0x297A2D39u;
+const uint32_t OCTAVE_SEED = 0x9E3779B9u;
+const float UNIT = 1.0f / 8388608.0f;
+const size_t BLOCK = 64;
+
+inline uint32_t mix(uint32_t h) {
+    h ^= h >> 15;
+    h *= MIX_1;
+    h ^= h >> 12;
+    h *= MIX_2;
+    h ^= h >> 15;
+    return h;
+}
+
+// Top 24 bits of the hash as a float in [-1, 1), exact in single precision.
+inline float latticeValue(uint32_t h) {
+    return float(int32_t(h >> 8)) * UNIT - 1.0f;
+}
+
+inline int floorInt(float v) {
+    int i = int(v);
+    return float(i) > v ? i - 1 : i;
+}
+
+inline float fade(float t) {
+    return t * t * (3.0f - 2.0f * t);
+}
+
+inline float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+// The y/z half of the row: hashes of the four lattice edges the row runs
+// between and the blend weights across them.
+struct RowSetup {
+    uint32_t edge[4];   // (y0,z0) (y1,z0) (y0,z1) (y1,z1)
+    float ty;
+    float tz;
+
+    RowSetup(float y, float z, uint32_t seed) {
+        int yi = floorInt(y);
+        int zi = floorInt(z);
+        ty = fade(y - float(yi));
+        tz = fade(z - float(zi));
+        for (int k = 0; k < 4; ++k) {
+            edge[k] = seed ^ (uint32_t(yi + (k & 1)) * PRIME_Y) ^ (uint32_t(zi + (k >> 1)) * PRIME_Z);
+        }
+    }
+};
+
+inline float noiseAt(const RowSetup &row, float x) {
+    int xi = floorInt(x);
+    float tx = fade(x - float(xi));
+    uint32_t hx0 = uint32_t(xi) * PRIME_X;
+    uint32_t hx1 = uint32_t(xi + 1) * PRIME_X;
+    float e[4];
+    for (int k = 0; k < 4; ++k) {
+        e[k] = lerp(latticeValue(mix(row.edge[k] ^ hx0)), latticeValue(mix(row.edge[k] ^ hx1)), tx);
+    }
+    return lerp(lerp(e[0], e[1], row.ty), lerp(e[2], e[3], row.ty), row.tz);
+}
+
+#if defined(VOX_NOISE_AVX2)
+
+const size_t LANES = 8;
+typedef __m256 VF;
+typedef __m256i VI;
+
+inline VF fset(float v) { return _mm256_set1_ps(v); }
+inline VI iset(uint32_t v) { return _mm256_set1_epi32(int(v)); }
+inline VI ilanes() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+inline VF fadd(VF a, VF b) { return _mm256_add_ps(a, b); }
+inline VF fsub(VF a, VF b) { return _mm256_sub_ps(a, b); }
+inline VF fmul(VF a, VF b) { return _mm256_mul_ps(a, b); }
+inline VI iadd(VI a, VI b) { return _mm256_add_epi32(a, b); }
+inline VI ixor(VI a, VI b) { return _mm256_xor_si256(a, b); }
+inline VI imul(VI a, VI b) { return _mm256_mullo_epi32(a, b); }
+inline VI ishr(VI a, int n) { return _mm256_srli_epi32(a, n); }
+inline VI truncInt(VF a) { return _mm256_cvttps_epi32(a); }
+inline VF toFloat(VI a) { return _mm256_cvtepi32_ps(a); }
+inline VI greater(VF a, VF b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+inline void fstore(float *p, VF v) { _mm256_storeu_ps(p, v); }
+
+#elif defined(VOX_NOISE_SSE2)
+
+const size_t LANES = 4;
+typedef __m128 VF;
+typedef __m128i VI;
+
+inline VF fset(float v) { return _mm_set1_ps(v); }
+inline VI iset(uint32_t v) { return _mm_set1_epi32(int(v)); }
+inline VI ilanes() { return _mm_setr_epi32(0, 1, 2, 3); }
+inline VF fadd(VF a, VF b) { return _mm_add_ps(a, b); }
+inline VF fsub(VF a, VF b) { return _mm_sub_ps(a, b); }
+inline VF fmul(VF a, VF b) { return _mm_mul_ps(a, b); }
+inline VI iadd(VI a, VI b) { return _mm_add_epi32(a, b); }
+inline VI ixor(VI a, VI b) { return _mm_xor_si128(a, b); }
+inline VI ishr(VI a, int n) { return _mm_srli_epi32(a, n); }
+inline VI truncInt(VF a) { return _mm_cvttps_epi32(a); }
+inline VF toFloat(VI a) { return _mm_cvtepi32_ps(a); }
+inline VI greater(VF a, VF b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+inline void fstore(float *p, VF v) { _mm_storeu_ps(p, v); }
+
+// SSE2 has no 32-bit mullo: multiply even and odd lanes as 64-bit and
+// gather the low halves.
+inline VI imul(VI a, VI b) {
+    VI even = _mm_mul_epu32(a, b);
+    VI odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+#endif
+
+#if defined(VOX_NOISE_AVX2) || defined(VOX_NOISE_SSE2)
+#define VOX_NOISE_SIMD 1
+
+inline VI vmix(VI h) {
+    h = ixor(h, ishr(h, 15));
+    h = imul(h, iset(MIX_1));
+    h = ixor(h, ishr(h, 12));
+    h = imul(h, iset(MIX_2));
+    return ixor(h, ishr(h, 15));
+}
+
+inline VF vlattice(VI h) {
+    return fsub(fmul(toFloat(ishr(h, 8)), fset(UNIT)), fset(1.0f));
+}
+
+inline VF vlerp(VF a, VF b, VF t) {
+    return fadd(a, fmul(fsub(b, a), t));
+}
+
+// Same operations in the same order as noiseAt(), LANES points at a time.
+inline VF vnoise(const RowSetup &row, VF x) {
+    VI xi = truncInt(x);
+    xi = iadd(xi, greater(toFloat(xi), x));     // true lanes are -1
+    VF t = fsub(x, toFloat(xi));
+    VF tx = fmul(fmul(t, t), fsub(fset(3.0f), fmul(fset(2.0f), t)));
+    VI hx0 = imul(xi, iset(PRIME_X));
+    VI hx1 = imul(iadd(xi, iset(1)), iset(PRIME_X));
+    VF e[4];
+    for (int k = 0; k < 4; ++k) {
+        VI edge = iset(row.edge[k]);
+        e[k] = vlerp(vlattice(vmix(ixor(edge, hx0))), vlattice(vmix(ixor(edge, hx1))), tx);
+    }
+    VF ty = fset(row.ty);
+    return vlerp(vlerp(e[0], e[1], ty), vlerp(e[2], e[3], ty), fset(row.tz));
+}
+#endif
+
+} // namespace
+
+void valueNoiseRow(float x0, float step, float y, float z, uint32_t seed, float *out, size_t count) {
+    RowSetup row(y, z, seed);
+    size_t i = 0;
+#ifdef VOX_NOISE_SIMD
+    if (isSimdEnabled()) {
+        VF start = fset(x0);
+        VF stride = fset(step);
+        for (; i + LANES <= count; i += LANES) {
+            VF x = fadd(start, fmul(toFloat(iadd(iset(uint32_t(i)), ilanes())), stride));
+            fstore(out + i, vnoise(row, x));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = noiseAt(row, x0 + float(int(i)) * step);
+    }
+}
+
+void fbmRow(float x0, float step, float y, float z, uint32_t seed, int octaves, float gain,
+            float *out, size_t count) {
+    float octave[BLOCK];
+    for (size_t first = 0; first < count; first += BLOCK) {
+        size_t n = count - first < BLOCK ? count - first : BLOCK;
+        float *sum = out + first;
+        float start = x0 + float(int(first)) * step;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        float total = 0.0f;
+        for (int o = 0; o < octaves; ++o) {
+            valueNoiseRow(start * frequency, step * frequency, y * frequency, z * frequency,
+                          seed + uint32_t(o) * OCTAVE_SEED, o ? octave : sum, n);
+            if (o) {
+                for (size_t i = 0; i < n; ++i) {
+                    sum[i] += octave[i] * amplitude;
+                }
+            }
+            total += amplitude;
+            frequency *= 2.0f;
+            amplitude *= gain;
+        }
+        float scale = total > 0.0f ? 1.0f / total : 0.0f;
+        for (size_t i = 0; i < n; ++i) {
+            sum[i] *= scale;
+        }
+    }
+}
+
+} // namespace kernels
+} // namespace vox
@@ -0,0 +1,26 @@
+#ifndef NOISEKERNELS_H
+#define NOISEKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vox {
+namespace kernels {
+
+// Hashed value noise, evaluated a row of points at a time. Like the
+// occupancy kernels there is an AVX2, SSE2 and scalar build, and
+// setSimdEnabled() switches between them. All three give bit-identical
+// results, so generated content does not depend on the machine.
+
+// Noise in [-1, 1) at (x0 + i * step, y, z) for i in [0, count).
+void valueNoiseRow(float x0, float step, float y, float z, uint32_t seed, float *out, size_t count);
+
+// Fractal sum of octaves, each at twice the frequency and gain times the
+// amplitude of the one before, scaled back to [-1, 1).
+void fbmRow(float x0, float step, float y, float z, uint32_t seed, int octaves, float gain,
+            float *out, size_t count);
+
+} // namespace kernels
+} // namespace vox
+
+#endif // NOISEKERNELS_H
@@ -0,0 +1,245 @@
+#include "OccupancyKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VOX_KERNELS_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VOX_KERNELS_SSE2 1
+#endif
+
+namespace vox {
+namespace kernels {
+
+namespace {
+
+bool gSimdEnabled = true;
+
+inline int popcount64(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return int((v * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+inline uint64_t walkableWord(uint64_t a, int clearance) {
+    uint64_t open = ~a;
+    for (int k = 1; k < clearance; ++k) {
+        open &= ~(a >> k);
+    }
+    return open & (a << 1);
+}
+
+#if defined(VOX_KERNELS_AVX2)
+
+const size_t LANES = 4;
+typedef __m256i Vec;
+
+inline Vec load(const uint64_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+inline void store(uint64_t *p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+inline Vec vor(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline Vec vand(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+inline Vec vandnot(Vec a, Vec b) { return _mm256_andnot_si256(b, a); }
+inline Vec vnot(Vec a) { return _mm256_xor_si256(a, _mm256_set1_epi64x(-1)); }
+inline Vec vshl(Vec a, int n) { return _mm256_slli_epi64(a, n); }
+inline Vec vshr(Vec a, int n) { return _mm256_srli_epi64(a, n); }
+
+// Per 64-bit lane population count (nibble lookup, Mula et al.).
+inline Vec vpopcnt(Vec v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_and_si256(v, low);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+inline Vec vadd(Vec a, Vec b) { return _mm256_add_epi64(a, b); }
+inline Vec vzero() { return _mm256_setzero_si256(); }
+
+#elif defined(VOX_KERNELS_SSE2)
+
+const size_t LANES = 2;
+typedef __m128i Vec;
+
+inline Vec load(const uint64_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+inline void store(uint64_t *p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+inline Vec vor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline Vec vand(Vec a, Vec b) { return _mm_and_si128(a, b); }
+inline Vec vandnot(Vec a, Vec b) { return _mm_andnot_si128(b, a); }
+inline Vec vnot(Vec a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+inline Vec vshl(Vec a, int n) { return _mm_slli_epi64(a, n); }
+inline Vec vshr(Vec a, int n) { return _mm_srli_epi64(a, n); }
+
+// SWAR byte counts folded into 64-bit lanes with psadbw.
+inline Vec vpopcnt(Vec v) {
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0F);
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+    v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+    v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+    return _mm_sad_epu8(v, _mm_setzero_si128());
+}
+
+inline Vec vadd(Vec a, Vec b) { return _mm_add_epi64(a, b); }
+inline Vec vzero() { return _mm_setzero_si128(); }
+
+#endif
+
+#if defined(VOX_KERNELS_AVX2) || defined(VOX_KERNELS_SSE2)
+#define VOX_KERNELS_SIMD 1
+
+inline size_t vectorCount(size_t count) {
+    return gSimdEnabled ? count - count % LANES : 0;
+}
+
+inline uint64_t laneSum(Vec v) {
+    uint64_t lanes[LANES];
+    store(lanes, v);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < LANES; ++i) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+#endif
+
+} // namespace
+
+const char *instructionSet() {
+#if defined(VOX_KERNELS_AVX2)
+    return gSimdEnabled ? "avx2" : "scalar";
+#elif defined(VOX_KERNELS_SSE2)
+    return gSimdEnabled ? "sse2" : "scalar";
+#else
+    return "scalar";
+#endif
+}
+
+void setSimdEnabled(bool enabled) {
+    gSimdEnabled = enabled;
+}
+
+bool isSimdEnabled() {
+    return gSimdEnabled;
+}
+
+void orWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        store(out + i, vor(load(a + i), load(b + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] | b[i];
+    }
+}
+
+void andWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        store(out + i, vand(load(a + i), load(b + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] & b[i];
+    }
+}
+
+void andNotWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        store(out + i, vandnot(load(a + i), load(b + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] & ~b[i];
+    }
+}
+
+size_t popcountWords(const uint64_t *words, size_t count) {
+    size_t i = 0;
+    size_t total = 0;
+#ifdef VOX_KERNELS_SIMD
+    Vec acc = vzero();
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        acc = vadd(acc, vpopcnt(load(words + i)));
+    }
+    total = size_t(laneSum(acc));
+#endif
+    for (; i < count; ++i) {
+        total += popcount64(words[i]);
+    }
+    return total;
+}
+
+void popcountEach(const uint64_t *words, uint16_t *out, size_t count) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        uint64_t lanes[LANES];
+        store(lanes, vpopcnt(load(words + i)));
+        for (size_t l = 0; l < LANES; ++l) {
+            out[i + l] = uint16_t(lanes[l]);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = uint16_t(popcount64(words[i]));
+    }
+}
+
+void faceUp(const uint64_t *a, uint64_t *out, size_t count) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        Vec v = load(a + i);
+        store(out + i, vandnot(v, vshr(v, 1)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] & ~(a[i] >> 1);
+    }
+}
+
+void faceDown(const uint64_t *a, uint64_t *out, size_t count) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        Vec v = load(a + i);
+        store(out + i, vandnot(v, vshl(v, 1)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] & ~(a[i] << 1);
+    }
+}
+
+void walkable(const uint64_t *a, uint64_t *out, size_t count, int clearance) {
+    size_t i = 0;
+#ifdef VOX_KERNELS_SIMD
+    for (size_t n = vectorCount(count); i < n; i += LANES) {
+        Vec v = load(a + i);
+        Vec open = vnot(v);
+        for (int k = 1; k < clearance; ++k) {
+            open = vandnot(open, vshr(v, k));
+        }
+        store(out + i, vand(open, vshl(v, 1)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = walkableWord(a[i], clearance);
+    }
+}
+
+} // namespace kernels
+} // namespace vox
@@ -0,0 +1,38 @@
+#ifndef OCCUPANCYKERNELS_H
+#define OCCUPANCYKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vox {
+namespace kernels {
+
+// Word-array kernels behind OccupancyMask. Each has an AVX2, SSE2 and scalar
+// build; the vector path is picked at compile time (build with CONFIG+=avx2
+// for the AVX2 one) and can be switched off at runtime for comparisons.
+
+const char *instructionSet();
+void setSimdEnabled(bool enabled);
+bool isSimdEnabled();
+
+// out = a | b, a & b, a & ~b. out may alias a.
+void orWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count);
+void andWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count);
+void andNotWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t count);
+
+size_t popcountWords(const uint64_t *words, size_t count);
+// Per-word population count, used for single-word columns.
+void popcountEach(const uint64_t *words, uint16_t *out, size_t count);
+
+// Single-word columns only: faces whose +Y / -Y neighbour bit is clear.
+void faceUp(const uint64_t *a, uint64_t *out, size_t count);
+void faceDown(const uint64_t *a, uint64_t *out, size_t count);
+
+// Single-word columns only: empty cells standing on a solid cell with
+// clearance - 1 more empty cells above them.
+void walkable(const uint64_t *a, uint64_t *out, size_t count, int clearance);
+
+} // namespace kernels
+} // namespace vox
+
+#endif // OCCUPANCYKERNELS_H
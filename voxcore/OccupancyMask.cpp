@@ -0,0 +1,273 @@
+#include "OccupancyMask.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "OccupancyKernels.h"
+#include "VoxelMap.h"
+
+namespace vox {
+
+namespace {
+
+inline uint64_t lastWordMask(int height) {
+    int bits = height & 63;
+    return bits ? (uint64_t(1) << bits) - 1 : ~uint64_t(0);
+}
+
+} // namespace
+
+OccupancyMask::OccupancyMask()
+    : mWordsPerColumn(0) {}
+
+OccupancyMask::OccupancyMask(const Vec3i &origin, const Vec3i &size)
+    : mWordsPerColumn(0) {
+    reset(origin, size);
+}
+
+void OccupancyMask::reset(const Vec3i &origin, const Vec3i &size) {
+    mOrigin = origin;
+    mSize = size;
+    mWordsPerColumn = (size.y + 63) / 64;
+    mWords.assign(size_t(size.x) * size.z * mWordsPerColumn, 0);
+}
+
+void OccupancyMask::clear() {
+    std::fill(mWords.begin(), mWords.end(), 0);
+}
+
+OccupancyMask OccupancyMask::fromMap(const VoxelMap &map, const Vec3i &origin, const Vec3i &size) {
+    OccupancyMask mask(origin, size);
+    Vec3i last(origin.x + size.x - 1, origin.y + size.y - 1, origin.z + size.z - 1);
+    Vec3i first = chunkOf(origin);
+    Vec3i end = chunkOf(last);
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+
+    for (int cz = first.z; cz <= end.z; ++cz) {
+        for (int cy = first.y; cy <= end.y; ++cy) {
+            for (int cx = first.x; cx <= end.x; ++cx) {
+                mask.copyChunk(map, Vec3i(cx, cy, cz), cells);
+            }
+        }
+    }
+    return mask;
+}
+
+void OccupancyMask::copyChunk(const VoxelMap &map, const Vec3i &chunk) {
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    copyChunk(map, chunk, cells);
+}
+
+void OccupancyMask::copyChunk(const VoxelMap &map, const Vec3i &chunk, std::vector<uint32_t> &cells) {
+    Vec3i base(chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, chunk.z * CHUNK_SIZE);
+    int x0 = std::max(mOrigin.x, base.x), x1 = std::min(mOrigin.x + mSize.x - 1, base.x + CHUNK_MASK);
+    int y0 = std::max(mOrigin.y, base.y), y1 = std::min(mOrigin.y + mSize.y - 1, base.y + CHUNK_MASK);
+    int z0 = std::max(mOrigin.z, base.z), z1 = std::min(mOrigin.z + mSize.z - 1, base.z + CHUNK_MASK);
+    if (x0 > x1 || y0 > y1 || z0 > z1) {
+        return;
+    }
+    const Chunk *cellsChunk = map.findChunk(chunk);
+    bool empty = !cellsChunk || cellsChunk->isEmpty();
+    if (!empty) {
+        cellsChunk->getMaterials().decode(cells.data());
+    }
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+            uint64_t *column = getColumn(x - mOrigin.x, z - mOrigin.z);
+            for (int y = y0; y <= y1; ++y) {
+                int ly = y - mOrigin.y;
+                uint64_t bit = uint64_t(1) << (ly & 63);
+                bool solid = !empty && cells[cellIndex(x - base.x, y - base.y, z - base.z)] != AIR;
+                column[ly >> 6] = solid ? (column[ly >> 6] | bit) : (column[ly >> 6] & ~bit);
+            }
+        }
+    }
+}
+
+bool OccupancyMask::get(int x, int y, int z) const {
+    if (x < 0 || y < 0 || z < 0 || x >= mSize.x || y >= mSize.y || z >= mSize.z) {
+        return false;
+    }
+    return (getColumn(x, z)[y >> 6] >> (y & 63)) & 1;
+}
+
+void OccupancyMask::set(int x, int y, int z, bool solid) {
+    uint64_t bit = uint64_t(1) << (y & 63);
+    uint64_t &word = getColumn(x, z)[y >> 6];
+    word = solid ? (word | bit) : (word & ~bit);
+}
+
+const Vec3i &OccupancyMask::getOrigin() const {
+    return mOrigin;
+}
+
+const Vec3i &OccupancyMask::getSize() const {
+    return mSize;
+}
+
+int OccupancyMask::getWordsPerColumn() const {
+    return mWordsPerColumn;
+}
+
+const uint64_t *OccupancyMask::getColumn(int x, int z) const {
+    return mWords.data() + columnOffset(x, z);
+}
+
+uint64_t *OccupancyMask::getColumn(int x, int z) {
+    return mWords.data() + columnOffset(x, z);
+}
+
+const std::vector<uint64_t> &OccupancyMask::getWords() const {
+    return mWords;
+}
+
+void OccupancyMask::unite(const OccupancyMask &other) {
+    requireSameShape(other);
+    kernels::orWords(mWords.data(), other.mWords.data(), mWords.data(), mWords.size());
+}
+
+void OccupancyMask::intersect(const OccupancyMask &other) {
+    requireSameShape(other);
+    kernels::andWords(mWords.data(), other.mWords.data(), mWords.data(), mWords.size());
+}
+
+void OccupancyMask::subtract(const OccupancyMask &other) {
+    requireSameShape(other);
+    kernels::andNotWords(mWords.data(), other.mWords.data(), mWords.data(), mWords.size());
+}
+
+size_t OccupancyMask::count() const {
+    return kernels::popcountWords(mWords.data(), mWords.size());
+}
+
+void OccupancyMask::columnCounts(std::vector<uint16_t> &out) const {
+    size_t columns = size_t(mSize.x) * mSize.z;
+    out.resize(columns);
+    if (mWordsPerColumn == 1) {
+        kernels::popcountEach(mWords.data(), out.data(), columns);
+        return;
+    }
+    for (size_t c = 0; c < columns; ++c) {
+        out[c] = uint16_t(kernels::popcountWords(mWords.data() + c * mWordsPerColumn, mWordsPerColumn));
+    }
+}
+
+void OccupancyMask::extractFaces(Face face, OccupancyMask &out) const {
+    if (&out == this) {
+        throw std::invalid_argument("extractFaces cannot work in place");
+    }
+    out.reset(mOrigin, mSize);
+    if (mWords.empty()) {
+        return;
+    }
+    const uint64_t *a = mWords.data();
+    uint64_t *o = out.mWords.data();
+    const size_t wpc = size_t(mWordsPerColumn);
+    const size_t row = size_t(mSize.x) * wpc;
+    const size_t total = mWords.size();
+
+    switch (face) {
+    case FACE_POS_X:
+    case FACE_NEG_X:
+        for (int z = 0; z < mSize.z; ++z) {
+            size_t base = z * row;
+            if (face == FACE_POS_X) {
+                kernels::andNotWords(a + base, a + base + wpc, o + base, row - wpc);
+                std::copy(a + base + row - wpc, a + base + row, o + base + row - wpc);
+            } else {
+                kernels::andNotWords(a + base + wpc, a + base, o + base + wpc, row - wpc);
+                std::copy(a + base, a + base + wpc, o + base);
+            }
+        }
+        break;
+    case FACE_POS_Z:
+        kernels::andNotWords(a, a + row, o, total - row);
+        std::copy(a + total - row, a + total, o + total - row);
+        break;
+    case FACE_NEG_Z:
+        kernels::andNotWords(a + row, a, o + row, total - row);
+        std::copy(a, a + row, o);
+        break;
+    case FACE_POS_Y:
+    case FACE_NEG_Y:
+        if (wpc == 1) {
+            if (face == FACE_POS_Y) {
+                kernels::faceUp(a, o, total);
+            } else {
+                kernels::faceDown(a, o, total);
+            }
+            break;
+        }
+        for (size_t c = 0; c < total; c += wpc) {
+            for (size_t w = 0; w < wpc; ++w) {
+                uint64_t v = a[c + w];
+                uint64_t neighbour;
+                if (face == FACE_POS_Y) {
+                    neighbour = (v >> 1) | (w + 1 < wpc ? a[c + w + 1] << 63 : 0);
+                } else {
+                    neighbour = (v << 1) | (w > 0 ? a[c + w - 1] >> 63 : 0);
+                }
+                o[c + w] = v & ~neighbour;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+size_t OccupancyMask::countFaces() const {
+    OccupancyMask faces;
+    size_t total = 0;
+    for (int f = 0; f < FACE_COUNT; ++f) {
+        extractFaces(Face(f), faces);
+        total += faces.count();
+    }
+    return total;
+}
+
+void OccupancyMask::extractWalkable(int clearance, OccupancyMask &out) const {
+    if (&out == this) {
+        throw std::invalid_argument("extractWalkable cannot work in place");
+    }
+    if (clearance < 1 || clearance > 63) {
+        throw std::invalid_argument("clearance must be within 1..63");
+    }
+    out.reset(mOrigin, mSize);
+    const size_t wpc = size_t(mWordsPerColumn);
+    const uint64_t topMask = lastWordMask(mSize.y);
+    const uint64_t *a = mWords.data();
+    uint64_t *o = out.mWords.data();
+
+    if (wpc == 1) {
+        kernels::walkable(a, o, mWords.size(), clearance);
+        for (size_t i = 0; i < mWords.size(); ++i) {
+            o[i] &= topMask;
+        }
+        return;
+    }
+    for (size_t c = 0; c < mWords.size(); c += wpc) {
+        for (size_t w = 0; w < wpc; ++w) {
+            uint64_t v = a[c + w];
+            uint64_t next = w + 1 < wpc ? a[c + w + 1] : 0;
+            uint64_t below = (v << 1) | (w > 0 ? a[c + w - 1] >> 63 : 0);
+            uint64_t open = ~v;
+            for (int k = 1; k < clearance; ++k) {
+                open &= ~((v >> k) | (next << (64 - k)));
+            }
+            o[c + w] = open & below & (w + 1 == wpc ? topMask : ~uint64_t(0));
+        }
+    }
+}
+
+size_t OccupancyMask::columnOffset(int x, int z) const {
+    return (size_t(z) * mSize.x + x) * mWordsPerColumn;
+}
+
+void OccupancyMask::requireSameShape(const OccupancyMask &other) const {
+    if (mOrigin != other.mOrigin || mSize != other.mSize) {
+        throw std::invalid_argument("Occupancy masks cover different regions");
+    }
+}
+
+} // namespace vox
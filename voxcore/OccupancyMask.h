@@ -0,0 +1,78 @@
+#ifndef OCCUPANCYMASK_H
+#define OCCUPANCYMASK_H
+
+#include <vector>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+class VoxelMap;
+
+enum Face {
+    FACE_POS_X = 0,
+    FACE_NEG_X,
+    FACE_POS_Y,
+    FACE_NEG_Y,
+    FACE_POS_Z,
+    FACE_NEG_Z,
+    FACE_COUNT
+};
+
+// Solid/empty bits for a box of the world. Each (x, z) column is a run of
+// 64-bit words with bit b of word w holding y = w * 64 + b, columns are laid
+// out x fastest. Everything outside the box counts as empty.
+class OccupancyMask {
+public:
+    OccupancyMask();
+    OccupancyMask(const Vec3i &origin, const Vec3i &size);
+
+    void reset(const Vec3i &origin, const Vec3i &size);
+    void clear();
+
+    // Copies the solid cells of map inside [origin, origin + size).
+    static OccupancyMask fromMap(const VoxelMap &map, const Vec3i &origin, const Vec3i &size);
+    // Recopies the cells of one chunk, for keeping a mask in step with edits.
+    void copyChunk(const VoxelMap &map, const Vec3i &chunk);
+
+    // Local coordinates, relative to the origin.
+    bool get(int x, int y, int z) const;
+    void set(int x, int y, int z, bool solid);
+
+    const Vec3i &getOrigin() const;
+    const Vec3i &getSize() const;
+    int getWordsPerColumn() const;
+    const uint64_t *getColumn(int x, int z) const;
+    uint64_t *getColumn(int x, int z);
+    const std::vector<uint64_t> &getWords() const;
+
+    // Boolean ops between masks of the same shape.
+    void unite(const OccupancyMask &other);
+    void intersect(const OccupancyMask &other);
+    void subtract(const OccupancyMask &other);
+
+    size_t count() const;
+    // One count per column, x fastest.
+    void columnCounts(std::vector<uint16_t> &out) const;
+
+    // Solid cells whose neighbour across face is empty.
+    void extractFaces(Face face, OccupancyMask &out) const;
+    size_t countFaces() const;
+
+    // Empty cells with a solid cell below and clearance - 1 empty cells above.
+    void extractWalkable(int clearance, OccupancyMask &out) const;
+
+private:
+    void copyChunk(const VoxelMap &map, const Vec3i &chunk, std::vector<uint32_t> &cells);
+    size_t columnOffset(int x, int z) const;
+    void requireSameShape(const OccupancyMask &other) const;
+
+    Vec3i mOrigin;
+    Vec3i mSize;
+    int mWordsPerColumn;
+    std::vector<uint64_t> mWords;
+};
+
+} // namespace vox
+
+#endif // OCCUPANCYMASK_H
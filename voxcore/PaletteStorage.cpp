@@ -0,0 +1,312 @@
+#include "PaletteStorage.h"
+
+#include "Serialization.h"
+
+namespace vox {
+
+namespace {
+const size_t LINEAR_LOOKUP_LIMIT = 16;
+}
+
+PaletteStorage::PaletteStorage(uint32_t fill)
+    : mBits(0), mValuesPerWord(0), mMask(0) {
+    this->fill(fill);
+}
+
+int PaletteStorage::bitsFor(size_t paletteSize) {
+    int bits = 0;
+    while ((size_t(1) << bits) < paletteSize) {
+        ++bits;
+    }
+    return bits > 16 ? 16 : bits;
+}
+
+uint32_t PaletteStorage::get(int index) const {
+    return mPalette[getIndex(index)];
+}
+
+bool PaletteStorage::set(int index, uint32_t value) {
+    uint32_t oldSlot = getIndex(index);
+    if (mPalette[oldSlot] == value) {
+        return false;
+    }
+    uint32_t newSlot = findOrAdd(value);
+    setIndex(index, newSlot);
+    ++mRefCounts[newSlot];
+    if (--mRefCounts[oldSlot] == 0) {
+        mFreeSlots.push_back(oldSlot);
+    }
+    return true;
+}
+
+void PaletteStorage::fill(uint32_t value) {
+    mPalette.assign(1, value);
+    mRefCounts.assign(1, CHUNK_VOLUME);
+    mFreeSlots.clear();
+    mLookup.clear();
+    mWords.clear();
+    mBits = 0;
+    mValuesPerWord = 0;
+    mMask = 0;
+}
+
+void PaletteStorage::decode(uint32_t *out) const {
+    if (mBits == 0) {
+        for (int i = 0; i < CHUNK_VOLUME; ++i) {
+            out[i] = mPalette[0];
+        }
+        return;
+    }
+    int i = 0;
+    for (size_t w = 0; w < mWords.size() && i < CHUNK_VOLUME; ++w) {
+        uint64_t word = mWords[w];
+        for (int n = 0; n < mValuesPerWord && i < CHUNK_VOLUME; ++n, ++i) {
+            out[i] = mPalette[word & mMask];
+            word >>= mBits;
+        }
+    }
+}
+
+void PaletteStorage::encode(const uint32_t *values) {
+    mPalette.clear();
+    mRefCounts.clear();
+    mFreeSlots.clear();
+    mLookup.clear();
+
+    std::vector<uint32_t> slots(CHUNK_VOLUME);
+    std::unordered_map<uint32_t, uint32_t> seen;
+    for (int i = 0; i < CHUNK_VOLUME; ++i) {
+        // Runs of equal values are common, skip the hash lookup for them.
+        if (i > 0 && values[i] == values[i - 1]) {
+            slots[i] = slots[i - 1];
+        } else {
+            auto it = seen.find(values[i]);
+            if (it == seen.end()) {
+                it = seen.emplace(values[i], uint32_t(mPalette.size())).first;
+                mPalette.push_back(values[i]);
+                mRefCounts.push_back(0);
+            }
+            slots[i] = it->second;
+        }
+        ++mRefCounts[slots[i]];
+    }
+
+    mBits = bitsFor(mPalette.size());
+    mWords.clear();
+    if (mBits > 0) {
+        mValuesPerWord = 64 / mBits;
+        mMask = (uint64_t(1) << mBits) - 1;
+        mWords.assign((CHUNK_VOLUME + mValuesPerWord - 1) / mValuesPerWord, 0);
+        for (int i = 0; i < CHUNK_VOLUME; ++i) {
+            setIndex(i, slots[i]);
+        }
+    } else {
+        mValuesPerWord = 0;
+        mMask = 0;
+    }
+    rebuildLookup();
+}
+
+void PaletteStorage::compact() {
+    if (mFreeSlots.empty()) {
+        return;
+    }
+    std::vector<uint32_t> values(CHUNK_VOLUME);
+    decode(values.data());
+    encode(values.data());
+}
+
+void PaletteStorage::write(ByteWriter &out) const {
+    if (!mFreeSlots.empty()) {
+        PaletteStorage compacted(*this);
+        compacted.compact();
+        compacted.write(out);
+        return;
+    }
+    out.putU16(uint16_t(mPalette.size() - 1));
+    out.putU8(uint8_t(mBits));
+    for (uint32_t value : mPalette) {
+        out.putU32(value);
+    }
+    for (uint64_t word : mWords) {
+        out.putU64(word);
+    }
+}
+
+bool PaletteStorage::read(ByteReader &in) {
+    size_t count = size_t(in.getU16()) + 1;
+    int bits = in.getU8();
+    if (!in.ok() || bits != bitsFor(count) || !in.require(count * 4)) {
+        return false;
+    }
+    std::vector<uint32_t> palette(count);
+    for (uint32_t &value : palette) {
+        value = in.getU32();
+    }
+    int perWord = bits ? 64 / bits : 0;
+    size_t wordCount = bits ? (CHUNK_VOLUME + perWord - 1) / perWord : 0;
+    if (!in.require(wordCount * 8)) {
+        return false;
+    }
+    std::vector<uint64_t> words(wordCount);
+    for (uint64_t &word : words) {
+        word = in.getU64();
+    }
+
+    std::vector<uint32_t> refCounts(count, 0);
+    if (bits == 0) {
+        refCounts[0] = CHUNK_VOLUME;
+    } else {
+        uint64_t mask = (uint64_t(1) << bits) - 1;
+        int i = 0;
+        for (size_t w = 0; w < wordCount; ++w) {
+            uint64_t word = words[w];
+            for (int n = 0; n < perWord && i < CHUNK_VOLUME; ++n, ++i) {
+                uint64_t slot = word & mask;
+                if (slot >= count) {
+                    return false;
+                }
+                ++refCounts[slot];
+                word >>= bits;
+            }
+        }
+    }
+
+    mBits = bits;
+    mValuesPerWord = perWord;
+    mMask = bits ? (uint64_t(1) << bits) - 1 : 0;
+    mPalette.swap(palette);
+    mRefCounts.swap(refCounts);
+    mWords.swap(words);
+    mFreeSlots.clear();
+    for (size_t slot = 0; slot < mRefCounts.size(); ++slot) {
+        if (mRefCounts[slot] == 0) {
+            mFreeSlots.push_back(uint32_t(slot));
+        }
+    }
+    rebuildLookup();
+    return true;
+}
+
+bool PaletteStorage::isUniform() const {
+    return mPalette.size() - mFreeSlots.size() == 1;
+}
+
+int PaletteStorage::getBits() const {
+    return mBits;
+}
+
+size_t PaletteStorage::getPaletteSize() const {
+    return mPalette.size();
+}
+
+uint32_t PaletteStorage::getPaletteValue(size_t slot) const {
+    return mPalette[slot];
+}
+
+size_t PaletteStorage::memoryUsage() const {
+    return sizeof(*this)
+        + mWords.capacity() * sizeof(uint64_t)
+        + mPalette.capacity() * sizeof(uint32_t)
+        + mRefCounts.capacity() * sizeof(uint32_t)
+        + mFreeSlots.capacity() * sizeof(uint32_t)
+        + mLookup.size() * (sizeof(uint32_t) * 2 + sizeof(void *));
+}
+
+uint32_t PaletteStorage::getIndex(int index) const {
+    if (mBits == 0) {
+        return 0;
+    }
+    int word = index / mValuesPerWord;
+    int shift = (index - word * mValuesPerWord) * mBits;
+    return uint32_t((mWords[word] >> shift) & mMask);
+}
+
+void PaletteStorage::setIndex(int index, uint32_t slot) {
+    int word = index / mValuesPerWord;
+    int shift = (index - word * mValuesPerWord) * mBits;
+    mWords[word] = (mWords[word] & ~(mMask << shift)) | (uint64_t(slot) << shift);
+}
+
+uint32_t PaletteStorage::findOrAdd(uint32_t value) {
+    if (mPalette.size() <= LINEAR_LOOKUP_LIMIT) {
+        for (size_t i = 0; i < mPalette.size(); ++i) {
+            if (mPalette[i] == value && mRefCounts[i] > 0) {
+                return uint32_t(i);
+            }
+        }
+    } else {
+        auto it = mLookup.find(value);
+        if (it != mLookup.end() && mRefCounts[it->second] > 0) {
+            return it->second;
+        }
+    }
+
+    uint32_t slot;
+    if (!mFreeSlots.empty()) {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        if (!mLookup.empty()) {
+            auto old = mLookup.find(mPalette[slot]);
+            if (old != mLookup.end() && old->second == slot) {
+                mLookup.erase(old);
+            }
+        }
+        mPalette[slot] = value;
+    } else {
+        slot = uint32_t(mPalette.size());
+        mPalette.push_back(value);
+        mRefCounts.push_back(0);
+        int bits = bitsFor(mPalette.size());
+        if (bits != mBits) {
+            repack(bits);
+        }
+    }
+
+    if (mPalette.size() > LINEAR_LOOKUP_LIMIT) {
+        if (mLookup.empty()) {
+            rebuildLookup();
+        }
+        mLookup[value] = slot;
+    }
+    return slot;
+}
+
+void PaletteStorage::repack(int bits) {
+    std::vector<uint64_t> oldWords;
+    oldWords.swap(mWords);
+    int oldBits = mBits;
+    int oldPerWord = mValuesPerWord;
+    uint64_t oldMask = mMask;
+
+    mBits = bits;
+    mValuesPerWord = 64 / bits;
+    mMask = (uint64_t(1) << bits) - 1;
+    mWords.assign((CHUNK_VOLUME + mValuesPerWord - 1) / mValuesPerWord, 0);
+
+    if (oldBits == 0) {
+        return; // every cell was slot 0
+    }
+    int i = 0;
+    for (size_t w = 0; w < oldWords.size() && i < CHUNK_VOLUME; ++w) {
+        uint64_t word = oldWords[w];
+        for (int n = 0; n < oldPerWord && i < CHUNK_VOLUME; ++n, ++i) {
+            setIndex(i, uint32_t(word & oldMask));
+            word >>= oldBits;
+        }
+    }
+}
+
+void PaletteStorage::rebuildLookup() {
+    mLookup.clear();
+    if (mPalette.size() <= LINEAR_LOOKUP_LIMIT) {
+        return;
+    }
+    for (size_t i = 0; i < mPalette.size(); ++i) {
+        if (mRefCounts[i] > 0) {
+            mLookup[mPalette[i]] = uint32_t(i);
+        }
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,69 @@
+#ifndef PALETTESTORAGE_H
+#define PALETTESTORAGE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "VoxelTypes.h"
+
+namespace vox {
+
+class ByteReader;
+class ByteWriter;
+
+// Stores CHUNK_VOLUME 32-bit values as indices into a small palette.
+// Indices are packed into 64-bit words with 0..16 bits per cell depending
+// on how many distinct values are live; a uniform chunk uses no words at all.
+// Indices never straddle a word boundary so reads are one load and a shift.
+class PaletteStorage {
+public:
+    explicit PaletteStorage(uint32_t fill = 0);
+
+    uint32_t get(int index) const;
+    // Returns false when the cell already held value.
+    bool set(int index, uint32_t value);
+    void fill(uint32_t value);
+
+    // Bulk access, CHUNK_VOLUME values in cell order.
+    void decode(uint32_t *out) const;
+    void encode(const uint32_t *values);
+
+    // Drops unused palette entries and shrinks the bit width.
+    void compact();
+
+    // Compact form: live palette, bit width and packed words. read() checks
+    // every index against the palette and leaves the storage untouched on
+    // malformed input.
+    void write(ByteWriter &out) const;
+    bool read(ByteReader &in);
+
+    bool isUniform() const;
+    int getBits() const;
+    size_t getPaletteSize() const;
+    uint32_t getPaletteValue(size_t slot) const;
+    size_t memoryUsage() const;
+
+private:
+    uint32_t getIndex(int index) const;
+    void setIndex(int index, uint32_t slot);
+    uint32_t findOrAdd(uint32_t value);
+    void repack(int bits);
+    void rebuildLookup();
+
+    static int bitsFor(size_t paletteSize);
+
+    int mBits;
+    int mValuesPerWord;
+    uint64_t mMask;
+    std::vector<uint32_t> mPalette;
+    std::vector<uint32_t> mRefCounts;
+    std::vector<uint32_t> mFreeSlots;
+    std::vector<uint64_t> mWords;
+    // Only used once the palette outgrows a linear scan.
+    std::unordered_map<uint32_t, uint32_t> mLookup;
+};
+
+} // namespace vox
+
+#endif // PALETTESTORAGE_H
@@ -0,0 +1,96 @@
+#include "Parallel.h"
+
+namespace vox {
+
+int hardwareThreads() {
+    int threads = int(std::thread::hardware_concurrency());
+    return threads > 0 ? threads : 1;
+}
+
+ThreadPool::ThreadPool(int threads)
+    : mTask(nullptr), mCount(0), mNext(0), mPending(0), mGeneration(0), mStop(false) {
+    if (threads <= 0) {
+        threads = hardwareThreads();
+    }
+    for (int i = 1; i < threads; ++i) {
+        mThreads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (std::thread &thread : mThreads) {
+        thread.join();
+    }
+}
+
+int ThreadPool::getThreadCount() const {
+    return int(mThreads.size()) + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &fn) {
+    if (count == 0) {
+        return;
+    }
+    if (mThreads.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(mCallMutex);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &fn;
+        mCount = count;
+        mNext = 0;
+        mPending = mThreads.size();
+        ++mGeneration;
+    }
+    mWake.notify_all();
+    runItems();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mPending == 0; });
+    mTask = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+        if (mStop) {
+            return;
+        }
+        seen = mGeneration;
+        lock.unlock();
+        runItems();
+        lock.lock();
+        if (--mPending == 0) {
+            mDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runItems() {
+    for (;;) {
+        size_t i = mNext.fetch_add(1);
+        if (i >= mCount) {
+            return;
+        }
+        (*mTask)(i);
+    }
+}
+
+ThreadPool &defaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+} // namespace vox
@@ -0,0 +1,56 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vox {
+
+// Number of hardware threads, at least 1.
+int hardwareThreads();
+
+// Fixed set of worker threads for splitting per-chunk work. The threads
+// stay parked between calls so per-frame jobs (physics, diffusion, meshing)
+// do not pay for thread creation every time.
+class ThreadPool {
+public:
+    // threads counts the calling thread too, 0 means hardwareThreads().
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    int getThreadCount() const;
+
+    // Calls fn(i) once for every i in [0, count) and returns when all calls
+    // are done. The calling thread takes part. Indices are handed out one
+    // at a time, so uneven items balance out. Calls from several threads
+    // are serialized; calling it from inside fn is not supported.
+    void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+private:
+    void workerLoop();
+    void runItems();
+
+    std::vector<std::thread> mThreads;
+    std::mutex mCallMutex;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    const std::function<void(size_t)> *mTask;
+    size_t mCount;
+    std::atomic<size_t> mNext;
+    size_t mPending;
+    uint64_t mGeneration;
+    bool mStop;
+};
+
+// Shared pool sized to the machine, created on first use.
+ThreadPool &defaultThreadPool();
+
+} // namespace vox
+
+#endif // PARALLEL_H
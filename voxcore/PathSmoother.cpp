@@ -0,0 +1,186 @@
+#include "PathSmoother.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace vox {
+
+namespace {
+
+// Heights tried around the curve when looking for the floor under it.
+const int LAND_OFFSETS[5] = {0, 1, -1, 2, -2};
+
+struct Point {
+    float x, y, z;
+};
+
+Point pointOf(const Vec3i &cell) {
+    return Point{float(cell.x), float(cell.y), float(cell.z)};
+}
+
+Point mix(const Point &a, const Point &b, float ta, float tb, float t) {
+    float wa = (tb - t) / (tb - ta);
+    float wb = (t - ta) / (tb - ta);
+    return Point{a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb};
+}
+
+float distance(const Point &a, const Point &b) {
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float dz = b.z - a.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+float distance(const Waypoint &a, const Waypoint &b) {
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float dz = b.z - a.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+inline int roundInt(float v) {
+    return int(std::floor(v + 0.5f));
+}
+
+} // namespace
+
+PathSmoother::PathSmoother(const GridPathfinder &pathfinder)
+    : mPathfinder(pathfinder) {}
+
+Waypoint PathSmoother::waypointOf(const Vec3i &cell) {
+    return Waypoint(float(cell.x), float(cell.y) - 0.5f, float(cell.z));
+}
+
+// Walks out from each kept cell as far as straight lines reach. A failed
+// line ends the search from that cell: paths bend around what blocked it,
+// so cells further on are rarely in reach either.
+void PathSmoother::pull(const std::vector<Vec3i> &path, std::vector<Vec3i> &corners, const PathSettings &settings,
+                        const SmoothSettings &smooth, size_t *checks) const {
+    corners.clear();
+    if (path.empty()) {
+        return;
+    }
+    size_t walked = 0;
+    size_t anchor = 0;
+    corners.push_back(path[0]);
+    while (anchor + 1 < path.size()) {
+        if (smooth.maxChecks && walked >= smooth.maxChecks) {
+            corners.insert(corners.end(), path.begin() + anchor + 1, path.end());
+            break;
+        }
+        size_t last = std::min(path.size() - 1, anchor + std::max<size_t>(smooth.maxLookahead, 1));
+        size_t best = anchor + 1;
+        for (size_t next = anchor + 2; next <= last; ++next) {
+            if ((smooth.maxChecks && walked >= smooth.maxChecks)
+                || !mPathfinder.canWalkStraight(path[anchor], path[next], settings, &walked)) {
+                break;
+            }
+            best = next;
+        }
+        corners.push_back(path[best]);
+        anchor = best;
+    }
+    if (checks) {
+        *checks += walked;
+    }
+}
+
+bool PathSmoother::landOn(float x, float y, float z, const PathSettings &settings, Vec3i &cell) const {
+    int cx = roundInt(x);
+    int cy = roundInt(y);
+    int cz = roundInt(z);
+    for (int offset : LAND_OFFSETS) {
+        Vec3i c(cx, cy + offset, cz);
+        if (mPathfinder.isWalkable(c, settings)) {
+            cell = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Curve from points[1] to points[2], without either end.
+bool PathSmoother::curve(const Vec3i *points[4], std::vector<Waypoint> &out, const PathSettings &settings,
+                         const SmoothSettings &smooth, size_t &checks) const {
+    Point p[4];
+    for (int i = 0; i < 4; ++i) {
+        p[i] = pointOf(*points[i]);
+    }
+    // Missing neighbours at the ends of the path are mirrored.
+    if (*points[0] == *points[1]) {
+        p[0] = Point{2.0f * p[1].x - p[2].x, 2.0f * p[1].y - p[2].y, 2.0f * p[1].z - p[2].z};
+    }
+    if (*points[3] == *points[2]) {
+        p[3] = Point{2.0f * p[2].x - p[1].x, 2.0f * p[2].y - p[1].y, 2.0f * p[2].z - p[1].z};
+    }
+    // Centripetal knots: the square root of the distance between points,
+    // which keeps the curve from looping or overshooting at sharp turns.
+    float t[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 1; i < 4; ++i) {
+        t[i] = t[i - 1] + std::max(std::sqrt(distance(p[i - 1], p[i])), 1e-3f);
+    }
+    int samples = std::max(1, int(std::ceil(distance(p[1], p[2]) / std::max(smooth.spacing, 0.1f))));
+    Vec3i previous = *points[1];
+    for (int k = 1; k < samples; ++k) {
+        float u = t[1] + (t[2] - t[1]) * float(k) / float(samples);
+        Point a1 = mix(p[0], p[1], t[0], t[1], u);
+        Point a2 = mix(p[1], p[2], t[1], t[2], u);
+        Point a3 = mix(p[2], p[3], t[2], t[3], u);
+        Point b1 = mix(a1, a2, t[0], t[2], u);
+        Point b2 = mix(a2, a3, t[1], t[3], u);
+        Point c = mix(b1, b2, t[1], t[2], u);
+        Vec3i cell;
+        if (!landOn(c.x, c.y, c.z, settings, cell)) {
+            return false;
+        }
+        if (cell != previous) {
+            if (!mPathfinder.canWalkStraight(previous, cell, settings, &checks)) {
+                return false;
+            }
+            previous = cell;
+        }
+        out.push_back(Waypoint(c.x, float(cell.y) - 0.5f, c.z));
+    }
+    return previous == *points[2] || mPathfinder.canWalkStraight(previous, *points[2], settings, &checks);
+}
+
+void PathSmoother::smooth(const std::vector<Vec3i> &path, std::vector<Waypoint> &out, const PathSettings &settings,
+                          const SmoothSettings &smooth, SmoothStats *stats) const {
+    auto start = std::chrono::steady_clock::now();
+    out.clear();
+    size_t checks = 0;
+    std::vector<Vec3i> corners;
+    pull(path, corners, settings, smooth, &checks);
+
+    for (size_t i = 0; i < corners.size(); ++i) {
+        if (i > 0 && smooth.spline && (!smooth.maxChecks || checks < smooth.maxChecks)) {
+            const Vec3i *points[4] = {&corners[i > 1 ? i - 2 : i - 1], &corners[i - 1], &corners[i],
+                                      &corners[i + 1 < corners.size() ? i + 1 : i]};
+            size_t mark = out.size();
+            if (!curve(points, out, settings, smooth, checks)) {
+                out.resize(mark);
+            }
+        }
+        out.push_back(waypointOf(corners[i]));
+    }
+
+    if (stats) {
+        stats->cellsIn = path.size();
+        stats->corners = corners.size();
+        stats->points = out.size();
+        stats->checks = checks;
+        stats->lengthIn = 0.0f;
+        for (size_t i = 1; i < path.size(); ++i) {
+            stats->lengthIn += distance(pointOf(path[i - 1]), pointOf(path[i]));
+        }
+        stats->lengthOut = 0.0f;
+        for (size_t i = 1; i < out.size(); ++i) {
+            stats->lengthOut += distance(out[i - 1], out[i]);
+        }
+        stats->milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+} // namespace vox
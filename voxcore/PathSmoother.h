@@ -0,0 +1,82 @@
+#ifndef PATHSMOOTHER_H
+#define PATHSMOOTHER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "GridPathfinder.h"
+
+namespace vox {
+
+// A point an agent walks to, on the floor: x and z at the middle of the
+// cell, y at the top of the solid cell below.
+struct Waypoint {
+    float x, y, z;
+
+    Waypoint() : x(0.0f), y(0.0f), z(0.0f) {}
+    Waypoint(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+struct SmoothSettings {
+    size_t maxLookahead;    // furthest cell down the path tried as a shortcut
+    size_t maxChecks;       // columns walked per path before shortcuts stop; 0 for no limit
+    bool spline;            // round the corners that are left
+    float spacing;          // distance between points on the rounded curve
+
+    SmoothSettings() : maxLookahead(32), maxChecks(20000), spline(false), spacing(0.5f) {}
+};
+
+struct SmoothStats {
+    size_t cellsIn;
+    size_t corners;         // cells kept by string pulling
+    size_t points;          // waypoints written
+    size_t checks;          // columns walked testing shortcuts and curve points
+    float lengthIn;
+    float lengthOut;
+    double milliseconds;
+
+    SmoothStats()
+        : cellsIn(0), corners(0), points(0), checks(0), lengthIn(0.0f), lengthOut(0.0f), milliseconds(0.0) {}
+};
+
+// Post pass over GridPathfinder paths. String pulling keeps a cell only
+// when the next one down the path cannot be walked to in a straight line
+// from the last cell kept, so agents cut across open ground at any angle
+// instead of zig-zagging along the grid. Shortcuts are tested with
+// GridPathfinder::canWalkStraight() and the same PathSettings the path was
+// found with, which keeps height and radius clearance intact.
+//
+// The spline option runs a centripetal Catmull-Rom curve through the kept
+// cells. Each point of a curve segment must land on a walkable cell that
+// can be walked to straight from the point before; a segment that fails
+// stays a straight line.
+//
+// The work per path is bounded by maxLookahead and maxChecks; once the
+// budget runs out the rest of the path is copied unchanged.
+class PathSmoother {
+public:
+    explicit PathSmoother(const GridPathfinder &pathfinder);
+
+    // Cells of path worth keeping, first and last always included.
+    void pull(const std::vector<Vec3i> &path, std::vector<Vec3i> &corners,
+              const PathSettings &settings = PathSettings(), const SmoothSettings &smooth = SmoothSettings(),
+              size_t *checks = nullptr) const;
+
+    // Pulls path and writes the waypoints to follow, curved when asked.
+    void smooth(const std::vector<Vec3i> &path, std::vector<Waypoint> &out,
+                const PathSettings &settings = PathSettings(), const SmoothSettings &smooth = SmoothSettings(),
+                SmoothStats *stats = nullptr) const;
+
+    static Waypoint waypointOf(const Vec3i &cell);
+
+private:
+    bool curve(const Vec3i *points[4], std::vector<Waypoint> &out, const PathSettings &settings,
+               const SmoothSettings &smooth, size_t &checks) const;
+    bool landOn(float x, float y, float z, const PathSettings &settings, Vec3i &cell) const;
+
+    const GridPathfinder &mPathfinder;
+};
+
+} // namespace vox
+
+#endif // PATHSMOOTHER_H
@@ -0,0 +1,318 @@
+#include "RegionFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include "MapFile.h"
+#include "Parallel.h"
+#include "Serialization.h"
+
+namespace vox {
+
+namespace {
+
+const char REGION_MAGIC[4] = {'V', 'X', 'R', '1'};
+const uint32_t REGION_VERSION = 1;
+const size_t SECTOR_SIZE = 4096;
+const size_t MAX_SECTORS = 255;
+const size_t HEADER_BYTES = 8 + REGION_VOLUME * 4;
+const size_t HEADER_SECTORS = (HEADER_BYTES + SECTOR_SIZE - 1) / SECTOR_SIZE;
+// Chunks decoded per parallel batch, bounds the payload memory held at once.
+const size_t DECODE_BATCH = 256;
+const char MATERIALS_FILE[] = "materials.vxm";
+
+bool fail(std::string *error, const std::string &message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+int regionSlot(const Vec3i &chunk) {
+    return (chunk.x & (REGION_SIZE - 1))
+        + ((chunk.y & (REGION_SIZE - 1)) << REGION_BITS)
+        + ((chunk.z & (REGION_SIZE - 1)) << (2 * REGION_BITS));
+}
+
+Vec3i slotChunk(const Vec3i &region, int slot) {
+    return Vec3i((region.x << REGION_BITS) + (slot & (REGION_SIZE - 1)),
+                 (region.y << REGION_BITS) + ((slot >> REGION_BITS) & (REGION_SIZE - 1)),
+                 (region.z << REGION_BITS) + (slot >> (2 * REGION_BITS)));
+}
+
+bool parseRegionName(const std::string &path, Vec3i &region) {
+    std::string name = std::filesystem::path(path).filename().string();
+    char tail[8] = {0};
+    return std::sscanf(name.c_str(), "r.%d.%d.%d.%4s", &region.x, &region.y, &region.z, tail) == 4
+        && !std::strcmp(tail, "vxr");
+}
+
+bool writeRegion(const std::string &path, const std::vector<std::pair<int, std::vector<uint8_t>>> &chunks) {
+    std::vector<uint8_t> header;
+    ByteWriter out(header);
+    out.putBytes(REGION_MAGIC, 4);
+    out.putU32(REGION_VERSION);
+    std::vector<uint32_t> table(REGION_VOLUME, 0);
+    size_t sector = HEADER_SECTORS;
+    for (const auto &chunk : chunks) {
+        size_t sectors = (chunk.second.size() + 8 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        if (sectors > MAX_SECTORS) {
+            return false;
+        }
+        table[chunk.first] = uint32_t(sector << 8 | sectors);
+        sector += sectors;
+    }
+    for (uint32_t entry : table) {
+        out.putU32(entry);
+    }
+    header.resize(HEADER_SECTORS * SECTOR_SIZE, 0);
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+    std::vector<uint8_t> record;
+    for (const auto &chunk : chunks) {
+        if (!ok) {
+            break;
+        }
+        record.clear();
+        ByteWriter w(record);
+        w.putU32(uint32_t(chunk.second.size()));
+        w.putU32(checksum(chunk.second.data(), chunk.second.size()));
+        w.putBytes(chunk.second.data(), chunk.second.size());
+        record.resize((record.size() + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE, 0);
+        ok = std::fwrite(record.data(), 1, record.size(), file) == record.size();
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+bool readMaterialTable(const std::string &path, MaterialRegistry &materials, std::vector<uint32_t> &remap) {
+    MapRecordReader reader;
+    if (!reader.open(path, MAP_MAGIC)) {
+        return false;
+    }
+    MapRecord record;
+    MaterialRegistry stored;
+    while (reader.next(record)) {
+        if (record.type == RECORD_MATERIALS) {
+            if (!decodeMaterials(record.payload, stored)) {
+                return false;
+            }
+            break;
+        }
+    }
+    // Ids in the regions refer to the stored registry, match them up by name.
+    remap.assign(stored.size(), AIR);
+    for (size_t i = 1; i < stored.size(); ++i) {
+        const Material &material = stored.get(MaterialId(i));
+        MaterialId id = materials.findByName(material.name);
+        remap[i] = id != AIR ? id : materials.add(material);
+    }
+    bool identity = true;
+    for (size_t i = 0; i < remap.size(); ++i) {
+        identity = identity && remap[i] == i;
+    }
+    if (identity) {
+        remap.clear();
+    }
+    return true;
+}
+
+struct PendingChunk {
+    Vec3i key;
+    std::vector<uint8_t> payload;
+    std::shared_ptr<Chunk> cells;
+};
+
+bool importRegionFile(VoxelMap &map, const std::string &path, const Vec3i &region, const ImportOptions &options,
+                      const std::vector<uint32_t> &remap, ImportStats &stats, std::string *error) {
+    if (localCoord(options.offset.x) || localCoord(options.offset.y) || localCoord(options.offset.z)) {
+        return fail(error, "Region imports need a chunk aligned offset");
+    }
+    Vec3i shift = chunkOf(options.offset);
+
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return fail(error, "Cannot read " + path);
+    }
+    std::unique_ptr<FILE, int (*)(FILE *)> closer(file, std::fclose);
+    std::vector<uint8_t> header(HEADER_BYTES);
+    if (std::fread(header.data(), 1, header.size(), file) != header.size() || std::memcmp(header.data(), REGION_MAGIC, 4)) {
+        return fail(error, path + " is not a region file");
+    }
+    ByteReader in(header.data() + 4, header.size() - 4);
+    if (in.getU32() != REGION_VERSION) {
+        return fail(error, path + " has an unsupported version");
+    }
+    std::vector<std::pair<uint32_t, int>> entries;
+    for (int slot = 0; slot < REGION_VOLUME; ++slot) {
+        uint32_t entry = in.getU32();
+        if (entry) {
+            entries.push_back(std::make_pair(entry, slot));
+        }
+    }
+    // Sector order turns the reads into one forward pass over the file.
+    std::sort(entries.begin(), entries.end());
+
+    ThreadPool &pool = options.pool ? *options.pool : defaultThreadPool();
+    std::vector<PendingChunk> batch;
+    std::atomic<bool> corrupt(false);
+    for (size_t first = 0; first < entries.size(); first += DECODE_BATCH) {
+        size_t count = std::min(DECODE_BATCH, entries.size() - first);
+        batch.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t entry = entries[first + i].first;
+            PendingChunk &pending = batch[i];
+            pending.key = slotChunk(region, entries[first + i].second) + shift;
+            uint8_t lengths[8];
+            std::fseek(file, long((entry >> 8) * SECTOR_SIZE), SEEK_SET);
+            if (std::fread(lengths, 1, 8, file) != 8) {
+                return fail(error, "Truncated region " + path);
+            }
+            ByteReader sizes(lengths, 8);
+            uint32_t length = sizes.getU32();
+            uint32_t sum = sizes.getU32();
+            if (uint64_t(length) + 8 > (entry & 0xFF) * SECTOR_SIZE) {
+                return fail(error, "Corrupt chunk table in " + path);
+            }
+            pending.payload.resize(length);
+            if (std::fread(pending.payload.data(), 1, length, file) != length
+                || checksum(pending.payload.data(), length) != sum) {
+                return fail(error, "Corrupt chunk in " + path);
+            }
+            stats.bytes += length + 8;
+        }
+
+        pool.parallelFor(count, [&](size_t i) {
+            PendingChunk &pending = batch[i];
+            std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+            ByteReader data(pending.payload.data(), pending.payload.size());
+            if (!chunk->read(data)) {
+                corrupt = true;
+                return;
+            }
+            if (!remap.empty()) {
+                std::vector<uint32_t> values(CHUNK_VOLUME);
+                chunk->getMaterials().decode(values.data());
+                for (uint32_t &value : values) {
+                    value = value < remap.size() ? remap[value] : AIR;
+                }
+                chunk->getMaterials().encode(values.data());
+            }
+            pending.cells = std::move(chunk);
+            std::vector<uint8_t>().swap(pending.payload);
+        });
+        if (corrupt) {
+            return fail(error, "Corrupt chunk in " + path);
+        }
+        for (PendingChunk &pending : batch) {
+            map.setChunk(pending.key, std::move(pending.cells));
+        }
+        stats.chunks += count;
+    }
+    stats.voxels += uint64_t(entries.size()) * CHUNK_VOLUME;
+    return true;
+}
+
+} // namespace
+
+std::string regionFileName(const Vec3i &region) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "r.%d.%d.%d.vxr", region.x, region.y, region.z);
+    return name;
+}
+
+bool saveRegions(const VoxelMap &map, const std::string &directory, ThreadPool *pool, std::string *error) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::filesystem::path root(directory);
+
+    std::unordered_map<Vec3i, std::vector<std::pair<int, const Chunk *>>, Vec3iHash> regions;
+    for (const auto &entry : map.getChunks()) {
+        Vec3i region(entry.first.x >> REGION_BITS, entry.first.y >> REGION_BITS, entry.first.z >> REGION_BITS);
+        regions[region].push_back(std::make_pair(regionSlot(entry.first), entry.second.get()));
+    }
+
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    for (auto &region : regions) {
+        std::vector<std::pair<int, const Chunk *>> &chunks = region.second;
+        std::sort(chunks.begin(), chunks.end());
+        std::vector<std::pair<int, std::vector<uint8_t>>> encoded(chunks.size());
+        threads.parallelFor(chunks.size(), [&](size_t i) {
+            encoded[i].first = chunks[i].first;
+            ByteWriter out(encoded[i].second);
+            chunks[i].second->write(out);
+        });
+        std::string path = (root / regionFileName(region.first)).string();
+        if (!writeRegion(path, encoded)) {
+            return fail(error, "Failed writing " + path);
+        }
+    }
+
+    std::vector<uint8_t> payload;
+    encodeMaterials(map.getMaterials(), payload);
+    MapRecordWriter writer;
+    std::string materials = (root / MATERIALS_FILE).string();
+    bool ok = writer.open(materials, MAP_MAGIC, false)
+        && writer.write(RECORD_MATERIALS, Vec3i(), map.getVersion(), payload)
+        && writer.write(RECORD_END, Vec3i(), map.getVersion(), std::vector<uint8_t>());
+    ok = writer.close() && ok;
+    return ok || fail(error, "Failed writing " + materials);
+}
+
+bool importRegion(VoxelMap &map, const std::string &path, const ImportOptions &options,
+                  ImportStats *stats, std::string *error) {
+    auto start = std::chrono::steady_clock::now();
+    Vec3i region;
+    if (!parseRegionName(path, region)) {
+        return fail(error, path + " is not named r.X.Y.Z.vxr");
+    }
+    ImportStats local;
+    if (!importRegionFile(map, path, region, options, std::vector<uint32_t>(), local, error)) {
+        return false;
+    }
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+bool importRegions(VoxelMap &map, const std::string &directory, const ImportOptions &options,
+                   ImportStats *stats, std::string *error) {
+    auto start = std::chrono::steady_clock::now();
+    std::filesystem::path root(directory);
+    std::vector<uint32_t> remap;
+    if (!readMaterialTable((root / MATERIALS_FILE).string(), map.getMaterials(), remap)) {
+        return fail(error, "Cannot read " + (root / MATERIALS_FILE).string());
+    }
+
+    std::error_code ec;
+    ImportStats local;
+    for (const auto &entry : std::filesystem::directory_iterator(root, ec)) {
+        Vec3i region;
+        std::string path = entry.path().string();
+        if (!parseRegionName(path, region)) {
+            continue;
+        }
+        if (!importRegionFile(map, path, region, options, remap, local, error)) {
+            return false;
+        }
+    }
+    if (ec) {
+        return fail(error, "Cannot list " + directory);
+    }
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+} // namespace vox
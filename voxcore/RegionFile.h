@@ -0,0 +1,42 @@
+#ifndef REGIONFILE_H
+#define REGIONFILE_H
+
+#include <string>
+
+#include "Import.h"
+#include "VoxelMap.h"
+
+namespace vox {
+
+// Region files (.vxr) store REGION_SIZE^3 chunks the way Minecraft's region
+// files store columns: a table of sector offsets up front and every chunk in
+// a run of 4 KiB sectors, so one chunk can be read or rewritten without
+// touching the rest. A directory of regions named r.X.Y.Z.vxr is a map.
+//
+//   "VXR1", u32 version, REGION_VOLUME x u32 (first sector << 8 | sectors)
+//   chunk: u32 length, u32 checksum, Chunk::write() payload
+//
+// Material ids are stored as they are; the map's materials go into a
+// materials.vxm next to the regions.
+const int REGION_BITS = 4;
+const int REGION_SIZE = 1 << REGION_BITS;
+const int REGION_VOLUME = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+
+std::string regionFileName(const Vec3i &region);
+
+// Writes every chunk of map into region files under directory.
+bool saveRegions(const VoxelMap &map, const std::string &directory, ThreadPool *pool = nullptr,
+                 std::string *error = nullptr);
+
+// Reads one region file. Chunk payloads are read straight from their
+// sectors in table order and decoded in parallel.
+bool importRegion(VoxelMap &map, const std::string &path, const ImportOptions &options = ImportOptions(),
+                  ImportStats *stats = nullptr, std::string *error = nullptr);
+
+// Reads the materials and every region of a directory written by saveRegions().
+bool importRegions(VoxelMap &map, const std::string &directory, const ImportOptions &options = ImportOptions(),
+                   ImportStats *stats = nullptr, std::string *error = nullptr);
+
+} // namespace vox
+
+#endif // REGIONFILE_H
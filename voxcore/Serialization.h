@@ -0,0 +1,125 @@
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace vox {
+
+// Little-endian helpers for the map and chunk log formats.
+class ByteWriter {
+public:
+    explicit ByteWriter(std::vector<uint8_t> &out) : mOut(out) {}
+
+    void putU8(uint8_t v) { mOut.push_back(v); }
+    void putU16(uint16_t v) { putLE(v, 2); }
+    void putU32(uint32_t v) { putLE(v, 4); }
+    void putU64(uint64_t v) { putLE(v, 8); }
+    void putI32(int32_t v) { putLE(uint32_t(v), 4); }
+
+    void putF32(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        putU32(bits);
+    }
+
+    void putString(const std::string &s) {
+        putU32(uint32_t(s.size()));
+        putBytes(s.data(), s.size());
+    }
+
+    void putBytes(const void *data, size_t size) {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        mOut.insert(mOut.end(), p, p + size);
+    }
+
+private:
+    void putLE(uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            mOut.push_back(uint8_t(v >> (8 * i)));
+        }
+    }
+
+    std::vector<uint8_t> &mOut;
+};
+
+// Reads past the end fail softly: values come back as zero and ok() turns false.
+class ByteReader {
+public:
+    ByteReader(const uint8_t *data, size_t size) : mPos(data), mEnd(data + size), mOk(true) {}
+
+    bool ok() const { return mOk; }
+    size_t remaining() const { return size_t(mEnd - mPos); }
+
+    uint8_t getU8() { return uint8_t(getLE(1)); }
+    uint16_t getU16() { return uint16_t(getLE(2)); }
+    uint32_t getU32() { return uint32_t(getLE(4)); }
+    uint64_t getU64() { return getLE(8); }
+    int32_t getI32() { return int32_t(uint32_t(getLE(4))); }
+
+    float getF32() {
+        uint32_t bits = getU32();
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    std::string getString() {
+        uint32_t size = getU32();
+        if (!require(size)) {
+            return std::string();
+        }
+        std::string s(reinterpret_cast<const char *>(mPos), size);
+        mPos += size;
+        return s;
+    }
+
+    bool getBytes(void *out, size_t size) {
+        if (!require(size)) {
+            return false;
+        }
+        std::memcpy(out, mPos, size);
+        mPos += size;
+        return true;
+    }
+
+    bool require(size_t size) {
+        if (!mOk || remaining() < size) {
+            mOk = false;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint64_t getLE(int bytes) {
+        if (!require(size_t(bytes))) {
+            return 0;
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) {
+            v |= uint64_t(mPos[i]) << (8 * i);
+        }
+        mPos += bytes;
+        return v;
+    }
+
+    const uint8_t *mPos;
+    const uint8_t *mEnd;
+    bool mOk;
+};
+
+// FNV-1a, enough to spot torn writes at the end of a log.
+inline uint32_t checksum(const uint8_t *data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+} // namespace vox
+
+#endif // SERIALIZATION_H
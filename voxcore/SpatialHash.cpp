@@ -0,0 +1,153 @@
+#include "SpatialHash.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+const size_t MIN_BUCKETS = 1024;
+const size_t POINTS_PER_BLOCK = 4096;
+
+// std::floor is a library call without SSE4.1, and queries floor three
+// times per candidate.
+inline int floorInt(float v) {
+    int i = int(v);
+    return float(i) > v ? i - 1 : i;
+}
+
+} // namespace
+
+SpatialHash::SpatialHash(float cellSize)
+    : mCellSize(cellSize > 0.0f ? cellSize : 1.0f), mInvCellSize(1.0f / mCellSize), mBucketMask(0) {}
+
+float SpatialHash::getCellSize() const {
+    return mCellSize;
+}
+
+size_t SpatialHash::size() const {
+    return mEntries.size();
+}
+
+const std::vector<SpatialHash::Entry> &SpatialHash::getEntries() const {
+    return mEntries;
+}
+
+void SpatialHash::cellOf(float x, float y, float z, int &cx, int &cy, int &cz) const {
+    cx = floorInt(x * mInvCellSize);
+    cy = floorInt(y * mInvCellSize);
+    cz = floorInt(z * mInvCellSize);
+}
+
+uint32_t SpatialHash::bucketOf(int cx, int cy, int cz) const {
+    uint32_t h = (uint32_t(cx) * 0x8DA6B343u) ^ (uint32_t(cy) * 0xD8163841u) ^ (uint32_t(cz) * 0xCB1AB31Fu);
+    h ^= h >> 15;
+    return h & mBucketMask;
+}
+
+void SpatialHash::build(const float *positions, size_t count, size_t stride, ThreadPool *pool) {
+    // About two buckets per point keeps collisions between cells rare.
+    size_t buckets = MIN_BUCKETS;
+    while (buckets < count * 2) {
+        buckets <<= 1;
+    }
+    mBucketMask = uint32_t(buckets - 1);
+    mBuckets.resize(count);
+    mEntries.resize(count);
+
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(positions);
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    size_t blocks = (count + POINTS_PER_BLOCK - 1) / POINTS_PER_BLOCK;
+    threads.parallelFor(blocks, [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * POINTS_PER_BLOCK);
+        for (size_t i = block * POINTS_PER_BLOCK; i < end; ++i) {
+            const float *p = reinterpret_cast<const float *>(base + i * stride);
+            int cx, cy, cz;
+            cellOf(p[0], p[1], p[2], cx, cy, cz);
+            mBuckets[i] = bucketOf(cx, cy, cz);
+        }
+    });
+
+    // Counting sort: histogram, prefix sum, scatter. Points keep their
+    // input order within a bucket.
+    mStart.assign(buckets + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        ++mStart[mBuckets[i] + 1];
+    }
+    for (size_t b = 0; b < buckets; ++b) {
+        mStart[b + 1] += mStart[b];
+    }
+    std::vector<uint32_t> &next = mBuckets;
+    std::vector<uint32_t> cursor(mStart.begin(), mStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        const float *p = reinterpret_cast<const float *>(base + i * stride);
+        Entry &entry = mEntries[cursor[next[i]]++];
+        entry.x = p[0];
+        entry.y = p[1];
+        entry.z = p[2];
+        entry.id = uint32_t(i);
+    }
+}
+
+template <typename Accept>
+void SpatialHash::visit(const float min[3], const float max[3], Accept accept, std::vector<uint32_t> &out) const {
+    if (mEntries.empty()) {
+        return;
+    }
+    int lo[3], hi[3];
+    cellOf(min[0], min[1], min[2], lo[0], lo[1], lo[2]);
+    cellOf(max[0], max[1], max[2], hi[0], hi[1], hi[2]);
+    double cells = double(hi[0] - lo[0] + 1) * double(hi[1] - lo[1] + 1) * double(hi[2] - lo[2] + 1);
+    if (cells >= double(mBucketMask) + 1.0) {
+        // Bigger than the table: one pass over everything is cheaper.
+        for (const Entry &entry : mEntries) {
+            if (accept(entry)) {
+                out.push_back(entry.id);
+            }
+        }
+        return;
+    }
+    for (int cz = lo[2]; cz <= hi[2]; ++cz) {
+        for (int cy = lo[1]; cy <= hi[1]; ++cy) {
+            for (int cx = lo[0]; cx <= hi[0]; ++cx) {
+                uint32_t bucket = bucketOf(cx, cy, cz);
+                for (uint32_t i = mStart[bucket]; i < mStart[bucket + 1]; ++i) {
+                    const Entry &entry = mEntries[i];
+                    if (!accept(entry)) {
+                        continue;
+                    }
+                    // Other cells can share the bucket; only take points of
+                    // this one so nothing is reported twice.
+                    int ex, ey, ez;
+                    cellOf(entry.x, entry.y, entry.z, ex, ey, ez);
+                    if (ex == cx && ey == cy && ez == cz) {
+                        out.push_back(entry.id);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::queryRadius(float x, float y, float z, float radius, std::vector<uint32_t> &out) const {
+    const float min[3] = {x - radius, y - radius, z - radius};
+    const float max[3] = {x + radius, y + radius, z + radius};
+    float radiusSq = radius * radius;
+    visit(min, max, [&](const Entry &entry) {
+        float dx = entry.x - x;
+        float dy = entry.y - y;
+        float dz = entry.z - z;
+        return dx * dx + dy * dy + dz * dz <= radiusSq;
+    }, out);
+}
+
+void SpatialHash::queryBox(const float min[3], const float max[3], std::vector<uint32_t> &out) const {
+    visit(min, max, [&](const Entry &entry) {
+        return entry.x >= min[0] && entry.x <= max[0] && entry.y >= min[1] && entry.y <= max[1]
+            && entry.z >= min[2] && entry.z <= max[2];
+    }, out);
+}
+
+} // namespace vox
@@ -0,0 +1,61 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vox {
+
+class ThreadPool;
+
+// Neighbour lookup for moving points such as agents and triggers. Points
+// are binned into cubic cells, the cells hashed into a power of two number
+// of buckets, and a counting sort lays the points out bucket by bucket in
+// one array, so a query reads a few short contiguous runs. Rebuilding is
+// linear in the number of points and meant to happen every tick.
+class SpatialHash {
+public:
+    struct Entry {
+        float x, y, z;
+        uint32_t id;        // index of the point passed to build()
+    };
+
+    // cellSize should be about the usual query radius. The default divides
+    // CHUNK_SIZE so cells line up with chunks.
+    explicit SpatialHash(float cellSize = 4.0f);
+
+    float getCellSize() const;
+    size_t size() const;
+
+    // Replaces the contents with count points. Point i is read as three
+    // floats at positions + i * stride bytes, so the xyz of a struct array
+    // can be passed directly.
+    void build(const float *positions, size_t count, size_t stride = 3 * sizeof(float),
+               ThreadPool *pool = nullptr);
+
+    // Append the ids of the points inside the sphere or box (inclusive) to
+    // out. Each point is reported once. Safe to call from several threads.
+    void queryRadius(float x, float y, float z, float radius, std::vector<uint32_t> &out) const;
+    void queryBox(const float min[3], const float max[3], std::vector<uint32_t> &out) const;
+
+    // Points in bucket order, for walking everything with good locality.
+    const std::vector<Entry> &getEntries() const;
+
+private:
+    void cellOf(float x, float y, float z, int &cx, int &cy, int &cz) const;
+    uint32_t bucketOf(int cx, int cy, int cz) const;
+    template <typename Accept>
+    void visit(const float min[3], const float max[3], Accept accept, std::vector<uint32_t> &out) const;
+
+    float mCellSize;
+    float mInvCellSize;
+    uint32_t mBucketMask;
+    std::vector<uint32_t> mStart;   // bucket b holds mEntries[mStart[b], mStart[b + 1])
+    std::vector<Entry> mEntries;
+    std::vector<uint32_t> mBuckets; // scratch, bucket of each point during build
+};
+
+} // namespace vox
+
+#endif // SPATIALHASH_H
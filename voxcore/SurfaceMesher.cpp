@@ -0,0 +1,308 @@
+#include "SurfaceMesher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "OccupancyKernels.h"
+
+namespace vox {
+
+namespace {
+
+const uint32_t NO_VERTEX = 0xFFFFFFFFu;
+
+// Halfway between DENSITY_ISO - 1 and DENSITY_ISO, so no sample is ever
+// exactly on the surface.
+const float ISO_LEVEL = float(DENSITY_ISO) - 0.5f;
+
+// Shade of a face pointing straight down; straight up is full colour.
+const float SKY_LOW = 0.55f;
+
+const uint32_t FALLBACK_COLOR = 0xFF808080u;
+
+// Padded samples 1..CHUNK_SIZE of a row are the chunk's own.
+const uint64_t INTERIOR_BITS = ((uint64_t(1) << CHUNK_SIZE) - 1) << 1;
+// Cubes start at samples 0..CHUNK_SIZE of a row.
+const uint64_t CUBE_BITS = (uint64_t(1) << (CHUNK_SIZE + 1)) - 1;
+
+// Cube corner c is at (c & 1, (c >> 1) & 1, (c >> 2) & 1).
+const int EDGE_CORNERS[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+const int EDGE_AXIS[12] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2};
+
+// The edges of a cube the surface crosses, for each set of inside corners.
+struct EdgeTable {
+    uint16_t edges[256];
+
+    EdgeTable() {
+        for (int mask = 0; mask < 256; ++mask) {
+            edges[mask] = 0;
+            for (int e = 0; e < 12; ++e) {
+                if (((mask >> EDGE_CORNERS[e][0]) ^ (mask >> EDGE_CORNERS[e][1])) & 1) {
+                    edges[mask] |= uint16_t(1 << e);
+                }
+            }
+        }
+    }
+};
+
+const EdgeTable EDGE_TABLE;
+
+inline bool inside(uint8_t density) {
+    return density >= DENSITY_ISO;
+}
+
+inline int ctz64(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    int n = 0;
+    while (!(v & 1)) {
+        v >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+inline float distanceSquared(const MeshVertex &a, const MeshVertex &b) {
+    float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+} // namespace
+
+SurfaceMesher::SurfaceMesher(const VoxelMap &map)
+    : mMap(map),
+      mCells(PADDED * PADDED * PADDED, AIR),
+      mDensity(PADDED * PADDED * PADDED, 0),
+      mInside(PADDED * PADDED, 0),
+      mDecoded(CHUNK_VOLUME) {
+    mSlices[0].resize(CUBES * CUBES);
+    mSlices[1].resize(CUBES * CUBES);
+}
+
+void SurfaceMesher::mesh(const Vec3i &chunk, ChunkMesh &out) {
+    out.clear();
+    out.chunk = chunk;
+    // Without an inside sample a chunk owns no edges.
+    const Chunk *center = mMap.findChunk(chunk);
+    if (!center || (center->isEmpty() && !center->hasAttribute(ATTR_DENSITY))) {
+        return;
+    }
+    mBase = Vec3i(chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, chunk.z * CHUNK_SIZE);
+    int insideSamples = gatherDensity(chunk);
+    if (insideSamples == 0 || insideSamples == PADDED * PADDED * PADDED) {
+        return;
+    }
+
+    // Quads of slice z join the vertices of cube slices z - 1 and z.
+    for (int z = 0; z < CUBES; ++z) {
+        buildSlice(z, mSlices[z & 1].data(), out);
+        if (z > 0) {
+            emitQuads(z, out);
+        }
+    }
+}
+
+int SurfaceMesher::gatherDensity(const Vec3i &chunk) {
+    gatherPadded(mMap, chunk, mCells, mDecoded);
+    const size_t count = mCells.size();
+    for (size_t i = 0; i < count; ++i) {
+        mDensity[i] = mCells[i] != AIR ? uint8_t(DENSITY_SOLID) : 0;
+    }
+
+    // Density channels override the material default wherever they are set.
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const Chunk *source = mMap.findChunk(chunk + Vec3i(dx, dy, dz));
+                if (!source || !source->hasAttribute(ATTR_DENSITY)) {
+                    continue;
+                }
+                // Padded range of this neighbour: its last layer, all of it
+                // or its first layer.
+                int lo[3], hi[3];
+                const int d[3] = {dx, dy, dz};
+                for (int a = 0; a < 3; ++a) {
+                    lo[a] = d[a] < 0 ? 0 : (d[a] > 0 ? CHUNK_SIZE + 1 : 1);
+                    hi[a] = d[a] < 0 ? 0 : (d[a] > 0 ? CHUNK_SIZE + 1 : CHUNK_SIZE);
+                }
+                bool whole = dx == 0 && dy == 0 && dz == 0;
+                if (whole) {
+                    source->getAttributes(ATTR_DENSITY)->decode(mDecoded.data());
+                }
+                for (int z = lo[2]; z <= hi[2]; ++z) {
+                    for (int y = lo[1]; y <= hi[1]; ++y) {
+                        for (int x = lo[0]; x <= hi[0]; ++x) {
+                            int local = cellIndex((x - 1) & CHUNK_MASK, (y - 1) & CHUNK_MASK, (z - 1) & CHUNK_MASK);
+                            uint32_t value = whole ? mDecoded[local] : source->getAttribute(ATTR_DENSITY, local);
+                            if (value) {
+                                mDensity[x + PADDED * (y + PADDED * z)] =
+                                    uint8_t(value < DENSITY_SOLID ? value : DENSITY_SOLID);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int row = 0; row < PADDED * PADDED; ++row) {
+        const uint8_t *density = &mDensity[size_t(row) * PADDED];
+        uint64_t bits = 0;
+        for (int x = 0; x < PADDED; ++x) {
+            bits |= uint64_t(inside(density[x])) << x;
+        }
+        mInside[row] = bits;
+    }
+    return int(kernels::popcountWords(mInside.data(), mInside.size()));
+}
+
+void SurfaceMesher::buildSlice(int z, uint32_t *slice, ChunkMesh &out) {
+    std::fill(slice, slice + CUBES * CUBES, NO_VERTEX);
+    for (int y = 0; y < CUBES; ++y) {
+        // Cubes whose four rows of corners neither all miss nor all hit.
+        const uint64_t *rows = &mInside[y + PADDED * z];
+        uint64_t any = rows[0] | rows[1] | rows[PADDED] | rows[PADDED + 1];
+        uint64_t all = rows[0] & rows[1] & rows[PADDED] & rows[PADDED + 1];
+        uint64_t mixed = (any | (any >> 1)) & ~(all & (all >> 1)) & CUBE_BITS;
+        while (mixed) {
+            int x = ctz64(mixed);
+            mixed &= mixed - 1;
+            slice[x + CUBES * y] = buildVertex(x, y, z, out);
+        }
+    }
+}
+
+uint32_t SurfaceMesher::buildVertex(int x, int y, int z, ChunkMesh &out) {
+    static const int OFFSETS[8] = {
+        0, 1, PADDED, PADDED + 1,
+        PADDED * PADDED, PADDED * PADDED + 1, PADDED * PADDED + PADDED, PADDED * PADDED + PADDED + 1
+    };
+    const int base = x + PADDED * (y + PADDED * z);
+    float d[8];
+    int mask = 0;
+    for (int c = 0; c < 8; ++c) {
+        uint8_t density = mDensity[base + OFFSETS[c]];
+        d[c] = float(density);
+        mask |= int(inside(density)) << c;
+    }
+
+    // Mean of the edge crossings, in cube coordinates.
+    float p[3] = {0.0f, 0.0f, 0.0f};
+    int crossings = 0;
+    const uint16_t edges = EDGE_TABLE.edges[mask];
+    for (int e = 0; e < 12; ++e) {
+        if (!(edges & (1 << e))) {
+            continue;
+        }
+        int a = EDGE_CORNERS[e][0];
+        int b = EDGE_CORNERS[e][1];
+        float t = (ISO_LEVEL - d[a]) / (d[b] - d[a]);
+        p[0] += float(a & 1);
+        p[1] += float((a >> 1) & 1);
+        p[2] += float((a >> 2) & 1);
+        p[EDGE_AXIS[e]] += t;
+        ++crossings;
+    }
+    float inv = 1.0f / float(crossings);
+
+    // Density rises inwards, the normal points down its gradient.
+    float nx = (d[0] + d[2] + d[4] + d[6]) - (d[1] + d[3] + d[5] + d[7]);
+    float ny = (d[0] + d[1] + d[4] + d[5]) - (d[2] + d[3] + d[6] + d[7]);
+    float nz = (d[0] + d[1] + d[2] + d[3]) - (d[4] + d[5] + d[6] + d[7]);
+    float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+    if (length > 0.0f) {
+        nx /= length;
+        ny /= length;
+        nz /= length;
+    } else {
+        nx = 0.0f;
+        ny = 1.0f;
+        nz = 0.0f;
+    }
+
+    // Colour of an inside corner that has a material, else of any.
+    MaterialId material = AIR;
+    for (int c = 0; c < 8 && material == AIR; ++c) {
+        if (mask & (1 << c)) {
+            material = mCells[base + OFFSETS[c]];
+        }
+    }
+    for (int c = 0; c < 8 && material == AIR; ++c) {
+        material = mCells[base + OFFSETS[c]];
+    }
+    uint32_t color = material != AIR ? mMap.getMaterials().get(material).color : FALLBACK_COLOR;
+    float shade = SKY_LOW + (1.0f - SKY_LOW) * (0.5f + 0.5f * ny);
+
+    // Sample (x, y, z) of the padded grid is voxel base + (x, y, z) - 1.
+    MeshVertex vertex;
+    vertex.x = float(mBase.x + x - 1) + p[0] * inv;
+    vertex.y = float(mBase.y + y - 1) + p[1] * inv;
+    vertex.z = float(mBase.z + z - 1) + p[2] * inv;
+    vertex.nx = nx;
+    vertex.ny = ny;
+    vertex.nz = nz;
+    vertex.r = uint8_t(((color >> 16) & 0xFF) * shade);
+    vertex.g = uint8_t(((color >> 8) & 0xFF) * shade);
+    vertex.b = uint8_t((color & 0xFF) * shade);
+    vertex.a = uint8_t((color >> 24) & 0xFF);
+    out.vertices.push_back(vertex);
+    return uint32_t(out.vertices.size() - 1);
+}
+
+void SurfaceMesher::emitQuads(int z, ChunkMesh &out) {
+    // Every crossed edge whose inside sample belongs to this chunk, per
+    // direction from the inside sample to the outside one.
+    for (int y = 1; y <= CHUNK_SIZE; ++y) {
+        const uint64_t *row = &mInside[y + PADDED * z];
+        uint64_t in = row[0] & INTERIOR_BITS;
+        if (!in) {
+            continue;
+        }
+        const uint64_t crossed[6] = {
+            in & ~(row[0] >> 1), in & ~(row[0] << 1),
+            in & ~row[1], in & ~row[-1],
+            in & ~row[PADDED], in & ~row[-PADDED]
+        };
+        for (int k = 0; k < 6; ++k) {
+            for (uint64_t bits = crossed[k]; bits; bits &= bits - 1) {
+                emitEdge(k >> 1, (k & 1) ? -1 : 1, ctz64(bits), y, z, out);
+            }
+        }
+    }
+}
+
+void SurfaceMesher::emitEdge(int axis, int dir, int x, int y, int z, ChunkMesh &out) {
+    static const int AROUND[4][2] = {{-1, -1}, {0, -1}, {0, 0}, {-1, 0}};
+    // The 4 cubes around the edge start at its lower sample, less 0 or 1
+    // along each of the other two axes.
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+    int lower[3] = {x, y, z};
+    lower[axis] += dir < 0 ? -1 : 0;
+    uint32_t q[4];
+    for (int k = 0; k < 4; ++k) {
+        int cube[3] = {lower[0], lower[1], lower[2]};
+        cube[u] += AROUND[k][0];
+        cube[v] += AROUND[k][1];
+        // Counter-clockwise seen from +axis; the outside is towards -axis
+        // when the inside sample is the upper one.
+        q[dir < 0 ? 3 - k : k] = mSlices[cube[2] & 1][cube[0] + CUBES * cube[1]];
+    }
+
+    // Split along the shorter diagonal, it follows curved surfaces better.
+    const std::vector<MeshVertex> &vertices = out.vertices;
+    if (distanceSquared(vertices[q[0]], vertices[q[2]]) <= distanceSquared(vertices[q[1]], vertices[q[3]])) {
+        out.indices.insert(out.indices.end(), {q[0], q[1], q[2], q[0], q[2], q[3]});
+    } else {
+        out.indices.insert(out.indices.end(), {q[1], q[2], q[3], q[1], q[3], q[0]});
+    }
+}
+
+} // namespace vox
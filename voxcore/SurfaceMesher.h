@@ -0,0 +1,65 @@
+#ifndef SURFACEMESHER_H
+#define SURFACEMESHER_H
+
+#include <vector>
+
+#include "ChunkMesher.h"
+
+namespace vox {
+
+// Density of a cell, 0 (empty) to DENSITY_SOLID. ATTR_DENSITY holds it
+// where set; a cell without one is DENSITY_SOLID when it has a material
+// and empty otherwise, so blocky maps mesh smoothly without any densities.
+// Cells at or above DENSITY_ISO are inside the surface.
+const uint32_t DENSITY_SOLID = 255;
+const uint32_t DENSITY_ISO = 128;
+
+// Smooth alternative to ChunkMesher for maps set to SURFACE_SMOOTH. The
+// density samples sit at voxel centres; every cube of 8 samples the
+// surface passes through gets one vertex, placed at the mean of the points
+// where the surface crosses its edges (surface nets, dual contouring with
+// mass point vertices), and every crossed sample edge becomes a quad
+// joining the vertices of the 4 cubes around it. Which edges a cube
+// crosses comes from a 256 entry table indexed by its inside corners.
+//
+// Vertices are shared by all the quads around them, so a chunk has about
+// one vertex per quad. An edge belongs to the chunk holding its inside
+// sample and cubes straddling a border are placed from the same samples on
+// both sides, so neighbouring chunks meet without cracks or overlaps.
+//
+// Colours are the material colour of an inside corner shaded by the
+// normal against the sky; lighting is not applied. Reuse one mesher per
+// thread, it keeps its scratch buffers between calls.
+class SurfaceMesher {
+public:
+    explicit SurfaceMesher(const VoxelMap &map);
+
+    void mesh(const Vec3i &chunk, ChunkMesh &out);
+
+private:
+    static const int PADDED = PADDED_SIZE;
+    // Cubes per slice: their first corners span the padded grid but one.
+    static const int CUBES = PADDED - 1;
+
+    // Fills mDensity from the materials in mCells and any density channels.
+    // Returns the number of inside samples.
+    int gatherDensity(const Vec3i &chunk);
+    void buildSlice(int z, uint32_t *slice, ChunkMesh &out);
+    uint32_t buildVertex(int x, int y, int z, ChunkMesh &out);
+    void emitQuads(int z, ChunkMesh &out);
+    void emitEdge(int axis, int dir, int x, int y, int z, ChunkMesh &out);
+
+    const VoxelMap &mMap;
+    Vec3i mBase;
+    std::vector<MaterialId> mCells;   // PADDED^3, one cell of border
+    std::vector<uint8_t> mDensity;    // PADDED^3
+    std::vector<uint64_t> mInside;    // PADDED^2 rows along x, y fastest
+    std::vector<uint32_t> mDecoded;
+    // Vertex of each cube in the last two slices, NO_VERTEX where the
+    // surface does not pass.
+    std::vector<uint32_t> mSlices[2];
+};
+
+} // namespace vox
+
+#endif // SURFACEMESHER_H
@@ -0,0 +1,246 @@
+#include "TerrainGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "NoiseKernels.h"
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+const int DIRT_DEPTH = 4;
+const int CAVE_OCTAVES = 2;
+const int CORRIDOR_HALF_WIDTH = 1;
+const int CORRIDOR_HEIGHT = 3;
+const int MAX_ROOM_HEIGHT = 6;
+// Separate streams for the noise fields and room placement.
+const uint32_t CAVE_SEED_A = 0x68E31DA4u;
+const uint32_t CAVE_SEED_B = 0xB5297A4Du;
+const uint32_t ROOM_SEED = 0x1B56C4E9u;
+
+MaterialId findOrAdd(MaterialRegistry &materials, const char *name, uint32_t color) {
+    MaterialId id = materials.findByName(name);
+    return id != AIR ? id : materials.add(Material(name, color));
+}
+
+uint32_t hash2(uint32_t seed, int x, int z) {
+    uint32_t h = seed ^ (uint32_t(x) * 0x8DA6B343u) ^ (uint32_t(z) * 0xCB1AB31Fu);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Sets cells in [min, max] (world coordinates) to air, clipped to the chunk.
+void carve(const Vec3i &base, const Vec3i &min, const Vec3i &max, uint32_t *cells) {
+    Vec3i lo(std::max(min.x - base.x, 0), std::max(min.y - base.y, 0), std::max(min.z - base.z, 0));
+    Vec3i hi(std::min(max.x - base.x, CHUNK_MASK), std::min(max.y - base.y, CHUNK_MASK),
+             std::min(max.z - base.z, CHUNK_MASK));
+    for (int z = lo.z; z <= hi.z; ++z) {
+        for (int y = lo.y; y <= hi.y; ++y) {
+            for (int x = lo.x; x <= hi.x; ++x) {
+                cells[cellIndex(x, y, z)] = AIR;
+            }
+        }
+    }
+}
+
+} // namespace
+
+TerrainGenerator::TerrainGenerator(const TerrainSettings &settings, MaterialRegistry &materials)
+    : mSettings(settings) {
+    mSettings.dungeonCell = std::max(mSettings.dungeonCell, 24);
+    mBedrock = findOrAdd(materials, "bedrock", 0xFF303030);
+    mStone = findOrAdd(materials, "stone", 0xFF7F7F7F);
+    mDirt = findOrAdd(materials, "dirt", 0xFF79553A);
+    mGrass = findOrAdd(materials, "grass", 0xFF4C9A2A);
+}
+
+const TerrainSettings &TerrainGenerator::getSettings() const {
+    return mSettings;
+}
+
+void TerrainGenerator::surfaceHeights(const Vec3i &base, int *heights) const {
+    float scale = mSettings.heightScale;
+    float row[CHUNK_SIZE];
+    for (int z = 0; z < CHUNK_SIZE; ++z) {
+        kernels::fbmRow(float(base.x) * scale, scale, 0.0f, float(base.z + z) * scale, mSettings.seed,
+                        mSettings.heightOctaves, 0.5f, row, CHUNK_SIZE);
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            heights[x + z * CHUNK_SIZE] = mSettings.baseHeight + int(std::floor(row[x] * mSettings.heightRange));
+        }
+    }
+}
+
+std::shared_ptr<Chunk> TerrainGenerator::generateChunk(const Vec3i &chunk) const {
+    Vec3i base(chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, chunk.z * CHUNK_SIZE);
+    if (base.y + CHUNK_MASK < 0) {
+        return nullptr;
+    }
+    int heights[CHUNK_SIZE * CHUNK_SIZE];
+    surfaceHeights(base, heights);
+    int top = *std::max_element(heights, heights + CHUNK_SIZE * CHUNK_SIZE);
+    if (base.y > top) {
+        return nullptr;
+    }
+
+    std::vector<uint32_t> cells(CHUNK_VOLUME);
+    for (int z = 0; z < CHUNK_SIZE; ++z) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            int wy = base.y + y;
+            uint32_t *row = &cells[cellIndex(0, y, z)];
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                int h = heights[x + z * CHUNK_SIZE];
+                MaterialId material = AIR;
+                if (wy == 0) {
+                    material = mBedrock;
+                } else if (wy > 0 && wy <= h) {
+                    material = wy == h ? mGrass : (wy > h - DIRT_DEPTH ? mDirt : mStone);
+                }
+                row[x] = material;
+            }
+        }
+    }
+
+    if (mSettings.caves) {
+        float scale = mSettings.caveScale;
+        float a[CHUNK_SIZE];
+        float b[CHUNK_SIZE];
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            const int *columns = &heights[z * CHUNK_SIZE];
+            int rowTop = *std::max_element(columns, columns + CHUNK_SIZE) - mSettings.caveCeiling;
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                int wy = base.y + y;
+                if (wy < 1 || wy > rowTop) {
+                    continue;
+                }
+                // Tunnels run where both fields cross zero.
+                float fy = float(wy) * scale;
+                float fz = float(base.z + z) * scale;
+                kernels::fbmRow(float(base.x) * scale, scale, fy, fz, mSettings.seed ^ CAVE_SEED_A, CAVE_OCTAVES,
+                                0.5f, a, CHUNK_SIZE);
+                kernels::fbmRow(float(base.x) * scale, scale, fy, fz, mSettings.seed ^ CAVE_SEED_B, CAVE_OCTAVES,
+                                0.5f, b, CHUNK_SIZE);
+                uint32_t *row = &cells[cellIndex(0, y, z)];
+                for (int x = 0; x < CHUNK_SIZE; ++x) {
+                    if (wy <= columns[x] - mSettings.caveCeiling && std::fabs(a[x]) < mSettings.caveWidth
+                        && std::fabs(b[x]) < mSettings.caveWidth) {
+                        row[x] = AIR;
+                    }
+                }
+            }
+        }
+    }
+
+    if (mSettings.dungeons) {
+        carveDungeons(base, cells.data());
+    }
+
+    std::shared_ptr<Chunk> out = std::make_shared<Chunk>();
+    out->getMaterials().encode(cells.data());
+    if (out->isEmpty()) {
+        return nullptr;
+    }
+    out->compact();
+    return out;
+}
+
+// One room per dungeon cell at most, placed from a hash of the cell so any
+// chunk can work out the rooms around it on its own.
+bool TerrainGenerator::findRoom(int cx, int cz, Room &room) const {
+    uint32_t h = hash2(mSettings.seed ^ ROOM_SEED, cx, cz);
+    if ((h & 0xFF) >= 180) {
+        return false;
+    }
+    int cell = mSettings.dungeonCell;
+    int width = 6 + int((h >> 8) % 10);
+    int depth = 6 + int((h >> 12) % 10);
+    int height = 4 + int((h >> 16) % (MAX_ROOM_HEIGHT - 3));
+    int x = cx * cell + 2 + int((h >> 20) % uint32_t(cell - width - 3));
+    int z = cz * cell + 2 + int((h >> 26) % uint32_t(cell - depth - 3));
+    room.min = Vec3i(x, mSettings.dungeonLevel, z);
+    room.max = Vec3i(x + width - 1, mSettings.dungeonLevel + height - 1, z + depth - 1);
+    return true;
+}
+
+void TerrainGenerator::carveDungeons(const Vec3i &base, uint32_t *cells) const {
+    int level = mSettings.dungeonLevel;
+    if (base.y > level + MAX_ROOM_HEIGHT || base.y + CHUNK_MASK < level) {
+        return;
+    }
+    int cell = mSettings.dungeonCell;
+    // Corridors reach into the next cell over, so look one cell further out.
+    int cx0 = floorDiv(base.x, cell) - 1;
+    int cx1 = floorDiv(base.x + CHUNK_MASK, cell) + 1;
+    int cz0 = floorDiv(base.z, cell) - 1;
+    int cz1 = floorDiv(base.z + CHUNK_MASK, cell) + 1;
+    const int w = CORRIDOR_HALF_WIDTH;
+    const int top = level + CORRIDOR_HEIGHT - 1;
+    for (int cz = cz0; cz <= cz1; ++cz) {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            Room room;
+            if (!findRoom(cx, cz, room)) {
+                continue;
+            }
+            carve(base, room.min, room.max, cells);
+            Vec3i from((room.min.x + room.max.x) / 2, level, (room.min.z + room.max.z) / 2);
+            // Corridors to the +x and +z neighbours, along x first, then z.
+            const Vec3i steps[2] = {Vec3i(1, 0, 0), Vec3i(0, 0, 1)};
+            for (const Vec3i &step : steps) {
+                Room next;
+                if (!findRoom(cx + step.x, cz + step.z, next)) {
+                    continue;
+                }
+                Vec3i to((next.min.x + next.max.x) / 2, level, (next.min.z + next.max.z) / 2);
+                carve(base, Vec3i(std::min(from.x, to.x) - w, level, from.z - w),
+                      Vec3i(std::max(from.x, to.x) + w, top, from.z + w), cells);
+                carve(base, Vec3i(to.x - w, level, std::min(from.z, to.z) - w),
+                      Vec3i(to.x + w, top, std::max(from.z, to.z) + w), cells);
+            }
+        }
+    }
+}
+
+void TerrainGenerator::generate(VoxelMap &map, const Vec3i &minChunk, const Vec3i &maxChunk, ThreadPool *pool,
+                                TerrainStats *stats) const {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Vec3i> keys;
+    for (int z = minChunk.z; z <= maxChunk.z; ++z) {
+        for (int y = minChunk.y; y <= maxChunk.y; ++y) {
+            for (int x = minChunk.x; x <= maxChunk.x; ++x) {
+                keys.push_back(Vec3i(x, y, z));
+            }
+        }
+    }
+    std::vector<std::shared_ptr<Chunk>> results(keys.size());
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    threads.parallelFor(keys.size(), [&](size_t i) {
+        results[i] = generateChunk(keys[i]);
+    });
+
+    size_t stored = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (results[i]) {
+            map.setChunk(keys[i], std::move(results[i]));
+            ++stored;
+        } else {
+            map.removeChunk(keys[i]);
+        }
+    }
+    if (stats) {
+        stats->chunks = keys.size();
+        stats->stored = stored;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,84 @@
+#ifndef TERRAINGENERATOR_H
+#define TERRAINGENERATOR_H
+
+#include <memory>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+class ThreadPool;
+
+struct TerrainSettings {
+    uint32_t seed;
+    int baseHeight;         // mean surface height
+    int heightRange;        // surface varies by up to this much either way
+    float heightScale;      // noise frequency of the surface, 1 / feature size
+    int heightOctaves;
+    bool caves;
+    float caveScale;
+    float caveWidth;        // worm tunnel radius in noise units, 0..1
+    int caveCeiling;        // caves stay this far under the surface
+    bool dungeons;
+    int dungeonLevel;       // floor height of rooms and corridors
+    int dungeonCell;        // at most one room per dungeonCell^2 columns
+
+    TerrainSettings()
+        : seed(1), baseHeight(48), heightRange(24), heightScale(1.0f / 96.0f), heightOctaves(5), caves(true),
+          caveScale(1.0f / 40.0f), caveWidth(0.08f), caveCeiling(4), dungeons(true), dungeonLevel(4),
+          dungeonCell(48) {}
+};
+
+struct TerrainStats {
+    size_t chunks;      // chunks generated, including all-air ones that were dropped
+    size_t stored;      // chunks that ended up in the map
+    double seconds;
+
+    TerrainStats() : chunks(0), stored(0), seconds(0.0) {}
+
+    double chunksPerSecond() const { return seconds > 0.0 ? chunks / seconds : 0.0; }
+};
+
+// Seeded world generator: a fractal noise heightfield with grass, dirt and
+// stone layers on bedrock at y = 0, worm caves where two 3D noise fields
+// are both near zero, and a level of rooms joined by corridors.
+//
+// A chunk only depends on the settings and its own coordinate, so chunks
+// can be made in any order, on any thread, and any region regenerated
+// later comes out the same.
+class TerrainGenerator {
+public:
+    // Looks up the materials it places by name in materials, adding them
+    // when missing.
+    TerrainGenerator(const TerrainSettings &settings, MaterialRegistry &materials);
+
+    const TerrainSettings &getSettings() const;
+
+    // Null when the chunk is all air. Safe to call from several threads.
+    std::shared_ptr<Chunk> generateChunk(const Vec3i &chunk) const;
+
+    // Generates every chunk in [minChunk, maxChunk] in parallel and puts the
+    // ones with content into map, replacing what was there.
+    void generate(VoxelMap &map, const Vec3i &minChunk, const Vec3i &maxChunk, ThreadPool *pool = nullptr,
+                  TerrainStats *stats = nullptr) const;
+
+private:
+    struct Room {
+        Vec3i min;
+        Vec3i max;
+    };
+
+    void surfaceHeights(const Vec3i &base, int *heights) const;
+    bool findRoom(int cx, int cz, Room &room) const;
+    void carveDungeons(const Vec3i &base, uint32_t *cells) const;
+
+    TerrainSettings mSettings;
+    MaterialId mBedrock;
+    MaterialId mStone;
+    MaterialId mDirt;
+    MaterialId mGrass;
+};
+
+} // namespace vox
+
+#endif // TERRAINGENERATOR_H
@@ -0,0 +1,518 @@
+#include "VoxFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "Parallel.h"
+#include "Serialization.h"
+
+namespace vox {
+
+namespace {
+
+const size_t VOXELS_PER_READ = 4096;
+const int MAX_SCENE_DEPTH = 64;
+// Groups may share children, so a small file can describe a huge scene.
+const size_t MAX_SCENE_VISITS = 1u << 20;
+const size_t MAX_SCENE_INSTANCES = 1u << 16;
+const uint32_t MAX_CHUNK_CONTENT = 64u << 20;
+
+typedef std::unordered_map<std::string, std::string> Dict;
+
+struct Model {
+    Vec3i size;
+    long offset;        // first voxel of the XYZI chunk
+    uint32_t count;
+};
+
+// Integer rotation and translation, applied as m * p + t.
+struct Transform {
+    int m[3][3];
+    Vec3i t;
+
+    Transform() : m{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}} {}
+
+    Vec3i apply(const Vec3i &p) const {
+        return Vec3i(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + t.x,
+                     m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + t.y,
+                     m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + t.z);
+    }
+
+    Transform then(const Transform &local) const {
+        Transform out;
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                out.m[r][c] = m[r][0] * local.m[0][c] + m[r][1] * local.m[1][c] + m[r][2] * local.m[2][c];
+            }
+        }
+        Transform rotation = *this;
+        rotation.t = Vec3i();
+        out.t = rotation.apply(local.t) + t;
+        return out;
+    }
+};
+
+enum NodeType {
+    NODE_TRANSFORM,
+    NODE_GROUP,
+    NODE_SHAPE
+};
+
+struct SceneNode {
+    NodeType type;
+    bool hidden;
+    int layer;
+    Transform transform;
+    std::vector<int> children;  // child node ids, or model ids for shapes
+};
+
+struct Instance {
+    int model;
+    Transform transform;
+    bool centered;
+};
+
+struct VoxMaterial {
+    bool glass;
+    float emit;
+    float alpha;
+};
+
+struct VoxScene {
+    std::vector<Model> models;
+    uint32_t palette[256];
+    VoxMaterial materials[256];
+    std::unordered_map<int, SceneNode> nodes;
+    std::unordered_map<int, bool> hiddenLayers;
+};
+
+bool fail(std::string *error, const std::string &message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+// MagicaVoxel's palette for files without an RGBA chunk, as ARGB.
+void defaultPalette(uint32_t palette[256]) {
+    int i = 0;
+    palette[i++] = 0;
+    for (int r = 5; r >= 0; --r) {
+        for (int g = 5; g >= 0; --g) {
+            for (int b = 5; b >= 0; --b) {
+                if (r || g || b) {
+                    palette[i++] = 0xFF000000u | uint32_t(r * 0x33) << 16 | uint32_t(g * 0x33) << 8 | uint32_t(b * 0x33);
+                }
+            }
+        }
+    }
+    const uint32_t ramp[10] = {0xEE, 0xDD, 0xBB, 0xAA, 0x88, 0x77, 0x55, 0x44, 0x22, 0x11};
+    for (int shift = 16; shift >= 0; shift -= 8) {
+        for (uint32_t v : ramp) {
+            palette[i++] = 0xFF000000u | v << shift;
+        }
+    }
+    for (uint32_t v : ramp) {
+        palette[i++] = 0xFF000000u | v << 16 | v << 8 | v;
+    }
+}
+
+Dict readDict(ByteReader &in) {
+    Dict dict;
+    uint32_t count = in.getU32();
+    for (uint32_t i = 0; i < count && in.ok(); ++i) {
+        std::string key = in.getString();
+        dict[key] = in.getString();
+    }
+    return dict;
+}
+
+float dictFloat(const Dict &dict, const char *key, float fallback) {
+    auto it = dict.find(key);
+    return it != dict.end() ? float(std::atof(it->second.c_str())) : fallback;
+}
+
+// NaN comes out as 0.
+float clamp01(float value) {
+    return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+}
+
+bool dictHidden(const Dict &dict) {
+    auto it = dict.find("_hidden");
+    return it != dict.end() && it->second == "1";
+}
+
+// Rotations are stored as one byte: the column of the non-zero entry in the
+// first two rows and the sign of each row.
+Transform decodeTransform(const Dict &frame) {
+    Transform transform;
+    auto r = frame.find("_r");
+    if (r != frame.end()) {
+        int bits = std::atoi(r->second.c_str());
+        int c0 = bits & 3, c1 = (bits >> 2) & 3, c2 = 3 - c0 - c1;
+        if (c0 < 3 && c1 < 3 && c0 != c1) {
+            int columns[3] = {c0, c1, c2};
+            for (int row = 0; row < 3; ++row) {
+                for (int c = 0; c < 3; ++c) {
+                    transform.m[row][c] = 0;
+                }
+                transform.m[row][columns[row]] = (bits >> (4 + row)) & 1 ? -1 : 1;
+            }
+        }
+    }
+    auto t = frame.find("_t");
+    if (t != frame.end()) {
+        std::sscanf(t->second.c_str(), "%d %d %d", &transform.t.x, &transform.t.y, &transform.t.z);
+    }
+    return transform;
+}
+
+bool readContent(FILE *file, uint32_t size, std::vector<uint8_t> &out) {
+    if (size > MAX_CHUNK_CONTENT) {
+        return false;
+    }
+    out.resize(size);
+    return size == 0 || std::fread(out.data(), 1, size, file) == size;
+}
+
+bool parseScene(FILE *file, long end, VoxScene &scene, std::string *error) {
+    std::vector<uint8_t> content;
+    Vec3i size;
+    bool haveSize = false;
+    while (std::ftell(file) < end) {
+        uint8_t header[12];
+        if (std::fread(header, 1, sizeof(header), file) != sizeof(header)) {
+            return fail(error, "Truncated chunk header");
+        }
+        ByteReader sizes(header + 4, 8);
+        uint32_t contentSize = sizes.getU32();
+        uint32_t childrenSize = sizes.getU32();
+        const char *id = reinterpret_cast<const char *>(header);
+
+        if (!std::memcmp(id, "XYZI", 4)) {
+            // Only remember where the voxels are, they are streamed later.
+            uint8_t countBytes[4];
+            if (!haveSize || contentSize < 4 || std::fread(countBytes, 1, 4, file) != 4) {
+                return fail(error, "Malformed XYZI chunk");
+            }
+            ByteReader countIn(countBytes, 4);
+            Model model = {size, std::ftell(file), countIn.getU32()};
+            if (uint64_t(model.count) * 4 > contentSize - 4) {
+                return fail(error, "Malformed XYZI chunk");
+            }
+            scene.models.push_back(model);
+            haveSize = false;
+            std::fseek(file, long(contentSize - 4), SEEK_CUR);
+        } else {
+            if (!readContent(file, contentSize, content)) {
+                return fail(error, "Truncated chunk");
+            }
+            ByteReader in(content.data(), content.size());
+            if (!std::memcmp(id, "SIZE", 4)) {
+                size.x = in.getI32();
+                size.y = in.getI32();
+                size.z = in.getI32();
+                haveSize = in.ok();
+            } else if (!std::memcmp(id, "RGBA", 4)) {
+                for (int i = 0; i < 255 && in.ok(); ++i) {
+                    uint8_t rgba[4];
+                    in.getBytes(rgba, 4);
+                    scene.palette[i + 1] = uint32_t(rgba[3]) << 24 | uint32_t(rgba[0]) << 16 | uint32_t(rgba[1]) << 8 | rgba[2];
+                }
+            } else if (!std::memcmp(id, "MATL", 4)) {
+                int index = in.getI32();
+                Dict dict = readDict(in);
+                if (index > 0 && index < 256) {
+                    VoxMaterial &material = scene.materials[index];
+                    const std::string type = dict["_type"];
+                    material.glass = type == "_glass" || type == "_blend";
+                    material.emit = type == "_emit" ? clamp01(dictFloat(dict, "_emit", 0.0f)) : 0.0f;
+                    material.alpha = material.glass ? 1.0f - clamp01(dictFloat(dict, "_trans", dictFloat(dict, "_alpha", 0.5f))) : 1.0f;
+                }
+            } else if (!std::memcmp(id, "nTRN", 4)) {
+                int nodeId = in.getI32();
+                if (scene.nodes.count(nodeId)) {
+                    return fail(error, "Duplicate scene node " + std::to_string(nodeId));
+                }
+                SceneNode &node = scene.nodes[nodeId];
+                node.type = NODE_TRANSFORM;
+                node.hidden = dictHidden(readDict(in));
+                node.children.assign(1, in.getI32());
+                in.getI32(); // reserved
+                node.layer = in.getI32();
+                if (in.getU32() > 0) {
+                    node.transform = decodeTransform(readDict(in));
+                }
+            } else if (!std::memcmp(id, "nGRP", 4)) {
+                int nodeId = in.getI32();
+                if (scene.nodes.count(nodeId)) {
+                    return fail(error, "Duplicate scene node " + std::to_string(nodeId));
+                }
+                SceneNode &node = scene.nodes[nodeId];
+                node.type = NODE_GROUP;
+                node.hidden = dictHidden(readDict(in));
+                node.layer = -1;
+                uint32_t count = in.getU32();
+                for (uint32_t i = 0; i < count && in.ok(); ++i) {
+                    node.children.push_back(in.getI32());
+                }
+            } else if (!std::memcmp(id, "nSHP", 4)) {
+                int nodeId = in.getI32();
+                if (scene.nodes.count(nodeId)) {
+                    return fail(error, "Duplicate scene node " + std::to_string(nodeId));
+                }
+                SceneNode &node = scene.nodes[nodeId];
+                node.type = NODE_SHAPE;
+                node.hidden = dictHidden(readDict(in));
+                node.layer = -1;
+                uint32_t count = in.getU32();
+                for (uint32_t i = 0; i < count && in.ok(); ++i) {
+                    node.children.push_back(in.getI32());
+                    readDict(in);
+                }
+            } else if (!std::memcmp(id, "LAYR", 4)) {
+                int layer = in.getI32();
+                scene.hiddenLayers[layer] = dictHidden(readDict(in));
+            }
+            if (!in.ok()) {
+                return fail(error, std::string("Malformed ") + std::string(id, 4) + " chunk");
+            }
+        }
+        std::fseek(file, long(childrenSize), SEEK_CUR);
+    }
+    return true;
+}
+
+// stack holds the nodes above this one: a node found on it again is a cycle.
+bool collectInstances(const VoxScene &scene, int nodeId, const Transform &parent, const ImportOptions &options,
+                      std::vector<int> &stack, size_t &visits, std::vector<Instance> &out, std::string *error) {
+    auto it = scene.nodes.find(nodeId);
+    if (it == scene.nodes.end()) {
+        return true;
+    }
+    if (std::find(stack.begin(), stack.end(), nodeId) != stack.end()) {
+        return fail(error, "Scene node " + std::to_string(nodeId) + " contains itself");
+    }
+    if (stack.size() > size_t(MAX_SCENE_DEPTH) || ++visits > MAX_SCENE_VISITS) {
+        return fail(error, "Scene graph too large");
+    }
+    const SceneNode &node = it->second;
+    if (options.skipHidden) {
+        auto layer = scene.hiddenLayers.find(node.layer);
+        if (node.hidden || (layer != scene.hiddenLayers.end() && layer->second)) {
+            return true;
+        }
+    }
+    stack.push_back(nodeId);
+    bool ok = true;
+    switch (node.type) {
+    case NODE_TRANSFORM:
+        ok = collectInstances(scene, node.children[0], parent.then(node.transform), options, stack, visits, out, error);
+        break;
+    case NODE_GROUP:
+        for (size_t i = 0; i < node.children.size() && ok; ++i) {
+            ok = collectInstances(scene, node.children[i], parent, options, stack, visits, out, error);
+        }
+        break;
+    case NODE_SHAPE:
+        for (int model : node.children) {
+            if (model >= 0 && size_t(model) < scene.models.size()) {
+                if (out.size() == MAX_SCENE_INSTANCES) {
+                    ok = fail(error, "Scene has too many model instances");
+                    break;
+                }
+                out.push_back(Instance{model, parent, true});
+            }
+        }
+        break;
+    }
+    stack.pop_back();
+    return ok;
+}
+
+// Cells of one chunk while voxels are being binned into it.
+struct ChunkBlock {
+    std::vector<MaterialId> cells;
+    PaletteStorage storage;
+};
+
+class MaterialTable {
+public:
+    MaterialTable(MaterialRegistry &registry, const VoxScene &scene)
+        : mRegistry(registry), mScene(scene) {
+        for (MaterialId &id : mIds) {
+            id = AIR;
+        }
+    }
+
+    MaterialId get(uint8_t index) {
+        if (mIds[index] == AIR && index != 0) {
+            mIds[index] = create(index);
+        }
+        return mIds[index];
+    }
+
+private:
+    MaterialId create(uint8_t index) {
+        const VoxMaterial &source = mScene.materials[index];
+        uint32_t color = mScene.palette[index];
+        if (source.glass) {
+            color = (color & 0x00FFFFFFu) | uint32_t(source.alpha * 255.0f + 0.5f) << 24;
+        }
+        int emission = int(source.emit * 15.0f + 0.5f);
+        emission = emission > 15 ? 15 : emission;
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "vox #%06X%s%s", unsigned(color & 0xFFFFFFu),
+                      source.glass ? " glass" : "", emission ? " emit" : "");
+        MaterialId id = mRegistry.findByName(name);
+        if (id != AIR) {
+            return id;
+        }
+        Material material(name, color);
+        material.opaque = !source.glass;
+        material.emission = uint8_t(emission);
+        return mRegistry.add(material);
+    }
+
+    MaterialRegistry &mRegistry;
+    const VoxScene &mScene;
+    MaterialId mIds[256];
+};
+
+// Streams one model instance into chunk blocks, then encodes and installs
+// them. Blocks start from the map's current cells so instances overlapping
+// each other or existing content merge like edits.
+bool importInstance(VoxelMap &map, FILE *file, const VoxScene &scene, const Instance &instance,
+                    const ImportOptions &options, MaterialTable &materials, ThreadPool &pool,
+                    ImportStats &stats) {
+    const Model &model = scene.models[instance.model];
+    Vec3i pivot = instance.centered ? Vec3i(model.size.x / 2, model.size.y / 2, model.size.z / 2) : Vec3i();
+    std::unordered_map<Vec3i, std::unique_ptr<ChunkBlock>, Vec3iHash> blocks;
+    Vec3i lastKey;
+    ChunkBlock *last = nullptr;
+
+    std::fseek(file, model.offset, SEEK_SET);
+    std::vector<uint8_t> buffer(VOXELS_PER_READ * 4);
+    std::vector<uint32_t> decoded;
+    for (uint32_t done = 0; done < model.count;) {
+        size_t batch = model.count - done < VOXELS_PER_READ ? model.count - done : VOXELS_PER_READ;
+        if (std::fread(buffer.data(), 4, batch, file) != batch) {
+            return false;
+        }
+        for (size_t i = 0; i < batch; ++i) {
+            const uint8_t *v = &buffer[i * 4];
+            Vec3i p = instance.transform.apply(Vec3i(v[0], v[1], v[2]) - pivot);
+            Vec3i world = Vec3i(p.x, p.z, -p.y) + options.offset;
+            Vec3i key = chunkOf(world);
+            if (!last || key != lastKey) {
+                std::unique_ptr<ChunkBlock> &slot = blocks[key];
+                if (!slot) {
+                    slot.reset(new ChunkBlock());
+                    slot->cells.assign(CHUNK_VOLUME, AIR);
+                    if (const Chunk *existing = static_cast<const VoxelMap &>(map).findChunk(key)) {
+                        decoded.resize(CHUNK_VOLUME);
+                        existing->getMaterials().decode(decoded.data());
+                        slot->cells.assign(decoded.begin(), decoded.end());
+                    }
+                }
+                last = slot.get();
+                lastKey = key;
+            }
+            last->cells[cellIndex(localCoord(world.x), localCoord(world.y), localCoord(world.z))] = materials.get(v[3]);
+        }
+        done += uint32_t(batch);
+    }
+    stats.voxels += model.count;
+
+    std::vector<std::pair<Vec3i, ChunkBlock *>> work;
+    for (auto &entry : blocks) {
+        work.push_back(std::make_pair(entry.first, entry.second.get()));
+    }
+    pool.parallelFor(work.size(), [&](size_t i) {
+        ChunkBlock &block = *work[i].second;
+        std::vector<uint32_t> values(block.cells.begin(), block.cells.end());
+        block.storage.encode(values.data());
+        std::vector<MaterialId>().swap(block.cells);
+    });
+    for (const auto &entry : work) {
+        map.getOrCreateChunk(entry.first).getMaterials() = std::move(entry.second->storage);
+        map.markChunkChanged(entry.first);
+    }
+    stats.chunks += work.size();
+    return true;
+}
+
+} // namespace
+
+bool importVox(VoxelMap &map, const std::string &path, const ImportOptions &options,
+               ImportStats *stats, std::string *error) {
+    auto start = std::chrono::steady_clock::now();
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return fail(error, "Cannot read " + path);
+    }
+    std::unique_ptr<FILE, int (*)(FILE *)> closer(file, std::fclose);
+
+    uint8_t header[20];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header)
+        || std::memcmp(header, "VOX ", 4) || std::memcmp(header + 8, "MAIN", 4)) {
+        return fail(error, path + " is not a MagicaVoxel file");
+    }
+    ByteReader in(header + 12, 8);
+    uint32_t mainContent = in.getU32();
+    uint32_t mainChildren = in.getU32();
+    long end = long(sizeof(header)) + long(mainContent) + long(mainChildren);
+    std::fseek(file, long(mainContent), SEEK_CUR);
+
+    std::unique_ptr<VoxScene> scene(new VoxScene());
+    defaultPalette(scene->palette);
+    for (VoxMaterial &material : scene->materials) {
+        material = VoxMaterial{false, 0.0f, 1.0f};
+    }
+    if (!parseScene(file, end, *scene, error)) {
+        if (error) {
+            *error = path + ": " + *error;
+        }
+        return false;
+    }
+
+    std::vector<Instance> instances;
+    if (scene->nodes.count(0)) {
+        std::vector<int> stack;
+        size_t visits = 0;
+        if (!collectInstances(*scene, 0, Transform(), options, stack, visits, instances, error)) {
+            if (error) {
+                *error = path + ": " + *error;
+            }
+            return false;
+        }
+    } else {
+        for (size_t i = 0; i < scene->models.size(); ++i) {
+            instances.push_back(Instance{int(i), Transform(), false});
+        }
+    }
+
+    ImportStats local;
+    MaterialTable materials(map.getMaterials(), *scene);
+    ThreadPool &pool = options.pool ? *options.pool : defaultThreadPool();
+    for (const Instance &instance : instances) {
+        if (!importInstance(map, file, *scene, instance, options, materials, pool, local)) {
+            return fail(error, "Truncated voxel data in " + path);
+        }
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    local.bytes = uint64_t(std::ftell(file));
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+} // namespace vox
@@ -0,0 +1,26 @@
+#ifndef VOXFILE_H
+#define VOXFILE_H
+
+#include <string>
+
+#include "Import.h"
+#include "VoxelMap.h"
+
+namespace vox {
+
+// Imports a MagicaVoxel .vox file (version 150 and the 200 scene format)
+// into map. Every model instance of the scene graph is placed with its
+// transform; files without a scene graph put their models at the origin.
+// MagicaVoxel is z-up, a voxel (x, y, z) lands at (x, z, -y) + offset.
+// Palette colours become materials named "vox #RRGGBB", reused when the map
+// already has them; emissive and glass MATL entries carry over.
+//
+// The file is read twice through a small buffer: once for the headers,
+// palette and scene graph, once to stream each model's voxels into chunk
+// sized blocks, which are encoded into chunk storage in parallel.
+bool importVox(VoxelMap &map, const std::string &path, const ImportOptions &options = ImportOptions(),
+               ImportStats *stats = nullptr, std::string *error = nullptr);
+
+} // namespace vox
+
+#endif // VOXFILE_H
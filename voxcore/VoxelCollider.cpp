@@ -0,0 +1,292 @@
+#include "VoxelCollider.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "DistanceField.h"
+#include "Parallel.h"
+
+namespace vox {
+
+namespace {
+
+// Gap kept between boxes and the cells they rest against, so a box that
+// touches a wall is not counted as inside it next tick.
+const float SKIN = 1e-3f;
+const float EPS = 1e-4f;
+const size_t BODIES_PER_BLOCK = 256;
+// Furthest a point of a voxel can be from its centre.
+const float HALF_DIAGONAL = 0.8660254f;
+
+inline int floorInt(float v) {
+    return int(std::floor(v));
+}
+
+// Cells a box overlaps on one axis, open at both ends.
+inline void cellRange(float min, float max, int &lo, int &hi) {
+    lo = floorInt(min + 0.5f + EPS);
+    hi = floorInt(max + 0.5f - EPS);
+}
+
+inline uint64_t bitsFrom(int bit) {
+    return ~uint64_t(0) << bit;
+}
+
+inline uint64_t bitsTo(int bit) {
+    return bit == 63 ? ~uint64_t(0) : (uint64_t(1) << (bit + 1)) - 1;
+}
+
+CollisionBox boxOf(const AgentBody &body) {
+    CollisionBox box;
+    box.min[0] = body.x - body.halfWidth;
+    box.min[1] = body.y;
+    box.min[2] = body.z - body.halfWidth;
+    box.max[0] = body.x + body.halfWidth;
+    box.max[1] = body.y + body.height;
+    box.max[2] = body.z + body.halfWidth;
+    return box;
+}
+
+// First and last layer a move of the leading face crosses, in the order
+// they are met.
+inline void layersAhead(const CollisionBox &box, int axis, float delta, int &first, int &last) {
+    if (delta > 0.0f) {
+        first = floorInt(box.max[axis] + 0.5f - EPS) + 1;
+        last = floorInt(box.max[axis] + delta + 0.5f - EPS);
+    } else {
+        first = floorInt(box.min[axis] - 0.5f + EPS);
+        last = floorInt(box.min[axis] + delta - 0.5f + EPS) + 1;
+    }
+}
+
+inline float stopBefore(const CollisionBox &box, int axis, float delta, int layer) {
+    if (delta > 0.0f) {
+        return std::min(delta, std::max(0.0f, float(layer) - 0.5f - SKIN - box.max[axis]));
+    }
+    return std::max(delta, std::min(0.0f, float(layer) + 0.5f + SKIN - box.min[axis]));
+}
+
+inline void shift(CollisionBox &box, int axis, float distance) {
+    box.min[axis] += distance;
+    box.max[axis] += distance;
+}
+
+} // namespace
+
+VoxelCollider::VoxelCollider(const OccupancyMask &mask)
+    : mMask(mask), mField(nullptr) {}
+
+void VoxelCollider::setDistanceField(const DistanceField *field) {
+    mField = field;
+}
+
+// Everything the body can reach this tick lies within a sphere around its
+// centre, and the field gives a lower bound on how far the cell holding
+// that centre is from any solid cell: a cell centre is within half a
+// diagonal of both the body centre and every point of a solid cell.
+bool VoxelCollider::isClear(const AgentBody &body, float travel) const {
+    float halfHeight = body.height * 0.5f;
+    float reach = std::sqrt(2.0f * body.halfWidth * body.halfWidth + halfHeight * halfHeight) + travel;
+    return mField->hasClearance(floorInt(body.x + 0.5f), floorInt(body.y + halfHeight + 0.5f), floorInt(body.z + 0.5f),
+                                reach + 2.0f * HALF_DIAGONAL + SKIN);
+}
+
+bool VoxelCollider::isSolid(int x, int y, int z) const {
+    const Vec3i &origin = mMask.getOrigin();
+    return mMask.get(x - origin.x, y - origin.y, z - origin.z);
+}
+
+bool VoxelCollider::solidRange(int x, int z, int y0, int y1) const {
+    return firstSolid(x, z, y0, y1, true) != INT_MIN;
+}
+
+int VoxelCollider::firstSolid(int x, int z, int y0, int y1, bool up) const {
+    const Vec3i &origin = mMask.getOrigin();
+    const Vec3i &size = mMask.getSize();
+    int lx = x - origin.x;
+    int lz = z - origin.z;
+    if (lx < 0 || lz < 0 || lx >= size.x || lz >= size.z) {
+        return INT_MIN;
+    }
+    int ly0 = std::max(y0 - origin.y, 0);
+    int ly1 = std::min(y1 - origin.y, size.y - 1);
+    if (ly0 > ly1) {
+        return INT_MIN;
+    }
+    const uint64_t *column = mMask.getColumn(lx, lz);
+    int w0 = ly0 >> 6;
+    int w1 = ly1 >> 6;
+    for (int i = 0; i <= w1 - w0; ++i) {
+        int w = up ? w0 + i : w1 - i;
+        uint64_t bits = column[w];
+        if (w == w0) {
+            bits &= bitsFrom(ly0 & 63);
+        }
+        if (w == w1) {
+            bits &= bitsTo(ly1 & 63);
+        }
+        if (bits) {
+            int bit = up ? __builtin_ctzll(bits) : 63 - __builtin_clzll(bits);
+            return origin.y + w * 64 + bit;
+        }
+    }
+    return INT_MIN;
+}
+
+bool VoxelCollider::layerSolid(int axis, int layer, const CollisionBox &box) const {
+    int x0, x1, y0, y1, z0, z1;
+    cellRange(box.min[0], box.max[0], x0, x1);
+    cellRange(box.min[1], box.max[1], y0, y1);
+    cellRange(box.min[2], box.max[2], z0, z1);
+    if (axis == 0) {
+        x0 = x1 = layer;
+    } else if (axis == 1) {
+        y0 = y1 = layer;
+    } else {
+        z0 = z1 = layer;
+    }
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+            if (solidRange(x, z, y0, y1)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool VoxelCollider::overlaps(const CollisionBox &box) const {
+    int x0, x1, y0, y1, z0, z1;
+    cellRange(box.min[0], box.max[0], x0, x1);
+    cellRange(box.min[1], box.max[1], y0, y1);
+    cellRange(box.min[2], box.max[2], z0, z1);
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+            if (solidRange(x, z, y0, y1)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Vertical moves scan each column under the box with bit operations
+// instead of stepping layer by layer.
+float VoxelCollider::sweepVertical(CollisionBox &box, float delta) const {
+    if (delta == 0.0f) {
+        return 0.0f;
+    }
+    int first, last;
+    layersAhead(box, 1, delta, first, last);
+    bool up = delta > 0.0f;
+    if (up ? last < first : last > first) {
+        shift(box, 1, delta);
+        return delta;
+    }
+    int x0, x1, z0, z1;
+    cellRange(box.min[0], box.max[0], x0, x1);
+    cellRange(box.min[2], box.max[2], z0, z1);
+    int hit = INT_MIN;
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+            int y = up ? firstSolid(x, z, first, last, true) : firstSolid(x, z, last, first, false);
+            if (y != INT_MIN && (hit == INT_MIN || (up ? y < hit : y > hit))) {
+                hit = y;
+            }
+        }
+    }
+    float moved = hit == INT_MIN ? delta : stopBefore(box, 1, delta, hit);
+    shift(box, 1, moved);
+    return moved;
+}
+
+float VoxelCollider::sweep(CollisionBox &box, int axis, float delta) const {
+    if (axis == 1) {
+        return sweepVertical(box, delta);
+    }
+    if (delta == 0.0f) {
+        return 0.0f;
+    }
+    int first, last;
+    layersAhead(box, axis, delta, first, last);
+    int step = delta > 0.0f ? 1 : -1;
+    for (int layer = first; step > 0 ? layer <= last : layer >= last; layer += step) {
+        if (layerSolid(axis, layer, box)) {
+            float moved = stopBefore(box, axis, delta, layer);
+            shift(box, axis, moved);
+            return moved;
+        }
+    }
+    shift(box, axis, delta);
+    return delta;
+}
+
+void VoxelCollider::moveOne(AgentBody &body, float dt, const MoveSettings &settings) const {
+    bool grounded = (body.flags & AGENT_ON_GROUND) != 0;
+    CollisionBox box = boxOf(body);
+
+    body.vy += settings.gravity * dt;
+    if (mField) {
+        float travel = std::sqrt(body.vx * body.vx + body.vy * body.vy + body.vz * body.vz) * dt;
+        if (isClear(body, travel)) {
+            // Nothing within reach: no sweeps, no step-up, not on the ground.
+            body.x += body.vx * dt;
+            body.y += body.vy * dt;
+            body.z += body.vz * dt;
+            body.flags &= ~AGENT_ON_GROUND;
+            return;
+        }
+    }
+    float dy = body.vy * dt;
+    if (std::fabs(sweepVertical(box, dy) - dy) > EPS) {
+        body.vy = 0.0f;
+    }
+
+    float *velocity[3] = {&body.vx, nullptr, &body.vz};
+    for (int axis = 0; axis < 3; axis += 2) {
+        float delta = *velocity[axis] * dt;
+        if (delta == 0.0f) {
+            continue;
+        }
+        CollisionBox start = box;
+        float moved = sweep(box, axis, delta);
+        // Blocked while walking: try again from stepHeight higher and keep
+        // that if it gets further, dropping back down onto the step.
+        if (std::fabs(moved) < std::fabs(delta) - EPS && grounded && settings.stepHeight > 0.0f) {
+            CollisionBox lifted = start;
+            float up = sweepVertical(lifted, settings.stepHeight);
+            float stepped = sweep(lifted, axis, delta);
+            if (std::fabs(stepped) > std::fabs(moved) + EPS) {
+                sweepVertical(lifted, -up);
+                box = lifted;
+                moved = stepped;
+            }
+        }
+        if (std::fabs(moved) < std::fabs(delta) - EPS) {
+            *velocity[axis] = 0.0f;
+        }
+    }
+
+    // Standing on something when a tiny drop is blocked.
+    CollisionBox probe = box;
+    grounded = sweepVertical(probe, -2.0f * SKIN) > -1.5f * SKIN;
+    body.flags = grounded ? (body.flags | AGENT_ON_GROUND) : (body.flags & ~AGENT_ON_GROUND);
+    body.x = (box.min[0] + box.max[0]) * 0.5f;
+    body.y = box.min[1];
+    body.z = (box.min[2] + box.max[2]) * 0.5f;
+}
+
+void VoxelCollider::move(AgentBody *bodies, size_t count, float dt, const MoveSettings &settings,
+                         ThreadPool *pool) const {
+    size_t blocks = (count + BODIES_PER_BLOCK - 1) / BODIES_PER_BLOCK;
+    ThreadPool &threads = pool ? *pool : defaultThreadPool();
+    threads.parallelFor(blocks, [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * BODIES_PER_BLOCK);
+        for (size_t i = block * BODIES_PER_BLOCK; i < end; ++i) {
+            moveOne(bodies[i], dt, settings);
+        }
+    });
+}
+
+} // namespace vox
@@ -0,0 +1,86 @@
+#ifndef VOXELCOLLIDER_H
+#define VOXELCOLLIDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "OccupancyMask.h"
+
+namespace vox {
+
+class DistanceField;
+class ThreadPool;
+
+// Axis aligned box in world units, where voxel (x, y, z) covers
+// [x - 0.5, x + 0.5] on each axis like the editors draw it.
+struct CollisionBox {
+    float min[3];
+    float max[3];
+};
+
+// An upright box standing on (x, y, z), the centre of its bottom face.
+struct AgentBody {
+    float x, y, z;
+    float vx, vy, vz;       // units per second
+    float halfWidth;        // half extent on x and z
+    float height;
+    uint32_t flags;         // AGENT_ON_GROUND
+};
+
+const uint32_t AGENT_ON_GROUND = 1;
+
+struct MoveSettings {
+    float gravity;          // added to vy every second, negative pulls down
+    float stepHeight;       // ledges up to this high are climbed while walking
+
+    MoveSettings() : gravity(-30.0f), stepHeight(1.0f) {}
+};
+
+// Collision of boxes against the solid cells of an OccupancyMask. Moves are
+// swept one axis at a time through the mask's cell layers, so boxes never
+// tunnel through walls however far they move in a tick. Cells outside the
+// mask are empty. Keep the mask in step with edits through
+// OccupancyMask::copyChunk().
+class VoxelCollider {
+public:
+    explicit VoxelCollider(const OccupancyMask &mask);
+
+    // Optional field built from the same mask. Bodies it shows to be well
+    // clear of every solid cell move without sweeping, which gives the same
+    // result up to rounding. Null turns it off.
+    void setDistanceField(const DistanceField *field);
+
+    bool isSolid(int x, int y, int z) const;
+    bool overlaps(const CollisionBox &box) const;
+
+    // Moves box by up to delta along axis (0 x, 1 y, 2 z), stopping just
+    // short of the first solid cell in the way. Returns the distance moved.
+    float sweep(CollisionBox &box, int axis, float delta) const;
+
+    // Applies gravity and velocity for dt seconds: y first, then x and z
+    // with step-up, zeroing velocity on blocked axes and updating
+    // AGENT_ON_GROUND. Bodies are independent and split across the pool
+    // in contiguous blocks.
+    void move(AgentBody *bodies, size_t count, float dt, const MoveSettings &settings = MoveSettings(),
+              ThreadPool *pool = nullptr) const;
+
+    void moveOne(AgentBody &body, float dt, const MoveSettings &settings) const;
+
+private:
+    // World coordinates, y0..y1 inclusive.
+    bool solidRange(int x, int z, int y0, int y1) const;
+    // Nearest solid y in [y0, y1] going up from y0 (up) or down from y1,
+    // or INT_MIN when the range is clear.
+    int firstSolid(int x, int z, int y0, int y1, bool up) const;
+    bool layerSolid(int axis, int layer, const CollisionBox &box) const;
+    float sweepVertical(CollisionBox &box, float delta) const;
+
+    bool isClear(const AgentBody &body, float travel) const;
+
+    const OccupancyMask &mMask;
+    const DistanceField *mField;
+};
+
+} // namespace vox
+
+#endif // VOXELCOLLIDER_H
@@ -0,0 +1,406 @@
+#include "VoxelLighting.h"
+
+#include <algorithm>
+
+namespace vox {
+
+namespace {
+
+const Vec3i DIRECTIONS[6] = {
+    Vec3i(1, 0, 0), Vec3i(-1, 0, 0),
+    Vec3i(0, 1, 0), Vec3i(0, -1, 0),
+    Vec3i(0, 0, 1), Vec3i(0, 0, -1)
+};
+const int DOWN = 3;
+
+inline int channelValue(uint8_t cell, LightChannel channel) {
+    return channel == LIGHT_SKY ? cell >> 4 : cell & 0x0F;
+}
+
+inline int localIndex(const Vec3i &p) {
+    return cellIndex(localCoord(p.x), localCoord(p.y), localCoord(p.z));
+}
+
+} // namespace
+
+VoxelLighting::VoxelLighting(const VoxelMap &map)
+    : mMap(map) {}
+
+void VoxelLighting::relightAll() {
+    mLight.clear();
+    for (int c = 0; c < LIGHT_CHANNELS; ++c) {
+        mRemoveQueue[c].clear();
+        mAddQueue[c].clear();
+    }
+    // Top down, so every chunk sees the finished sky columns above it.
+    std::vector<Vec3i> chunks;
+    for (const auto &entry : mMap.getChunks()) {
+        chunks.push_back(entry.first);
+    }
+    std::sort(chunks.begin(), chunks.end(), [](const Vec3i &a, const Vec3i &b) { return a.y > b.y; });
+    for (const Vec3i &chunk : chunks) {
+        seedChunk(chunk);
+    }
+}
+
+void VoxelLighting::relightChunk(const Vec3i &chunk) {
+    if (mMap.findChunk(chunk)) {
+        seedChunk(chunk);
+    }
+}
+
+void VoxelLighting::removeChunk(const Vec3i &chunk) {
+    mLight.erase(chunk);
+}
+
+void VoxelLighting::onVoxelChanged(int x, int y, int z) {
+    Vec3i p(x, y, z);
+    Vec3i chunk = chunkOf(p);
+    if (!findLight(chunk)) {
+        if (!mMap.findChunk(chunk)) {
+            return;
+        }
+        seedChunk(chunk);
+    }
+
+    bool opaque = isOpaque(p);
+    for (int c = 0; c < LIGHT_CHANNELS; ++c) {
+        LightChannel channel = LightChannel(c);
+        int old = getLight(channel, x, y, z);
+        int source = channel == LIGHT_BLOCK ? sourceLevel(p) : 0;
+        if (old != source) {
+            setLight(channel, p, source);
+            if (old > source) {
+                RemoveNode node = {p, uint8_t(old)};
+                mRemoveQueue[c].push_back(node);
+            }
+        }
+        if (source > 0) {
+            mAddQueue[c].push_back(p);
+        }
+        if (!opaque) {
+            // Let the surroundings flow back into the opened cell.
+            for (const Vec3i &d : DIRECTIONS) {
+                Vec3i n = p + d;
+                if (getLight(channel, n.x, n.y, n.z) > 0) {
+                    mAddQueue[c].push_back(n);
+                }
+            }
+        }
+    }
+}
+
+void VoxelLighting::addEmitter(int x, int y, int z, int level) {
+    mEmitters[Vec3i(x, y, z)] = uint8_t(std::min(std::max(level, 0), MAX_LIGHT));
+    onVoxelChanged(x, y, z);
+}
+
+void VoxelLighting::removeEmitter(int x, int y, int z) {
+    if (mEmitters.erase(Vec3i(x, y, z))) {
+        onVoxelChanged(x, y, z);
+    }
+}
+
+size_t VoxelLighting::update(int maxSteps) {
+    int steps = 0;
+    while (maxSteps < 0 || steps < maxSteps) {
+        bool worked = false;
+        // Removals first, otherwise stale light would be spread again.
+        for (int c = 0; c < LIGHT_CHANNELS && !worked; ++c) {
+            if (!mRemoveQueue[c].empty()) {
+                RemoveNode node = mRemoveQueue[c].front();
+                mRemoveQueue[c].pop_front();
+                propagateRemove(LightChannel(c), node);
+                worked = true;
+            }
+        }
+        for (int c = 0; c < LIGHT_CHANNELS && !worked; ++c) {
+            if (!mAddQueue[c].empty()) {
+                Vec3i p = mAddQueue[c].front();
+                mAddQueue[c].pop_front();
+                propagateAdd(LightChannel(c), p);
+                worked = true;
+            }
+        }
+        if (!worked) {
+            break;
+        }
+        ++steps;
+    }
+
+    size_t left = 0;
+    for (int c = 0; c < LIGHT_CHANNELS; ++c) {
+        left += mRemoveQueue[c].size() + mAddQueue[c].size();
+    }
+    return left;
+}
+
+bool VoxelLighting::isPending() const {
+    for (int c = 0; c < LIGHT_CHANNELS; ++c) {
+        if (!mRemoveQueue[c].empty() || !mAddQueue[c].empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int VoxelLighting::getLight(LightChannel channel, int x, int y, int z) const {
+    const LightChunk *light = findLight(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    if (!light) {
+        return channel == LIGHT_SKY ? MAX_LIGHT : 0;
+    }
+    return channelValue(light->cells[cellIndex(localCoord(x), localCoord(y), localCoord(z))], channel);
+}
+
+int VoxelLighting::getLevel(int x, int y, int z) const {
+    const LightChunk *light = findLight(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    if (!light) {
+        return MAX_LIGHT;
+    }
+    uint8_t cell = light->cells[cellIndex(localCoord(x), localCoord(y), localCoord(z))];
+    return std::max(cell >> 4, cell & 0x0F);
+}
+
+void VoxelLighting::takeChangedChunks(std::vector<Vec3i> &out) {
+    out.assign(mChangedChunks.begin(), mChangedChunks.end());
+    mChangedChunks.clear();
+}
+
+VoxelLighting::LightChunk *VoxelLighting::findLight(const Vec3i &chunk) {
+    auto it = mLight.find(chunk);
+    return it != mLight.end() ? it->second.get() : nullptr;
+}
+
+const VoxelLighting::LightChunk *VoxelLighting::findLight(const Vec3i &chunk) const {
+    auto it = mLight.find(chunk);
+    return it != mLight.end() ? it->second.get() : nullptr;
+}
+
+bool VoxelLighting::setLight(LightChannel channel, const Vec3i &p, int level) {
+    LightChunk *light = findLight(chunkOf(p));
+    if (!light) {
+        return false;
+    }
+    uint8_t &cell = light->cells[localIndex(p)];
+    uint8_t value = channel == LIGHT_SKY ? uint8_t((cell & 0x0F) | (level << 4))
+                                         : uint8_t((cell & 0xF0) | level);
+    if (value == cell) {
+        return false;
+    }
+    cell = value;
+    markChanged(p);
+    return true;
+}
+
+bool VoxelLighting::isOpaque(const Vec3i &p) const {
+    MaterialId material = mMap.getMaterial(p.x, p.y, p.z);
+    return material != AIR && mMap.getMaterials().get(material).opaque;
+}
+
+int VoxelLighting::sourceLevel(const Vec3i &p) const {
+    int level = mMap.getMaterials().get(mMap.getMaterial(p.x, p.y, p.z)).emission;
+    auto it = mEmitters.find(p);
+    if (it != mEmitters.end()) {
+        level = std::max<int>(level, it->second);
+    }
+    return std::min(level, MAX_LIGHT);
+}
+
+void VoxelLighting::markChanged(const Vec3i &p) {
+    Vec3i chunk = chunkOf(p);
+    mChangedChunks.insert(chunk);
+    // Meshes sample the light of the cell in front of each face, so cells on
+    // a chunk border also affect the neighbouring chunk.
+    int lx = localCoord(p.x), ly = localCoord(p.y), lz = localCoord(p.z);
+    if (lx == 0) mChangedChunks.insert(chunk + Vec3i(-1, 0, 0));
+    if (lx == CHUNK_MASK) mChangedChunks.insert(chunk + Vec3i(1, 0, 0));
+    if (ly == 0) mChangedChunks.insert(chunk + Vec3i(0, -1, 0));
+    if (ly == CHUNK_MASK) mChangedChunks.insert(chunk + Vec3i(0, 1, 0));
+    if (lz == 0) mChangedChunks.insert(chunk + Vec3i(0, 0, -1));
+    if (lz == CHUNK_MASK) mChangedChunks.insert(chunk + Vec3i(0, 0, 1));
+}
+
+void VoxelLighting::seedChunk(const Vec3i &chunk) {
+    const Chunk *cells = mMap.findChunk(chunk);
+    if (!cells) {
+        return;
+    }
+    std::unique_ptr<LightChunk> &slot = mLight[chunk];
+    if (!slot) {
+        slot.reset(new LightChunk());
+    }
+    LightChunk &light = *slot;
+    std::fill(light.cells, light.cells + CHUNK_VOLUME, uint8_t(0));
+
+    std::vector<uint32_t> materials(CHUNK_VOLUME);
+    cells->getMaterials().decode(materials.data());
+    const MaterialRegistry &registry = mMap.getMaterials();
+    std::vector<uint8_t> opaque(registry.size());
+    std::vector<uint8_t> emission(registry.size());
+    for (size_t m = 0; m < registry.size(); ++m) {
+        opaque[m] = m != AIR && registry.get(MaterialId(m)).opaque;
+        emission[m] = std::min<uint8_t>(registry.get(MaterialId(m)).emission, MAX_LIGHT);
+    }
+    auto isOpaqueCell = [&](int index) {
+        uint32_t m = materials[index];
+        return m < opaque.size() ? opaque[m] != 0 : true;
+    };
+
+    Vec3i base(chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, chunk.z * CHUNK_SIZE);
+    std::deque<Vec3i> &skyQueue = mAddQueue[LIGHT_SKY];
+    std::deque<Vec3i> &blockQueue = mAddQueue[LIGHT_BLOCK];
+
+    // Sky columns, straight down from whatever the chunk above lets through.
+    for (int lz = 0; lz < CHUNK_SIZE; ++lz) {
+        for (int lx = 0; lx < CHUNK_SIZE; ++lx) {
+            bool open = getLight(LIGHT_SKY, base.x + lx, base.y + CHUNK_SIZE, base.z + lz) == MAX_LIGHT;
+            for (int ly = CHUNK_MASK; ly >= 0 && open; --ly) {
+                int index = cellIndex(lx, ly, lz);
+                if (isOpaqueCell(index)) {
+                    open = false;
+                } else {
+                    light.cells[index] = uint8_t(MAX_LIGHT << 4);
+                }
+            }
+        }
+    }
+
+    // Only sky cells next to something darker need to spread.
+    for (int lz = 0; lz < CHUNK_SIZE; ++lz) {
+        for (int ly = 0; ly < CHUNK_SIZE; ++ly) {
+            for (int lx = 0; lx < CHUNK_SIZE; ++lx) {
+                int index = cellIndex(lx, ly, lz);
+                if ((light.cells[index] >> 4) != MAX_LIGHT) {
+                    continue;
+                }
+                bool border = lx == 0 || lz == 0 || ly == 0 || lx == CHUNK_MASK || lz == CHUNK_MASK;
+                bool spread = border;
+                const int offsets[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+                for (int o = 0; o < 4 && !spread; ++o) {
+                    int n = cellIndex(lx + offsets[o][0], ly, lz + offsets[o][1]);
+                    spread = !isOpaqueCell(n) && (light.cells[n] >> 4) != MAX_LIGHT;
+                }
+                if (spread) {
+                    skyQueue.push_back(Vec3i(base.x + lx, base.y + ly, base.z + lz));
+                }
+            }
+        }
+    }
+
+    // Emissive materials.
+    for (int index = 0; index < CHUNK_VOLUME; ++index) {
+        uint32_t m = materials[index];
+        if (m < emission.size() && emission[m] > 0) {
+            light.cells[index] = uint8_t((light.cells[index] & 0xF0) | emission[m]);
+            int lx = index & CHUNK_MASK;
+            int ly = (index >> CHUNK_BITS) & CHUNK_MASK;
+            int lz = index >> (2 * CHUNK_BITS);
+            blockQueue.push_back(Vec3i(base.x + lx, base.y + ly, base.z + lz));
+        }
+    }
+    // Point emitters.
+    for (const auto &emitter : mEmitters) {
+        if (chunkOf(emitter.first) == chunk) {
+            uint8_t &cell = light.cells[localIndex(emitter.first)];
+            if ((cell & 0x0F) < emitter.second) {
+                cell = uint8_t((cell & 0xF0) | emitter.second);
+                blockQueue.push_back(emitter.first);
+            }
+        }
+    }
+
+    // Light already in the neighbours flows in across the shared faces.
+    for (int d = 0; d < 6; ++d) {
+        const LightChunk *neighbour = findLight(chunk + DIRECTIONS[d]);
+        if (!neighbour) {
+            continue;
+        }
+        int axis = d / 2;
+        int layer = DIRECTIONS[d].x + DIRECTIONS[d].y + DIRECTIONS[d].z > 0 ? 0 : CHUNK_MASK;
+        for (int a = 0; a < CHUNK_SIZE; ++a) {
+            for (int b = 0; b < CHUNK_SIZE; ++b) {
+                int l[3];
+                l[axis] = layer;
+                l[(axis + 1) % 3] = a;
+                l[(axis + 2) % 3] = b;
+                uint8_t cell = neighbour->cells[cellIndex(l[0], l[1], l[2])];
+                Vec3i p = (chunk + DIRECTIONS[d]);
+                p = Vec3i(p.x * CHUNK_SIZE + l[0], p.y * CHUNK_SIZE + l[1], p.z * CHUNK_SIZE + l[2]);
+                if ((cell >> 4) > 1) {
+                    skyQueue.push_back(p);
+                }
+                if ((cell & 0x0F) > 1) {
+                    blockQueue.push_back(p);
+                }
+            }
+        }
+    }
+
+    // Columns this chunk now shades must stop lighting the chunk below.
+    if (findLight(chunk + Vec3i(0, -1, 0))) {
+        for (int lz = 0; lz < CHUNK_SIZE; ++lz) {
+            for (int lx = 0; lx < CHUNK_SIZE; ++lx) {
+                if ((light.cells[cellIndex(lx, 0, lz)] >> 4) == MAX_LIGHT) {
+                    continue;
+                }
+                Vec3i below(base.x + lx, base.y - 1, base.z + lz);
+                if (getLight(LIGHT_SKY, below.x, below.y, below.z) == MAX_LIGHT) {
+                    setLight(LIGHT_SKY, below, 0);
+                    RemoveNode node = {below, uint8_t(MAX_LIGHT)};
+                    mRemoveQueue[LIGHT_SKY].push_back(node);
+                }
+            }
+        }
+    }
+
+    mChangedChunks.insert(chunk);
+    for (const Vec3i &d : DIRECTIONS) {
+        mChangedChunks.insert(chunk + d);
+    }
+}
+
+void VoxelLighting::propagateRemove(LightChannel channel, const RemoveNode &node) {
+    for (int d = 0; d < 6; ++d) {
+        Vec3i n = node.pos + DIRECTIONS[d];
+        if (!findLight(chunkOf(n))) {
+            continue;
+        }
+        int level = getLight(channel, n.x, n.y, n.z);
+        if (level == 0) {
+            continue;
+        }
+        bool fedByNode = level < node.level
+            || (channel == LIGHT_SKY && d == DOWN && node.level == MAX_LIGHT && level == MAX_LIGHT);
+        if (fedByNode) {
+            int source = channel == LIGHT_BLOCK ? sourceLevel(n) : 0;
+            setLight(channel, n, source);
+            RemoveNode next = {n, uint8_t(level)};
+            mRemoveQueue[channel].push_back(next);
+            if (source > 0) {
+                mAddQueue[channel].push_back(n);
+            }
+        } else {
+            // Independently lit, refill the hole from here.
+            mAddQueue[channel].push_back(n);
+        }
+    }
+}
+
+void VoxelLighting::propagateAdd(LightChannel channel, const Vec3i &p) {
+    int level = getLight(channel, p.x, p.y, p.z);
+    if (level <= 1) {
+        return;
+    }
+    for (int d = 0; d < 6; ++d) {
+        Vec3i n = p + DIRECTIONS[d];
+        if (isOpaque(n)) {
+            continue;
+        }
+        int next = (channel == LIGHT_SKY && d == DOWN && level == MAX_LIGHT) ? MAX_LIGHT : level - 1;
+        if (getLight(channel, n.x, n.y, n.z) < next && setLight(channel, n, next)) {
+            mAddQueue[channel].push_back(n);
+        }
+    }
+}
+
+} // namespace vox
@@ -0,0 +1,87 @@
+#ifndef VOXELLIGHTING_H
+#define VOXELLIGHTING_H
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "VoxelMap.h"
+
+namespace vox {
+
+enum LightChannel {
+    LIGHT_SKY = 0,
+    LIGHT_BLOCK,
+    LIGHT_CHANNELS
+};
+
+const int MAX_LIGHT = 15;
+
+// Flood-fill voxel light. Every chunk of the map gets a byte per cell with
+// sky light in the high nibble and block light (emissive materials and point
+// emitters) in the low one. Sky light travels straight down at full strength,
+// everything else loses one level per step.
+//
+// Edits only queue work; update() drains the queues with a step budget so a
+// frame never pays for more than it can afford. Space outside any chunk is
+// treated as open sky and is not propagated through.
+class VoxelLighting {
+public:
+    explicit VoxelLighting(const VoxelMap &map);
+
+    // Throws away all light and seeds every chunk of the map again.
+    void relightAll();
+    void relightChunk(const Vec3i &chunk);
+    void removeChunk(const Vec3i &chunk);
+
+    // Call after the material at a cell changed.
+    void onVoxelChanged(int x, int y, int z);
+
+    void addEmitter(int x, int y, int z, int level);
+    void removeEmitter(int x, int y, int z);
+
+    // Processes at most maxSteps queued cells, returns how many are left.
+    // A negative budget runs until the light is stable.
+    size_t update(int maxSteps);
+    bool isPending() const;
+
+    int getLight(LightChannel channel, int x, int y, int z) const;
+    // max(sky, block), what the mesher shades with.
+    int getLevel(int x, int y, int z) const;
+
+    // Chunks whose light changed since the last call.
+    void takeChangedChunks(std::vector<Vec3i> &out);
+
+private:
+    struct LightChunk {
+        uint8_t cells[CHUNK_VOLUME];
+    };
+
+    struct RemoveNode {
+        Vec3i pos;
+        uint8_t level;
+    };
+
+    LightChunk *findLight(const Vec3i &chunk);
+    const LightChunk *findLight(const Vec3i &chunk) const;
+    bool setLight(LightChannel channel, const Vec3i &p, int level);
+    bool isOpaque(const Vec3i &p) const;
+    int sourceLevel(const Vec3i &p) const;
+    void markChanged(const Vec3i &p);
+    void seedChunk(const Vec3i &chunk);
+    void propagateRemove(LightChannel channel, const RemoveNode &node);
+    void propagateAdd(LightChannel channel, const Vec3i &p);
+
+    const VoxelMap &mMap;
+    std::unordered_map<Vec3i, std::unique_ptr<LightChunk>, Vec3iHash> mLight;
+    std::unordered_map<Vec3i, uint8_t, Vec3iHash> mEmitters;
+    std::deque<RemoveNode> mRemoveQueue[LIGHT_CHANNELS];
+    std::deque<Vec3i> mAddQueue[LIGHT_CHANNELS];
+    std::unordered_set<Vec3i, Vec3iHash> mChangedChunks;
+};
+
+} // namespace vox
+
+#endif // VOXELLIGHTING_H
@@ -0,0 +1,279 @@
+#include "VoxelMap.h"
+
+#include <atomic>
+
+namespace vox {
+
+VoxelMap::VoxelMap()
+    : mVersion(0), mSurfaceStyle(SURFACE_BLOCKS) {}
+
+MaterialId VoxelMap::getMaterial(int x, int y, int z) const {
+    const Chunk *chunk = findChunk(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    return chunk ? chunk->getMaterial(localCoord(x), localCoord(y), localCoord(z)) : AIR;
+}
+
+void VoxelMap::setMaterial(int x, int y, int z, MaterialId material) {
+    Vec3i key(chunkCoord(x), chunkCoord(y), chunkCoord(z));
+    int lx = localCoord(x), ly = localCoord(y), lz = localCoord(z);
+    // Check before unsharing so no-op edits never copy a chunk.
+    const Chunk *current = static_cast<const VoxelMap *>(this)->findChunk(key);
+    if (current ? current->getMaterial(lx, ly, lz) == material : material == AIR) {
+        return;
+    }
+    Chunk &chunk = getOrCreateChunk(key);
+    if (chunk.setMaterial(lx, ly, lz, material)) {
+        cellChanged(key, chunk, lx, ly, lz);
+    }
+}
+
+bool VoxelMap::isSolid(int x, int y, int z) const {
+    return getMaterial(x, y, z) != AIR;
+}
+
+uint32_t VoxelMap::getAttribute(AttributeChannel channel, int x, int y, int z) const {
+    const Chunk *chunk = findChunk(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    return chunk ? chunk->getAttribute(channel, cellIndex(localCoord(x), localCoord(y), localCoord(z))) : 0;
+}
+
+void VoxelMap::setAttribute(AttributeChannel channel, int x, int y, int z, uint32_t value) {
+    Vec3i key(chunkCoord(x), chunkCoord(y), chunkCoord(z));
+    int lx = localCoord(x), ly = localCoord(y), lz = localCoord(z);
+    int index = cellIndex(lx, ly, lz);
+    const Chunk *current = static_cast<const VoxelMap *>(this)->findChunk(key);
+    if ((current ? current->getAttribute(channel, index) : 0) == value) {
+        return;
+    }
+    Chunk &chunk = getOrCreateChunk(key);
+    if (chunk.setAttribute(channel, index, value)) {
+        cellChanged(key, chunk, lx, ly, lz);
+    }
+}
+
+bool VoxelMap::hasChunk(const Vec3i &chunk) const {
+    return mChunks.count(chunk) != 0;
+}
+
+const Chunk *VoxelMap::findChunk(const Vec3i &chunk) const {
+    auto it = mChunks.find(chunk);
+    return it != mChunks.end() ? it->second.get() : nullptr;
+}
+
+Chunk *VoxelMap::findChunk(const Vec3i &chunk) {
+    auto it = mChunks.find(chunk);
+    return it != mChunks.end() ? unshare(it->second) : nullptr;
+}
+
+Chunk &VoxelMap::getOrCreateChunk(const Vec3i &chunk) {
+    std::shared_ptr<Chunk> &slot = mChunks[chunk];
+    if (!slot) {
+        slot = std::make_shared<Chunk>();
+        slot->setVersion(++mVersion);
+        mChanges.record(chunk, CHANGE_CONTENT, mVersion);
+        return *slot;
+    }
+    return *unshare(slot);
+}
+
+void VoxelMap::setChunk(const Vec3i &chunk, std::shared_ptr<Chunk> cells) {
+    mChunks[chunk] = std::move(cells);
+    markChunkChanged(chunk);
+}
+
+std::shared_ptr<const Chunk> VoxelMap::shareChunk(const Vec3i &chunk) const {
+    auto it = mChunks.find(chunk);
+    return it != mChunks.end() ? it->second : nullptr;
+}
+
+void VoxelMap::removeChunk(const Vec3i &chunk) {
+    if (mChunks.erase(chunk)) {
+        chunkRemoved(chunk);
+    }
+}
+
+void VoxelMap::markChunkChanged(const Vec3i &chunk) {
+    auto it = mChunks.find(chunk);
+    if (it == mChunks.end()) {
+        return;
+    }
+    Chunk *cells = unshare(it->second);
+    uint64_t version = ++mVersion;
+    cells->setVersion(version);
+    mChanges.record(chunk, CHANGE_CONTENT, version);
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                Vec3i neighbour = chunk + Vec3i(dx, dy, dz);
+                if ((dx || dy || dz) && hasChunk(neighbour)) {
+                    mChanges.record(neighbour, CHANGE_NEIGHBOUR, version);
+                }
+            }
+        }
+    }
+}
+
+const VoxelMap::ChunkTable &VoxelMap::getChunks() const {
+    return mChunks;
+}
+
+size_t VoxelMap::getChunkCount() const {
+    return mChunks.size();
+}
+
+void VoxelMap::compact() {
+    for (auto it = mChunks.begin(); it != mChunks.end();) {
+        // Shared chunks are left alone, copying them would cost more than
+        // compacting saves.
+        if (it->second.use_count() == 1) {
+            it->second->compact();
+        }
+        if (it->second->isEmpty() && !it->second->hasAttributes()) {
+            Vec3i chunk = it->first;
+            it = mChunks.erase(it);
+            chunkRemoved(chunk);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void VoxelMap::clear() {
+    std::vector<Vec3i> removed;
+    for (const auto &entry : mChunks) {
+        removed.push_back(entry.first);
+    }
+    mChunks.clear();
+    for (const Vec3i &chunk : removed) {
+        chunkRemoved(chunk);
+    }
+    mMaterials.clear();
+    mSurfaceStyle = SURFACE_BLOCKS;
+}
+
+size_t VoxelMap::memoryUsage() const {
+    size_t bytes = sizeof(*this);
+    for (const auto &entry : mChunks) {
+        bytes += entry.second->memoryUsage() + sizeof(entry);
+    }
+    return bytes;
+}
+
+std::shared_ptr<const MapSnapshot> VoxelMap::snapshot() const {
+    std::shared_ptr<MapSnapshot> snapshot = std::make_shared<MapSnapshot>();
+    snapshot->mChunks.reserve(mChunks.size());
+    for (const auto &entry : mChunks) {
+        snapshot->mChunks.emplace(entry.first, entry.second);
+    }
+    snapshot->mVersion = mVersion;
+    snapshot->mMaterials = mMaterials;
+    return snapshot;
+}
+
+uint64_t VoxelMap::getVersion() const {
+    return mVersion;
+}
+
+ChangeTracker &VoxelMap::getChanges() {
+    return mChanges;
+}
+
+Chunk *VoxelMap::unshare(std::shared_ptr<Chunk> &slot) {
+    if (slot.use_count() > 1) {
+        slot = std::make_shared<Chunk>(*slot);
+    } else {
+        // Pairs with the release of the last reader's reference, so its reads
+        // of the cells are done before we write them.
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return slot.get();
+}
+
+void VoxelMap::cellChanged(const Vec3i &chunk, Chunk &cells, int lx, int ly, int lz) {
+    uint64_t version = ++mVersion;
+    cells.setVersion(version);
+    mChanges.record(chunk, CHANGE_CONTENT, version);
+    if (!mChanges.hasSubscribers()) {
+        return;
+    }
+    // Border cells are read by the meshes and light of up to 7 neighbours.
+    int x0 = lx == 0 ? -1 : 0, x1 = lx == CHUNK_MASK ? 1 : 0;
+    int y0 = ly == 0 ? -1 : 0, y1 = ly == CHUNK_MASK ? 1 : 0;
+    int z0 = lz == 0 ? -1 : 0, z1 = lz == CHUNK_MASK ? 1 : 0;
+    for (int dz = z0; dz <= z1; ++dz) {
+        for (int dy = y0; dy <= y1; ++dy) {
+            for (int dx = x0; dx <= x1; ++dx) {
+                Vec3i neighbour = chunk + Vec3i(dx, dy, dz);
+                if ((dx || dy || dz) && hasChunk(neighbour)) {
+                    mChanges.record(neighbour, CHANGE_NEIGHBOUR, version);
+                }
+            }
+        }
+    }
+}
+
+void VoxelMap::chunkRemoved(const Vec3i &chunk) {
+    uint64_t version = ++mVersion;
+    mChanges.record(chunk, CHANGE_REMOVED, version);
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                Vec3i neighbour = chunk + Vec3i(dx, dy, dz);
+                if ((dx || dy || dz) && hasChunk(neighbour)) {
+                    mChanges.record(neighbour, CHANGE_NEIGHBOUR, version);
+                }
+            }
+        }
+    }
+}
+
+MaterialRegistry &VoxelMap::getMaterials() {
+    return mMaterials;
+}
+
+const MaterialRegistry &VoxelMap::getMaterials() const {
+    return mMaterials;
+}
+
+SurfaceStyle VoxelMap::getSurfaceStyle() const {
+    return mSurfaceStyle;
+}
+
+void VoxelMap::setSurfaceStyle(SurfaceStyle style) {
+    mSurfaceStyle = style;
+}
+
+MaterialId MapSnapshot::getMaterial(int x, int y, int z) const {
+    const Chunk *chunk = findChunk(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    return chunk ? chunk->getMaterial(localCoord(x), localCoord(y), localCoord(z)) : AIR;
+}
+
+bool MapSnapshot::isSolid(int x, int y, int z) const {
+    return getMaterial(x, y, z) != AIR;
+}
+
+uint32_t MapSnapshot::getAttribute(AttributeChannel channel, int x, int y, int z) const {
+    const Chunk *chunk = findChunk(Vec3i(chunkCoord(x), chunkCoord(y), chunkCoord(z)));
+    return chunk ? chunk->getAttribute(channel, cellIndex(localCoord(x), localCoord(y), localCoord(z))) : 0;
+}
+
+const Chunk *MapSnapshot::findChunk(const Vec3i &chunk) const {
+    auto it = mChunks.find(chunk);
+    return it != mChunks.end() ? it->second.get() : nullptr;
+}
+
+const MapSnapshot::ChunkTable &MapSnapshot::getChunks() const {
+    return mChunks;
+}
+
+size_t MapSnapshot::getChunkCount() const {
+    return mChunks.size();
+}
+
+uint64_t MapSnapshot::getVersion() const {
+    return mVersion;
+}
+
+const MaterialRegistry &MapSnapshot::getMaterials() const {
+    return mMaterials;
+}
+
+} // namespace vox
@@ -0,0 +1,118 @@
+#ifndef VOXELMAP_H
+#define VOXELMAP_H
+
+#include <memory>
+#include <unordered_map>
+
+#include "ChangeTracker.h"
+#include "Chunk.h"
+#include "Material.h"
+
+namespace vox {
+
+class MapSnapshot;
+
+// How a map's surface is meshed: ChunkMesher cubes or SurfaceMesher's
+// smooth surface through the cell densities. Saved with the map.
+enum SurfaceStyle {
+    SURFACE_BLOCKS = 0,
+    SURFACE_SMOOTH = 1
+};
+
+// Sparse world made of chunks. Cells outside any chunk read as air.
+// Every change bumps a map-wide edit counter, stamps the chunk with it and
+// is recorded in getChanges() for whoever needs to catch up with edits.
+//
+// Chunks are reference counted so snapshot() can hand other threads an
+// immutable view without copying cells. The first edit of a chunk that a
+// snapshot still shares copies it (copy-on-write); chunks nobody else holds
+// are edited in place with no locking.
+class VoxelMap {
+public:
+    typedef std::unordered_map<Vec3i, std::shared_ptr<Chunk>, Vec3iHash> ChunkTable;
+
+    VoxelMap();
+
+    MaterialId getMaterial(int x, int y, int z) const;
+    void setMaterial(int x, int y, int z, MaterialId material);
+    bool isSolid(int x, int y, int z) const;
+
+    uint32_t getAttribute(AttributeChannel channel, int x, int y, int z) const;
+    void setAttribute(AttributeChannel channel, int x, int y, int z, uint32_t value);
+
+    bool hasChunk(const Vec3i &chunk) const;
+    const Chunk *findChunk(const Vec3i &chunk) const;
+    // The non-const lookups are for editing and unshare the chunk first.
+    Chunk *findChunk(const Vec3i &chunk);
+    Chunk &getOrCreateChunk(const Vec3i &chunk);
+    // Puts cells in place of whatever is at chunk, for loaders that decode
+    // chunks off the map and then hand them over without a copy.
+    void setChunk(const Vec3i &chunk, std::shared_ptr<Chunk> cells);
+    // Reference to the current cells that stays valid and unchanged while
+    // the map keeps being edited. Null when there is no such chunk.
+    std::shared_ptr<const Chunk> shareChunk(const Vec3i &chunk) const;
+    void removeChunk(const Vec3i &chunk);
+    // For code that edits a Chunk directly instead of through the setters.
+    void markChunkChanged(const Vec3i &chunk);
+    const ChunkTable &getChunks() const;
+    size_t getChunkCount() const;
+
+    // Drops empty chunks and shrinks every palette.
+    void compact();
+    void clear();
+    size_t memoryUsage() const;
+
+    // Immutable view of the whole map, safe to read from other threads.
+    std::shared_ptr<const MapSnapshot> snapshot() const;
+
+    uint64_t getVersion() const;
+    ChangeTracker &getChanges();
+
+    MaterialRegistry &getMaterials();
+    const MaterialRegistry &getMaterials() const;
+
+    // Views compare it against the style they meshed with; changing it
+    // records no chunk changes.
+    SurfaceStyle getSurfaceStyle() const;
+    void setSurfaceStyle(SurfaceStyle style);
+
+private:
+    static Chunk *unshare(std::shared_ptr<Chunk> &slot);
+    void cellChanged(const Vec3i &chunk, Chunk &cells, int lx, int ly, int lz);
+    void chunkRemoved(const Vec3i &chunk);
+
+    ChunkTable mChunks;
+    uint64_t mVersion;
+    ChangeTracker mChanges;
+    MaterialRegistry mMaterials;
+    SurfaceStyle mSurfaceStyle;
+};
+
+// The map as it was when VoxelMap::snapshot() was called. Holds its own
+// references to the chunks, so it can outlive edits and the map itself.
+class MapSnapshot {
+public:
+    typedef std::unordered_map<Vec3i, std::shared_ptr<const Chunk>, Vec3iHash> ChunkTable;
+
+    MaterialId getMaterial(int x, int y, int z) const;
+    bool isSolid(int x, int y, int z) const;
+    uint32_t getAttribute(AttributeChannel channel, int x, int y, int z) const;
+
+    const Chunk *findChunk(const Vec3i &chunk) const;
+    const ChunkTable &getChunks() const;
+    size_t getChunkCount() const;
+
+    uint64_t getVersion() const;
+    const MaterialRegistry &getMaterials() const;
+
+private:
+    friend class VoxelMap;
+
+    ChunkTable mChunks;
+    uint64_t mVersion;
+    MaterialRegistry mMaterials;
+};
+
+} // namespace vox
+
+#endif // VOXELMAP_H
@@ -0,0 +1,70 @@
+#ifndef VOXELTYPES_H
+#define VOXELTYPES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace vox {
+
+typedef uint16_t MaterialId;
+
+// Material 0 is always empty space.
+const MaterialId AIR = 0;
+
+// Chunks are cubes of CHUNK_SIZE cells along each axis.
+const int CHUNK_BITS = 5;
+const int CHUNK_SIZE = 1 << CHUNK_BITS;
+const int CHUNK_MASK = CHUNK_SIZE - 1;
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Optional per-voxel channels stored next to the material.
+enum AttributeChannel {
+    ATTR_DENSITY = 0,
+    ATTR_WEIGHT,
+    ATTR_AFFECTOR,
+    ATTR_COUNT
+};
+
+struct Vec3i {
+    int x, y, z;
+
+    Vec3i() : x(0), y(0), z(0) {}
+    Vec3i(int x, int y, int z) : x(x), y(y), z(z) {}
+
+    bool operator==(const Vec3i &o) const { return x == o.x && y == o.y && z == o.z; }
+    bool operator!=(const Vec3i &o) const { return !(*this == o); }
+    Vec3i operator+(const Vec3i &o) const { return Vec3i(x + o.x, y + o.y, z + o.z); }
+    Vec3i operator-(const Vec3i &o) const { return Vec3i(x - o.x, y - o.y, z - o.z); }
+};
+
+struct Vec3iHash {
+    size_t operator()(const Vec3i &v) const {
+        uint64_t h = uint64_t(uint32_t(v.x)) * 0x9E3779B97F4A7C15ull;
+        h ^= uint64_t(uint32_t(v.y)) * 0xC2B2AE3D27D4EB4Full;
+        h ^= uint64_t(uint32_t(v.z)) * 0x165667B19E3779F9ull;
+        return size_t(h ^ (h >> 29));
+    }
+};
+
+// Chunk containing a world coordinate (floor division).
+inline int chunkCoord(int world) {
+    return world >> CHUNK_BITS;
+}
+
+inline int localCoord(int world) {
+    return world & CHUNK_MASK;
+}
+
+inline Vec3i chunkOf(const Vec3i &world) {
+    return Vec3i(chunkCoord(world.x), chunkCoord(world.y), chunkCoord(world.z));
+}
+
+// Linear cell index inside a chunk, x fastest (same order as main.cpp's grid).
+inline int cellIndex(int lx, int ly, int lz) {
+    return lx + (ly << CHUNK_BITS) + (lz << (2 * CHUNK_BITS));
+}
+
+} // namespace vox
+
+#endif // VOXELTYPES_H
@@ -0,0 +1,81 @@
+# Core voxel library shared by the editors and the command line tools.
+# Plain C++, no Qt or rendering dependencies.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CONFIG += c++17
+
+# SSE2 kernels are used on x86-64 by default, CONFIG+=avx2 selects AVX2.
+avx2 {
+    QMAKE_CXXFLAGS += -mavx2 -mpopcnt
+}
+
+SOURCES += \
+    $$PWD/PaletteStorage.cpp \
+    $$PWD/Material.cpp \
+    $$PWD/Chunk.cpp \
+    $$PWD/ChangeTracker.cpp \
+    $$PWD/VoxelMap.cpp \
+    $$PWD/OccupancyKernels.cpp \
+    $$PWD/NoiseKernels.cpp \
+    $$PWD/DiffusionKernels.cpp \
+    $$PWD/OccupancyMask.cpp \
+    $$PWD/VoxelLighting.cpp \
+    $$PWD/ChunkMesher.cpp \
+    $$PWD/GreedyMesher.cpp \
+    $$PWD/SurfaceMesher.cpp \
+    $$PWD/MeshExport.cpp \
+    $$PWD/MapTools.cpp \
+    $$PWD/TerrainGenerator.cpp \
+    $$PWD/VoxelCollider.cpp \
+    $$PWD/SpatialHash.cpp \
+    $$PWD/LocalAvoidance.cpp \
+    $$PWD/LineOfSight.cpp \
+    $$PWD/DistanceField.cpp \
+    $$PWD/GridPathfinder.cpp \
+    $$PWD/PathSmoother.cpp \
+    $$PWD/MeshVoxelizer.cpp \
+    $$PWD/CellularPhysics.cpp \
+    $$PWD/DiffusionField.cpp \
+    $$PWD/MapFile.cpp \
+    $$PWD/Autosaver.cpp \
+    $$PWD/Parallel.cpp \
+    $$PWD/VoxFile.cpp \
+    $$PWD/RegionFile.cpp
+
+HEADERS += \
+    $$PWD/VoxelTypes.h \
+    $$PWD/PaletteStorage.h \
+    $$PWD/Material.h \
+    $$PWD/Chunk.h \
+    $$PWD/ChangeTracker.h \
+    $$PWD/VoxelMap.h \
+    $$PWD/OccupancyKernels.h \
+    $$PWD/NoiseKernels.h \
+    $$PWD/DiffusionKernels.h \
+    $$PWD/OccupancyMask.h \
+    $$PWD/VoxelLighting.h \
+    $$PWD/ChunkMesher.h \
+    $$PWD/GreedyMesher.h \
+    $$PWD/SurfaceMesher.h \
+    $$PWD/MeshExport.h \
+    $$PWD/MapTools.h \
+    $$PWD/TerrainGenerator.h \
+    $$PWD/VoxelCollider.h \
+    $$PWD/SpatialHash.h \
+    $$PWD/LocalAvoidance.h \
+    $$PWD/LineOfSight.h \
+    $$PWD/DistanceField.h \
+    $$PWD/GridPathfinder.h \
+    $$PWD/PathSmoother.h \
+    $$PWD/MeshVoxelizer.h \
+    $$PWD/CellularPhysics.h \
+    $$PWD/DiffusionField.h \
+    $$PWD/Serialization.h \
+    $$PWD/MapFile.h \
+    $$PWD/Autosaver.h \
+    $$PWD/Parallel.h \
+    $$PWD/Import.h \
+    $$PWD/VoxFile.h \
+    $$PWD/RegionFile.h
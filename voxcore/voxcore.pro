@@ -0,0 +1,6 @@
+TEMPLATE = lib
+TARGET = voxcore
+CONFIG += staticlib
+CONFIG -= qt
+
+include(voxcore.pri)
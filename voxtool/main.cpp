@@ -0,0 +1,380 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MapFile.h"
+#include "MapTools.h"
+#include "MeshExport.h"
+#include "Parallel.h"
+#include "RegionFile.h"
+#include "TerrainGenerator.h"
+#include "VoxFile.h"
+
+namespace {
+
+struct ToolOptions {
+    int threads;
+    bool stats;
+    std::vector<std::string> args;
+
+    ToolOptions() : threads(0), stats(false) {}
+};
+
+struct CommandEntry {
+    const char *name;
+    const char *usage;
+    int (*run)(const ToolOptions &, vox::ThreadPool &);
+};
+
+class Timer {
+public:
+    Timer() : mStart(std::chrono::steady_clock::now()) {}
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point mStart;
+};
+
+bool endsWith(const std::string &s, const char *suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool parseInt(const std::string &text, int &value) {
+    char *end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end || parsed < -(1L << 30) || parsed > (1L << 30)) {
+        std::fprintf(stderr, "voxtool: expected a number, got \"%s\"\n", text.c_str());
+        return false;
+    }
+    value = int(parsed);
+    return true;
+}
+
+bool parseVec(const std::vector<std::string> &args, size_t at, vox::Vec3i &v) {
+    return parseInt(args[at], v.x) && parseInt(args[at + 1], v.y) && parseInt(args[at + 2], v.z);
+}
+
+void printStats(const std::string &label, const vox::VoxelMap &map, vox::ThreadPool &pool) {
+    vox::MapStats stats;
+    computeMapStats(map, stats, &pool);
+    std::printf("%s: %zu chunks (%zu empty, %zu uniform, %zu with attributes), %llu solid voxels, %.1f MB in memory\n",
+                label.c_str(), stats.chunks, stats.emptyChunks, stats.uniformChunks, stats.attributeChunks,
+                (unsigned long long)stats.solidVoxels, stats.memoryBytes / (1024.0 * 1024.0));
+    if (!stats.bounds.empty()) {
+        vox::Vec3i size = stats.bounds.size();
+        std::printf("  bounds %d %d %d .. %d %d %d (%d x %d x %d)\n", stats.bounds.min.x, stats.bounds.min.y,
+                    stats.bounds.min.z, stats.bounds.max.x, stats.bounds.max.y, stats.bounds.max.z,
+                    size.x, size.y, size.z);
+    }
+    const vox::MaterialRegistry &materials = map.getMaterials();
+    for (size_t i = 1; i < stats.materialVoxels.size(); ++i) {
+        if (stats.materialVoxels[i]) {
+            const char *name = i < materials.size() ? materials.get(vox::MaterialId(i)).name.c_str() : "(unknown)";
+            std::printf("  material %zu %s: %llu voxels\n", i, name, (unsigned long long)stats.materialVoxels[i]);
+        }
+    }
+}
+
+// A .vxm map, a MagicaVoxel .vox or a directory of region files.
+bool loadInput(vox::VoxelMap &map, const std::string &path, vox::ThreadPool &pool) {
+    Timer timer;
+    std::string error;
+    vox::ImportOptions options;
+    options.pool = &pool;
+    bool ok;
+    if (std::filesystem::is_directory(path)) {
+        ok = vox::importRegions(map, path, options, nullptr, &error);
+    } else if (endsWith(path, ".vox")) {
+        ok = vox::importVox(map, path, options, nullptr, &error);
+    } else {
+        ok = vox::loadMap(map, path, &error);
+    }
+    if (!ok) {
+        std::fprintf(stderr, "voxtool: %s: %s\n", path.c_str(), error.c_str());
+        return false;
+    }
+    std::printf("loaded %s: %zu chunks in %.3f s\n", path.c_str(), map.getChunkCount(), timer.seconds());
+    return true;
+}
+
+// .vxm, .obj and .glb by extension, anything else is a region directory.
+bool saveOutput(const vox::VoxelMap &map, const std::string &path, vox::ThreadPool &pool) {
+    Timer timer;
+    std::string error;
+    bool ok;
+    if (endsWith(path, ".obj") || endsWith(path, ".glb")) {
+        vox::ExportOptions options;
+        options.pool = &pool;
+        vox::ExportStats stats;
+        ok = endsWith(path, ".glb") ? vox::exportGlb(map, path, options, &stats, &error)
+                                    : vox::exportObj(map, path, options, &stats, &error);
+        if (ok) {
+            std::printf("exported %s: %zu chunks, %llu vertices, %llu triangles, %.1f MB in %.3f s\n",
+                        path.c_str(), stats.chunks, (unsigned long long)stats.vertices,
+                        (unsigned long long)stats.triangles, stats.bytes / (1024.0 * 1024.0), stats.seconds);
+        }
+    } else {
+        ok = endsWith(path, ".vxm") ? vox::saveMap(map, path, &error) : vox::saveRegions(map, path, &pool, &error);
+        if (ok) {
+            std::printf("saved %s: %zu chunks in %.3f s\n", path.c_str(), map.getChunkCount(), timer.seconds());
+        }
+    }
+    if (!ok) {
+        std::fprintf(stderr, "voxtool: %s: %s\n", path.c_str(), error.c_str());
+    }
+    return ok;
+}
+
+bool reportProblems(const std::string &path, const vox::VoxelMap &map, vox::ThreadPool &pool) {
+    std::vector<std::string> problems = vox::validateMap(map, &pool);
+    for (const std::string &problem : problems) {
+        std::printf("%s: %s\n", path.c_str(), problem.c_str());
+    }
+    std::printf("%s: %s\n", path.c_str(), problems.empty() ? "ok" : "invalid");
+    return problems.empty();
+}
+
+int runStats(const ToolOptions &options, vox::ThreadPool &pool) {
+    if (options.args.empty()) {
+        return -1;
+    }
+    int result = 0;
+    for (const std::string &path : options.args) {
+        vox::VoxelMap map;
+        if (!loadInput(map, path, pool)) {
+            result = 1;
+            continue;
+        }
+        printStats(path, map, pool);
+    }
+    return result;
+}
+
+int runValidate(const ToolOptions &options, vox::ThreadPool &pool) {
+    if (options.args.empty()) {
+        return -1;
+    }
+    int result = 0;
+    for (const std::string &path : options.args) {
+        vox::VoxelMap map;
+        if (!loadInput(map, path, pool) || !reportProblems(path, map, pool)) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+// Runs the steps in the order given, each on the result of the last.
+int runProcess(const ToolOptions &options, vox::ThreadPool &pool) {
+    const std::vector<std::string> &args = options.args;
+    if (args.size() < 2) {
+        return -1;
+    }
+    std::unique_ptr<vox::VoxelMap> map(new vox::VoxelMap());
+    if (!loadInput(*map, args[0], pool)) {
+        return 1;
+    }
+    if (options.stats) {
+        printStats(args[0], *map, pool);
+    }
+
+    for (size_t i = 2; i < args.size();) {
+        const std::string &step = args[i];
+        std::unique_ptr<vox::VoxelMap> next(new vox::VoxelMap());
+        Timer timer;
+        if (step == "--crop" && i + 6 < args.size()) {
+            vox::VoxelBox box;
+            if (!parseVec(args, i + 1, box.min) || !parseVec(args, i + 4, box.max)) {
+                return 1;
+            }
+            vox::cropMap(*map, box, *next, &pool);
+            i += 7;
+        } else if (step == "--resize" && i + 3 < args.size()) {
+            vox::Vec3i size;
+            if (!parseVec(args, i + 1, size)) {
+                return 1;
+            }
+            vox::resizeMap(*map, size, *next, &pool);
+            i += 4;
+        } else if (step == "--rotate" && i + 2 < args.size()) {
+            int axis = args[i + 1] == "x" ? 0 : (args[i + 1] == "y" ? 1 : (args[i + 1] == "z" ? 2 : -1));
+            int turns;
+            if (axis < 0 || !parseInt(args[i + 2], turns)) {
+                return -1;
+            }
+            vox::rotateMap(*map, axis, turns, *next, &pool);
+            i += 3;
+        } else if (step == "--merge" && i + 4 < args.size()) {
+            vox::VoxelMap other;
+            vox::Vec3i offset;
+            if (!parseVec(args, i + 2, offset) || !loadInput(other, args[i + 1], pool)) {
+                return 1;
+            }
+            timer = Timer();
+            vox::mergeMap(*map, other, offset, &pool);
+            next.reset();
+            i += 5;
+        } else if (step == "--compress") {
+            size_t before = map->memoryUsage();
+            vox::compactMap(*map, &pool);
+            std::printf("  compacted %.1f MB to %.1f MB\n", before / (1024.0 * 1024.0),
+                        map->memoryUsage() / (1024.0 * 1024.0));
+            next.reset();
+            i += 1;
+        } else if (step == "--surface" && i + 1 < args.size()) {
+            if (args[i + 1] != "blocks" && args[i + 1] != "smooth") {
+                return -1;
+            }
+            map->setSurfaceStyle(args[i + 1] == "smooth" ? vox::SURFACE_SMOOTH : vox::SURFACE_BLOCKS);
+            next.reset();
+            i += 2;
+        } else if (step == "--validate") {
+            // Named after the output: it is the processed map that is checked.
+            if (!reportProblems(args[1], *map, pool)) {
+                return 1;
+            }
+            next.reset();
+            i += 1;
+        } else {
+            return -1;
+        }
+        if (next) {
+            next->setSurfaceStyle(map->getSurfaceStyle());
+            map.swap(next);
+        }
+        std::printf("%s: %zu chunks in %.3f s\n", step.c_str() + 2, map->getChunkCount(), timer.seconds());
+    }
+
+    if (options.stats) {
+        printStats(args[1], *map, pool);
+    }
+    return saveOutput(*map, args[1], pool) ? 0 : 1;
+}
+
+int runExport(const ToolOptions &options, vox::ThreadPool &pool) {
+    if (options.args.size() != 2) {
+        return -1;
+    }
+    if (!endsWith(options.args[1], ".obj") && !endsWith(options.args[1], ".glb")) {
+        std::fprintf(stderr, "voxtool: %s: export writes .obj or .glb\n", options.args[1].c_str());
+        return 1;
+    }
+    vox::VoxelMap map;
+    if (!loadInput(map, options.args[0], pool)) {
+        return 1;
+    }
+    if (options.stats) {
+        printStats(options.args[0], map, pool);
+    }
+    return saveOutput(map, options.args[1], pool) ? 0 : 1;
+}
+
+// Width and depth in voxels, rounded up to whole chunks.
+int runGenerate(const ToolOptions &options, vox::ThreadPool &pool) {
+    const std::vector<std::string> &args = options.args;
+    vox::TerrainSettings settings;
+    int width;
+    int depth;
+    if (args.size() < 3 || !parseInt(args[1], width) || !parseInt(args[2], depth) || width < 1 || depth < 1) {
+        return -1;
+    }
+    for (size_t i = 3; i < args.size(); ++i) {
+        int seed;
+        if (args[i] == "--seed" && i + 1 < args.size() && parseInt(args[i + 1], seed)) {
+            settings.seed = uint32_t(seed);
+            ++i;
+        } else if (args[i] == "--no-caves") {
+            settings.caves = false;
+        } else if (args[i] == "--no-dungeons") {
+            settings.dungeons = false;
+        } else {
+            return -1;
+        }
+    }
+
+    vox::VoxelMap map;
+    vox::TerrainGenerator generator(settings, map.getMaterials());
+    vox::Vec3i last((width - 1) / vox::CHUNK_SIZE, (settings.baseHeight + settings.heightRange) / vox::CHUNK_SIZE,
+                    (depth - 1) / vox::CHUNK_SIZE);
+    vox::TerrainStats stats;
+    generator.generate(map, vox::Vec3i(0, 0, 0), last, &pool, &stats);
+    std::printf("generated %zu chunks (%zu stored) in %.3f s, %.0f chunks/s\n", stats.chunks, stats.stored,
+                stats.seconds, stats.chunksPerSecond());
+    if (options.stats) {
+        printStats(args[0], map, pool);
+    }
+    return saveOutput(map, args[0], pool) ? 0 : 1;
+}
+
+const CommandEntry COMMANDS[] = {
+    {"stats", "stats <map>...", runStats},
+    {"validate", "validate <map>...", runValidate},
+    {"process", "process <in> <out> [--crop x0 y0 z0 x1 y1 z1] [--resize w h d] [--rotate x|y|z turns]\n"
+                "                  [--merge <map> x y z] [--compress] [--surface blocks|smooth] [--validate]...", runProcess},
+    {"export", "export <in> <out.obj|out.glb>", runExport},
+    {"generate", "generate <out> <width> <depth> [--seed N] [--no-caves] [--no-dungeons]", runGenerate},
+};
+
+void usage() {
+    std::printf("usage: voxtool [--threads N] [--stats] <command> [args...]\n");
+    for (const CommandEntry &entry : COMMANDS) {
+        std::printf("  voxtool %s\n", entry.usage);
+    }
+    std::printf("maps are read from .vxm, .vox or region directories and written to .vxm, .obj, .glb\n"
+                "or, for any other name, a region directory\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    ToolOptions options;
+    const CommandEntry *command = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--stats")) {
+            options.stats = true;
+        } else if (!std::strcmp(argv[i], "--help")) {
+            usage();
+            return 0;
+        } else if (!command) {
+            for (const CommandEntry &entry : COMMANDS) {
+                if (!std::strcmp(argv[i], entry.name)) {
+                    command = &entry;
+                }
+            }
+            if (!command) {
+                usage();
+                return 1;
+            }
+        } else {
+            // Step flags and negative coordinates belong to the command.
+            options.args.push_back(argv[i]);
+        }
+    }
+    if (!command || options.threads < 0) {
+        usage();
+        return 1;
+    }
+
+    Timer timer;
+    vox::ThreadPool pool(options.threads);
+    int result = command->run(options, pool);
+    if (result < 0) {
+        usage();
+        return 1;
+    }
+    if (options.stats) {
+        std::printf("%s took %.3f s on %d threads\n", command->name, timer.seconds(), pool.getThreadCount());
+    }
+    return result;
+}
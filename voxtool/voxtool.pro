@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = voxtool
+CONFIG += console
+CONFIG -= qt app_bundle
+
+include(../voxcore/voxcore.pri)
+
+SOURCES += main.cpp